@@ -0,0 +1,5 @@
+#define VERSION "4.5"
+#define MAJOR 4
+#define MINOR 5
+#define PATCH 0
+#define SINCE_TAG 0
@@ -0,0 +1,4 @@
+VERSION=4.5
+FULL_VERSION=4.5
+MAJOR_VER=4
+RELEASE=1
@@ -718,7 +718,7 @@ static int cfg_mask_handler(const char *optarg, void *value_addr,
 		case CFG_MASK_64:
 			if (nums[i] >= sizeof(uint64_t) * 8)
 				goto range_error;
-			*((long long *) value_addr) |= 1 << nums[i];
+			*((long long *) value_addr) |= 1ULL << nums[i];
 			break;
 		case CFG_MASK_32:
 			if (nums[i] >= sizeof(uint32_t) * 8)
@@ -33,12 +33,18 @@
 #include <switchtec/utils.h>
 #include <switchtec/endian.h>
 #include <switchtec/errors.h>
+#include <switchtec/ber.h>
+#include <switchtec/eye.h>
+#include <switchtec/eq.h>
+#include <switchtec/osa.h>
 
 #include <errno.h>
 #include <limits.h>
 #include <locale.h>
 #include <math.h>
+#include <signal.h>
 #include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 
 struct diag_common_cfg {
@@ -223,6 +229,170 @@ static int ltssm_log(int argc, char **argv) {
 	return ret;
 }
 
+static volatile sig_atomic_t diag_stop;
+
+static void diag_stop_handler(int signum)
+{
+	diag_stop = 1;
+}
+
+static void ltssm_monitor_print(FILE *f, struct switchtec_dev *dev,
+				const struct switchtec_ltssm_entry *e)
+{
+	time_t secs = e->time_us / 1000000;
+	char buf[32];
+
+	strftime(buf, sizeof(buf), "%F %T", localtime(&secs));
+	fprintf(f, "%s.%06u,%d,%08x,%.1fG,", buf,
+		(unsigned)(e->time_us % 1000000), e->port, e->timestamp,
+		e->link_rate);
+	if (switchtec_is_gen6(dev))
+		fprintf(f, "x%d,", e->link_width);
+	fprintf(f, "%s\n", switchtec_ltssm_str(e->link_state, 1, dev));
+}
+
+static void ltssm_monitor_summary(struct switchtec_dev *dev,
+				  struct switchtec_ltssm_collector *c)
+{
+	struct switchtec_ltssm_stats st;
+	const int *ports;
+	uint64_t total;
+	int nr_ports, i, j, k, top[3];
+
+	nr_ports = switchtec_ltssm_collector_ports(c, &ports);
+
+	printf("\nPort\tEntries\tRetrains\tLink Downs\tSpeed Changes\tGaps\tLongest Dwell\n");
+	for (i = 0; i < nr_ports; i++) {
+		if (switchtec_ltssm_collector_stats(c, ports[i], &st) ||
+		    !st.nr_entries)
+			continue;
+
+		printf("%d\t%llu\t%u\t\t%u\t\t%u\t\t%u\t", ports[i],
+		       (unsigned long long)st.nr_entries, st.retrains,
+		       st.link_downs, st.speed_changes, st.nr_gaps);
+
+		total = 0;
+		for (j = 0; j < SWITCHTEC_LTSSM_MAX_STATES; j++)
+			total += st.dwell[j];
+
+		/* the three states the link spent the most time in */
+		for (k = 0; k < ARRAY_SIZE(top); k++) {
+			top[k] = -1;
+			for (j = 0; j < SWITCHTEC_LTSSM_MAX_STATES; j++) {
+				if (!st.dwell[j] || (k > 0 && j == top[0]) ||
+				    (k > 1 && j == top[1]))
+					continue;
+				if (top[k] < 0 || st.dwell[j] > st.dwell[top[k]])
+					top[k] = j;
+			}
+			if (top[k] < 0)
+				break;
+
+			printf("%s%s %.1f%%", k ? ", " : "",
+			       switchtec_ltssm_str(top[k], 0, dev),
+			       100.0 * st.dwell[top[k]] / total);
+		}
+		printf("\n");
+	}
+}
+
+#define CMD_DESC_LTSSM_MONITOR "Continuously collect the LTSSM logs of all ports"
+static int ltssm_monitor(int argc, char **argv)
+{
+	struct switchtec_ltssm_collector *c;
+	const struct switchtec_ltssm_entry *entries;
+	int ret = 0, i, n;
+	unsigned polls;
+
+	static struct {
+		struct switchtec_dev *dev;
+		int port_id;
+		unsigned interval;
+		unsigned count;
+		unsigned ring_size;
+		FILE *out;
+		const char *out_filename;
+	} cfg = {
+		.port_id = -1,
+		.interval = 1000,
+		.ring_size = 1024,
+	};
+
+	const struct argconfig_options opts[] = {
+		DEVICE_OPTION,
+		{"port", 'p', "PORT_ID", CFG_NONNEGATIVE, &cfg.port_id,
+		 required_argument,
+		 "physical port ID to monitor (default: all ports)"},
+		{"interval", 'i', "MS", CFG_POSITIVE, &cfg.interval,
+		 required_argument,
+		 "time between polls of the logs (default: 1000)"},
+		{"count", 'n', "NUM", CFG_NONNEGATIVE, &cfg.count,
+		 required_argument,
+		 "number of polls (default: 0, run until interrupted)"},
+		{"ring", 'r', "NUM", CFG_POSITIVE, &cfg.ring_size,
+		 required_argument,
+		 "number of entries kept for each port (default: 1024)"},
+		{"output", 'o', "FILE", CFG_FILE_A, &cfg.out,
+		 required_argument,
+		 "append the entries to this file instead of printing them"},
+		{NULL}
+	};
+
+	argconfig_parse(argc, argv, CMD_DESC_LTSSM_MONITOR, opts, &cfg,
+			sizeof(cfg));
+
+	if (switchtec_is_gen3(cfg.dev)) {
+		fprintf(stderr,
+			"This command is not supported on Gen3 devices\n");
+		return -1;
+	}
+
+	if (!cfg.out)
+		cfg.out = stdout;
+
+	c = switchtec_ltssm_collector_open(cfg.dev,
+					   cfg.port_id < 0 ? NULL : &cfg.port_id,
+					   1, cfg.ring_size);
+	if (!c) {
+		switchtec_perror("ltssm_monitor");
+		return -1;
+	}
+
+	signal(SIGINT, diag_stop_handler);
+	signal(SIGTERM, diag_stop_handler);
+
+	fprintf(cfg.out, "Time,Phys Port,Timestamp,PCIe Rate,%sState\n",
+		switchtec_is_gen6(cfg.dev) ? "Link Width," : "");
+
+	for (polls = 0; !diag_stop &&
+	     (!cfg.count || polls < cfg.count); polls++) {
+		if (polls)
+			usleep(cfg.interval * 1000);
+
+		n = switchtec_ltssm_collector_poll(c, &entries);
+		if (n < 0) {
+			switchtec_perror("ltssm_monitor");
+			ret = n;
+			break;
+		}
+
+		for (i = 0; i < n; i++)
+			ltssm_monitor_print(cfg.out, cfg.dev, &entries[i]);
+		fflush(cfg.out);
+	}
+
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+
+	ltssm_monitor_summary(cfg.dev, c);
+
+	switchtec_ltssm_collector_close(c);
+	if (cfg.out != stdout)
+		fclose(cfg.out);
+
+	return ret;
+}
+
 static const struct argconfig_choice data_mode_choices[] = {
 	{"ADC", SWITCHTEC_DIAG_EYE_ADC,
 	 "ADC data mode"},
@@ -405,7 +575,7 @@ out_err:
 }
 
 static void print_eye_csv(FILE *f, struct range *X, struct range *Y,
-			  double *pixels, const char *title, int interval)
+			  const double *pixels, const char *title, int interval)
 {
 	size_t stride = RANGE_CNT(X);
 	int x, y, i, j = 0;
@@ -465,6 +635,147 @@ static void write_eye_csv_files(int port_id, int lane_id, int num_lanes,
 	}
 }
 
+static void eye_lane_init(struct switchtec_eye_lane *lane, int port_id,
+			  int lane_id, int switch_lane, int gen,
+			  struct range *X, struct range *Y)
+{
+	*lane = (struct switchtec_eye_lane) {
+		.port_id = port_id,
+		.lane_id = lane_id,
+		.switch_lane = switch_lane,
+		.link_gen = gen,
+		.x = *X,
+		.y = *Y,
+		.data_type = SWITCHTEC_EYE_DATA_FLOAT32,
+		.nr_pixels = RANGE_CNT(X) * RANGE_CNT(Y),
+	};
+}
+
+static struct switchtec_eye_writer *
+eye_writer_open(FILE *f, struct switchtec_dev *dev, int interval_ms,
+		const struct switchtec_diag_eye_params *params)
+{
+	struct switchtec_eye_capture_info info = {
+		.gen = switchtec_gen(dev),
+		.interval_ms = interval_ms,
+		.params = *params,
+	};
+	struct switchtec_eye_writer *w;
+
+	w = switchtec_eye_writer_open(f, &info, SWITCHTEC_EYE_WRITER_COMPRESS);
+	if (!w)
+		perror("writing eye data file");
+
+	return w;
+}
+
+static int write_eye_bin_file(FILE *f, const char *fname,
+			      struct switchtec_dev *dev, int port_id,
+			      int lane_id, int num_lanes, int interval_ms,
+			      int gen, struct range *X, struct range *Y,
+			      const struct switchtec_diag_eye_params *params,
+			      double *pixels, uint64_t *errors,
+			      uint64_t *samples)
+{
+	int stride = RANGE_CNT(X) * RANGE_CNT(Y);
+	struct switchtec_eye_writer *w;
+	struct switchtec_eye_lane lane;
+	int l, ret = 0;
+
+	w = eye_writer_open(f, dev, interval_ms, params);
+	if (!w)
+		return -1;
+
+	for (l = 0; l < num_lanes && !ret; l++) {
+		eye_lane_init(&lane, port_id, lane_id + l,
+			      switchtec_calc_lane_id(dev, port_id,
+						     lane_id + l, NULL),
+			      gen, X, Y);
+		if (errors)
+			ret = switchtec_eye_writer_add_raw(w, &lane,
+							   &errors[l * stride],
+							   &samples[l * stride]);
+		else
+			ret = switchtec_eye_writer_add(w, &lane,
+						       &pixels[l * stride]);
+	}
+
+	if (switchtec_eye_writer_close(w))
+		ret = -1;
+
+	if (ret) {
+		perror("writing eye data file");
+		return -1;
+	}
+
+	fprintf(stderr, "Wrote %d lanes to %s\n", num_lanes, fname);
+	return 0;
+}
+
+/*
+ * Load a lane of a binary eye data file: the given port and lane, or the
+ * first lane of the file if port_id is negative. *sw_gen is set to the
+ * generation of the switch that captured it.
+ */
+static double *load_eye_bin(const char *path, int port_id, int lane_id,
+			    struct range *X, struct range *Y, char *title,
+			    int *interval, int *gen,
+			    enum switchtec_gen *sw_gen)
+{
+	struct switchtec_eye_capture_info info;
+	struct switchtec_eye_lane lane;
+	struct switchtec_eye_file *f;
+	double *pixels = NULL;
+	int i, nr_lanes;
+
+	f = switchtec_eye_file_open(path);
+	if (!f) {
+		switchtec_perror(path);
+		return NULL;
+	}
+
+	nr_lanes = switchtec_eye_file_info(f, &info);
+	for (i = 0; i < nr_lanes; i++) {
+		if (switchtec_eye_file_lane(f, i, &lane)) {
+			switchtec_perror(path);
+			goto out;
+		}
+		if (port_id < 0 ||
+		    (lane.port_id == port_id && lane.lane_id == lane_id))
+			break;
+	}
+
+	if (i == nr_lanes) {
+		fprintf(stderr, "No data for port %d, lane %d in %s\n",
+			port_id, lane_id, path);
+		goto out;
+	}
+
+	pixels = calloc(lane.nr_pixels, sizeof(*pixels));
+	if (!pixels) {
+		perror("allocating pixels");
+		goto out;
+	}
+
+	if (switchtec_eye_file_pixels(f, i, pixels) < 0) {
+		switchtec_perror(path);
+		free(pixels);
+		pixels = NULL;
+		goto out;
+	}
+
+	*X = lane.x;
+	*Y = lane.y;
+	*interval = info.interval_ms;
+	*gen = lane.link_gen;
+	*sw_gen = info.gen;
+	eye_set_title(title, lane.port_id, lane.lane_id, lane.link_gen);
+
+out:
+	switchtec_eye_file_close(f);
+	return pixels;
+}
+
 static void eye_graph_data(struct range *X, struct range *Y, double *pixels,
 			   int *data, int *shades)
 {
@@ -545,13 +856,6 @@ static void crosshair_plot(struct range *X, struct range *Y, int *data,
 	}
 }
 
-static int crosshair_w2h(struct switchtec_diag_cross_hair *ch)
-{
-	return (ch->eye_right_lim - ch->eye_left_lim) *
-		(ch->eye_top_right_lim - ch->eye_bot_right_lim +
-		 ch->eye_top_left_lim - ch->eye_bot_right_lim);
-}
-
 struct crosshair_anim_data {
 	struct switchtec_dev *dev;
 	struct switchtec_diag_cross_hair ch_int;
@@ -645,11 +949,11 @@ static void crosshair_set_status(struct crosshair_anim_data *cad,
 		if (cad && cad->pixels) {
 			sprintf(status,
 				"Done    W2H=%d   Dwell Time: crosshair=200ms, eye=%dms",
-				crosshair_w2h(ch), cad->eye_interval);
+				switchtec_diag_cross_hair_w2h(ch), cad->eye_interval);
 		} else {
 			sprintf(status,
 				"Done    W2H=%d   Dwell Time: crosshair=200ms",
-				crosshair_w2h(ch));
+				switchtec_diag_cross_hair_w2h(ch));
 		}
 		break;
 	case SWITCHTEC_DIAG_CROSS_HAIR_ERROR:
@@ -801,11 +1105,11 @@ static int crosshair_graph(struct switchtec_dev *dev,
 		if (pixels)
 			sprintf(status,
 				" W2H=%d   Dwell Time: crosshair=200ms, eye=%dms",
-				crosshair_w2h(ch), eye_interval);
+				switchtec_diag_cross_hair_w2h(ch), eye_interval);
 		else
 			sprintf(status,
 				" W2H=%d   Dwell Time: crosshair=200ms",
-				crosshair_w2h(ch));
+				switchtec_diag_cross_hair_w2h(ch));
 
 		return graph_draw_win(X, Y, data, shades, title, 'T', 'V',
 				      status, NULL, NULL);
@@ -912,10 +1216,10 @@ static int crosshair_text(struct switchtec_diag_cross_hair *ch,
 	graph_draw_text(X, Y, data, title, 'T', 'V');
 	if (pixels)
 		printf("\n       W2H=%d   Dwell Time: crosshair=200ms, eye=%dms\n",
-		       crosshair_w2h(ch), eye_interval);
+		       switchtec_diag_cross_hair_w2h(ch), eye_interval);
 	else
 		printf("\n       W2H=%d   Dwell Time: crosshair=200ms\n",
-		       crosshair_w2h(ch));
+		       switchtec_diag_cross_hair_w2h(ch));
 
 	return 0;
 }
@@ -935,7 +1239,7 @@ static void crosshair_csv(FILE *f, struct switchtec_diag_cross_hair *ch,
 	fprintf(f, "bottom_right_limit, %d, %d\n", ch_right,
 		ch->eye_bot_right_lim);
 	fprintf(f, "interval_ms, 200\n");
-	fprintf(f, "w2h, %d\n", crosshair_w2h(ch));
+	fprintf(f, "w2h, %d\n", switchtec_diag_cross_hair_w2h(ch));
 }
 
 static void crosshair_set_title(char *title, int port, int lane, int gen)
@@ -1053,6 +1357,72 @@ static int load_crosshair_csv(FILE *f, struct switchtec_diag_cross_hair *ch,
 	return 0;
 }
 
+static int crosshair_sweep(struct switchtec_dev *dev, int timeout,
+			   enum output_format fmt)
+{
+	struct switchtec_diag_cross_hair_result res[SWITCHTEC_MAX_LANES];
+	struct switchtec_diag_cross_hair *ch;
+	const char *state;
+	int i, n, failed = 0;
+
+	fprintf(stderr, "Measuring the cross hair of all lanes\n");
+
+	n = switchtec_diag_cross_hair_sweep(dev, timeout * 1000, res,
+					    ARRAY_SIZE(res));
+	if (n < 0) {
+		switchtec_perror("cross hair sweep");
+		return -1;
+	}
+
+	if (fmt == FMT_CSV)
+		printf("port, lane, switch_lane, gen, state, left, right, "
+		       "top_left, top_right, bot_left, bot_right, w2h\n");
+	else
+		printf("Port Lane SwLane Gen State    Left Right TopL TopR BotL BotR    W2H\n");
+
+	for (i = 0; i < n; i++) {
+		ch = &res[i].ch;
+
+		if (ch->state == SWITCHTEC_DIAG_CROSS_HAIR_DONE) {
+			state = "done";
+		} else {
+			state = ch->state == SWITCHTEC_DIAG_CROSS_HAIR_ERROR ?
+				"error" : "timeout";
+			failed++;
+
+			if (fmt == FMT_CSV)
+				printf("%d, %d, %d, %d, %s, , , , , , , \n",
+				       res[i].port_id, res[i].port_lane,
+				       ch->lane_id, res[i].link_rate, state);
+			else
+				printf("%4d %4d %6d %3d %-7s\n",
+				       res[i].port_id, res[i].port_lane,
+				       ch->lane_id, res[i].link_rate, state);
+			continue;
+		}
+
+		if (fmt == FMT_CSV)
+			printf("%d, %d, %d, %d, %s, %d, %d, %d, %d, %d, %d, %d\n",
+			       res[i].port_id, res[i].port_lane, ch->lane_id,
+			       res[i].link_rate, state, ch->eye_left_lim,
+			       ch->eye_right_lim, ch->eye_top_left_lim,
+			       ch->eye_top_right_lim, ch->eye_bot_left_lim,
+			       ch->eye_bot_right_lim, res[i].w2h);
+		else
+			printf("%4d %4d %6d %3d %-7s %5d %5d %4d %4d %4d %4d %6d\n",
+			       res[i].port_id, res[i].port_lane, ch->lane_id,
+			       res[i].link_rate, state, ch->eye_left_lim,
+			       ch->eye_right_lim, ch->eye_top_left_lim,
+			       ch->eye_top_right_lim, ch->eye_bot_left_lim,
+			       ch->eye_bot_right_lim, res[i].w2h);
+	}
+
+	if (failed)
+		fprintf(stderr, "%d of %d lanes did not finish\n", failed, n);
+
+	return failed ? -1 : 0;
+}
+
 #define CMD_DESC_CROSS_HAIR "Measure Eye Cross Hair"
 
 static int crosshair(int argc, char **argv)
@@ -1077,6 +1447,8 @@ static int crosshair(int argc, char **argv)
 		const char *plot_filename;
 		FILE *crosshair_file;
 		const char *crosshair_filename;
+		int sweep;
+		int timeout;
 	} cfg = {
 		.fmt = FMT_DEFAULT,
 		.port_id = -1,
@@ -1117,11 +1489,26 @@ static int crosshair(int argc, char **argv)
 		 required_argument, "end voltage (v-start to 255)"},
 		{"v-step", 'S', "NUM", CFG_NONNEGATIVE, &cfg.y_range.step,
 		 required_argument, "voltage step (default: 5)"},
+		{"sweep", 'w', "", CFG_NONE, &cfg.sweep, no_argument,
+		 "measure all lanes at once and print a table of the results (text or csv format)"},
+		{"timeout", 'W', "SECS", CFG_NONNEGATIVE, &cfg.timeout,
+		 required_argument,
+		 "with --sweep, give up on lanes still measuring after this long (default: 0, no limit)"},
 		{NULL}};
 
 	argconfig_parse(argc, argv, CMD_DESC_CROSS_HAIR, opts, &cfg,
 			sizeof(cfg));
 
+	if (cfg.sweep) {
+		if (!cfg.dev) {
+			fprintf(stderr,
+				"Must specify a switchtec device with --sweep/-w\n");
+			return -1;
+		}
+
+		return crosshair_sweep(cfg.dev, cfg.timeout, cfg.fmt);
+	}
+
 	if (cfg.plot_file) {
 		pixels = load_eye_csv(cfg.plot_file, &cfg.x_range,
 				&cfg.y_range, subtitle, sizeof(subtitle),
@@ -1238,18 +1625,37 @@ out:
 	return ret;
 }
 
+static void eye_swap_lanes(void *a, void *b, size_t len)
+{
+	uint8_t *x = a, *y = b, tmp;
+
+	while (len--) {
+		tmp = *x;
+		*x++ = *y;
+		*y++ = tmp;
+	}
+}
+
+/*
+ * If errors and samples are given, they receive the raw counts of a
+ * capture in raw mode.
+ */
 static double *eye_observe_dev(struct switchtec_dev *dev, int port_id,
 			       int lane_id, int num_lanes, int mode, int interval,
-			       struct range *X, struct range *Y, int *gen)
+			       struct range *X, struct range *Y, int *gen,
+			       uint64_t *errors, uint64_t *samples)
 {
 	size_t stride = RANGE_CNT(X) * RANGE_CNT(Y);
 	size_t pixel_cnt = stride * num_lanes;
+	struct switchtec_diag_eye_batch batch = {
+		.lane_pixels = stride,
+		.errors = errors,
+		.samples = samples,
+	};
 	struct switchtec_status status;
-	int i, ret, first_lane, lane;
-	size_t lane_cnt[num_lanes];
-	int lane_mask[5] = {};
-	double tmp[500];
+	int ret, lane_mask[5] = {};
 	double *pixels;
+	int l, r;
 
 	ret = switchtec_calc_lane_mask(dev, port_id, lane_id, num_lanes,
 				       lane_mask, &status);
@@ -1258,18 +1664,15 @@ static double *eye_observe_dev(struct switchtec_dev *dev, int port_id,
 		return NULL;
 	}
 
-	for (i = 0; i < 4; i++) {
-		first_lane = ffs(lane_mask[i]);
-		if (first_lane)
-			break;
-	}
-
 	pixels = calloc(pixel_cnt, sizeof(*pixels));
 	if (!pixels) {
 		perror("allocating pixels");
 		return NULL;
 	}
 
+	memcpy(batch.lane_mask, lane_mask, sizeof(batch.lane_mask));
+	batch.pixels = pixels;
+
 	switchtec_diag_eye_cancel(dev);
 
 	ret = switchtec_diag_eye_set_mode(dev, mode);
@@ -1295,40 +1698,37 @@ static double *eye_observe_dev(struct switchtec_dev *dev, int port_id,
 
 	*gen = status.link_rate;
 
-	memset(lane_cnt, 0, sizeof(lane_cnt));
 	progress_start();
-	for (i = 0; i < pixel_cnt; i += ret) {
-		ret = switchtec_diag_eye_fetch(dev, tmp, ARRAY_SIZE(tmp),
-					       &lane);
-		if (ret == 0) {
-			fprintf(stderr, "No data for specified lane.\n");
-			goto out_err;
-		}
-
+	while (batch.fetched < pixel_cnt) {
+		ret = switchtec_diag_eye_fetch_batch(dev, &batch);
 		if (ret < 0) {
-			switchtec_perror("eye_fetch");
-			goto out_err;
-		}
-
-		if (ret > ARRAY_SIZE(tmp)) {
-			fprintf(stderr, "Not enough pixels allocated!\n");
+			if (errno == ENODATA)
+				fprintf(stderr, "No data for specified lane.\n");
+			else
+				switchtec_perror("eye_fetch");
 			goto out_err;
 		}
 
-		lane -= first_lane;
-
-		if (status.lane_reversal)
-			lane = num_lanes - lane - 1;
-
-		memcpy(&pixels[lane * stride + lane_cnt[lane]], tmp,
-		       ret * sizeof(double));
-		lane_cnt[lane] += ret;
-
-		progress_update_norate(i, pixel_cnt);
+		progress_update_norate(batch.fetched, pixel_cnt);
 	}
 
 	progress_finish(false);
 	fprintf(stderr, "\n");
+
+	/* the batch holds the lanes in switch order */
+	for (l = 0; status.lane_reversal && l < num_lanes / 2; l++) {
+		r = num_lanes - l - 1;
+		eye_swap_lanes(&pixels[l * stride], &pixels[r * stride],
+			       stride * sizeof(*pixels));
+		if (errors)
+			eye_swap_lanes(&errors[l * stride], &errors[r * stride],
+				       stride * sizeof(*errors));
+		if (samples)
+			eye_swap_lanes(&samples[l * stride],
+				       &samples[r * stride],
+				       stride * sizeof(*samples));
+	}
+
 	return pixels;
 
 out_err:
@@ -1338,8 +1738,7 @@ out_err:
 
 static int eye_graph(enum output_format fmt, struct range *X, struct range *Y,
 		     double *pixels, const char *title,
-		     struct switchtec_diag_cross_hair *ch,
-		     struct switchtec_dev *dev)
+		     struct switchtec_diag_cross_hair *ch, bool gen5)
 {
 	size_t pixel_cnt = RANGE_CNT(X) * RANGE_CNT(Y);
 	int data[pixel_cnt], shades[pixel_cnt];
@@ -1362,12 +1761,12 @@ static int eye_graph(enum output_format fmt, struct range *X, struct range *Y,
 
 		crosshair_plot(X, Y, data, shades, ch, chars);
 
-		sprintf(status, " W2H=%d", crosshair_w2h(ch));
+		sprintf(status, " W2H=%d", switchtec_diag_cross_hair_w2h(ch));
 		status_ptr = status;
 	}
 
 	if (fmt == FMT_TEXT) {
-		if (switchtec_is_gen5(dev))
+		if (gen5)
 			graph_draw_text_no_invert(X, Y, data, title, 'P', 'B');
 		else
 			graph_draw_text(X, Y, data, title, 'T', 'V');
@@ -1376,7 +1775,7 @@ static int eye_graph(enum output_format fmt, struct range *X, struct range *Y,
 		return 0;
 	}
 
-	if (switchtec_is_gen5(dev))
+	if (gen5)
 		return graph_draw_win(X, Y, data, shades, title, 'P', 'B',
 				      status_ptr, NULL, NULL);
 	else
@@ -1449,13 +1848,142 @@ static double *eye_capture_dev_gen5(struct switchtec_dev *dev,
 	return ber_data;
 }
 
+struct eye_all_ports {
+	struct switchtec_eye_writer *w;
+	int port_id[SWITCHTEC_DIAG_EYE_MAX_LANES];
+	int lane_id[SWITCHTEC_DIAG_EYE_MAX_LANES];
+	int gen[SWITCHTEC_DIAG_EYE_MAX_LANES];
+	struct range *Y;
+	int interval;
+	double ber;
+	int done, total;
+};
+
+static int eye_all_ports_lane(void *ctx, int lane, int num_phases,
+			      const double *ber_data)
+{
+	struct eye_all_ports *a = ctx;
+	struct range X = {.start = 0, .end = num_phases - 1, .step = 1};
+	struct switchtec_eye_metrics m;
+	struct switchtec_eye_lane l;
+	char title[128], fname[128];
+	FILE *f;
+
+	if (a->ber >= 0 &&
+	    !switchtec_eye_metrics(ber_data, 1, &X, a->Y, &a->ber, 1, &m))
+		fprintf(stderr,
+			"Port %d, Lane %d: width %d, height %d at BER %g\n",
+			a->port_id[lane], a->lane_id[lane], m.width, m.height,
+			a->ber);
+
+	if (a->w) {
+		eye_lane_init(&l, a->port_id[lane], a->lane_id[lane], lane,
+			      a->gen[lane], &X, a->Y);
+		if (switchtec_eye_writer_add(a->w, &l, ber_data)) {
+			perror("writing eye data file");
+			return -1;
+		}
+
+		fprintf(stderr, "Captured Port %d, Lane %d (%d/%d)\n",
+			a->port_id[lane], a->lane_id[lane], ++a->done,
+			a->total);
+		return 0;
+	}
+
+	eye_set_title(title, a->port_id[lane], a->lane_id[lane], a->gen[lane]);
+	snprintf(fname, sizeof(fname), "eye_port%d_lane%d.csv",
+		 a->port_id[lane], a->lane_id[lane]);
+
+	f = fopen(fname, "w");
+	if (!f) {
+		fprintf(stderr, "Unable to write CSV file '%s': %m\n", fname);
+		return -1;
+	}
+
+	print_eye_csv(f, &X, a->Y, ber_data, title, a->interval);
+	fclose(f);
+
+	fprintf(stderr, "Wrote %s (%d/%d)\n", fname, ++a->done, a->total);
+	return 0;
+}
+
+static int eye_capture_all_ports(struct switchtec_dev *dev,
+				 const struct switchtec_diag_eye_params *params,
+				 int max_batch, int interval, struct range *Y,
+				 double ber, FILE *out, const char *out_name)
+{
+	struct eye_all_ports a = {.Y = Y, .interval = interval, .ber = ber};
+	int lanes[SWITCHTEC_DIAG_EYE_MAX_LANES];
+	struct switchtec_status *status;
+	int nr_ports, nr_up = 0, p, l, lane, ret;
+
+	nr_ports = switchtec_status(dev, &status);
+	if (nr_ports < 0) {
+		switchtec_perror("status");
+		return -1;
+	}
+
+	for (p = 0; p < nr_ports; p++) {
+		if (!status[p].link_up)
+			continue;
+
+		nr_up++;
+		for (l = 0; l < status[p].neg_lnk_width; l++) {
+			lane = switchtec_calc_status_lane_id(&status[p], l);
+			if (lane < 0 || lane >= SWITCHTEC_DIAG_EYE_MAX_LANES)
+				continue;
+
+			a.port_id[lane] = status[p].port.phys_id;
+			a.lane_id[lane] = l;
+			a.gen[lane] = status[p].link_rate;
+			lanes[a.total++] = lane;
+		}
+	}
+
+	switchtec_status_free(status, nr_ports);
+
+	if (!a.total) {
+		fprintf(stderr, "No ports with the link up\n");
+		return -1;
+	}
+
+	if (out) {
+		a.w = eye_writer_open(out, dev, interval, params);
+		if (!a.w)
+			return -1;
+	}
+
+	fprintf(stderr, "Capturing %d lanes of %d ports\n", a.total, nr_up);
+
+	ret = switchtec_diag_eye_capture_lanes(dev, lanes, a.total, max_batch,
+					       params, eye_all_ports_lane, &a);
+	if (ret)
+		switchtec_perror("eye_capture");
+
+	if (a.w) {
+		if (switchtec_eye_writer_close(a.w)) {
+			perror("writing eye data file");
+			ret = -1;
+		} else {
+			fprintf(stderr, "Wrote %d lanes to %s\n", a.done,
+				out_name);
+		}
+	}
+
+	return ret ? -1 : 0;
+}
+
 #define CMD_DESC_EYE "Capture PCIe Eye Errors"
 
 static int eye(int argc, char **argv)
 {
 	struct switchtec_diag_cross_hair ch = {}, *ch_ptr = NULL;
+	struct switchtec_diag_eye_params params;
+	uint64_t *errors = NULL, *samples = NULL;
 	char title[128], subtitle[50];
+	enum switchtec_gen sw_gen = SWITCHTEC_GEN_UNKNOWN;
 	double *pixels = NULL;
+	size_t pixel_cnt;
 	int num_phases, ret, gen;
 
 	static struct {
@@ -1478,6 +2006,11 @@ static int eye(int argc, char **argv)
 		int intleav_sel;
 		uint64_t refclk;
 		int data_mode;
+		int all_ports;
+		int batch;
+		FILE *out_file;
+		const char *out_filename;
+		double ber;
 	} cfg = {
 		.fmt = FMT_DEFAULT,
 		.port_id = -1,
@@ -1498,6 +2031,7 @@ static int eye(int argc, char **argv)
 		.refclk = 100000,
 		.data_mode = SWITCHTEC_DIAG_EYE_ADC,
 		.eye_modes_gen6 = SWITCHTEC_DIAG_EYE_FULL,
+		.ber = -1,
 	};
 	const struct argconfig_options opts[] = {
 		DEVICE_OPTION_OPTIONAL,
@@ -1524,7 +2058,8 @@ static int eye(int argc, char **argv)
 		{"port", 'p', "PORT_ID", CFG_NONNEGATIVE, &cfg.port_id,
 		 required_argument, "physical port ID to observe"},
 		{"plot", 'P', "FILE", CFG_FILE_R, &cfg.plot_file,
-		 required_argument, "plot a CSV file from an earlier capture"},
+		 required_argument,
+		 "plot a CSV or binary eye data file from an earlier capture"},
 		{"t-start", 't', "NUM", CFG_NONNEGATIVE, &cfg.x_range.start,
 		 required_argument, "start time (0 to 63)"},
 		{"t-end", 'T', "NUM", CFG_NONNEGATIVE, &cfg.x_range.end,
@@ -1550,6 +2085,16 @@ static int eye(int argc, char **argv)
 		 required_argument, "Eye scan for a particular interleave (0 to 3) Gen6 only"},
 		{"refclk", 'r', "NUM", CFG_NONNEGATIVE, &cfg.refclk, required_argument,
 		 "Configures the number of ref clk cycles used to sample the data (0 to 48 bit num max) Gen 6 only"},
+		{"all-ports", 'a', "", CFG_NONE, &cfg.all_ports, no_argument,
+		 "capture every lane of every port with the link up, writing a CSV file per lane as it completes (Gen 5 and Gen 6 only)"},
+		{"batch", 'b', "NUM", CFG_NONNEGATIVE, &cfg.batch,
+		 required_argument,
+		 "with --all-ports, most lanes to capture at once (default: 0, as many as the switch accepts)"},
+		{"output", 'o', "FILE", CFG_FILE_W, &cfg.out_file,
+		 required_argument,
+		 "write the capture to a binary eye data file instead of CSV files or a graph (see eye-convert)"},
+		{"ber", 'B', "BER", CFG_DOUBLE, &cfg.ber, required_argument,
+		 "with --all-ports, print the eye width and height at this BER as each lane completes"},
 		{NULL}};
 
 	argconfig_parse(argc, argv, CMD_DESC_EYE, opts, &cfg,
@@ -1579,9 +2124,22 @@ static int eye(int argc, char **argv)
 	}
 
 	if (cfg.plot_file) {
-		pixels = load_eye_csv(cfg.plot_file, &cfg.x_range,
-				      &cfg.y_range, subtitle, sizeof(subtitle),
-				      &cfg.step_interval);
+		if (fread(subtitle, 1, 8, cfg.plot_file) == 8 &&
+		    !memcmp(subtitle, SWITCHTEC_EYE_FILE_MAGIC, 8)) {
+			pixels = load_eye_bin(cfg.plot_filename, cfg.port_id,
+					      cfg.lane_id, &cfg.x_range,
+					      &cfg.y_range, subtitle,
+					      &cfg.step_interval, &gen,
+					      &sw_gen);
+			if (!pixels)
+				return -1;
+		} else {
+			rewind(cfg.plot_file);
+			pixels = load_eye_csv(cfg.plot_file, &cfg.x_range,
+					      &cfg.y_range, subtitle,
+					      sizeof(subtitle),
+					      &cfg.step_interval);
+		}
 		if (!pixels) {
 			fprintf(stderr, "Unable to parse CSV file: %s\n",
 				cfg.plot_filename);
@@ -1605,7 +2163,7 @@ static int eye(int argc, char **argv)
 				"Must specify a switchtec device if not using -P\n");
 			return -1;
 		}
-		if (cfg.port_id < 0) {
+		if (cfg.port_id < 0 && !cfg.all_ports) {
 			fprintf(stderr, "Must specify a port ID with --port/-p\n");
 			return -1;
 		}
@@ -1631,7 +2189,7 @@ static int eye(int argc, char **argv)
 		return -1;
 	}
 
-	if (cfg.num_lanes > 1 && cfg.fmt != FMT_CSV) {
+	if (cfg.num_lanes > 1 && cfg.fmt != FMT_CSV && !cfg.out_file) {
 		fprintf(stderr, "--format/-f must be CSV if --num-lanes/-n is greater than 1\n");
 		return -1;
 	}
@@ -1641,6 +2199,37 @@ static int eye(int argc, char **argv)
 		return -1;
 	}
 
+	if (cfg.out_file && pixels) {
+		fprintf(stderr, "--output/-o cannot be used with --plot/-P\n");
+		free(pixels);
+		return -1;
+	}
+
+	params = (struct switchtec_diag_eye_params) {
+		.capture_depth = cfg.capture_depth,
+		.sar_sel = cfg.sar_sel,
+		.intleav_sel = cfg.intleav_sel,
+		.hstep = cfg.hstep,
+		.data_mode = cfg.data_mode,
+		.eye_mode = cfg.eye_modes_gen6,
+		.refclk = cfg.refclk,
+		.vstep = cfg.y_range.step,
+	};
+
+	if (cfg.all_ports) {
+		if (pixels || !(switchtec_is_gen5(cfg.dev) ||
+				switchtec_is_gen6(cfg.dev))) {
+			fprintf(stderr, "--all-ports is only supported for captures on Gen 5 and Gen 6 switches\n");
+			free(pixels);
+			return -1;
+		}
+
+		return eye_capture_all_ports(cfg.dev, &params, cfg.batch,
+					     cfg.step_interval, &cfg.y_range,
+					     cfg.ber, cfg.out_file,
+					     cfg.out_filename);
+	}
+
 	if (!pixels) {
 		if (switchtec_is_gen5(cfg.dev) || switchtec_is_gen6(cfg.dev)) {
 			pixels = eye_capture_dev_gen5(cfg.dev, cfg.port_id,
@@ -1656,29 +2245,321 @@ static int eye(int argc, char **argv)
 			cfg.x_range.end = num_phases - 1;
 		}
 		else {
+			/* keep the raw counts when writing an eye data file */
+			if (cfg.out_file && cfg.mode == SWITCHTEC_DIAG_EYE_RAW) {
+				pixel_cnt = RANGE_CNT(&cfg.x_range) *
+					RANGE_CNT(&cfg.y_range) * cfg.num_lanes;
+				errors = calloc(pixel_cnt, sizeof(*errors));
+				samples = calloc(pixel_cnt, sizeof(*samples));
+				if (!errors || !samples) {
+					perror("allocating eye counts");
+					free(errors);
+					free(samples);
+					return -1;
+				}
+			}
+
 			pixels = eye_observe_dev(cfg.dev, cfg.port_id,
 						 cfg.lane_id, cfg.num_lanes,
 						 cfg.mode, cfg.step_interval,
 						 &cfg.x_range, &cfg.y_range,
-						 &gen);
-			if (!pixels)
+						 &gen, errors, samples);
+			if (!pixels) {
+				free(errors);
+				free(samples);
 				return -1;
+			}
+		}
+		eye_set_title(title, cfg.port_id, cfg.lane_id, gen);
+	}
+
+	if (cfg.out_file) {
+		ret = write_eye_bin_file(cfg.out_file, cfg.out_filename,
+					 cfg.dev, cfg.port_id, cfg.lane_id,
+					 cfg.num_lanes, cfg.step_interval, gen,
+					 &cfg.x_range, &cfg.y_range, &params,
+					 pixels, errors, samples);
+		free(pixels);
+		free(errors);
+		free(samples);
+		return ret;
+	}
+
+	if (cfg.fmt == FMT_CSV) {
+		write_eye_csv_files(cfg.port_id, cfg.lane_id, cfg.num_lanes,
+				    cfg.step_interval, gen, &cfg.x_range,
+				    &cfg.y_range, pixels);
+		free(pixels);
+		return 0;
+	}
+
+	/* files record the switch that captured them, CSV files do not */
+	if (sw_gen == SWITCHTEC_GEN_UNKNOWN && cfg.dev)
+		sw_gen = switchtec_gen(cfg.dev);
+
+	ret = eye_graph(cfg.fmt, &cfg.x_range, &cfg.y_range, pixels, title,
+			ch_ptr, sw_gen == SWITCHTEC_GEN5);
+
+	free(pixels);
+	return ret;
+}
+
+#define CMD_DESC_EYE_CONVERT "Convert a binary eye data file to CSV files"
+
+static int eye_convert(int argc, char **argv)
+{
+	struct switchtec_eye_capture_info info;
+	struct switchtec_eye_lane lane;
+	struct switchtec_eye_file *f;
+	char title[128], fname[128];
+	double *pixels = NULL, *tmp;
+	size_t nr_alloc = 0;
+	int i, nr_lanes, ret = 0;
+	FILE *out;
+
+	static struct {
+		const char *eye_file;
+	} cfg = {};
+	const struct argconfig_options opts[] = {
+		{"eye_file", .cfg_type = CFG_STRING,
+		 .value_addr = &cfg.eye_file,
+		 .argument_type = required_positional,
+		 .help = "eye data file written by eye --output"},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_EYE_CONVERT, opts, &cfg,
+			sizeof(cfg));
+
+	f = switchtec_eye_file_open(cfg.eye_file);
+	if (!f) {
+		switchtec_perror(cfg.eye_file);
+		return -1;
+	}
+
+	nr_lanes = switchtec_eye_file_info(f, &info);
+	for (i = 0; i < nr_lanes; i++) {
+		if (switchtec_eye_file_lane(f, i, &lane)) {
+			switchtec_perror(cfg.eye_file);
+			ret = -1;
+			break;
+		}
+
+		if (lane.nr_pixels > nr_alloc) {
+			tmp = realloc(pixels, lane.nr_pixels * sizeof(*pixels));
+			if (!tmp) {
+				perror("allocating pixels");
+				ret = -1;
+				break;
+			}
+			pixels = tmp;
+			nr_alloc = lane.nr_pixels;
+		}
+
+		if (switchtec_eye_file_pixels(f, i, pixels) < 0) {
+			switchtec_perror(cfg.eye_file);
+			ret = -1;
+			break;
+		}
+
+		eye_set_title(title, lane.port_id, lane.lane_id,
+			      lane.link_gen);
+		snprintf(fname, sizeof(fname), "eye_port%d_lane%d.csv",
+			 lane.port_id, lane.lane_id);
+
+		out = fopen(fname, "w");
+		if (!out) {
+			fprintf(stderr, "Unable to write CSV file '%s': %m\n",
+				fname);
+			ret = -1;
+			continue;
+		}
+
+		print_eye_csv(out, &lane.x, &lane.y, pixels, title,
+			      info.interval_ms);
+		fclose(out);
+
+		fprintf(stderr, "Wrote %s\n", fname);
+	}
+
+	free(pixels);
+	switchtec_eye_file_close(f);
+	return ret;
+}
+
+#define CMD_DESC_EYE_METRICS "Measure the eye openings of an eye capture"
+
+#define EYE_METRICS_MAX_BER 8
+
+static int eye_metrics_parse_ber(const char *str, double *ber)
+{
+	char *end;
+	int n = 0;
+
+	while (n < EYE_METRICS_MAX_BER) {
+		ber[n] = strtod(str, &end);
+		if (end == str || ber[n] < 0)
+			return -1;
+		n++;
+
+		if (!*end)
+			return n;
+		if (*end != ',')
+			return -1;
+		str = end + 1;
+	}
+
+	return -1;
+}
+
+static int eye_metrics_lane(int port_id, int lane_id, int gen,
+			    const double *pixels, struct range *X,
+			    struct range *Y, const double *ber, int nr_ber,
+			    int min_width, int min_height, int contour)
+{
+	struct switchtec_eye_metrics m[EYE_METRICS_MAX_BER];
+	struct switchtec_eye_contour_row rows[RANGE_CNT(Y)];
+	int i, n, fail = 0, lane_fail;
+
+	if (switchtec_eye_metrics(pixels, 1, X, Y, ber, nr_ber, m)) {
+		perror("eye_metrics");
+		return -1;
+	}
+
+	for (i = 0; i < nr_ber; i++) {
+		lane_fail = !m[i].open || m[i].width < min_width ||
+			m[i].height < min_height;
+		fail |= lane_fail;
+
+		printf("%4d %4d %3d %8.1e %6d %6d %5d %5d %5d %5d %8.0f %s\n",
+		       port_id, lane_id, gen, m[i].ber, m[i].width,
+		       m[i].height, m[i].left, m[i].right, m[i].top,
+		       m[i].bottom, m[i].area, lane_fail ? "FAIL" : "PASS");
+	}
+
+	if (contour) {
+		n = switchtec_eye_contour(pixels, X, Y, ber[0], rows);
+		for (i = n - 1; i >= 0; i--)
+			printf("    y %4d: %4d .. %d\n", rows[i].y,
+			       rows[i].left, rows[i].right);
+	}
+
+	return fail;
+}
+
+static int eye_metrics(int argc, char **argv)
+{
+	struct switchtec_eye_capture_info info;
+	struct switchtec_eye_lane lane;
+	struct switchtec_eye_file *f;
+	double ber[EYE_METRICS_MAX_BER];
+	int i, nr_ber, nr_lanes, ret = 0, port_id, lane_id, gen, interval;
+	double *pixels = NULL, *tmp;
+	struct range X, Y;
+	size_t nr_alloc = 0;
+	char title[128];
+
+	static struct {
+		FILE *eye_file;
+		const char *eye_filename;
+		const char *ber;
+		int min_width;
+		int min_height;
+		int contour;
+	} cfg = {
+		.ber = "1e-6",
+	};
+	const struct argconfig_options opts[] = {
+		{"ber", 'b', "BER[,BER...]", CFG_STRING, &cfg.ber,
+		 required_argument,
+		 "BER thresholds to measure the eyes at (default: 1e-6)"},
+		{"min-width", 'w', "NUM", CFG_NONNEGATIVE, &cfg.min_width,
+		 required_argument,
+		 "fail lanes narrower than this at any of the thresholds"},
+		{"min-height", 'H', "NUM", CFG_NONNEGATIVE, &cfg.min_height,
+		 required_argument,
+		 "fail lanes lower than this at any of the thresholds"},
+		{"contour", 'c', "", CFG_NONE, &cfg.contour, no_argument,
+		 "print the contour of each eye at the first threshold"},
+		{"eye_file", .cfg_type = CFG_FILE_R,
+		 .value_addr = &cfg.eye_file,
+		 .argument_type = required_positional,
+		 .help = "CSV file or binary eye data file of a capture"},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_EYE_METRICS, opts, &cfg,
+			sizeof(cfg));
+
+	nr_ber = eye_metrics_parse_ber(cfg.ber, ber);
+	if (nr_ber < 0) {
+		fprintf(stderr, "Invalid BER thresholds (at most %d): %s\n",
+			EYE_METRICS_MAX_BER, cfg.ber);
+		return -1;
+	}
+
+	printf("Port Lane Gen      BER  Width Height  Left Right   Top Bottom    Area Result\n");
+
+	if (fread(title, 1, 8, cfg.eye_file) != 8 ||
+	    memcmp(title, SWITCHTEC_EYE_FILE_MAGIC, 8)) {
+		rewind(cfg.eye_file);
+		pixels = load_eye_csv(cfg.eye_file, &X, &Y, title,
+				      sizeof(title), &interval);
+		if (!pixels) {
+			fprintf(stderr, "Unable to parse CSV file: %s\n",
+				cfg.eye_filename);
+			return -1;
+		}
+
+		port_id = lane_id = gen = 0;
+		sscanf(title, "Eye Observation, Port %d, Lane %d, Gen %d",
+		       &port_id, &lane_id, &gen);
+
+		ret = eye_metrics_lane(port_id, lane_id, gen, pixels, &X, &Y,
+				       ber, nr_ber, cfg.min_width,
+				       cfg.min_height, cfg.contour);
+		free(pixels);
+		return ret;
+	}
+
+	f = switchtec_eye_file_open(cfg.eye_filename);
+	if (!f) {
+		switchtec_perror(cfg.eye_filename);
+		return -1;
+	}
+
+	nr_lanes = switchtec_eye_file_info(f, &info);
+	for (i = 0; i < nr_lanes; i++) {
+		if (switchtec_eye_file_lane(f, i, &lane)) {
+			switchtec_perror(cfg.eye_filename);
+			ret = -1;
+			break;
+		}
+
+		if (lane.nr_pixels > nr_alloc) {
+			tmp = realloc(pixels, lane.nr_pixels * sizeof(*pixels));
+			if (!tmp) {
+				perror("allocating pixels");
+				ret = -1;
+				break;
+			}
+			pixels = tmp;
+			nr_alloc = lane.nr_pixels;
 		}
-		eye_set_title(title, cfg.port_id, cfg.lane_id, gen);
-	}
 
-	if (cfg.fmt == FMT_CSV) {
-		write_eye_csv_files(cfg.port_id, cfg.lane_id, cfg.num_lanes,
-				    cfg.step_interval, gen, &cfg.x_range,
-				    &cfg.y_range, pixels);
-		free(pixels);
-		return 0;
-	}
+		if (switchtec_eye_file_pixels(f, i, pixels) < 0) {
+			switchtec_perror(cfg.eye_filename);
+			ret = -1;
+			break;
+		}
 
-	ret = eye_graph(cfg.fmt, &cfg.x_range, &cfg.y_range, pixels, title,
-			ch_ptr, cfg.dev);
+		if (eye_metrics_lane(lane.port_id, lane.lane_id, lane.link_gen,
+				     pixels, &lane.x, &lane.y, ber, nr_ber,
+				     cfg.min_width, cfg.min_height,
+				     cfg.contour))
+			ret = -1;
+	}
 
 	free(pixels);
+	switchtec_eye_file_close(f);
 	return ret;
 }
 
@@ -2150,6 +3031,228 @@ static int pattern(int argc, char **argv)
 	return print_pattern_mode(cfg.dev, &cfg.port, cfg.port_id);
 }
 
+#define CMD_DESC_BER_TEST "Run a timed BER test with the pattern generator/monitor"
+
+enum {
+	BER_REPORT_TEXT,
+	BER_REPORT_CSV,
+};
+
+static const struct argconfig_choice ber_report_fmt_choices[] = {
+	{"text", BER_REPORT_TEXT, "Per-lane report as a table"},
+	{"csv", BER_REPORT_CSV, "Per-lane report in CSV format"},
+	{}
+};
+
+static const char *ber_lane_status(const struct switchtec_ber_lane *l)
+{
+	if (l->disabled)
+		return "monitor disabled";
+	if (l->inject_missed)
+		return "injection missed";
+	if (!l->nr_samples)
+		return "no samples";
+	return "ok";
+}
+
+static void ber_test_report(const struct switchtec_ber_lane *lanes, int nr,
+			    int fmt, double confidence)
+{
+	const struct switchtec_ber_lane *l;
+
+	if (fmt == BER_REPORT_CSV)
+		printf("port,lane,samples,failed,seconds,errors,injected,"
+		       "ber,ber_lower,ber_upper,status\n");
+	else
+		printf("Port Lane  Samples  Errors    Injected  BER        "
+		       "%.0f%% Bounds             Status\n", confidence * 100);
+
+	for (l = lanes; l < lanes + nr; l++) {
+		if (fmt == BER_REPORT_CSV)
+			printf("%d,%d,%u,%u,%.3f,%llu,%llu,%g,%g,%g,%s\n",
+			       l->port_id, l->lane_id, l->nr_samples,
+			       l->nr_failed, l->seconds, l->errors,
+			       l->injected, l->ber, l->ber_lower,
+			       l->ber_upper, ber_lane_status(l));
+		else if (isnan(l->ber))
+			printf("%4d %4d  %7u  %-8llu  %-8llu  %-10s %-22s %s\n",
+			       l->port_id, l->lane_id, l->nr_samples,
+			       l->errors, l->injected, "-", "-",
+			       ber_lane_status(l));
+		else
+			printf("%4d %4d  %7u  %-8llu  %-8llu  %-10.2e "
+			       "%-9.2e - %-9.2e  %s\n",
+			       l->port_id, l->lane_id, l->nr_samples,
+			       l->errors, l->injected, l->ber, l->ber_lower,
+			       l->ber_upper, ber_lane_status(l));
+	}
+}
+
+static int ber_test(int argc, char **argv)
+{
+	const struct switchtec_ber_lane *lanes;
+	struct switchtec_ber_test *test;
+	struct switchtec_ber_cfg bcfg;
+	int port_ids[64];
+	unsigned long long errors;
+	unsigned samples, inject_s, s;
+	int nr_ports = 0, nr, i, missed = 0, ret = 0;
+	double worst;
+
+	static struct {
+		struct switchtec_dev *dev;
+		long long port_mask;
+		int pattern;
+		int link_speed;
+		int generate;
+		unsigned duration;
+		unsigned interval;
+		double confidence;
+		unsigned inject;
+		unsigned inject_at;
+		int fmt;
+	} cfg = {
+		.pattern = SWITCHTEC_DIAG_PATTERN_PRBS_7,
+		.duration = 10,
+		.interval = 1000,
+		.confidence = 0.95,
+		.fmt = BER_REPORT_TEXT,
+	};
+	const struct argconfig_options opts[] = {
+		DEVICE_OPTION,
+		{"ports", 'p', "LIST", CFG_MASK_64, &cfg.port_mask,
+		 required_argument, "physical ports to test, e.g. 0,1,8-11"},
+		{"pattern", 't', "PATTERN", CFG_CHOICES, &cfg.pattern,
+		 required_argument,
+		 "pattern to generate and monitor for (default: PRBS7)",
+		 .choices = all_pattern_types},
+		{"speed", 's', "SPEED", CFG_CHOICES, &cfg.link_speed,
+		 required_argument,
+		 "link speed that applies to the pattern generator with -g (default: GEN1 on Gen5)",
+		 .choices = pat_gen_link_speeds},
+		{"generate", 'g', "", CFG_NONE, &cfg.generate, no_argument,
+		 "also enable the pattern generator on the ports"},
+		{"duration", 'd', "SEC", CFG_POSITIVE, &cfg.duration,
+		 required_argument, "length of the test (default: 10)"},
+		{"interval", 'i', "MS", CFG_POSITIVE, &cfg.interval,
+		 required_argument,
+		 "time between error counter samples (default: 1000)"},
+		{"confidence", 'c', "LEVEL", CFG_DOUBLE, &cfg.confidence,
+		 required_argument,
+		 "confidence level of the BER bounds (default: 0.95)"},
+		{"inject", 'j', "NUM", CFG_NONNEGATIVE, &cfg.inject,
+		 required_argument,
+		 "inject this many errors into each lane to validate the checkers (TX must be looped back to RX)"},
+		{"inject_at", 'a', "SEC", CFG_NONNEGATIVE, &cfg.inject_at,
+		 required_argument,
+		 "time into the test to inject the errors at (default: 0)"},
+		{"format", 'f', "FMT", CFG_CHOICES, &cfg.fmt, required_argument,
+		 "report format (default: text)",
+		 .choices = ber_report_fmt_choices},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_BER_TEST, opts, &cfg,
+			sizeof(cfg));
+
+	for (i = 0; i < ARRAY_SIZE(port_ids); i++)
+		if (cfg.port_mask & (1ULL << i))
+			port_ids[nr_ports++] = i;
+
+	if (!nr_ports) {
+		fprintf(stderr, "Must specify -p / --ports\n");
+		return -1;
+	}
+
+	if (cfg.inject > 1000) {
+		fprintf(stderr, "Too many errors to inject. --inject / -j must be less than 1000\n");
+		return -1;
+	}
+
+	if (cfg.confidence <= 0 || cfg.confidence >= 1) {
+		fprintf(stderr, "--confidence / -c must be between 0 and 1\n");
+		return -1;
+	}
+
+	samples = (cfg.duration * 1000ULL + cfg.interval - 1) / cfg.interval;
+	inject_s = cfg.inject_at * 1000ULL / cfg.interval;
+	if (cfg.inject && inject_s >= samples) {
+		fprintf(stderr, "--inject_at / -a must be within the test duration\n");
+		return -1;
+	}
+
+	if (cfg.generate && !cfg.link_speed && switchtec_is_gen5(cfg.dev))
+		cfg.link_speed = SWITCHTEC_DIAG_PAT_LINK_GEN1;
+
+	bcfg.pattern = cfg.pattern;
+	bcfg.link_rate = cfg.link_speed;
+	bcfg.generate = cfg.generate;
+	bcfg.confidence = cfg.confidence;
+
+	test = switchtec_ber_start(cfg.dev, port_ids, nr_ports, &bcfg);
+	if (!test) {
+		switchtec_perror("ber_test");
+		return -1;
+	}
+
+	signal(SIGINT, diag_stop_handler);
+	signal(SIGTERM, diag_stop_handler);
+
+	for (s = 0; !diag_stop && s < samples; s++) {
+		/* right after a sample, so the next one sees all of them */
+		if (cfg.inject && s == inject_s &&
+		    switchtec_ber_inject(test, -1, cfg.inject)) {
+			switchtec_perror("pattern_inject");
+			ret = -1;
+			break;
+		}
+
+		sleep(cfg.interval / 1000);
+		usleep((cfg.interval % 1000) * 1000);
+
+		nr = switchtec_ber_sample(test);
+		if (nr < 0) {
+			switchtec_perror("ber_test");
+			ret = -1;
+			break;
+		}
+
+		nr = switchtec_ber_lanes(test, &lanes);
+		errors = 0;
+		worst = 0;
+		for (i = 0; i < nr; i++) {
+			errors += lanes[i].errors;
+			if (lanes[i].ber > worst)
+				worst = lanes[i].ber;
+		}
+
+		fprintf(stderr, "\r%.1fs: %llu errors, worst lane BER %.2e ",
+			(s + 1) * cfg.interval / 1000.0, errors, worst);
+	}
+	fprintf(stderr, "\n");
+
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+
+	nr = switchtec_ber_lanes(test, &lanes);
+	ber_test_report(lanes, nr, cfg.fmt, cfg.confidence);
+
+	for (i = 0; i < nr; i++)
+		missed += lanes[i].inject_missed;
+
+	if (switchtec_ber_stop(test) && !ret) {
+		switchtec_perror("ber_test");
+		ret = -1;
+	}
+
+	if (missed) {
+		fprintf(stderr, "Injected errors were not seen on %d lane(s)\n",
+			missed);
+		ret = -1;
+	}
+
+	return ret;
+}
+
 #define CMD_DESC_LIST_MRPC "List permissible MRPC commands"
 
 static int list_mrpc(int argc, char **argv)
@@ -3410,13 +4513,22 @@ static int osa_dump_config(int argc, char **argv)
 
 #define CMD_ORDERED_SET_ANALYZER_DUMP_DATA "dump osa data"
 
+static const char *osa_link_rate_str(int link_rate)
+{
+	const char *link_rate_str[] = {"UNKNOWN", "Gen1", "Gen2", "Gen3",
+				       "Gen4", "Gen5", "Gen6"};
+
+	if (link_rate < 0 || link_rate >= ARRAY_SIZE(link_rate_str))
+		return "UNKNOWN";
+
+	return link_rate_str[link_rate];
+}
+
 static int osa_dump_data(int argc, char **argv)
 {
 	int ret = 0;
 	int i;
 	struct switchtec_osa_capture_data *data;
-	const char *link_rate_str[] = {"UNKNOWN", "Gen1", "Gen2", "Gen3",
-				       "Gen4", "Gen5", "Gen6"};
 	static struct {
 		struct switchtec_dev *dev;
 		int stack_id;
@@ -3466,7 +4578,7 @@ static int osa_dump_data(int argc, char **argv)
 	for (i = 0; i < data->entry_count; i++) {
 		printf("%d\t", i);
 		printf("%ld\t\t", (long)data->entries[i].timestamp);
-		printf("%s\t\t", link_rate_str[data->entries[i].link_rate]);
+		printf("%s\t\t", osa_link_rate_str(data->entries[i].link_rate));
 		printf("%d\t\t", data->entries[i].counter);
 		printf("%s\t\t", data->entries[i].trigger_indication ? "Pre-Trigger" : "Post-Trigger");
 		printf("%s\t\t", data->entries[i].os_dropped ? "Yes" : "No");
@@ -3481,12 +4593,352 @@ static int osa_dump_data(int argc, char **argv)
 	return 0;
 }
 
+#define CMD_DESC_OSA_CAPTURE "Stream ordered set analyzer captures to a binary trace"
+
+static int osa_capture(int argc, char **argv)
+{
+	struct switchtec_osa_lane lanes[32 * 2 * 16];
+	struct switchtec_osa_stream *s;
+	int nr_lanes = 0, total = 0, written, all;
+	int stack, lane, dir, i, ret;
+
+	static struct {
+		struct switchtec_dev *dev;
+		int stack_mask;
+		int lane_mask;
+		int dir_mask;
+		FILE *out;
+		const char *out_filename;
+	} cfg = {
+		.dir_mask = 0x3,
+	};
+	const struct argconfig_options opts[] = {
+		DEVICE_OPTION,
+		{"output", 'o', "FILE", CFG_FILE_W, &cfg.out, required_argument,
+		 "trace file to write"},
+		{"stacks", 's', "LIST", CFG_MASK, &cfg.stack_mask,
+		 required_argument, "stacks to read, e.g. 0,1,3"},
+		{"lanes", 'l', "LIST", CFG_MASK, &cfg.lane_mask,
+		 required_argument, "lanes within each stack to read, e.g. 0-3"},
+		{"direction", 'd', "LIST", CFG_MASK, &cfg.dir_mask,
+		 required_argument,
+		 "directions to read, tx: 0 rx: 1 (default: 0,1)"},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_OSA_CAPTURE, opts, &cfg,
+			sizeof(cfg));
+
+	if (!cfg.out) {
+		fprintf(stderr, "An output file must be specified\n");
+		return -1;
+	}
+
+	if (!cfg.stack_mask || !cfg.lane_mask || !(cfg.dir_mask & 0x3)) {
+		fprintf(stderr,
+			"At least one stack, lane and direction must be specified\n");
+		return -1;
+	}
+
+	for (stack = 0; stack < 32; stack++) {
+		if (!(cfg.stack_mask & (1U << stack)))
+			continue;
+
+		ret = stack_id_check(cfg.dev, stack);
+		if (ret)
+			return ret;
+
+		for (lane = 0; lane < 16; lane++) {
+			if (!(cfg.lane_mask & (1U << lane)))
+				continue;
+
+			for (dir = 0; dir < 2; dir++) {
+				if (!(cfg.dir_mask & (1U << dir)))
+					continue;
+
+				lanes[nr_lanes].stack_id = stack;
+				lanes[nr_lanes].lane = lane;
+				lanes[nr_lanes].direction = dir;
+				nr_lanes++;
+			}
+		}
+	}
+
+	s = switchtec_osa_stream_open(cfg.dev, cfg.out, lanes, nr_lanes);
+	if (!s) {
+		switchtec_perror("osa_capture");
+		return -1;
+	}
+
+	while ((ret = switchtec_osa_stream_poll(s)) > 0) {
+		total += ret;
+		fprintf(stderr, "\rRead %d entries", total);
+	}
+	fprintf(stderr, "\n");
+
+	if (ret < 0)
+		switchtec_perror("osa_capture");
+
+	for (i = 0; i < nr_lanes; i++) {
+		switchtec_osa_stream_lane_entries(s, i, &written, &all);
+		printf("Stack %d lane %d %s: %d of %d entries\n",
+		       lanes[i].stack_id, lanes[i].lane,
+		       lanes[i].direction ? "RX" : "TX", written, all);
+	}
+
+	if (switchtec_osa_stream_close(s) && !ret) {
+		perror(cfg.out_filename);
+		ret = -1;
+	}
+	fclose(cfg.out);
+
+	return ret < 0 ? -1 : 0;
+}
+
+#define CMD_DESC_OSA_DECODE "Decode a binary ordered set analyzer trace"
+
+static const struct argconfig_choice osa_decode_fmt_choices[] = {
+	{"text", FMT_TEXT, "Display data in a simplified text format"},
+	{"csv", FMT_CSV, "Raw Data in CSV format"},
+	{}
+};
+
+static int osa_decode(int argc, char **argv)
+{
+	struct switchtec_osa_trace_info info;
+	struct switchtec_osa_trace_rec *rec;
+	struct switchtec_osa_capture_entry *e;
+	int ret, i;
+
+	static struct {
+		FILE *in;
+		const char *in_filename;
+		int fmt;
+	} cfg = {
+		.fmt = FMT_TEXT,
+	};
+	const struct argconfig_options opts[] = {
+		{"trace_file", .cfg_type=CFG_FILE_R, .value_addr=&cfg.in,
+		 .argument_type=required_positional,
+		 .help="trace file written by osa-capture"},
+		{"format", 'f', "FMT", CFG_CHOICES, &cfg.fmt, required_argument,
+		 "output format (default: text)",
+		 .choices=osa_decode_fmt_choices},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_OSA_DECODE, opts, &cfg,
+			sizeof(cfg));
+
+	if (switchtec_osa_trace_read_hdr(cfg.in, &info)) {
+		switchtec_perror(cfg.in_filename);
+		return -1;
+	}
+
+	rec = malloc(sizeof(*rec));
+	if (!rec) {
+		perror("osa_decode");
+		return -1;
+	}
+
+	if (cfg.fmt == FMT_CSV)
+		printf("stack,lane,direction,entry,timestamp,link_rate,counter,"
+		       "trigger,os_dropped,data0,data1,data2,data3\n");
+	else
+		printf("Stack\tLane\tDir\tEntry\tTimestamp\tLink Rate\tCounter\t\tTrigger Indication\tOS Dropped?\tOSA Data\n");
+
+	while ((ret = switchtec_osa_trace_read(cfg.in, rec)) > 0) {
+		for (i = 0; i < rec->nr_entries; i++) {
+			e = &rec->entries[i];
+			printf(cfg.fmt == FMT_CSV ?
+			       "%d,%d,%s,%d,%llu,%s,%u,%s,%s,0x%08x,0x%08x,0x%08x,0x%08x\n" :
+			       "%d\t%d\t%s\t%d\t%llu\t\t%s\t\t%u\t\t%s\t\t%s\t\t0x%08x 0x%08x 0x%08x 0x%08x\n",
+			       rec->lane.stack_id, rec->lane.lane,
+			       rec->lane.direction ? "RX" : "TX",
+			       rec->first_entry + i,
+			       (unsigned long long)e->timestamp,
+			       osa_link_rate_str(e->link_rate), e->counter,
+			       e->trigger_indication ? "Pre-Trigger" :
+						       "Post-Trigger",
+			       e->os_dropped ? "Yes" : "No",
+			       e->osa_data[0], e->osa_data[1],
+			       e->osa_data[2], e->osa_data[3]);
+		}
+	}
+
+	if (ret < 0)
+		switchtec_perror(cfg.in_filename);
+
+	free(rec);
+	fclose(cfg.in);
+	return ret < 0 ? -1 : 0;
+}
+
+#define CMD_DESC_EQ_SNAPSHOT "Save the equalization settings of all ports to a file"
+
+enum {
+	EQ_SNAPSHOT_BINARY,
+	EQ_SNAPSHOT_JSON,
+};
+
+static const struct argconfig_choice eq_snapshot_fmt_choices[] = {
+	{"binary", EQ_SNAPSHOT_BINARY, "Snapshot file that eq-diff can read"},
+	{"json", EQ_SNAPSHOT_JSON, "JSON for use by other tools"},
+	{}
+};
+
+static int eq_snapshot(int argc, char **argv)
+{
+	struct switchtec_eq_snapshot *snap;
+	struct switchtec_eq_port *p;
+	int ret;
+
+	static struct {
+		struct switchtec_dev *dev;
+		FILE *out;
+		const char *out_filename;
+		int fmt;
+	} cfg = {
+		.fmt = EQ_SNAPSHOT_BINARY,
+	};
+	const struct argconfig_options opts[] = {
+		DEVICE_OPTION,
+		{"output", 'o', "FILE", CFG_FILE_W, &cfg.out, required_argument,
+		 "snapshot file to write"},
+		{"format", 'f', "FMT", CFG_CHOICES, &cfg.fmt, required_argument,
+		 "file format (default: binary)",
+		 .choices=eq_snapshot_fmt_choices},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_EQ_SNAPSHOT, opts, &cfg,
+			sizeof(cfg));
+
+	if (!cfg.out) {
+		fprintf(stderr, "An output file must be specified\n");
+		return -1;
+	}
+
+	snap = switchtec_eq_snapshot(cfg.dev);
+	if (!snap) {
+		switchtec_perror("eq_snapshot");
+		fclose(cfg.out);
+		return -1;
+	}
+
+	if (cfg.fmt == EQ_SNAPSHOT_JSON)
+		ret = switchtec_eq_snapshot_write_json(snap, cfg.out);
+	else
+		ret = switchtec_eq_snapshot_write(snap, cfg.out);
+
+	if (ret)
+		perror(cfg.out_filename);
+
+	for (p = snap->ports; !ret && p < snap->ports + snap->nr_ports; p++)
+		printf("Port %d: x%d, %d lanes%s\n", p->port_id, p->link_width,
+		       p->nr_lanes, p->valid & SWITCHTEC_EQ_TX_TABLE ?
+		       ", TX EQ table" : "");
+
+	switchtec_eq_snapshot_free(snap);
+	fclose(cfg.out);
+
+	return ret;
+}
+
+#define CMD_DESC_EQ_DIFF "Compare two equalization snapshot files"
+
+static struct switchtec_eq_snapshot *eq_diff_read(FILE *f, const char *name)
+{
+	struct switchtec_eq_snapshot *snap;
+
+	snap = switchtec_eq_snapshot_read(f);
+	if (!snap)
+		switchtec_perror(name);
+	fclose(f);
+
+	return snap;
+}
+
+static int eq_diff(int argc, char **argv)
+{
+	struct switchtec_eq_snapshot *a, *b = NULL;
+	struct switchtec_eq_diff *diffs;
+	char field[32];
+	int nr, i;
+
+	static struct {
+		FILE *old;
+		const char *old_filename;
+		FILE *new;
+		const char *new_filename;
+		int threshold;
+	} cfg = {};
+	const struct argconfig_options opts[] = {
+		{"old_file", .cfg_type=CFG_FILE_R, .value_addr=&cfg.old,
+		 .argument_type=required_positional,
+		 .help="snapshot file written by eq-snapshot"},
+		{"new_file", .cfg_type=CFG_FILE_R, .value_addr=&cfg.new,
+		 .argument_type=required_positional,
+		 .help="snapshot file to compare it with"},
+		{"threshold", 't', "NUM", CFG_NONNEGATIVE, &cfg.threshold,
+		 required_argument,
+		 "only list lane values that changed by more than this"},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_EQ_DIFF, opts, &cfg,
+			sizeof(cfg));
+
+	a = eq_diff_read(cfg.old, cfg.old_filename);
+	if (a)
+		b = eq_diff_read(cfg.new, cfg.new_filename);
+	else
+		fclose(cfg.new);
+
+	if (!a || !b) {
+		switchtec_eq_snapshot_free(a);
+		return -1;
+	}
+
+	nr = switchtec_eq_snapshot_diff(a, b, cfg.threshold, &diffs);
+	if (nr < 0) {
+		perror("eq_diff");
+		goto out;
+	}
+
+	if (!nr) {
+		printf("No differences\n");
+		goto out;
+	}
+
+	printf("Port\tLane\t%-18s\tOld\tNew\n", "Field");
+	for (i = 0; i < nr; i++) {
+		if (diffs[i].lane_id < 0)
+			printf("%d\t-\t", diffs[i].port_id);
+		else
+			printf("%d\t%d\t", diffs[i].port_id, diffs[i].lane_id);
+		if (diffs[i].step_id < 0)
+			snprintf(field, sizeof(field), "%s", diffs[i].field);
+		else
+			snprintf(field, sizeof(field), "%s[%d]",
+				 diffs[i].field, diffs[i].step_id);
+		printf("%-18s\t%d\t%d\n", field, diffs[i].old_val,
+		       diffs[i].new_val);
+	}
+
+	free(diffs);
+
+out:
+	switchtec_eq_snapshot_free(a);
+	switchtec_eq_snapshot_free(b);
+	return nr < 0 ? -1 : 0;
+}
+
 static const struct cmd commands[] = {
 	CMD(crosshair,		CMD_DESC_CROSS_HAIR),
 	CMD(eye,		CMD_DESC_EYE),
+	CMD(eye_convert,	CMD_DESC_EYE_CONVERT),
+	CMD(eye_metrics,	CMD_DESC_EYE_METRICS),
 	CMD(list_mrpc,		CMD_DESC_LIST_MRPC),
 	CMD(loopback,		CMD_DESC_LOOPBACK),
 	CMD(pattern,		CMD_DESC_PATTERN),
+	CMD(ber_test,		CMD_DESC_BER_TEST),
 	CMD(port_eq_txcoeff,	CMD_DESC_PORT_EQ_TXCOEFF),
 	CMD(port_eq_txfslf,	CMD_DESC_PORT_EQ_TXFSLF),
 	CMD(port_eq_txtable,	CMD_DESC_PORT_EQ_TXTABLE),
@@ -3494,6 +4946,7 @@ static const struct cmd commands[] = {
 	CMD(rcvr_obj,		CMD_DESC_RCVR_OBJ),
 	CMD(refclk,		CMD_DESC_REF_CLK),
 	CMD(ltssm_log,		CMD_DESC_LTSSM_LOG),
+	CMD(ltssm_monitor,	CMD_DESC_LTSSM_MONITOR),
 	CMD(tlp_inject,		CMD_TLP_INJECT),
 	CMD(aer_event_gen,	CMD_DESC_AER_EVENT_GEN),
 	CMD(linkerr_inject,	CMD_DESC_LNKERR_INJECT),
@@ -3504,6 +4957,10 @@ static const struct cmd commands[] = {
 	CMD(osa_capture_control, CMD_ORDERED_SET_ANALYZER_CAP_CTRL),
 	CMD(osa_dump_config,	CMD_ORDERED_SET_ANALYZER_DUMP_CONF),
 	CMD(osa_dump_data,	CMD_ORDERED_SET_ANALYZER_DUMP_DATA),
+	CMD(osa_capture,	CMD_DESC_OSA_CAPTURE),
+	CMD(osa_decode,		CMD_DESC_OSA_DECODE),
+	CMD(eq_snapshot,	CMD_DESC_EQ_SNAPSHOT),
+	CMD(eq_diff,		CMD_DESC_EQ_DIFF),
 	{}
 };
 
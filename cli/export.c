@@ -0,0 +1,774 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Command Line Interface
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * A small Prometheus exporter: one thread samples every device at a
+ * fixed interval and formats the results into a response buffer, which
+ * is then sent as is to every scrape until the next sample. Scrapes
+ * therefore never touch the devices and cost the same regardless of how
+ * many devices and ports are exported.
+ */
+
+#include "config.h"
+#include "export.h"
+#include <switchtec/switchtec.h>
+#include <switchtec/utils.h>
+
+#include <stdio.h>
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#define EXPORT_MAX_TEMPS	4
+#define EXPORT_LABEL_LEN	96
+#define EXPORT_MAX_REQ		2048
+#define EXPORT_BUF_INIT		(64 * 1024)
+
+/* room in front of the body for the HTTP response header */
+#define EXPORT_HDR_LEN		256
+
+struct export_buf {
+	char *buf;
+	size_t len;
+	size_t cap;
+};
+
+struct export_dev {
+	struct switchtec_dev *dev;
+	const char *name;
+	struct switchtec_pmon_session *pmon;
+	struct switchtec_evcntr_sampler *evcntr;
+
+	int up;
+	double sample_secs;		//!< time the last sample took
+	struct switchtec_pmon_sample sample;
+	int nr_temps;
+	float temps[EXPORT_MAX_TEMPS];
+
+	/* label sets of each port, rebuilt when the port map changes */
+	int have_labels;
+	unsigned generation;
+	char labels[SWITCHTEC_MAX_PORTS][EXPORT_LABEL_LEN];
+
+	/* event counts since the exporter started, kept across port maps */
+	int ev_nr_ports;
+	unsigned ev_generation;
+	struct switchtec_port_id ev_ports[SWITCHTEC_MAX_PORTS];
+	char ev_labels[SWITCHTEC_MAX_PORTS][EXPORT_LABEL_LEN];
+	uint64_t ev_totals[SWITCHTEC_MAX_PORTS]
+			  [SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS];
+};
+
+struct export_ctx {
+	struct export_dev *devs;
+	int nr_devs;
+	unsigned pmon_flags;
+	int nr_events;
+	const char *event_names[SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS];
+
+	struct export_buf out;	//!< header room followed by the body
+	size_t resp_off;	//!< start of the complete response in out
+};
+
+static volatile sig_atomic_t export_stop;
+
+static void export_handler(int signum)
+{
+	export_stop = 1;
+}
+
+static uint64_t export_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int buf_printf(struct export_buf *b, const char *fmt, ...)
+{
+	va_list ap;
+	size_t cap;
+	char *buf;
+	int n;
+
+	while (1) {
+		va_start(ap, fmt);
+		n = vsnprintf(b->buf + b->len, b->cap - b->len, fmt, ap);
+		va_end(ap);
+
+		if (n < 0)
+			return -1;
+		if (b->len + n < b->cap) {
+			b->len += n;
+			return 0;
+		}
+
+		/* only grows while the first samples are formatted */
+		cap = b->cap * 2;
+		while (cap <= b->len + n)
+			cap *= 2;
+
+		buf = realloc(b->buf, cap);
+		if (!buf)
+			return -1;
+
+		b->buf = buf;
+		b->cap = cap;
+	}
+}
+
+static void escape_label(char *dst, size_t len, const char *src)
+{
+	size_t i = 0;
+
+	for (; *src && i + 2 < len; src++) {
+		if (*src == '\\' || *src == '"')
+			dst[i++] = '\\';
+		else if (*src == '\n')
+			continue;
+		dst[i++] = *src;
+	}
+
+	dst[i] = 0;
+}
+
+static void port_labels(char *buf, const char *dev_name,
+			const struct switchtec_port_id *p)
+{
+	snprintf(buf, EXPORT_LABEL_LEN,
+		 "device=\"%s\",partition=\"%d\",port=\"%d\"",
+		 dev_name, p->partition, p->phys_id);
+}
+
+/*
+ * Move the event totals over to a new port map. Ports that are still
+ * there keep counting up, new ones start from zero.
+ */
+static void export_ev_remap(struct export_dev *d,
+			    const struct switchtec_evcntr_sample *ev,
+			    const char *name)
+{
+	uint64_t totals[SWITCHTEC_MAX_PORTS]
+			      [SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS];
+	const struct switchtec_port_id *p;
+	int i, j;
+
+	memset(totals, 0, sizeof(totals));
+
+	for (i = 0; i < ev->nr_ports; i++) {
+		p = &ev->ports[i];
+		for (j = 0; j < d->ev_nr_ports; j++) {
+			if (d->ev_ports[j].phys_id == p->phys_id &&
+			    d->ev_ports[j].partition == p->partition) {
+				memcpy(totals[i], d->ev_totals[j],
+				       sizeof(totals[i]));
+				break;
+			}
+		}
+
+		d->ev_ports[i] = *p;
+		port_labels(d->ev_labels[i], name, p);
+	}
+
+	memcpy(d->ev_totals, totals, sizeof(totals));
+	d->ev_nr_ports = ev->nr_ports;
+	d->ev_generation = ev->generation;
+}
+
+static void export_dev_sample(struct export_ctx *ctx, struct export_dev *d)
+{
+	struct switchtec_evcntr_sample ev;
+	char name[EXPORT_LABEL_LEN / 2];
+	uint64_t start = export_now_us();
+	int ret, i, j;
+
+	ret = switchtec_pmon_sample(d->pmon, 0, &d->sample);
+	if (ret)
+		goto out;
+
+	escape_label(name, sizeof(name), d->name);
+
+	if (!d->have_labels || d->sample.generation != d->generation) {
+		for (i = 0; i < d->sample.nr_ports; i++)
+			port_labels(d->labels[i], name, &d->sample.ports[i]);
+		d->generation = d->sample.generation;
+		d->have_labels = 1;
+	}
+
+	ret = switchtec_die_temps(d->dev, EXPORT_MAX_TEMPS, d->temps);
+	d->nr_temps = ret > 0 ? ret : 0;
+	ret = 0;
+
+	if (!d->evcntr)
+		goto out;
+
+	ret = switchtec_evcntr_sampler_poll(d->evcntr, &ev);
+	if (ret)
+		goto out;
+
+	if (!d->ev_nr_ports || ev.generation != d->ev_generation)
+		export_ev_remap(d, &ev, name);
+
+	for (i = 0; i < d->ev_nr_ports; i++)
+		for (j = 0; j < ctx->nr_events; j++)
+			d->ev_totals[i][j] += ev.deltas[i * ev.nr_events + j];
+
+out:
+	if (ret && d->up)
+		switchtec_perror(d->name);
+	else if (!ret && !d->up)
+		fprintf(stderr, "%s: sampling resumed\n", d->name);
+
+	d->up = !ret;
+	d->sample_secs = (export_now_us() - start) / 1e6;
+}
+
+static int family(struct export_buf *b, const char *name, const char *type,
+		  const char *help)
+{
+	return buf_printf(b, "# HELP %s %s\n# TYPE %s %s\n", name, help,
+			  name, type);
+}
+
+static int format_devs(struct export_ctx *ctx, struct export_buf *b)
+{
+	struct export_dev *d;
+	char name[EXPORT_LABEL_LEN / 2];
+	int ret = 0, i;
+
+	ret |= family(b, "switchtec_up", "gauge",
+		      "Whether the last sample of the device succeeded");
+	for (d = ctx->devs; d < ctx->devs + ctx->nr_devs; d++) {
+		escape_label(name, sizeof(name), d->name);
+		ret |= buf_printf(b, "switchtec_up{device=\"%s\"} %d\n",
+				  name, d->up);
+	}
+
+	ret |= family(b, "switchtec_sample_duration_seconds", "gauge",
+		      "Time taken to sample the device");
+	for (d = ctx->devs; d < ctx->devs + ctx->nr_devs; d++) {
+		escape_label(name, sizeof(name), d->name);
+		ret |= buf_printf(b,
+			"switchtec_sample_duration_seconds{device=\"%s\"} %.6f\n",
+			name, d->sample_secs);
+	}
+
+	ret |= family(b, "switchtec_die_temperature_celsius", "gauge",
+		      "Die temperature");
+	for (d = ctx->devs; d < ctx->devs + ctx->nr_devs; d++) {
+		if (!d->up)
+			continue;
+		escape_label(name, sizeof(name), d->name);
+		for (i = 0; i < d->nr_temps; i++)
+			ret |= buf_printf(b,
+				"switchtec_die_temperature_celsius{device=\"%s\",sensor=\"%d\"} %.2f\n",
+				name, i, d->temps[i]);
+	}
+
+	return ret;
+}
+
+static int format_ports(struct export_ctx *ctx, struct export_buf *b)
+{
+	const struct switchtec_status *st;
+	const struct switchtec_bwcntr_res *bw;
+	struct export_dev *d;
+	int ret = 0, i;
+
+#define for_each_port(d, i) \
+	for (d = ctx->devs; d < ctx->devs + ctx->nr_devs; d++) \
+		for (i = 0; d->up && i < d->sample.nr_ports; i++)
+
+	ret |= family(b, "switchtec_port_link_up", "gauge",
+		      "Whether the link of the port is up");
+	for_each_port(d, i) {
+		st = &d->sample.status[i];
+		ret |= buf_printf(b, "switchtec_port_link_up{%s,upstream=\"%d\"} %d\n",
+				  d->labels[i], st->port.upstream, st->link_up);
+	}
+
+	ret |= family(b, "switchtec_port_link_width", "gauge",
+		      "Negotiated link width in lanes");
+	for_each_port(d, i) {
+		st = &d->sample.status[i];
+		ret |= buf_printf(b, "switchtec_port_link_width{%s} %d\n",
+				  d->labels[i], st->neg_lnk_width);
+	}
+
+	ret |= family(b, "switchtec_port_link_width_configured", "gauge",
+		      "Configured link width in lanes");
+	for_each_port(d, i) {
+		st = &d->sample.status[i];
+		ret |= buf_printf(b,
+				  "switchtec_port_link_width_configured{%s} %d\n",
+				  d->labels[i], st->cfg_lnk_width);
+	}
+
+	ret |= family(b, "switchtec_port_link_generation", "gauge",
+		      "PCIe generation of the link rate");
+	for_each_port(d, i) {
+		st = &d->sample.status[i];
+		ret |= buf_printf(b, "switchtec_port_link_generation{%s} %d\n",
+				  d->labels[i], st->link_rate);
+	}
+
+	ret |= family(b, "switchtec_port_ltssm_state", "gauge",
+		      "Raw LTSSM state of the port");
+	for_each_port(d, i) {
+		st = &d->sample.status[i];
+		ret |= buf_printf(b, "switchtec_port_ltssm_state{%s} %d\n",
+				  d->labels[i], st->ltssm);
+	}
+
+	if (ctx->pmon_flags & SWITCHTEC_PMON_BW) {
+		ret |= family(b, "switchtec_port_egress_bytes_total",
+			      "counter", "TLP bytes sent out of the port");
+		for_each_port(d, i) {
+			bw = &d->sample.bw[i];
+			ret |= buf_printf(b,
+				"switchtec_port_egress_bytes_total{%s,type=\"posted\"} %" PRIu64 "\n"
+				"switchtec_port_egress_bytes_total{%s,type=\"comp\"} %" PRIu64 "\n"
+				"switchtec_port_egress_bytes_total{%s,type=\"nonposted\"} %" PRIu64 "\n",
+				d->labels[i], bw->egress.posted,
+				d->labels[i], bw->egress.comp,
+				d->labels[i], bw->egress.nonposted);
+		}
+
+		ret |= family(b, "switchtec_port_ingress_bytes_total",
+			      "counter", "TLP bytes received by the port");
+		for_each_port(d, i) {
+			bw = &d->sample.bw[i];
+			ret |= buf_printf(b,
+				"switchtec_port_ingress_bytes_total{%s,type=\"posted\"} %" PRIu64 "\n"
+				"switchtec_port_ingress_bytes_total{%s,type=\"comp\"} %" PRIu64 "\n"
+				"switchtec_port_ingress_bytes_total{%s,type=\"nonposted\"} %" PRIu64 "\n",
+				d->labels[i], bw->ingress.posted,
+				d->labels[i], bw->ingress.comp,
+				d->labels[i], bw->ingress.nonposted);
+		}
+	}
+
+	if (ctx->pmon_flags & SWITCHTEC_PMON_LAT) {
+		ret |= family(b, "switchtec_port_latency_nanoseconds", "gauge",
+			      "Last (Gen3) or minimum latency of TLPs egressing "
+			      "the port over the last sample interval");
+		for_each_port(d, i)
+			ret |= buf_printf(b,
+				"switchtec_port_latency_nanoseconds{%s} %d\n",
+				d->labels[i], d->sample.lat_cur_ns[i]);
+
+		ret |= family(b, "switchtec_port_latency_max_nanoseconds",
+			      "gauge",
+			      "Maximum latency of TLPs egressing the port over "
+			      "the last sample interval");
+		for_each_port(d, i)
+			ret |= buf_printf(b,
+				"switchtec_port_latency_max_nanoseconds{%s} %d\n",
+				d->labels[i], d->sample.lat_max_ns[i]);
+	}
+
+#undef for_each_port
+
+	return ret;
+}
+
+static int format_events(struct export_ctx *ctx, struct export_buf *b)
+{
+	struct export_dev *d;
+	int ret = 0, i, j;
+
+	if (!ctx->nr_events)
+		return 0;
+
+	ret |= family(b, "switchtec_port_events_total", "counter",
+		      "Events counted on the port since the exporter started");
+	for (d = ctx->devs; d < ctx->devs + ctx->nr_devs; d++) {
+		for (i = 0; i < d->ev_nr_ports; i++) {
+			for (j = 0; j < ctx->nr_events; j++) {
+				ret |= buf_printf(b,
+					"switchtec_port_events_total{%s,event=\"%s\"} %" PRIu64 "\n",
+					d->ev_labels[i], ctx->event_names[j],
+					d->ev_totals[i][j]);
+			}
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Sample all devices and rebuild the response. The body is formatted
+ * after EXPORT_HDR_LEN bytes of room, so the header can be put right in
+ * front of it once its length is known and the whole response goes out
+ * with a single send().
+ */
+static int export_sample(struct export_ctx *ctx)
+{
+	struct export_buf *b = &ctx->out;
+	char hdr[EXPORT_HDR_LEN];
+	int i, n, ret = 0;
+
+	for (i = 0; i < ctx->nr_devs; i++)
+		export_dev_sample(ctx, &ctx->devs[i]);
+
+	b->len = EXPORT_HDR_LEN;
+	ret |= format_devs(ctx, b);
+	ret |= format_ports(ctx, b);
+	ret |= format_events(ctx, b);
+	if (ret)
+		return -1;
+
+	n = snprintf(hdr, sizeof(hdr),
+		     "HTTP/1.0 200 OK\r\n"
+		     "Content-Type: text/plain; version=0.0.4\r\n"
+		     "Content-Length: %zu\r\n"
+		     "Connection: close\r\n\r\n",
+		     b->len - EXPORT_HDR_LEN);
+
+	ctx->resp_off = EXPORT_HDR_LEN - n;
+	memcpy(b->buf + ctx->resp_off, hdr, n);
+
+	return 0;
+}
+
+static void send_all(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = send(fd, buf, len, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return;
+
+		buf += n;
+		len -= n;
+	}
+}
+
+static void export_serve(struct export_ctx *ctx, int listen_fd)
+{
+	static const char not_found[] =
+		"HTTP/1.0 404 Not Found\r\n"
+		"Content-Type: text/plain\r\n"
+		"Connection: close\r\n\r\n"
+		"Metrics are at /metrics\n";
+	static const char bad_method[] =
+		"HTTP/1.0 405 Method Not Allowed\r\n"
+		"Allow: GET\r\n"
+		"Connection: close\r\n\r\n";
+	struct timeval tv = {.tv_sec = 1};
+	char req[EXPORT_MAX_REQ];
+	size_t len = 0;
+	ssize_t n;
+	char *path;
+	int fd;
+
+	fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0)
+		return;
+
+	/* a stalled client must not hold up sampling for long */
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	while (len < sizeof(req) - 1) {
+		n = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+		if (n <= 0)
+			break;
+
+		len += n;
+		req[len] = 0;
+		if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n"))
+			break;
+	}
+	req[len] = 0;
+
+	if (strncmp(req, "GET ", 4)) {
+		send_all(fd, bad_method, strlen(bad_method));
+		goto out;
+	}
+
+	path = req + 4;
+	path[strcspn(path, " ?\r\n")] = 0;
+
+	if (!strcmp(path, "/metrics"))
+		send_all(fd, ctx->out.buf + ctx->resp_off,
+			 ctx->out.len - ctx->resp_off);
+	else
+		send_all(fd, not_found, strlen(not_found));
+
+out:
+	close(fd);
+}
+
+static int listen_unix(const char *path)
+{
+	struct sockaddr_un sa = {.sun_family = AF_UNIX};
+	int fd;
+
+	if (strlen(path) >= sizeof(sa.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(sa.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) ||
+	    listen(fd, 16)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int listen_tcp(const char *addr)
+{
+	struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+		.ai_flags = AI_PASSIVE,
+	};
+	struct addrinfo *res, *ai;
+	char host[256] = "127.0.0.1";
+	const char *port = addr;
+	const char *colon;
+	int fd = -1, one = 1, ret;
+
+	colon = strrchr(addr, ':');
+	if (colon) {
+		snprintf(host, sizeof(host), "%.*s", (int)(colon - addr), addr);
+		port = colon + 1;
+
+		/* allow "[::1]:port" */
+		if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+			host[strlen(host) - 1] = 0;
+			memmove(host, host + 1, strlen(host));
+		}
+	}
+
+	ret = getaddrinfo(host[0] ? host : NULL, port, &hints, &res);
+	if (ret) {
+		fprintf(stderr, "%s: %s\n", addr, gai_strerror(ret));
+		errno = EINVAL;
+		return -2;
+	}
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (!bind(fd, ai->ai_addr, ai->ai_addrlen) && !listen(fd, 16))
+			break;
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(res);
+	return fd;
+}
+
+static void export_free(struct export_ctx *ctx)
+{
+	int i;
+
+	for (i = 0; i < ctx->nr_devs; i++) {
+		switchtec_evcntr_sampler_close(ctx->devs[i].evcntr);
+		switchtec_pmon_session_close(ctx->devs[i].pmon);
+	}
+
+	free(ctx->devs);
+	free(ctx->out.buf);
+}
+
+static int export_init(struct export_ctx *ctx, struct switchtec_dev **devs,
+		       int nr_devs, unsigned pmon_flags,
+		       const enum switchtec_evcntr_type_mask *events,
+		       int nr_events)
+{
+	struct export_dev *d;
+	int i, mask;
+
+	ctx->pmon_flags = pmon_flags;
+	ctx->nr_events = nr_events;
+	for (i = 0; i < nr_events; i++) {
+		mask = events[i];
+		ctx->event_names[i] = switchtec_evcntr_type_str(&mask);
+	}
+
+	ctx->devs = calloc(nr_devs, sizeof(*ctx->devs));
+	ctx->out.buf = malloc(EXPORT_BUF_INIT);
+	if (!ctx->devs || !ctx->out.buf) {
+		perror("export");
+		return -1;
+	}
+	ctx->out.cap = EXPORT_BUF_INIT;
+	ctx->nr_devs = nr_devs;
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &ctx->devs[i];
+		d->dev = devs[i];
+		d->name = switchtec_name(devs[i]);
+		d->up = 1;
+
+		/* latency gauges cover one interval, the byte counters all */
+		d->pmon = switchtec_pmon_session_open(d->dev, pmon_flags |
+						      SWITCHTEC_PMON_LAT_CLEAR);
+		if (!d->pmon) {
+			switchtec_perror(d->name);
+			return -1;
+		}
+
+		if (!nr_events)
+			continue;
+
+		d->evcntr = switchtec_evcntr_sampler_open(d->dev, events,
+							  nr_events);
+		if (!d->evcntr) {
+			switchtec_perror(d->name);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Serve metrics of devices over HTTP until interrupted
+ * @param[in] devs	Devices to export
+ * @param[in] nr_devs	Number of devices
+ * @param[in] addr	"[HOST:]PORT" or "unix:PATH" to listen on
+ * @param[in] interval	Seconds between samples
+ * @param[in] pmon_flags	Counters to sample (SWITCHTEC_PMON_BW/LAT)
+ * @param[in] events	Events to count on every port
+ * @param[in] nr_events	Number of entries in \p events
+ * @return 0 on success, -1 on error
+ */
+int export_main(struct switchtec_dev **devs, int nr_devs, const char *addr,
+		unsigned interval, unsigned pmon_flags,
+		const enum switchtec_evcntr_type_mask *events, int nr_events)
+{
+	struct export_ctx ctx = {};
+	const char *unix_path = NULL;
+	struct pollfd pfd;
+	uint64_t now, next;
+	int fd, ret = -1;
+
+	if (export_init(&ctx, devs, nr_devs, pmon_flags, events, nr_events))
+		goto out;
+
+	if (!strncmp(addr, "unix:", 5)) {
+		unix_path = addr + 5;
+		fd = listen_unix(unix_path);
+	} else {
+		fd = listen_tcp(addr);
+	}
+
+	if (fd < 0) {
+		if (fd == -1)
+			perror(addr);
+		goto out;
+	}
+
+	fprintf(stderr, "Serving metrics of %d device%s on %s, press Ctrl-C to stop.\n",
+		nr_devs, nr_devs == 1 ? "" : "s", addr);
+
+	signal(SIGINT, export_handler);
+	signal(SIGTERM, export_handler);
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	next = export_now_us();
+
+	while (!export_stop) {
+		now = export_now_us();
+		if (now >= next) {
+			if (export_sample(&ctx)) {
+				perror("export");
+				break;
+			}
+
+			/* keep a fixed cadence, but skip missed samples */
+			next += interval * 1000000ULL;
+			if (next <= now)
+				next = now + interval * 1000000ULL;
+			continue;
+		}
+
+		if (poll(&pfd, 1, (next - now + 999) / 1000) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+
+		if (pfd.revents & POLLIN)
+			export_serve(&ctx, fd);
+	}
+
+	ret = export_stop ? 0 : -1;
+	close(fd);
+	if (unix_path)
+		unlink(unix_path);
+
+out:
+	export_free(&ctx);
+	return ret;
+}
+
+#else
+
+int export_main(struct switchtec_dev **devs, int nr_devs, const char *addr,
+		unsigned interval, unsigned pmon_flags,
+		const enum switchtec_evcntr_type_mask *events, int nr_events)
+{
+	fprintf(stderr, "export is only supported on Linux\n");
+	return -1;
+}
+
+#endif
@@ -123,7 +123,7 @@ static void gui_signals(void)
 
 /* Generate a port based string for the port windows */
 
-static void portid_str(char *str, struct switchtec_port_id *port_id)
+static void portid_str(char *str, const struct switchtec_port_id *port_id)
 {
 	sprintf(str, "%s (%d-%d-%d-%d)", port_id->upstream ? "^ " : "v ",
 		port_id->phys_id, port_id->partition, port_id->stack,
@@ -134,7 +134,7 @@ static void portid_str(char *str, struct switchtec_port_id *port_id)
  * top, down-stream ports at the bottom. */
 
 static void get_portlocs(struct portloc *portlocs, unsigned all_ports,
-			 struct switchtec_status *status, int numports)
+			 const struct switchtec_status *status, int numports)
 {
 	unsigned p, nup, ndown, iup, idown;
 	nup = ndown = iup = idown = 0;
@@ -181,7 +181,7 @@ struct portstats {
 	double bw_rate_egress;
 };
 
-static void gui_portcalc(struct switchtec_bwcntr_res *after,
+static void gui_portcalc(const struct switchtec_bwcntr_res *after,
 			 struct switchtec_bwcntr_res *before,
 			 struct portstats *stats)
 {
@@ -190,8 +190,8 @@ static void gui_portcalc(struct switchtec_bwcntr_res *after,
 
 	memcpy(&this, after, sizeof(this));
 
-	stats->tot_val_ingress = switchtec_bwcntr_tot(&after->ingress);
-	stats->tot_val_egress = switchtec_bwcntr_tot(&after->egress);
+	stats->tot_val_ingress = switchtec_bwcntr_tot(&this.ingress);
+	stats->tot_val_egress = switchtec_bwcntr_tot(&this.egress);
 
 	switchtec_bwcntr_sub(&this, before);
 	ingress_tot = switchtec_bwcntr_tot(&this.ingress);
@@ -204,7 +204,8 @@ static void gui_portcalc(struct switchtec_bwcntr_res *after,
 /* Draw a window for the port. */
 
 static WINDOW *gui_portwin(struct portloc *portlocs,
-			   struct switchtec_status *s, struct portstats *stats)
+			   const struct switchtec_status *s,
+			   struct portstats *stats)
 {
 	WINDOW *portwin;
 	char str[256];
@@ -262,110 +263,100 @@ static WINDOW *gui_portwin(struct portloc *portlocs,
 	return portwin;
 }
 
-static int gui_winports(struct switchtec_dev *dev, unsigned all_ports,
-			struct switchtec_bwcntr_res *bw_data,
-			unsigned reset_cntrs)
+static int gui_winports(struct switchtec_pmon_session *session,
+			unsigned all_ports, struct switchtec_bwcntr_res *bw_data,
+			unsigned *generation, unsigned reset_cntrs)
 {
-	int ret, p, numports, port_ids[SWITCHTEC_MAX_PORTS];
-	struct switchtec_status *status;
-	struct switchtec_bwcntr_res bw_data_new[SWITCHTEC_MAX_PORTS];
+	int ret, p, numports;
+	struct switchtec_pmon_sample sample;
 
-	ret = switchtec_status(dev, &status);
+	if (reset_cntrs) {
+		switchtec_pmon_sample(session, 1, &sample);
+		ret = switchtec_pmon_sample(session, 0, &sample);
+		if (!ret)
+			memcpy(bw_data, sample.bw,
+			       sample.nr_ports * sizeof(*bw_data));
+	}
+
+	ret = switchtec_pmon_sample(session, 0, &sample);
 	if (errno == EINTR) {
 		errno = 0;
 		return -1;
 	} else if (ret < 0) {
-		cleanup_and_error("status");
+		cleanup_and_error("bwcntr");
 	}
-	numports = ret;
+	numports = sample.nr_ports;
 
-	ret = switchtec_get_devices(dev, status, numports);
-	if (ret < 0)
-		cleanup_and_error("get_devices");
+	/* the port map was re-read, so start over from this sample */
+	if (sample.generation != *generation) {
+		memcpy(bw_data, sample.bw, numports * sizeof(*bw_data));
+		*generation = sample.generation;
+	}
 
 	struct portloc portlocs[numports];
 	WINDOW *portwins[numports];
 
-	get_portlocs(portlocs, all_ports, status, numports);
-
-	for (p = 0; p < numports; p++)
-		port_ids[p] = status[p].port.phys_id;
-
-	if (reset_cntrs) {
-		switchtec_bwcntr_many(dev, numports, port_ids, 1,
-				      NULL);
-		switchtec_bwcntr_many(dev, numports, port_ids, 0,
-				      bw_data);
-	}
-
-	ret = switchtec_bwcntr_many(dev, numports, port_ids, 0, bw_data_new);
-	if (errno == EINTR) {
-		errno = 0;
-		goto free_and_return;
-	} else if (ret < 0) {
-		cleanup_and_error("bwcntr");
-	}
+	get_portlocs(portlocs, all_ports, sample.status, numports);
 
 	for (p = 0; p < numports; p++) {
-		struct switchtec_status *s = &status[p];
+		const struct switchtec_status *s = &sample.status[p];
 		struct portstats stats;
 
 		if (all_ports || s->link_up) {
-			gui_portcalc(&bw_data_new[p], &bw_data[p], &stats);
+			gui_portcalc(&sample.bw[p], &bw_data[p], &stats);
 			portwins[p] = gui_portwin(&portlocs[p], s, &stats);
 			wrefresh(portwins[p]);
 		}
 	}
 
-	memcpy(bw_data, bw_data_new, SWITCHTEC_MAX_PORTS *
-	       sizeof(struct switchtec_bwcntr_res));
-	ret = 0;
+	memcpy(bw_data, sample.bw, numports * sizeof(*bw_data));
 
-free_and_return:
-	switchtec_status_free(status, numports);
-	return ret;
+	return 0;
 }
 
-static int gui_init(struct switchtec_dev *dev, unsigned reset,
-		    struct switchtec_bwcntr_res *bw_data,
-		    enum switchtec_bw_type bw_type)
+static struct switchtec_pmon_session *
+gui_init(struct switchtec_dev *dev, unsigned reset,
+	 struct switchtec_bwcntr_res *bw_data, unsigned *generation,
+	 enum switchtec_bw_type bw_type)
 {
-	int ret, p, numports, port_ids[SWITCHTEC_MAX_PORTS];
-	struct switchtec_status *status;
+	struct switchtec_pmon_session *session;
+	struct switchtec_pmon_sample sample;
+	int ret;
 
 retry:
-	ret = switchtec_status(dev, &status);
-	if (errno == EINTR) {
+	session = switchtec_pmon_session_open(dev, SWITCHTEC_PMON_BW |
+					      SWITCHTEC_PMON_DEVICES);
+	if (!session && errno == EINTR) {
 		errno = 0;
 		goto retry;
-	} else if (ret < 0) {
+	} else if (!session) {
 		cleanup_and_error("status");
 	}
-	numports = ret;
 
-	for (p = 0; p < numports; p++)
-		port_ids[p] = status[p].port.phys_id;
-
-	ret = switchtec_bwcntr_set_many(dev, numports, port_ids, bw_type);
+	ret = switchtec_pmon_session_set_bw_type(session, bw_type);
 	if (ret < 0)
 		cleanup_and_error("Set bandwidth type");
-	/* switchtec_bwcntr_set_many will reset bandwidth counter and it needs
-	 * about 1s. */
+	/* setting the bandwidth type will reset bandwidth counter and it
+	 * needs about 1s. */
 	sleep(1);
 
-	if (reset)
-		ret = switchtec_bwcntr_many(dev, numports, port_ids, 1, NULL);
-	else
-		ret = switchtec_bwcntr_many(dev, numports, port_ids, 0,
-					    bw_data);
-
+	ret = switchtec_pmon_sample(session, reset, &sample);
 	if (errno == EINTR) {
 		errno = 0;
+		switchtec_pmon_session_close(session);
 		goto retry;
 	}
 
-	switchtec_status_free(status, numports);
-	return ret;
+	if (ret < 0) {
+		switchtec_pmon_session_close(session);
+		return NULL;
+	}
+
+	if (!reset)
+		memcpy(bw_data, sample.bw, sample.nr_ports * sizeof(*bw_data));
+	*generation = sample.generation;
+
+	return session;
 }
 
 /*
@@ -412,11 +403,13 @@ int gui_main(struct switchtec_dev *dev, unsigned all_ports, unsigned reset,
 
 	int ret;
 	struct switchtec_bwcntr_res bw_data[SWITCHTEC_MAX_PORTS] = { {0} };
+	struct switchtec_pmon_session *session;
+	unsigned generation;
 
-	ret = gui_init(dev, reset, bw_data, bw_type);
-	if (ret < 0) {
+	session = gui_init(dev, reset, bw_data, &generation, bw_type);
+	if (!session) {
 		cleanup_and_error("gui_init");
-		return ret;
+		return -1;
 	}
 	usleep(GUI_INIT_TIME);
 
@@ -430,7 +423,8 @@ int gui_main(struct switchtec_dev *dev, unsigned all_ports, unsigned reset,
 
 		do_reset = gui_keypress();
 		do_reset |= reset_signal;
-		ret = gui_winports(dev, all_ports, bw_data, do_reset);
+		ret = gui_winports(session, all_ports, bw_data, &generation,
+				   do_reset);
 		sleep(refresh);
 
 		if (!ret && do_reset)
@@ -27,12 +27,15 @@
 #include "suffix.h"
 #include "progress.h"
 #include "gui.h"
+#include "export.h"
 #include "common.h"
 
 #include <switchtec/switchtec.h>
 #include <switchtec/errors.h>
 #include <switchtec/utils.h>
 #include <switchtec/pci.h>
+#include <switchtec/metrics.h>
+#include <switchtec/health.h>
 
 #include <locale.h>
 #include <time.h>
@@ -42,6 +45,9 @@
 #include <errno.h>
 #include <stdio.h>
 #include <inttypes.h>
+#include <limits.h>
+
+#include <sys/time.h>
 
 static struct switchtec_dev *global_dev = NULL;
 static int global_pax_id = SWITCHTEC_PAX_ID_LOCAL;
@@ -252,7 +258,7 @@ static int info(int argc, char **argv)
 }
 
 static void print_port_title(struct switchtec_dev *dev,
-			     struct switchtec_port_id *p)
+			     const struct switchtec_port_id *p)
 {
 	static int last_partition = -1;
 	const char *local = "";
@@ -546,12 +552,123 @@ static void print_bw(const char *msg, uint64_t time_us, uint64_t bytes)
 	printf("\t%-8s\t%5.3g %sB/s\n", msg, rate, suf);
 }
 
+static const char * const bw_series_names[] = {
+	[SWITCHTEC_BW_EGRESS_POSTED] = "out posted",
+	[SWITCHTEC_BW_EGRESS_COMP] = "out comp",
+	[SWITCHTEC_BW_EGRESS_NONPOSTED] = "out non-posted",
+	[SWITCHTEC_BW_INGRESS_POSTED] = "in posted",
+	[SWITCHTEC_BW_INGRESS_COMP] = "in comp",
+	[SWITCHTEC_BW_INGRESS_NONPOSTED] = "in non-posted",
+};
+
+static void print_bw_talker(const struct switchtec_bw_port_stats *st)
+{
+	double egress = st->egress_rate, ingress = st->ingress_rate;
+	const char *egress_suf = suffix_si_get(&egress);
+	const char *ingress_suf = suffix_si_get(&ingress);
+	const char *sep = "";
+	int i;
+
+	if (st->port.partition == SWITCHTEC_UNBOUND_PORT)
+		printf("     -  %4d     -    -", st->port.phys_id);
+	else
+		printf("  %4d  %4d  %4d  %s", st->port.partition,
+		       st->port.phys_id, st->port.log_id,
+		       st->port.upstream ? "USP" : "DSP");
+
+	printf("  %5.3g %sB/s  %5.3g %sB/s  ", egress, egress_suf,
+	       ingress, ingress_suf);
+
+	for (i = 0; i < SWITCHTEC_BW_NR_SERIES; i++) {
+		if (!(st->anomalies & (1 << i)))
+			continue;
+
+		printf("%s%s %c", sep, bw_series_names[i],
+		       st->rate[i] > st->baseline[i] ? '+' : '-');
+		sep = ", ";
+	}
+	printf("\n");
+}
+
+static int bw_top(struct switchtec_pmon_session *session, int n,
+		  unsigned interval)
+{
+	const struct switchtec_bw_port_stats *stats;
+	struct switchtec_bw_analyzer *a;
+	struct switchtec_pmon_sample sample;
+	int top[SWITCHTEC_MAX_PORTS];
+	char in_top[SWITCHTEC_MAX_PORTS];
+	int nr_ports, nr_top, first = 1;
+	char timestr[16];
+	time_t now;
+	int ret, i;
+
+	if (n > SWITCHTEC_MAX_PORTS)
+		n = SWITCHTEC_MAX_PORTS;
+
+	a = switchtec_bw_analyzer_open(0.2, 4);
+	if (!a) {
+		perror("bw");
+		return -1;
+	}
+
+	while (1) {
+		ret = switchtec_pmon_sample(session, 0, &sample);
+		if (ret < 0) {
+			switchtec_perror("bw");
+			break;
+		}
+
+		ret = switchtec_bw_analyzer_update(a, &sample);
+		if (ret < 0) {
+			perror("bw");
+			break;
+		}
+
+		/* the first sample only provides the starting point */
+		if (first) {
+			first = 0;
+			sleep(interval);
+			continue;
+		}
+
+		nr_ports = switchtec_bw_analyzer_stats(a, &stats);
+		nr_top = switchtec_bw_analyzer_top(a, n, top);
+
+		now = time(NULL);
+		strftime(timestr, sizeof(timestr), "%H:%M:%S", localtime(&now));
+		printf("%s  Top %d of %d ports\n", timestr, nr_top, nr_ports);
+		printf("  Part  Phys   Log  Type        Out           In  Anomalies\n");
+
+		memset(in_top, 0, sizeof(in_top));
+		for (i = 0; i < nr_top; i++) {
+			in_top[top[i]] = 1;
+			print_bw_talker(&stats[top[i]]);
+		}
+
+		/* sudden changes are worth showing even on quieter ports */
+		for (i = 0; i < nr_ports; i++)
+			if (!in_top[i] && stats[i].anomalies)
+				print_bw_talker(&stats[i]);
+
+		printf("\n");
+		fflush(stdout);
+		sleep(interval);
+	}
+
+	switchtec_bw_analyzer_close(a);
+	return ret;
+}
+
 #define CMD_DESC_BW "measure the traffic bandwidth through each port"
 
 static int bw(int argc, char **argv)
 {
-	struct switchtec_bwcntr_res *before, *after;
-	struct switchtec_port_id *port_ids;
+	struct switchtec_bwcntr_res before[SWITCHTEC_MAX_PORTS];
+	struct switchtec_bwcntr_res after[SWITCHTEC_MAX_PORTS];
+	struct switchtec_pmon_session *session;
+	struct switchtec_pmon_sample sample;
+	unsigned generation;
 	int ret;
 	int i;
 	uint64_t ingress_tot, egress_tot;
@@ -561,6 +678,7 @@ static int bw(int argc, char **argv)
 		unsigned meas_time;
 		int verbose;
 		enum switchtec_bw_type bw_type;
+		int top;
 	} cfg = {
 		.meas_time = 5,
 		.bw_type = SWITCHTEC_BW_TYPE_RAW,
@@ -575,37 +693,61 @@ static int bw(int argc, char **argv)
 		 "print posted, non-posted and completion results"},
 		{"bw_type", 'b', "TYPE", CFG_CHOICES, &cfg.bw_type,
 		 required_argument, "bandwidth type", .choices=bandwidth_types},
+		{"top", 'n', "NUM", CFG_POSITIVE, &cfg.top, required_argument,
+		 "keep measuring every 'time' seconds and show the NUM ports "
+		 "with the most traffic, along with sudden changes in the "
+		 "traffic of any port"},
 		{NULL}};
 
 	argconfig_parse(argc, argv, CMD_DESC_BW, opts, &cfg, sizeof(cfg));
 
-	ret = switchtec_bwcntr_set_all(cfg.dev, cfg.bw_type);
+	session = switchtec_pmon_session_open(cfg.dev, SWITCHTEC_PMON_BW);
+	if (!session) {
+		switchtec_perror("bw");
+		return -1;
+	}
+
+	ret = switchtec_pmon_session_set_bw_type(session, cfg.bw_type);
 	if (ret < 0) {
 		switchtec_perror("bw type");
-		return ret;
+		goto close;
 	}
-	/* switchtec_bwcntr_set_all will reset bandwidth counter and it needs
-	 * about 1s */
+	/* setting the bandwidth type will reset bandwidth counter and it
+	 * needs about 1s */
 	sleep(1);
 
-	ret = switchtec_bwcntr_all(cfg.dev, 0, &port_ids, &before);
+	if (cfg.top) {
+		ret = bw_top(session, cfg.top, cfg.meas_time);
+		goto close;
+	}
+
+	ret = switchtec_pmon_sample(session, 0, &sample);
 	if (ret < 0) {
 		switchtec_perror("bw");
-		return ret;
+		goto close;
 	}
 
+	generation = sample.generation;
+	memcpy(before, sample.bw, sizeof(*before) * sample.nr_ports);
+
 	sleep(cfg.meas_time);
 
-	ret = switchtec_bwcntr_all(cfg.dev, 0, NULL, &after);
+	ret = switchtec_pmon_sample(session, 0, &sample);
 	if (ret < 0) {
-		free(before);
-		free(port_ids);
 		switchtec_perror("bw");
-		return ret;
+		goto close;
 	}
 
-	for (i = 0; i < ret; i++) {
-		print_port_title(cfg.dev, &port_ids[i]);
+	if (sample.generation != generation) {
+		fprintf(stderr, "The link state changed during the measurement, please try again.\n");
+		ret = -1;
+		goto close;
+	}
+
+	memcpy(after, sample.bw, sizeof(*after) * sample.nr_ports);
+
+	for (i = 0; i < sample.nr_ports; i++) {
+		print_port_title(cfg.dev, &sample.ports[i]);
 
 		switchtec_bwcntr_sub(&after[i], &before[i]);
 
@@ -636,14 +778,130 @@ static int bw(int argc, char **argv)
 		}
 	}
 
-	free(before);
-	free(after);
-	free(port_ids);
-	return 0;
+close:
+	switchtec_pmon_session_close(session);
+	return ret;
 }
 
 #define CMD_DESC_LATENCY "measure the latency of a port"
 
+static int latency_all(struct switchtec_dev *dev, unsigned meas_time,
+		       int ingress)
+{
+	struct switchtec_port_id *ports;
+	int *cur_ns, *max_ns;
+	int ret, i;
+
+	ret = switchtec_lat_setup_all(dev, ingress);
+	if (ret) {
+		switchtec_perror("latency");
+		return -1;
+	}
+
+	ret = switchtec_lat_get_all(dev, 1, &ports, &cur_ns, &max_ns);
+	if (ret < 0) {
+		switchtec_perror("latency");
+		return -1;
+	}
+
+	free(ports);
+	free(cur_ns);
+	free(max_ns);
+
+	sleep(meas_time);
+
+	ret = switchtec_lat_get_all(dev, 0, &ports, &cur_ns, &max_ns);
+	if (ret < 0) {
+		switchtec_perror("latency");
+		return -1;
+	}
+
+	for (i = 0; i < ret; i++) {
+		print_port_title(dev, &ports[i]);
+
+		if (switchtec_is_gen3(dev))
+			printf("\tCurrent: %d ns\n", cur_ns[i]);
+		else
+			printf("\tMinimum: %d ns\n", cur_ns[i]);
+
+		printf("\tMaximum: %d ns\n", max_ns[i]);
+	}
+
+	free(ports);
+	free(cur_ns);
+	free(max_ns);
+	return 0;
+}
+
+static void print_lat_hist(struct switchtec_lat_sampler *sampler)
+{
+	const struct switchtec_port_id *ports;
+	struct switchtec_lat_stats st;
+	int nr_ports, p, shown = 0;
+
+	nr_ports = switchtec_lat_sampler_ports(sampler, &ports);
+
+	printf("Percentiles of the maximum latency of each poll interval\n");
+
+	printf("%-9s %10s %8s %8s %8s %8s %8s\n", "Phys Port", "Samples",
+	       "p50", "p90", "p99", "p99.9", "Max");
+
+	for (p = 0; p < nr_ports; p++) {
+		if (switchtec_lat_sampler_stats(sampler, p, &st, NULL))
+			continue;
+		if (!st.count)
+			continue;
+
+		printf("%9d %10" PRIu64 " %5d ns %5d ns %5d ns %5d ns %5d ns\n",
+		       ports[p].phys_id, st.count, st.p50_ns, st.p90_ns,
+		       st.p99_ns, st.p999_ns, st.max_ns);
+		shown++;
+	}
+
+	if (!shown)
+		printf("No TLPs seen on any port\n");
+}
+
+static int latency_histogram(struct switchtec_dev *dev, unsigned meas_time,
+			     unsigned poll_ms, unsigned window)
+{
+	struct switchtec_lat_sampler *sampler;
+	time_t start, now, last;
+	int ret = 0;
+
+	sampler = switchtec_lat_sampler_open(dev, 1000,
+					     window ? window : meas_time);
+	if (!sampler) {
+		switchtec_perror("latency");
+		return -1;
+	}
+
+	start = last = time(NULL);
+	do {
+		ret = switchtec_lat_sampler_poll(sampler);
+		if (ret) {
+			switchtec_perror("latency");
+			goto close;
+		}
+
+		usleep(poll_ms * 1000);
+		now = time(NULL);
+
+		if (window && now != last) {
+			printf("\nLast %u s:\n", window);
+			print_lat_hist(sampler);
+			last = now;
+		}
+	} while (now - start < meas_time);
+
+	if (!window)
+		print_lat_hist(sampler);
+
+close:
+	switchtec_lat_sampler_close(sampler);
+	return ret;
+}
+
 static int latency(int argc, char **argv)
 {
 	int ret;
@@ -654,8 +912,13 @@ static int latency(int argc, char **argv)
 		unsigned meas_time;
 		int egress;
 		int ingress;
+		int all;
+		int histogram;
+		unsigned poll_ms;
+		unsigned window;
 	} cfg = {
 		.meas_time = 5,
+		.poll_ms = 10,
 		.egress = -1,
 		.ingress = SWITCHTEC_LAT_ALL_INGRESS,
 	};
@@ -671,13 +934,32 @@ static int latency(int argc, char **argv)
 		{"ingress", 'i', "NUM", CFG_NONNEGATIVE, &cfg.ingress,
 		  required_argument,
 		 "physical port ID for the ingress side (default: use all ports)"},
+		{"all", 'a', "", CFG_NONE, &cfg.all, no_argument,
+		 "measure the latency of every port on the egress side"},
+		{"histogram", 'H', "", CFG_NONE, &cfg.histogram, no_argument,
+		 "poll the latency of every port and report percentiles of the "
+		 "maximum latency of each poll interval"},
+		{"poll_interval", 'p', "MS", CFG_POSITIVE, &cfg.poll_ms,
+		 required_argument,
+		 "time between latency polls in histogram mode (default: 10)"},
+		{"window", 'w', "NUM", CFG_POSITIVE, &cfg.window,
+		 required_argument,
+		 "report the percentiles of the last NUM seconds every second "
+		 "in histogram mode (default: report once at the end)"},
 		{NULL}};
 
 	argconfig_parse(argc, argv, CMD_DESC_LATENCY, opts, &cfg, sizeof(cfg));
 
+	if (cfg.histogram)
+		return latency_histogram(cfg.dev, cfg.meas_time, cfg.poll_ms,
+					 cfg.window);
+
+	if (cfg.all)
+		return latency_all(cfg.dev, cfg.meas_time, cfg.ingress);
+
 	if (cfg.egress < 0) {
 		argconfig_print_usage(opts);
-		fprintf(stderr, "The --egress argument is required!\n");
+		fprintf(stderr, "The --egress, --all or --histogram argument is required!\n");
 		return 1;
 	}
 
@@ -705,6 +987,189 @@ static int latency(int argc, char **argv)
 	return 0;
 }
 
+static void metrics_default_path(char *buf, size_t len, const char *name)
+{
+	char *c;
+
+	snprintf(buf, len, SWITCHTEC_METRICS_PATH_FMT, name);
+
+	/* device names may be paths themselves, e.g. for UART devices */
+	for (c = buf + strlen("/dev/shm/"); *c; c++)
+		if (*c == '/')
+			*c = '_';
+}
+
+static volatile sig_atomic_t metrics_stop;
+
+static void metrics_handler(int signum)
+{
+	metrics_stop = 1;
+}
+
+#define CMD_DESC_METRICS_PUBLISH "publish metrics to shared memory for other tools to read"
+
+static int metrics_publish(int argc, char **argv)
+{
+	struct switchtec_metrics_pub *pub;
+	char path[PATH_MAX];
+	unsigned flags = SWITCHTEC_PMON_BW | SWITCHTEC_PMON_DEVICES;
+	int ret = 0;
+
+	static struct {
+		struct switchtec_dev *dev;
+		const char *path;
+		unsigned interval;
+		int latency;
+	} cfg = {
+		.interval = 1000,
+	};
+	const struct argconfig_options opts[] = {
+		DEVICE_OPTION,
+		{"path", 'p', "FILE", CFG_STRING, &cfg.path, required_argument,
+		 "file to publish to (default: /dev/shm/<device name>.metrics)"},
+		{"interval", 'i', "MS", CFG_POSITIVE, &cfg.interval,
+		 required_argument, "time between updates (default: 1000)"},
+		{"latency", 'l', "", CFG_NONE, &cfg.latency, no_argument,
+		 "also publish the latency of each update interval, this sets "
+		 "up and clears the latency counter of every port"},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_METRICS_PUBLISH, opts, &cfg,
+			sizeof(cfg));
+
+	if (cfg.path)
+		snprintf(path, sizeof(path), "%s", cfg.path);
+	else
+		metrics_default_path(path, sizeof(path),
+				     switchtec_name(cfg.dev));
+
+	if (cfg.latency)
+		flags |= SWITCHTEC_PMON_LAT;
+
+	pub = switchtec_metrics_pub_open(cfg.dev, path, flags);
+	if (!pub) {
+		switchtec_perror(path);
+		return -1;
+	}
+
+	fprintf(stderr, "Publishing metrics to %s, press Ctrl-C to stop.\n",
+		path);
+
+	signal(SIGINT, metrics_handler);
+	signal(SIGTERM, metrics_handler);
+
+	while (!metrics_stop) {
+		ret = switchtec_metrics_pub_update(pub);
+		if (ret) {
+			switchtec_perror("metrics_publish");
+			break;
+		}
+
+		sleep(cfg.interval / 1000);
+		usleep((cfg.interval % 1000) * 1000);
+	}
+
+	switchtec_metrics_pub_close(pub);
+	return ret;
+}
+
+#define CMD_DESC_METRICS_SHOW "show the metrics published by metrics-publish"
+
+static int metrics_show(int argc, char **argv)
+{
+	struct switchtec_metrics_reader *r;
+	struct switchtec_metrics *m;
+	struct switchtec_metrics_port *p;
+	char path[PATH_MAX];
+	struct timeval now;
+	double age, egress, ingress;
+	const char *egress_suf, *ingress_suf;
+	int ret, i;
+
+	static struct {
+		const char *name;
+		const char *path;
+	} cfg = {
+		.name = "switchtec0",
+	};
+	const struct argconfig_options opts[] = {
+		{"name", .cfg_type = CFG_STRING, .value_addr = &cfg.name,
+		 .argument_type = optional_positional,
+		 .help = "name of the publishing device (default: switchtec0)"},
+		{"path", 'p', "FILE", CFG_STRING, &cfg.path, required_argument,
+		 "file the metrics are published to (overrides <name>)"},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_METRICS_SHOW, opts, &cfg,
+			sizeof(cfg));
+
+	if (cfg.path)
+		snprintf(path, sizeof(path), "%s", cfg.path);
+	else
+		metrics_default_path(path, sizeof(path), cfg.name);
+
+	r = switchtec_metrics_open(path);
+	if (!r) {
+		switchtec_perror(path);
+		return -1;
+	}
+
+	m = malloc(sizeof(*m));
+	if (!m) {
+		perror("metrics_show");
+		switchtec_metrics_close(r);
+		return -1;
+	}
+
+	ret = switchtec_metrics_read(r, m);
+	switchtec_metrics_close(r);
+	if (ret) {
+		switchtec_perror("metrics_show");
+		free(m);
+		return -1;
+	}
+
+	gettimeofday(&now, NULL);
+	age = (now.tv_sec * 1e6 + now.tv_usec - m->hdr.update_us) / 1e6;
+
+	printf("Device:    %s\n", m->dev.name);
+	if (m->hdr.publisher_pid)
+		printf("Publisher: pid %u\n", m->hdr.publisher_pid);
+	else
+		printf("Publisher: stopped\n");
+	printf("Updated:   %.1f s ago (%u samples)\n", age,
+	       m->hdr.sample_count);
+
+	for (i = 0; i < m->dev.nr_temps; i++)
+		printf("Sensor %d:  %.3g °C\n", i, m->dev.die_temp[i]);
+
+	printf("\n%-9s %-6s %-8s %13s %13s", "Phys Port", "Link", "Width",
+	       "Out", "In");
+	if (m->hdr.flags & SWITCHTEC_PMON_LAT)
+		printf(" %10s %10s", "Lat", "Lat Max");
+	printf("\n");
+
+	for (i = 0; i < m->hdr.nr_ports && i < m->hdr.max_ports; i++) {
+		p = &m->ports[i];
+
+		egress = p->egress_rate;
+		egress_suf = suffix_si_get(&egress);
+		ingress = p->ingress_rate;
+		ingress_suf = suffix_si_get(&ingress);
+
+		printf("%9d %-6s x%-2d Gen%d %7.3g %1sB/s %7.3g %1sB/s",
+		       p->phys_id, p->link_up ? "UP" : "DOWN",
+		       p->neg_lnk_width, p->link_rate, egress, egress_suf,
+		       ingress, ingress_suf);
+		if (m->hdr.flags & SWITCHTEC_PMON_LAT)
+			printf(" %7d ns %7d ns", p->lat_cur_ns, p->lat_max_ns);
+		printf("\n");
+	}
+
+	free(m);
+	return 0;
+}
+
 struct event_list {
 	enum switchtec_event_id eid;
 	int partition;
@@ -977,8 +1442,61 @@ static int event_wait(int argc, char **argv)
 
 #define CMD_DESC_LOG_DUMP "dump the firmware log to a file"
 
+static volatile sig_atomic_t log_follow_stop;
+
+static void log_follow_handler(int signum)
+{
+	log_follow_stop = 1;
+}
+
+static int log_follow(struct switchtec_dev *dev, enum switchtec_log_type type,
+		      int fd, FILE *log_def_file, const char *filename,
+		      struct switchtec_log_file_info *info)
+{
+	struct switchtec_log_follow *follow;
+	unsigned int lost;
+	int ret = 0;
+
+	memset(info, 0, sizeof(*info));
+
+	follow = switchtec_log_follow_open(dev, type, fd, log_def_file, info);
+	if (!follow) {
+		switchtec_perror("log_dump");
+		return -1;
+	}
+
+	fprintf(stderr, "Following the log in %s, press Ctrl-C to stop.\n",
+		filename);
+
+	signal(SIGINT, log_follow_handler);
+	signal(SIGTERM, log_follow_handler);
+
+	while (!log_follow_stop) {
+		usleep(switchtec_log_follow_interval(follow) * 1000);
+		if (log_follow_stop)
+			break;
+
+		ret = switchtec_log_follow_poll(follow, &lost);
+		if (ret < 0) {
+			switchtec_perror("log_dump");
+			break;
+		}
+
+		if (lost)
+			fprintf(stderr, "\nWARNING: %u log entries were overwritten before they could be read!\n",
+				lost);
+	}
+
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	switchtec_log_follow_close(follow);
+
+	return ret < 0 ? ret : 0;
+}
+
 #define LOG_FMT_TXT 0
 #define LOG_FMT_BIN 1
+#define LOG_FMT_COL 2
 
 static FILE *get_log_def_file(struct switchtec_dev *dev, unsigned type,
 			      int format)
@@ -1044,6 +1562,7 @@ static int log_dump(int argc, char **argv)
 		FILE *log_def_file;
 		const char *log_def_filename;
 		int format;
+		int follow;
 	} cfg = {
 		.type = SWITCHTEC_LOG_RAM,
 		.out_fd = 0,
@@ -1065,10 +1584,18 @@ static int log_dump(int argc, char **argv)
 		{"format", 'f', "FORMAT", CFG_CHOICES, &cfg.format,
 		  required_argument,
 		 "output log file format", .choices=format},
+		{"follow", 'F', "", CFG_NONE, &cfg.follow, no_argument,
+		 "keep polling for new entries after dumping the log until interrupted (RAM and FLASH only)"},
 		{NULL}};
 
 	argconfig_parse(argc, argv, CMD_DESC_LOG_DUMP, opts, &cfg, sizeof(cfg));
 
+	if (cfg.follow && cfg.type != SWITCHTEC_LOG_RAM &&
+	    cfg.type != SWITCHTEC_LOG_FLASH) {
+		fprintf(stderr, "The follow option is only supported for RAM and FLASH logs\n");
+		return -1;
+	}
+
 	ret = switchtec_get_device_info(cfg.dev, &boot_phase, NULL, NULL);
 	if (ret) {
 		switchtec_perror("log_dump");
@@ -1107,12 +1634,21 @@ static int log_dump(int argc, char **argv)
 			return ret;
 	}
 
-	ret = switchtec_log_to_file(cfg.dev, cfg.type, cfg.out_fd,
-				    log_def_to_use, &info);
-	if (ret < 0)
-		switchtec_perror("log_dump");
-	else
-		fprintf(stderr, "\nLog saved to %s.\n", cfg.out_filename);
+	if (cfg.follow) {
+		ret = log_follow(cfg.dev, cfg.type, cfg.out_fd, log_def_to_use,
+				 cfg.out_filename, &info);
+		if (ret == 0)
+			fprintf(stderr, "\nLog saved to %s.\n",
+				cfg.out_filename);
+	} else {
+		ret = switchtec_log_to_file(cfg.dev, cfg.type, cfg.out_fd,
+					    log_def_to_use, &info);
+		if (ret < 0)
+			switchtec_perror("log_dump");
+		else
+			fprintf(stderr, "\nLog saved to %s.\n",
+				cfg.out_filename);
+	}
 
 	if (info.version_mismatch) {
 		fprintf(stderr, "\nWARNING: The binary log file have different version numbers\n"
@@ -1125,30 +1661,368 @@ static int log_dump(int argc, char **argv)
 		fprintf(stderr,	"The log file is parsed but the output file might contain errors.\n");
 	}
 
-	if (info.overflow)
-		fprintf(stderr, "\nWARNING: The log buffer pointer has wrapped. The log data may be incomplete!\n");
+	if (info.overflow)
+		fprintf(stderr, "\nWARNING: The log buffer pointer has wrapped. The log data may be incomplete!\n");
+
+	if (cfg.out_fd > 0)
+		close(cfg.out_fd);
+
+	if (log_def_to_use)
+		fclose(log_def_to_use);
+
+	return ret;
+}
+
+#define CMD_DESC_LOG_PARSE "parse a binary app log or mailbox log to a text file"
+
+static int log_parse(int argc, char **argv)
+{
+	int ret;
+	unsigned int flags = 0;
+	struct switchtec_log_file_info info;
+	const struct argconfig_choice log_types[] = {
+		{"APP", SWITCHTEC_LOG_PARSE_TYPE_APP, "app log"},
+		{"MAILBOX", SWITCHTEC_LOG_PARSE_TYPE_MAILBOX, "mailbox log"},
+		{"FTDC", SWITCHTEC_LOG_PARSE_TYPE_FTDC, "ftdc"},
+		{}
+	};
+	const struct argconfig_choice device_gen[] = {
+		{"GEN3", SWITCHTEC_GEN3, "GEN3"},
+		{"GEN4", SWITCHTEC_GEN4, "GEN4"},
+		{"GEN5", SWITCHTEC_GEN5, "GEN5"},
+		{"GEN6", SWITCHTEC_GEN6, "GEN6"},
+		{"UNKNOWN", SWITCHTEC_GEN_UNKNOWN, "UNKNOWN"},
+		{}
+	};
+	const struct argconfig_choice format[] = {
+		{"TXT", LOG_FMT_TXT, "output text log data (default)"},
+		{"COL", LOG_FMT_COL,
+		 "output decoded entries in a columnar binary format"},
+		{}
+	};
+
+	static struct {
+		enum switchtec_log_parse_type log_type;
+		FILE *bin_log_file;
+		const char *bin_log_filename;
+		FILE *log_def_file;
+		const char *log_def_filename;
+		FILE *parsed_log_file;
+		const char *parsed_log_filename;
+		enum switchtec_gen gen;
+		unsigned threads;
+		int format;
+		int wall_time;
+	} cfg = {
+		.log_type = SWITCHTEC_LOG_PARSE_TYPE_APP,
+		.bin_log_file = NULL,
+		.log_def_file = NULL,
+		.parsed_log_file = NULL,
+		.gen = SWITCHTEC_GEN_UNKNOWN,
+		.threads = 1,
+		.format = LOG_FMT_TXT,
+	};
+	const struct argconfig_options opts[] = {
+		{"type", 't',
+		 .meta = "TYPE", .cfg_type = CFG_CHOICES,
+		 .value_addr = &cfg.log_type,
+		 .argument_type = required_argument,
+		 .help = "log type to parse (default: APP)",
+		 .choices = log_types},
+		{"device_gen", 'g',
+		 .meta = "GEN", .cfg_type = CFG_CHOICES,
+		 .value_addr = &cfg.gen,
+		 .argument_type = required_argument,
+		 .help = "device generation (Only needed when parsing "
+			 "earlier log files which do not contain device "
+			 "generation information. Default: UNKNOWN)",
+		 .choices = device_gen},
+		{"threads", 'j',
+		 .meta = "NUM", .cfg_type = CFG_NONNEGATIVE,
+		 .value_addr = &cfg.threads,
+		 .argument_type = required_argument,
+		 .help = "number of threads used to parse the log "
+			 "(0 = one per CPU, default: 1)"},
+		{"format", 'f',
+		 .meta = "FORMAT", .cfg_type = CFG_CHOICES,
+		 .value_addr = &cfg.format,
+		 .argument_type = required_argument,
+		 .help = "output file format",
+		 .choices = format},
+		{"wall_time", 'w', "", CFG_NONE, &cfg.wall_time, no_argument,
+		 "print timestamps as UTC date and time (only for logs dumped "
+		 "with host time correlation)"},
+		{"log_input", .cfg_type = CFG_FILE_R,
+		 .value_addr = &cfg.bin_log_file,
+		 .argument_type = required_positional,
+		 .help = "binary app log input file"},
+		{"log_def", .cfg_type = CFG_FILE_R,
+		 .value_addr = &cfg.log_def_file,
+		 .argument_type = required_positional,
+		 .help = "log definition file"},
+		{"parsed_output", .cfg_type = CFG_FILE_W,
+		 .value_addr = &cfg.parsed_log_file,
+		 .argument_type = optional_positional,
+		 .force_default = "log.txt",
+		 .help = "parsed output file"},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_LOG_PARSE, opts,
+			&cfg, sizeof(cfg));
+
+	fseek(cfg.bin_log_file, 0, SEEK_END);
+	if (ftell(cfg.bin_log_file) == 0) {
+		fprintf(stderr, "\nLog file %s is empty!\n",
+			cfg.bin_log_filename);
+
+		ret = -1;
+		goto done;
+	}
+	fseek(cfg.bin_log_file, 0, SEEK_SET);
+
+	if (cfg.format == LOG_FMT_COL)
+		flags |= SWITCHTEC_LOG_PARSE_COLUMNAR;
+	if (cfg.wall_time)
+		flags |= SWITCHTEC_LOG_PARSE_WALL_TIME;
+
+	ret = switchtec_parse_log_ex(cfg.bin_log_file, cfg.log_def_file,
+				     cfg.parsed_log_file, cfg.log_type,
+				     cfg.gen, cfg.threads, flags, &info);
+	if (ret < 0)
+		switchtec_perror("log_parse");
+	else
+		fprintf(stderr, "\nParsed log saved to %s.\n",
+			cfg.parsed_log_filename);
+
+	if (info.version_mismatch && cfg.log_type != SWITCHTEC_LOG_PARSE_TYPE_FTDC) {
+		fprintf(stderr, "\nWARNING: The two input files have different version numbers.\n");
+		fprintf(stderr, "\t\tFW Version\tSDK Version\n");
+		fprintf(stderr, "Log file:\t0x%08x\t0x%08x\n",
+			info.log_fw_version, info.log_sdk_version);
+		fprintf(stderr, "Log def file:\t0x%08x\t0x%08x\n\n",
+			info.def_fw_version, info.def_sdk_version);
+		fprintf(stderr,	"The log file is parsed but the output file might contain errors.\n");
+	}
+
+	if (info.gen_unknown) {
+		fprintf(stderr, "\nWARNING: There is no device Generation information in the log file.\n");
+		fprintf(stderr, "           The log file is parsed but the output file contains errors.\n");
+		fprintf(stderr, "Hint: Use '-g' option to specify device generation.\n");
+	}
+
+	if (info.gen_ignored) {
+		fprintf(stderr, "\nNOTE: The input log file contains device generation information,\n");
+		fprintf(stderr, "        therefore the generation option in the command line is ignored.\n");
+	}
+
+done:
+	if (cfg.bin_log_file != NULL)
+		fclose(cfg.bin_log_file);
+
+	if (cfg.log_def_file != NULL)
+		fclose(cfg.log_def_file);
+
+	if (cfg.parsed_log_file != NULL)
+		fclose(cfg.parsed_log_file);
+
+	return ret;
+}
+
+#define CMD_DESC_LOG_MERGE "merge binary app logs from several switches in time order"
+
+static int log_merge(int argc, char **argv)
+{
+	FILE **bin_log_files = NULL, **log_def_files = NULL;
+	const char **names = NULL;
+	char *def_name, *base;
+	int i, nr_logs, ret = -1;
+
+	const struct argconfig_choice device_gen[] = {
+		{"GEN3", SWITCHTEC_GEN3, "GEN3"},
+		{"GEN4", SWITCHTEC_GEN4, "GEN4"},
+		{"GEN5", SWITCHTEC_GEN5, "GEN5"},
+		{"GEN6", SWITCHTEC_GEN6, "GEN6"},
+		{"UNKNOWN", SWITCHTEC_GEN_UNKNOWN, "UNKNOWN"},
+		{}
+	};
+
+	static struct {
+		const char *log_def_filename;
+		FILE *parsed_log_file;
+		const char *parsed_log_filename;
+		const char *first_log;
+		enum switchtec_gen gen;
+	} cfg = {
+		.gen = SWITCHTEC_GEN_UNKNOWN,
+	};
+	const struct argconfig_options opts[] = {
+		{"log_def", 'd', "DEF_FILE", CFG_STRING, &cfg.log_def_filename,
+		 required_argument,
+		 "log definition file for logs given without one"},
+		{"output", 'o', "FILE", CFG_FILE_W, &cfg.parsed_log_file,
+		 required_argument, "merged output file (default: stdout)"},
+		{"device_gen", 'g',
+		 .meta = "GEN", .cfg_type = CFG_CHOICES,
+		 .value_addr = &cfg.gen,
+		 .argument_type = required_argument,
+		 .help = "device generation (Only needed for log files "
+			 "which do not contain device generation "
+			 "information. Default: UNKNOWN)",
+		 .choices = device_gen},
+		{"log_input", .cfg_type = CFG_STRING,
+		 .value_addr = &cfg.first_log,
+		 .argument_type = required_positional,
+		 .help = "binary app logs dumped with host time correlation, "
+			 "each given as LOG or LOG=DEF_FILE"},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_LOG_MERGE, opts,
+			&cfg, sizeof(cfg));
+
+	/* the first log is argv[optind - 1], the rest follow it */
+	nr_logs = argc - optind + 1;
+
+	bin_log_files = calloc(nr_logs, sizeof(*bin_log_files));
+	log_def_files = calloc(nr_logs, sizeof(*log_def_files));
+	names = calloc(nr_logs, sizeof(*names));
+	if (!bin_log_files || !log_def_files || !names) {
+		perror("log_merge");
+		goto done;
+	}
+
+	for (i = 0; i < nr_logs; i++) {
+		names[i] = argv[optind - 1 + i];
+
+		def_name = strchr(names[i], '=');
+		if (def_name) {
+			*def_name++ = 0;
+		} else if (cfg.log_def_filename) {
+			def_name = (char *)cfg.log_def_filename;
+		} else {
+			fprintf(stderr, "No log definition file for %s\n",
+				names[i]);
+			goto done;
+		}
+
+		bin_log_files[i] = fopen(names[i], "rb");
+		if (!bin_log_files[i]) {
+			perror(names[i]);
+			goto done;
+		}
+
+		log_def_files[i] = fopen(def_name, "rb");
+		if (!log_def_files[i]) {
+			perror(def_name);
+			goto done;
+		}
+
+		base = strrchr(names[i], '/');
+		if (base)
+			names[i] = base + 1;
+	}
+
+	if (!cfg.parsed_log_file) {
+		cfg.parsed_log_file = stdout;
+		cfg.parsed_log_filename = "stdout";
+	}
+
+	ret = switchtec_parse_log_merge(bin_log_files, log_def_files, names,
+					nr_logs, cfg.parsed_log_file, cfg.gen);
+	if (ret < 0) {
+		if (errno == EINVAL)
+			fprintf(stderr, "Cannot convert timestamps without the device generation.\n"
+					"Hint: Use '-g' option to specify device generation.\n");
+		else
+			switchtec_perror("log_merge");
+	} else {
+		fprintf(stderr, "\nMerged log saved to %s.\n",
+			cfg.parsed_log_filename);
+	}
+
+done:
+	for (i = 0; bin_log_files && i < nr_logs; i++) {
+		if (bin_log_files[i])
+			fclose(bin_log_files[i]);
+		if (log_def_files && log_def_files[i])
+			fclose(log_def_files[i]);
+	}
 
-	if (cfg.out_fd > 0)
-		close(cfg.out_fd);
+	free(bin_log_files);
+	free(log_def_files);
+	free(names);
 
-	if (log_def_to_use)
-		fclose(log_def_to_use);
+	if (cfg.parsed_log_file && cfg.parsed_log_file != stdout)
+		fclose(cfg.parsed_log_file);
 
 	return ret;
 }
 
-#define CMD_DESC_LOG_PARSE "parse a binary app log or mailbox log to a text file"
+#define CMD_DESC_LOG_QUERY "print the entries of a binary app log that match a filter"
 
-static int log_parse(int argc, char **argv)
+static int parse_duration(const char *str, unsigned long long *ns)
+{
+	char *end;
+	double val;
+
+	val = strtod(str, &end);
+	if (end == str || val < 0)
+		return -1;
+
+	if (!strcmp(end, "ms"))
+		val *= 1e6;
+	else if (!*end || !strcmp(end, "s"))
+		val *= 1e9;
+	else if (!strcmp(end, "m"))
+		val *= 60e9;
+	else if (!strcmp(end, "h"))
+		val *= 3600e9;
+	else if (!strcmp(end, "d"))
+		val *= 86400e9;
+	else
+		return -1;
+
+	*ns = val;
+	return 0;
+}
+
+static FILE *log_index_open(FILE *bin_log_file, const char *path, bool rebuild)
 {
+	FILE *index_file;
 	int ret;
+
+	if (!rebuild) {
+		index_file = fopen(path, "rb");
+		if (index_file)
+			return index_file;
+	}
+
+	/* fall back to a temporary index if the log's directory is read-only */
+	index_file = fopen(path, "w+b");
+	if (!index_file)
+		index_file = tmpfile();
+	if (!index_file) {
+		perror(path);
+		return NULL;
+	}
+
+	ret = switchtec_log_index_build(bin_log_file, index_file);
+	if (ret) {
+		switchtec_perror("log_query");
+		fclose(index_file);
+		return NULL;
+	}
+
+	return index_file;
+}
+
+static int log_query(int argc, char **argv)
+{
 	struct switchtec_log_file_info info;
-	const struct argconfig_choice log_types[] = {
-		{"APP", SWITCHTEC_LOG_PARSE_TYPE_APP, "app log"},
-		{"MAILBOX", SWITCHTEC_LOG_PARSE_TYPE_MAILBOX, "mailbox log"},
-		{"FTDC", SWITCHTEC_LOG_PARSE_TYPE_FTDC, "ftdc"},
-		{}
-	};
+	struct switchtec_log_query query = {};
+	FILE *index_file = NULL;
+	char index_path[PATH_MAX];
+	int i, ret;
+
 	const struct argconfig_choice device_gen[] = {
 		{"GEN3", SWITCHTEC_GEN3, "GEN3"},
 		{"GEN4", SWITCHTEC_GEN4, "GEN4"},
@@ -1157,30 +2031,49 @@ static int log_parse(int argc, char **argv)
 		{"UNKNOWN", SWITCHTEC_GEN_UNKNOWN, "UNKNOWN"},
 		{}
 	};
+	const struct argconfig_choice severities[] = {
+		{"HIGHEST", 1, "highest severity entries only"},
+		{"HIGH", 2, "high severity entries and above"},
+		{"MEDIUM", 3, "medium severity entries and above"},
+		{"LOW", 4, "low severity entries and above"},
+		{"LOWEST", 5, "all entries"},
+		{}
+	};
 
 	static struct {
-		enum switchtec_log_parse_type log_type;
 		FILE *bin_log_file;
 		const char *bin_log_filename;
 		FILE *log_def_file;
 		const char *log_def_filename;
 		FILE *parsed_log_file;
 		const char *parsed_log_filename;
+		const char *module;
+		int sev;
+		const char *since;
+		const char *index;
+		int reindex;
 		enum switchtec_gen gen;
 	} cfg = {
-		.log_type = SWITCHTEC_LOG_PARSE_TYPE_APP,
-		.bin_log_file = NULL,
-		.log_def_file = NULL,
-		.parsed_log_file = NULL,
-		.gen = SWITCHTEC_GEN_UNKNOWN
+		.gen = SWITCHTEC_GEN_UNKNOWN,
 	};
 	const struct argconfig_options opts[] = {
-		{"type", 't',
-		 .meta = "TYPE", .cfg_type = CFG_CHOICES,
-		 .value_addr = &cfg.log_type,
-		 .argument_type = required_argument,
-		 .help = "log type to parse (default: APP)",
-		 .choices = log_types},
+		{"module", 'm', "NAME", CFG_STRING, &cfg.module,
+		 required_argument,
+		 "only print entries of this module (name or ID)"},
+		{"sev", 's', "SEV", CFG_CHOICES, &cfg.sev,
+		 required_argument,
+		 "only print entries of at least this severity",
+		 .choices = severities},
+		{"since", 'S', "TIME", CFG_STRING, &cfg.since,
+		 required_argument,
+		 "only print entries logged within TIME of the newest entry "
+		 "(e.g. 90s, 30m, 2h, 7d)"},
+		{"index", 'i', "FILE", CFG_STRING, &cfg.index,
+		 required_argument,
+		 "index file (default: the log file name with '.idx' appended, "
+		 "built if missing or out of date)"},
+		{"reindex", 'r', "", CFG_NONE, &cfg.reindex, no_argument,
+		 "rebuild the index even if it is up to date"},
 		{"device_gen", 'g',
 		 .meta = "GEN", .cfg_type = CFG_CHOICES,
 		 .value_addr = &cfg.gen,
@@ -1200,61 +2093,103 @@ static int log_parse(int argc, char **argv)
 		{"parsed_output", .cfg_type = CFG_FILE_W,
 		 .value_addr = &cfg.parsed_log_file,
 		 .argument_type = optional_positional,
-		 .force_default = "log.txt",
-		 .help = "parsed output file"},
+		 .help = "parsed output file (default: stdout)"},
 		{NULL}};
 
-	argconfig_parse(argc, argv, CMD_DESC_LOG_PARSE, opts,
+	argconfig_parse(argc, argv, CMD_DESC_LOG_QUERY, opts,
 			&cfg, sizeof(cfg));
 
-	fseek(cfg.bin_log_file, 0, SEEK_END);
-	if (ftell(cfg.bin_log_file) == 0) {
-		fprintf(stderr, "\nLog file %s is empty!\n",
-			cfg.bin_log_filename);
+	query.module = cfg.module;
+
+	for (i = 1; i <= cfg.sev; i++)
+		query.sev_mask |= 1 << i;
 
+	if (cfg.since && parse_duration(cfg.since, &query.since_ns)) {
+		fprintf(stderr, "Invalid time: %s\n", cfg.since);
 		ret = -1;
 		goto done;
 	}
-	fseek(cfg.bin_log_file, 0, SEEK_SET);
 
-	ret = switchtec_parse_log(cfg.bin_log_file, cfg.log_def_file,
-				  cfg.parsed_log_file, cfg.log_type,
-				  cfg.gen, &info);
-	if (ret < 0)
-		switchtec_perror("log_parse");
-	else
-		fprintf(stderr, "\nParsed log saved to %s.\n",
-			cfg.parsed_log_filename);
+	if (!cfg.parsed_log_file) {
+		cfg.parsed_log_file = stdout;
+		cfg.parsed_log_filename = "stdout";
+	}
 
-	if (info.version_mismatch && cfg.log_type != SWITCHTEC_LOG_PARSE_TYPE_FTDC) {
+	if (cfg.index) {
+		snprintf(index_path, sizeof(index_path), "%s", cfg.index);
+	} else if (snprintf(index_path, sizeof(index_path), "%s.idx",
+			    cfg.bin_log_filename) >= sizeof(index_path)) {
+		fprintf(stderr, "Log file name too long\n");
+		ret = -1;
+		goto done;
+	}
+
+	index_file = log_index_open(cfg.bin_log_file, index_path,
+				    cfg.reindex);
+	if (!index_file) {
+		ret = -1;
+		goto done;
+	}
+
+	ret = switchtec_log_query(cfg.bin_log_file, index_file,
+				  cfg.log_def_file, cfg.parsed_log_file,
+				  cfg.gen, &query, &info);
+	if (ret < 0 && errno == SWITCHTEC_ERR_LOG_INDEX_INVAL) {
+		/* the log has changed since it was indexed */
+		fclose(index_file);
+		index_file = log_index_open(cfg.bin_log_file, index_path, true);
+		if (!index_file)
+			goto done;
+
+		rewind(cfg.log_def_file);
+		ret = switchtec_log_query(cfg.bin_log_file, index_file,
+					  cfg.log_def_file,
+					  cfg.parsed_log_file, cfg.gen,
+					  &query, &info);
+	}
+
+	if (ret < 0) {
+		if (errno == EINVAL && query.since_ns && info.gen_unknown)
+			fprintf(stderr, "Cannot filter by time without the device generation.\n"
+					"Hint: Use '-g' option to specify device generation.\n");
+		else if (errno == EINVAL && query.module)
+			fprintf(stderr, "Unknown module: %s\n", query.module);
+		else
+			switchtec_perror("log_query");
+		goto done;
+	}
+
+	fprintf(stderr, "\n%d matching entries written to %s.\n", ret,
+		cfg.parsed_log_filename);
+
+	if (info.version_mismatch) {
 		fprintf(stderr, "\nWARNING: The two input files have different version numbers.\n");
 		fprintf(stderr, "\t\tFW Version\tSDK Version\n");
 		fprintf(stderr, "Log file:\t0x%08x\t0x%08x\n",
 			info.log_fw_version, info.log_sdk_version);
 		fprintf(stderr, "Log def file:\t0x%08x\t0x%08x\n\n",
 			info.def_fw_version, info.def_sdk_version);
-		fprintf(stderr,	"The log file is parsed but the output file might contain errors.\n");
+		fprintf(stderr,	"The log file is parsed but the output might contain errors.\n");
 	}
 
 	if (info.gen_unknown) {
 		fprintf(stderr, "\nWARNING: There is no device Generation information in the log file.\n");
-		fprintf(stderr, "           The log file is parsed but the output file contains errors.\n");
 		fprintf(stderr, "Hint: Use '-g' option to specify device generation.\n");
 	}
 
-	if (info.gen_ignored) {
-		fprintf(stderr, "\nNOTE: The input log file contains device generation information,\n");
-		fprintf(stderr, "        therefore the generation option in the command line is ignored.\n");
-	}
+	ret = 0;
 
 done:
+	if (index_file)
+		fclose(index_file);
+
 	if (cfg.bin_log_file != NULL)
 		fclose(cfg.bin_log_file);
 
 	if (cfg.log_def_file != NULL)
 		fclose(cfg.log_def_file);
 
-	if (cfg.parsed_log_file != NULL)
+	if (cfg.parsed_log_file != NULL && cfg.parsed_log_file != stdout)
 		fclose(cfg.parsed_log_file);
 
 	return ret;
@@ -3017,6 +3952,398 @@ static int evcntr_wait(int argc, char **argv)
 	return 0;
 }
 
+static void print_evcntr_sample(const struct switchtec_evcntr_sample *sample,
+				int changed_only)
+{
+	char date[32];
+	time_t secs = sample->time_us / 1000000;
+	int p, i, changed;
+
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", gmtime(&secs));
+
+	for (p = 0; p < sample->nr_ports; p++) {
+		const uint64_t *deltas = &sample->deltas[p * sample->nr_events];
+		const double *rates = &sample->rates[p * sample->nr_events];
+
+		for (i = changed = 0; i < sample->nr_events; i++)
+			changed |= deltas[i] != 0;
+		if (changed_only && !changed)
+			continue;
+
+		printf("%s.%03dZ,%d", date,
+		       (int)(sample->time_us % 1000000 / 1000),
+		       sample->ports[p].phys_id);
+		for (i = 0; i < sample->nr_events; i++)
+			printf(",%.3f", rates[i]);
+		printf("\n");
+	}
+
+	fflush(stdout);
+}
+
+/*
+ * Split a mask of events into one event per counter, as the event
+ * counter sampler wants them.
+ */
+static int evcntr_split_mask(int type_mask, enum switchtec_evcntr_type_mask
+			     events[SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS])
+{
+	int i, nr_events = 0;
+
+	for (i = 0; i < 31; i++) {
+		if (!(type_mask & (1 << i)))
+			continue;
+
+		if (nr_events == SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS) {
+			fprintf(stderr, "At most %d events can be monitored\n",
+				SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS);
+			return -1;
+		}
+		events[nr_events++] = 1 << i;
+	}
+
+	return nr_events;
+}
+
+#define CMD_DESC_EVCNTR_MONITOR "print per-port event rates at a fixed interval"
+
+static int evcntr_monitor(int argc, char **argv)
+{
+	int nr_type_choices = switchtec_evcntr_type_count();
+	struct argconfig_choice type_choices[nr_type_choices+1];
+	enum switchtec_evcntr_type_mask events[SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS];
+	struct switchtec_evcntr_sampler *sampler;
+	struct switchtec_evcntr_sample sample;
+	struct timeval now;
+	uint64_t next_us, now_us;
+	int nr_events;
+	unsigned n;
+	int ret = 0, i;
+
+	static struct {
+		struct switchtec_dev *dev;
+		int type_mask;
+		unsigned interval;
+		unsigned count;
+		int changed;
+	} cfg = {
+		.interval = 1,
+	};
+
+	const struct argconfig_options opts[] = {
+		DEVICE_OPTION,
+		{"event", 'e', "EVENT", CFG_MULT_CHOICES, &cfg.type_mask,
+		  required_argument,
+		 "event to count, may specify this argument multiple times "
+		 "(default: BAD_TLP, BAD_DLLP, RCVR_ERR, NAK_RCVD, "
+		 "REPLAY_TMR_TIMEOUT and REPLAY_NUM_ROLLOVER)",
+		 .choices=type_choices},
+		{"interval", 'i', "SECS", CFG_POSITIVE, &cfg.interval,
+		 required_argument, "time between samples (default: 1)"},
+		{"count", 'n', "NUM", CFG_NONNEGATIVE, &cfg.count,
+		 required_argument,
+		 "number of samples to print (default: 0, run until killed)"},
+		{"changed", 'c', "", CFG_NONE, &cfg.changed, no_argument,
+		 "only print ports that saw events during the interval"},
+		{NULL}};
+
+	create_type_choices(type_choices);
+	argconfig_parse(argc, argv, CMD_DESC_EVCNTR_MONITOR, opts, &cfg,
+			sizeof(cfg));
+
+	if (!cfg.type_mask)
+		cfg.type_mask = BAD_TLP | BAD_DLLP | RCVR_ERR | NAK_RCVD |
+			REPLAY_TMR_TIMEOUT | REPLAY_NUM_ROLLOVER;
+
+	nr_events = evcntr_split_mask(cfg.type_mask, events);
+	if (nr_events < 0)
+		return 1;
+
+	sampler = switchtec_evcntr_sampler_open(cfg.dev, events, nr_events);
+	if (!sampler) {
+		switchtec_perror("evcntr_monitor");
+		return -1;
+	}
+
+	printf("Time,Phys Port");
+	for (i = 0; i < nr_events; i++) {
+		int mask = events[i];
+
+		printf(",%s", switchtec_evcntr_type_str(&mask));
+	}
+	printf("\n");
+
+	gettimeofday(&now, NULL);
+	next_us = now.tv_sec * 1000000ULL + now.tv_usec;
+
+	for (n = 0; !cfg.count || n < cfg.count; n++) {
+		/* keep a fixed cadence regardless of how long sampling takes */
+		next_us += cfg.interval * 1000000ULL;
+		gettimeofday(&now, NULL);
+		now_us = now.tv_sec * 1000000ULL + now.tv_usec;
+		if (next_us > now_us) {
+			sleep((next_us - now_us) / 1000000);
+			usleep((next_us - now_us) % 1000000);
+		}
+
+		ret = switchtec_evcntr_sampler_poll(sampler, &sample);
+		if (ret) {
+			switchtec_perror("evcntr_monitor");
+			break;
+		}
+
+		print_evcntr_sample(&sample, cfg.changed);
+	}
+
+	switchtec_evcntr_sampler_close(sampler);
+	return ret;
+}
+
+#define CMD_DESC_HEALTH "rank the links of the switch by health"
+
+static const char * const health_issue_names[] = {
+	"link down", "width", "speed", "errors", "retrains", "link downs",
+};
+
+static void health_print_port(int rank, const struct switchtec_health_port *p)
+{
+	const char *sep = "";
+	int i;
+
+	printf("%4d  %4d  ", rank, p->port.phys_id);
+	if (p->port.partition == SWITCHTEC_UNBOUND_PORT)
+		printf("   -  ");
+	else
+		printf("%4d  ", p->port.partition);
+
+	if (p->link_up && p->expected_rate)
+		printf("up    x%-2d/x%-2d  GEN%d/%d  ", p->neg_width,
+		       p->cfg_width, p->link_rate, p->expected_rate);
+	else if (p->link_up)
+		printf("up    x%-2d/x%-2d  GEN%d    ", p->neg_width,
+		       p->cfg_width, p->link_rate);
+	else
+		printf("down      /x%-2d  -       ", p->cfg_width);
+
+	printf("%6.1f  ", p->score);
+
+	for (i = 0; i < ARRAY_SIZE(health_issue_names); i++) {
+		if (!(p->issues & (1 << i)))
+			continue;
+
+		printf("%s%s", sep, health_issue_names[i]);
+		sep = ", ";
+	}
+
+	if (!p->issues)
+		printf("-");
+	printf("\n");
+}
+
+static void health_print_details(const struct switchtec_health_report *r,
+				 const struct switchtec_health_port *p)
+{
+	const struct switchtec_rcvr_obj *o;
+	int i, j, mask;
+
+	printf("Port %d:\n", p->port.phys_id);
+
+	if (p->done & SWITCHTEC_HEALTH_LTSSM)
+		printf("    LTSSM log: %u retrains, %u link downs, %u rate changes\n",
+		       p->retrains, p->link_downs, p->speed_changes);
+	else
+		printf("    LTSSM log: not read\n");
+
+	if (p->done & SWITCHTEC_HEALTH_EVCNTR) {
+		for (i = 0; i < r->nr_events; i++) {
+			if (!p->errors[i])
+				continue;
+
+			mask = switchtec_health_events[i];
+			printf("    %-24s %8" PRIu64 "  (%.3g/s)\n",
+			       switchtec_evcntr_type_str(&mask),
+			       p->errors[i], p->error_rates[i]);
+		}
+	} else if (r->nr_events) {
+		printf("    Link errors: not counted\n");
+	}
+
+	for (i = 0; i < p->nr_rcvr; i++) {
+		o = &p->rcvr[i];
+		printf("    Lane %-2d  CTLE %-3d Target Amp %-4d Spec DFE %-4d DFE",
+		       i, o->ctle, o->target_amplitude, o->speculative_dfe);
+		for (j = 0; j < ARRAY_SIZE(o->dynamic_dfe); j++)
+			printf(" %d", o->dynamic_dfe[j]);
+		printf("\n");
+	}
+}
+
+static int health(int argc, char **argv)
+{
+	struct switchtec_health_cfg hcfg = {};
+	struct switchtec_health_report *r;
+	const struct switchtec_health_port *p;
+	int rank;
+
+	static struct {
+		struct switchtec_dev *dev;
+		unsigned window;
+		unsigned budget;
+		int rate;
+		int rcvr_ports;
+		int counters;
+		int no_ltssm;
+		int unhealthy;
+	} cfg = {
+		.window = 1000,
+		.budget = 10000,
+		.rcvr_ports = 3,
+	};
+	const struct argconfig_options opts[] = {
+		DEVICE_OPTION,
+		{"window", 'w', "MS", CFG_NONNEGATIVE, &cfg.window,
+		 required_argument,
+		 "time to count link errors over with --counters (default: 1000)"},
+		{"budget", 'b', "MS", CFG_NONNEGATIVE, &cfg.budget,
+		 required_argument,
+		 "time limit of the sweep, 0 for none (default: 10000)"},
+		{"rate", 'r', "GEN", CFG_POSITIVE, &cfg.rate, required_argument,
+		 "link rate to expect, slower links are reported (default: none)"},
+		{"rcvr", 'R', "NUM", CFG_NONNEGATIVE, &cfg.rcvr_ports,
+		 required_argument,
+		 "number of unhealthy links to read receiver objects of (default: 3)"},
+		{"counters", 'c', "", CFG_NONE, &cfg.counters, no_argument,
+		 "count link errors, this reconfigures the event counters of "
+		 "every stack and does not restore them"},
+		{"no-ltssm", 'L', "", CFG_NONE, &cfg.no_ltssm, no_argument,
+		 "do not read the LTSSM logs"},
+		{"unhealthy", 'u', "", CFG_NONE, &cfg.unhealthy, no_argument,
+		 "only list links with issues"},
+		{NULL}};
+
+	argconfig_parse(argc, argv, CMD_DESC_HEALTH, opts, &cfg, sizeof(cfg));
+
+	if (cfg.counters)
+		hcfg.parts |= SWITCHTEC_HEALTH_EVCNTR;
+	if (!cfg.no_ltssm)
+		hcfg.parts |= SWITCHTEC_HEALTH_LTSSM;
+	if (cfg.rcvr_ports)
+		hcfg.parts |= SWITCHTEC_HEALTH_RCVR;
+	hcfg.window_ms = cfg.window;
+	hcfg.budget_ms = cfg.budget;
+	hcfg.expected_rate = cfg.rate;
+	hcfg.max_rcvr_ports = cfg.rcvr_ports;
+
+	r = switchtec_health_sweep(cfg.dev, &hcfg);
+	if (!r) {
+		switchtec_perror("health");
+		return -1;
+	}
+
+	printf("Swept %d ports in %u ms", r->nr_ports, r->elapsed_ms);
+	if (r->window_us)
+		printf(", link errors counted over %.2f s", r->window_us / 1e6);
+	printf("\n");
+	if (r->budget_exceeded)
+		printf("The time budget ran out, some parts were skipped\n");
+
+	printf("\nRank  Port  Part  Link  Width    Rate    Score   Issues\n");
+	for (rank = 0, p = r->ports; p < r->ports + r->nr_ports; p++) {
+		if (cfg.unhealthy && !p->issues)
+			continue;
+		health_print_port(++rank, p);
+	}
+
+	for (p = r->ports; p < r->ports + r->nr_ports; p++) {
+		if (!p->issues)
+			continue;
+		printf("\n");
+		health_print_details(r, p);
+	}
+
+	switchtec_health_free(r);
+	return 0;
+}
+
+#define CMD_DESC_EXPORT "serve the metrics of one or more devices to Prometheus"
+
+static int export(int argc, char **argv)
+{
+	int nr_type_choices = switchtec_evcntr_type_count();
+	struct argconfig_choice type_choices[nr_type_choices+1];
+	enum switchtec_evcntr_type_mask events[SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS];
+	unsigned flags = SWITCHTEC_PMON_BW;
+	struct switchtec_dev **devs;
+	int nr_devs, nr_events, i, ret = -1;
+
+	static struct {
+		const char *device;
+		const char *addr;
+		unsigned interval;
+		int latency;
+		int type_mask;
+	} cfg = {
+		.addr = "127.0.0.1:9786",
+		.interval = 5,
+	};
+	const struct argconfig_options opts[] = {
+		{"device", .cfg_type = CFG_STRING, .value_addr = &cfg.device,
+		 .argument_type = required_positional,
+		 .help = "devices to export, more may follow the first"},
+		{"address", 'a', "ADDR", CFG_STRING, &cfg.addr,
+		 required_argument,
+		 "[HOST:]PORT or unix:PATH to serve /metrics on "
+		 "(default: 127.0.0.1:9786)"},
+		{"interval", 'i', "SECS", CFG_POSITIVE, &cfg.interval,
+		 required_argument, "time between samples (default: 5)"},
+		{"latency", 'l', "", CFG_NONE, &cfg.latency, no_argument,
+		 "also export the latency of each sample interval, this sets "
+		 "up and clears the latency counter of every port"},
+		{"event", 'e', "EVENT", CFG_MULT_CHOICES, &cfg.type_mask,
+		  required_argument,
+		 "count this event on every port, may specify this argument "
+		 "multiple times (this sets up the event counters)",
+		 .choices=type_choices},
+		{NULL}};
+
+	create_type_choices(type_choices);
+	argconfig_parse(argc, argv, CMD_DESC_EXPORT, opts, &cfg,
+			sizeof(cfg));
+
+	nr_events = evcntr_split_mask(cfg.type_mask, events);
+	if (nr_events < 0)
+		return 1;
+
+	if (cfg.latency)
+		flags |= SWITCHTEC_PMON_LAT;
+
+	/* the first device is argv[optind - 1], the rest follow it */
+	nr_devs = argc - optind + 1;
+	devs = calloc(nr_devs, sizeof(*devs));
+	if (!devs) {
+		perror("export");
+		return -1;
+	}
+
+	for (i = 0; i < nr_devs; i++) {
+		devs[i] = switchtec_open(argv[optind - 1 + i]);
+		if (!devs[i]) {
+			switchtec_perror(argv[optind - 1 + i]);
+			goto out;
+		}
+	}
+
+	ret = export_main(devs, nr_devs, cfg.addr, cfg.interval, flags,
+			  events, nr_events);
+
+out:
+	for (i = 0; i < nr_devs; i++)
+		if (devs[i])
+			switchtec_close(devs[i]);
+	free(devs);
+	return ret;
+}
+
 #define CMD_DESC_RTC "read the real-time clock"
 static int rtc(int argc, char **argv)
 {
@@ -3274,12 +4601,17 @@ static const struct cmd commands[] = {
 	CMD(info, CMD_DESC_INFO),
 	CMD(gui, CMD_DESC_GUI),
 	CMD(status, CMD_DESC_STATUS),
+	CMD(health, CMD_DESC_HEALTH),
 	CMD(bw, CMD_DESC_BW),
 	CMD(latency, CMD_DESC_LATENCY),
+	CMD(metrics_publish, CMD_DESC_METRICS_PUBLISH),
+	CMD(metrics_show, CMD_DESC_METRICS_SHOW),
 	CMD(events, CMD_DESC_EVENTS),
 	CMD(event_wait, CMD_DESC_EVENT_WAIT),
 	CMD(log_dump, CMD_DESC_LOG_DUMP),
 	CMD(log_parse, CMD_DESC_LOG_PARSE),
+	CMD(log_query, CMD_DESC_LOG_QUERY),
+	CMD(log_merge, CMD_DESC_LOG_MERGE),
 	CMD(test, CMD_DESC_TEST),
 	CMD(temp, CMD_DESC_TEMP),
 	CMD(port_bind_info, CMD_DESC_PORT_BIND_INFO),
@@ -3300,6 +4632,8 @@ static const struct cmd commands[] = {
 	CMD(evcntr_show, CMD_DESC_EVCNTR_SHOW),
 	CMD(evcntr_del, CMD_DESC_EVCNTR_DEL),
 	CMD(evcntr_wait, CMD_DESC_EVCNTR_WAIT),
+	CMD(evcntr_monitor, CMD_DESC_EVCNTR_MONITOR),
+	CMD(export, CMD_DESC_EXPORT),
 	CMD(rtc, CMD_DESC_RTC),
 	CMD(twi, CMD_DESC_TWI),
 	{},
@@ -0,0 +1,142 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * This benchmarks switchtec_parse_log() on a synthetic app log. It
+ * writes a log definition file with a mix of format strings and a binary
+ * log with random entries, then reports how many entries per second the
+ * library parses. No Switchtec device is needed.
+ *
+ * Usage: log_bench [number of entries] [number of threads]
+ */
+
+#include <switchtec/switchtec.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_MODULES	64
+#define NUM_EVENTS	32
+
+static const char *formats[] = {
+	"Port %d link up, width x%d, rate %d\n",
+	"LTSSM state 0x%08x -> 0x%08x\n",
+	"Event %u on stack %u, count %u\n",
+	"Timeout waiting for %x (status %#x)\n",
+	"Config write addr 0x%x data 0x%08X mask %x\n",
+};
+
+static int write_defs(FILE *f)
+{
+	int m, e;
+
+	fprintf(f, "# SDK Version: 0x%08x\n", 0);
+	fprintf(f, "# FW Version: 0x%08x\n", 0);
+
+	for (m = 0; m < NUM_MODULES; m++) {
+		fprintf(f, "MODULE_%d %d %d\n", m, m, NUM_EVENTS);
+		for (e = 0; e < NUM_EVENTS; e++)
+			fputs(formats[(m + e) % 5], f);
+	}
+
+	return fflush(f);
+}
+
+static int write_log(FILE *f, unsigned long count)
+{
+	uint32_t entry[8];
+	uint64_t ts = 0;
+	unsigned long i;
+	int j;
+
+	srand(1);
+
+	for (i = 0; i < count; i++) {
+		ts += rand() % 100000;
+		entry[0] = ts >> 32;
+		entry[1] = ts;
+		entry[2] = (2 << 28) | ((rand() % NUM_MODULES) << 16) |
+			(rand() % NUM_EVENTS);
+		for (j = 3; j < 8; j++)
+			entry[j] = rand();
+
+		if (fwrite(entry, sizeof(entry), 1, f) != 1)
+			return -1;
+	}
+
+	return fflush(f);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long count = 1000000;
+	unsigned int threads = 1;
+	struct timespec start, end;
+	FILE *def, *bin, *out;
+	double secs;
+	int ret;
+
+	if (argc > 1)
+		count = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		threads = strtoul(argv[2], NULL, 0);
+
+	def = tmpfile();
+	bin = tmpfile();
+	out = tmpfile();
+	if (!def || !bin || !out) {
+		perror("tmpfile");
+		return 1;
+	}
+
+	if (write_defs(def) || write_log(bin, count)) {
+		perror("generating log");
+		return 1;
+	}
+
+	rewind(def);
+	rewind(bin);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = switchtec_parse_log_parallel(bin, def, out,
+					   SWITCHTEC_LOG_PARSE_TYPE_APP,
+					   SWITCHTEC_GEN4, threads, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (ret < 0) {
+		switchtec_perror("switchtec_parse_log_parallel");
+		return 1;
+	}
+
+	secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("Parsed %lu entries in %.3f s: %.0f entries/s, %.1f MB/s of output\n",
+	       count, secs, count / secs, ftell(out) / secs / 1e6);
+
+	return 0;
+}
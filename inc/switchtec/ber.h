@@ -0,0 +1,95 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef LIBSWITCHTEC_BER_H
+#define LIBSWITCHTEC_BER_H
+
+/**
+ * @file
+ * @brief Timed bit error rate tests with the pattern generator/monitor
+ */
+
+#include <switchtec/switchtec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Settings of a BER test
+ */
+struct switchtec_ber_cfg {
+	/** Pattern to generate and check, in the encoding of the switch */
+	int pattern;
+
+	/**
+	 * Rate of the pattern generator, only used with \p generate; 0
+	 * leaves it to the switch. Without a generator, or with 0, the
+	 * current link rate of the port is used for the BER.
+	 */
+	enum switchtec_diag_pattern_link_rate link_rate;
+
+	int generate;		//!< Also start the generators of the ports
+	double confidence;	//!< Confidence level of the BER bounds
+};
+
+/**
+ * @brief Results of one lane of a BER test
+ *
+ * Errors injected with switchtec_ber_inject() are counted in \p errors.
+ * Those the next sample finds are left out of the BER.
+ */
+struct switchtec_ber_lane {
+	int port_id;			//!< Physical port ID
+	int lane_id;			//!< Lane within the port
+	int disabled;			//!< The lane's monitor is disabled
+	unsigned int nr_samples;	//!< Samples read
+	unsigned int nr_failed;		//!< Samples the switch refused
+	unsigned long long errors;	//!< Errors seen since the start
+	unsigned long long injected;	//!< Errors injected since the start
+	int inject_missed;		//!< An injection was not fully seen
+	double seconds;			//!< Time covered by the samples
+	double bits;			//!< Bits checked
+	double ber;			//!< Measured bit error rate
+	double ber_lower;		//!< Lower confidence bound of the BER
+	double ber_upper;		//!< Upper confidence bound of the BER
+};
+
+struct switchtec_ber_test;
+
+struct switchtec_ber_test *switchtec_ber_start(struct switchtec_dev *dev,
+		const int *port_ids, int nr_ports,
+		const struct switchtec_ber_cfg *cfg);
+int switchtec_ber_sample(struct switchtec_ber_test *test);
+int switchtec_ber_inject(struct switchtec_ber_test *test, int port_id,
+			 unsigned int err_cnt);
+int switchtec_ber_lanes(struct switchtec_ber_test *test,
+			const struct switchtec_ber_lane **lanes);
+int switchtec_ber_stop(struct switchtec_ber_test *test);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef LIBSWITCHTEC_EQ_H
+#define LIBSWITCHTEC_EQ_H
+
+/**
+ * @file
+ * @brief Switch-wide SerDes equalization snapshots
+ */
+
+#include <switchtec/switchtec.h>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SWITCHTEC_EQ_FILE_MAGIC "SWEQSNAP"
+#define SWITCHTEC_EQ_FILE_VERSION 1
+
+/**
+ * @brief Parts of a lane or port that were read successfully
+ *
+ * Not every part is available on every generation; parts the switch
+ * refuses are left out of the snapshot instead of failing it.
+ */
+enum switchtec_eq_valid {
+	SWITCHTEC_EQ_RCVR_OBJ = 1 << 0,		//!< Receiver object
+	SWITCHTEC_EQ_RCVR_EXT = 1 << 1,		//!< Extended receiver object
+	SWITCHTEC_EQ_LOCAL_COEFF = 1 << 2,	//!< Local TX coefficients
+	SWITCHTEC_EQ_FAR_COEFF = 1 << 3,	//!< Far end TX coefficients
+	SWITCHTEC_EQ_LOCAL_FSLF = 1 << 4,	//!< Local FS/LF
+	SWITCHTEC_EQ_FAR_FSLF = 1 << 5,		//!< Far end FS/LF
+	SWITCHTEC_EQ_TX_TABLE = 1 << 6,		//!< Far end TX EQ table (port)
+};
+
+/**
+ * @brief Equalization settings of one lane
+ */
+struct switchtec_eq_lane {
+	int lane_id;		//!< Lane within the port
+	unsigned valid;		//!< enum switchtec_eq_valid
+
+	/* receiver object */
+	int ctle;
+	int target_amplitude;
+	int speculative_dfe;
+	int dynamic_dfe[7];
+
+	/* extended receiver object */
+	int ctle2_rx_mode;
+	int dtclk_5;
+	int dtclk_8_6;
+	int dtclk_9;
+
+	/* TX equalization */
+	int local_pre;
+	int local_post;
+	int far_pre;
+	int far_post;
+	int local_fs;
+	int local_lf;
+	int far_fs;
+	int far_lf;
+};
+
+/**
+ * @brief Equalization settings of one port
+ */
+struct switchtec_eq_port {
+	int port_id;		//!< Physical port ID
+	int link_rate;		//!< Negotiated link rate (generation)
+	int link_width;		//!< Negotiated link width
+	unsigned valid;		//!< SWITCHTEC_EQ_TX_TABLE if the table was read
+	struct switchtec_port_eq_table table;	//!< Far end TX EQ table
+	int nr_lanes;
+	struct switchtec_eq_lane *lanes;
+};
+
+/**
+ * @brief Equalization settings of every link-up port of a switch
+ */
+struct switchtec_eq_snapshot {
+	enum switchtec_gen gen;	//!< Generation of the switch
+	uint64_t time_us;	//!< Host time of the snapshot (since the epoch)
+	int nr_ports;
+	struct switchtec_eq_port *ports;
+};
+
+/**
+ * @brief A value that differs between two snapshots
+ */
+struct switchtec_eq_diff {
+	int port_id;		//!< Physical port ID
+	int lane_id;		//!< Lane within the port, -1 for the port
+	int step_id;		//!< Step of the TX EQ table, -1 for none
+	const char *field;	//!< Name of the value
+	int old_val;		//!< Value in the first snapshot
+	int new_val;		//!< Value in the second snapshot
+};
+
+struct switchtec_eq_snapshot *switchtec_eq_snapshot(struct switchtec_dev *dev);
+void switchtec_eq_snapshot_free(struct switchtec_eq_snapshot *snap);
+
+int switchtec_eq_snapshot_write(const struct switchtec_eq_snapshot *snap,
+				FILE *f);
+int switchtec_eq_snapshot_write_json(const struct switchtec_eq_snapshot *snap,
+				     FILE *f);
+struct switchtec_eq_snapshot *switchtec_eq_snapshot_read(FILE *f);
+
+int switchtec_eq_snapshot_diff(const struct switchtec_eq_snapshot *a,
+			       const struct switchtec_eq_snapshot *b,
+			       int threshold, struct switchtec_eq_diff **diffs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
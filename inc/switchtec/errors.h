@@ -39,6 +39,12 @@ enum {
 	SWITCHTEC_ERR_INVALID_PORT,
 	SWITCHTEC_ERR_INVALID_LANE,
 	SWITCHTEC_ERR_DYNAMIC_BIF_UNSUPPORTED,
+	SWITCHTEC_ERR_LOG_INDEX_INVAL,
+	SWITCHTEC_ERR_LOG_NO_TIME_SYNC,
+	SWITCHTEC_ERR_METRICS_INVAL,
+	SWITCHTEC_ERR_EYE_FILE_INVAL,
+	SWITCHTEC_ERR_OSA_TRACE_INVAL,
+	SWITCHTEC_ERR_EQ_FILE_INVAL,
 };
 
 enum {
@@ -0,0 +1,220 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef LIBSWITCHTEC_EYE_H
+#define LIBSWITCHTEC_EYE_H
+
+/**
+ * @file
+ * @brief Binary eye data files and eye metrics
+ */
+
+#include <switchtec/switchtec.h>
+#include <switchtec/utils.h>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SWITCHTEC_EYE_FILE_MAGIC "SWEYEDAT"
+#define SWITCHTEC_EYE_FILE_VERSION 1
+
+/**
+ * @brief How the pixels of a lane are stored
+ */
+enum switchtec_eye_data_type {
+	/** @brief One float32 per pixel: BER or ratio */
+	SWITCHTEC_EYE_DATA_FLOAT32 = 0,
+	/**
+	 * @brief Error and sample counts of each pixel, stored as four
+	 *	  planes of 32-bit words: errors low, errors high, samples
+	 *	  low and samples high
+	 */
+	SWITCHTEC_EYE_DATA_RAW = 1,
+};
+
+/**
+ * @brief Encoding of the data of a lane
+ */
+enum switchtec_eye_encoding {
+	SWITCHTEC_EYE_ENC_NONE = 0,	//!< Little endian 32-bit words
+	/**
+	 * @brief Tokens of 32-bit words: with bit 31 set, the next word
+	 *	  repeated (token & 0x7fffffff) times, otherwise that many
+	 *	  words follow as they are
+	 */
+	SWITCHTEC_EYE_ENC_RLE = 1,
+};
+
+/**
+ * @brief Flags of switchtec_eye_writer_open()
+ */
+enum switchtec_eye_writer_flags {
+	/** @brief Run-length encode lanes when that makes them smaller */
+	SWITCHTEC_EYE_WRITER_COMPRESS = 1 << 0,
+};
+
+/**
+ * @brief Header of an eye data file
+ *
+ * All fields are little endian. The header is followed by one record
+ * per lane: a struct switchtec_eye_lane_hdr, then data_size bytes of
+ * data padded to a multiple of 8 bytes.
+ */
+struct switchtec_eye_file_hdr {
+	char magic[8];		//!< SWITCHTEC_EYE_FILE_MAGIC
+	uint32_t version;	//!< SWITCHTEC_EYE_FILE_VERSION
+	uint32_t hdr_size;	//!< Size of this header
+	uint32_t lane_hdr_size;	//!< Size of each lane header
+	uint32_t nr_lanes;	//!< Number of lanes, 0 if not known
+	uint32_t gen;		//!< enum switchtec_gen of the switch
+	int32_t interval_ms;	//!< Gen4 step interval, -1 if none
+
+	/* Gen5/Gen6 capture settings */
+	int32_t capture_depth;
+	int32_t sar_sel;
+	int32_t intleav_sel;
+	int32_t hstep;
+	int32_t data_mode;
+	int32_t eye_mode;
+	int32_t vstep;
+	uint32_t rsvd0;
+	uint64_t refclk;
+	uint8_t rsvd1[8];
+};
+
+/**
+ * @brief Header of one lane in an eye data file
+ */
+struct switchtec_eye_lane_hdr {
+	uint32_t data_size;	//!< Bytes of data following this header
+	uint16_t data_type;	//!< enum switchtec_eye_data_type
+	uint16_t encoding;	//!< enum switchtec_eye_encoding
+	uint16_t port_id;	//!< Physical port
+	uint16_t lane_id;	//!< Lane within the port
+	uint16_t switch_lane;	//!< Lane within the switch
+	uint16_t link_gen;	//!< Link rate of the port
+	int16_t x_start, x_end, x_step;	//!< Time (Gen4) or phase range
+	int16_t y_start, y_end, y_step;	//!< Voltage (Gen4) or bin range
+	uint32_t nr_pixels;	//!< Number of pixels, x major within y
+};
+
+/**
+ * @brief Settings an eye data file was captured with
+ */
+struct switchtec_eye_capture_info {
+	enum switchtec_gen gen;		//!< Generation of the switch
+	int interval_ms;		//!< Gen4 step interval, -1 if none
+	struct switchtec_diag_eye_params params;	//!< Gen5/Gen6 settings
+};
+
+/**
+ * @brief A lane in an eye data file
+ */
+struct switchtec_eye_lane {
+	int port_id;		//!< Physical port
+	int lane_id;		//!< Lane within the port
+	int switch_lane;	//!< Lane within the switch
+	int link_gen;		//!< Link rate of the port
+	struct range x;		//!< Time (Gen4) or phase range
+	struct range y;		//!< Voltage (Gen4) or bin range
+	enum switchtec_eye_data_type data_type;	//!< How the pixels are stored
+	size_t nr_pixels;	//!< RANGE_CNT(x) * RANGE_CNT(y)
+};
+
+/**
+ * @brief Opening of an eye at a BER threshold
+ *
+ * Pixels at or below the threshold are inside the eye. Positions and
+ * sizes are in the units of the capture's X and Y ranges. The center is
+ * the middle of the widest row of the eye, and the other values are
+ * measured through it. If no pixel meets the threshold, open is 0 and
+ * the other fields are 0.
+ */
+struct switchtec_eye_metrics {
+	double ber;		//!< BER threshold
+	int open;		//!< Whether the eye is open at this threshold
+	int center_x;		//!< X value of the center
+	int center_y;		//!< Y value of the center
+	int width;		//!< Horizontal opening through the center
+	int height;		//!< Vertical opening through the center
+	int left;		//!< Margin from the center to the left edge
+	int right;		//!< Margin from the center to the right edge
+	int top;		//!< Margin from the center to the top edge
+	int bottom;		//!< Margin from the center to the bottom edge
+	double area;		//!< Area inside the contour
+	double center_ber;	//!< Value of the center pixel
+};
+
+/**
+ * @brief One row of an eye contour
+ */
+struct switchtec_eye_contour_row {
+	int y;			//!< Y value of the row
+	int left;		//!< First X value inside the eye
+	int right;		//!< Last X value inside the eye
+};
+
+struct switchtec_eye_writer;
+struct switchtec_eye_file;
+
+struct switchtec_eye_writer *
+switchtec_eye_writer_open(FILE *f, const struct switchtec_eye_capture_info *info,
+			  unsigned flags);
+int switchtec_eye_writer_add(struct switchtec_eye_writer *w,
+			     const struct switchtec_eye_lane *lane,
+			     const double *pixels);
+int switchtec_eye_writer_add_raw(struct switchtec_eye_writer *w,
+				 const struct switchtec_eye_lane *lane,
+				 const uint64_t *errors,
+				 const uint64_t *samples);
+int switchtec_eye_writer_close(struct switchtec_eye_writer *w);
+
+struct switchtec_eye_file *switchtec_eye_file_open(const char *path);
+void switchtec_eye_file_close(struct switchtec_eye_file *f);
+int switchtec_eye_file_info(struct switchtec_eye_file *f,
+			    struct switchtec_eye_capture_info *info);
+int switchtec_eye_file_lane(struct switchtec_eye_file *f, int idx,
+			    struct switchtec_eye_lane *lane);
+int switchtec_eye_file_pixels(struct switchtec_eye_file *f, int idx,
+			      double *pixels);
+int switchtec_eye_file_raw(struct switchtec_eye_file *f, int idx,
+			   uint64_t *errors, uint64_t *samples);
+
+int switchtec_eye_metrics(const double *pixels, int nr_lanes,
+			  const struct range *X, const struct range *Y,
+			  const double *ber, int nr_ber,
+			  struct switchtec_eye_metrics *metrics);
+int switchtec_eye_contour(const double *pixels, const struct range *X,
+			  const struct range *Y, double ber,
+			  struct switchtec_eye_contour_row *rows);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
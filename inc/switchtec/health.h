@@ -0,0 +1,134 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef LIBSWITCHTEC_HEALTH_H
+#define LIBSWITCHTEC_HEALTH_H
+
+/**
+ * @file
+ * @brief Link health sweeps combining status, LTSSM logs and counters
+ */
+
+#include <switchtec/switchtec.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Number of link error events counted by a health sweep */
+#define SWITCHTEC_HEALTH_NR_EVENTS 8
+
+/**
+ * @brief Parts of a health sweep
+ */
+enum switchtec_health_parts {
+	/**
+	 * Count link errors; this reconfigures the event counters of
+	 * every stack and does not restore them
+	 */
+	SWITCHTEC_HEALTH_EVCNTR = 1 << 0,
+	SWITCHTEC_HEALTH_LTSSM = 1 << 1,	//!< Read the LTSSM logs
+	/** Read the receiver objects of the least healthy links */
+	SWITCHTEC_HEALTH_RCVR = 1 << 2,
+};
+
+/**
+ * @brief Problems found on a link
+ */
+enum switchtec_health_issue {
+	SWITCHTEC_HEALTH_LINK_DOWN = 1 << 0,	//!< The link is down
+	SWITCHTEC_HEALTH_WIDTH = 1 << 1,	//!< Narrower than configured
+	SWITCHTEC_HEALTH_SPEED = 1 << 2,	//!< Slower than expected
+	SWITCHTEC_HEALTH_ERRORS = 1 << 3,	//!< Link errors were counted
+	SWITCHTEC_HEALTH_RETRAINS = 1 << 4,	//!< The link retrained
+	SWITCHTEC_HEALTH_FLAPS = 1 << 5,	//!< The link went down
+};
+
+/**
+ * @brief Settings of a health sweep
+ */
+struct switchtec_health_cfg {
+	unsigned parts;		//!< Parts to run (enum switchtec_health_parts)
+	unsigned window_ms;	//!< Time to count link errors over
+	unsigned budget_ms;	//!< Time limit of the sweep, 0 for none
+	int expected_rate;	//!< Link rate (gen) to expect, 0 not to check
+	int max_rcvr_ports;	//!< Links to read receiver objects of
+};
+
+/**
+ * @brief Health of one port
+ */
+struct switchtec_health_port {
+	struct switchtec_port_id port;	//!< Port ID
+	int link_up;			//!< 1 if the link is up
+	int cfg_width;			//!< Configured link width
+	int neg_width;			//!< Negotiated link width
+	int link_rate;			//!< Link rate (gen)
+	int expected_rate;		//!< Link rate (gen) expected, 0 if unknown
+
+	unsigned done;		//!< Parts read (enum switchtec_health_parts)
+	unsigned issues;	//!< Problems found (enum switchtec_health_issue)
+	double score;		//!< Larger is less healthy, 0 is healthy
+
+	/** Events counted during the window, see switchtec_health_events */
+	uint64_t errors[SWITCHTEC_HEALTH_NR_EVENTS];
+	/** Events per second during the window */
+	double error_rates[SWITCHTEC_HEALTH_NR_EVENTS];
+
+	unsigned retrains;	//!< Retrains in the LTSSM log
+	unsigned link_downs;	//!< Link downs in the LTSSM log
+	unsigned speed_changes;	//!< Link rate changes in the LTSSM log
+
+	int nr_rcvr;		//!< Lanes in \p rcvr
+	struct switchtec_rcvr_obj rcvr[16];	//!< Receiver object of each lane
+};
+
+/**
+ * @brief Results of a health sweep
+ */
+struct switchtec_health_report {
+	uint64_t time_us;	//!< Host time of the start (since the epoch)
+	unsigned elapsed_ms;	//!< Time the sweep took
+	uint64_t window_us;	//!< Time the link errors were counted over
+	int nr_events;		//!< Events counted, 0 if not counted
+	int budget_exceeded;	//!< Some parts were skipped to stay in budget
+	int nr_ports;
+	struct switchtec_health_port *ports;	//!< Least healthy first
+};
+
+extern const enum switchtec_evcntr_type_mask
+	switchtec_health_events[SWITCHTEC_HEALTH_NR_EVENTS];
+
+struct switchtec_health_report *
+switchtec_health_sweep(struct switchtec_dev *dev,
+		       const struct switchtec_health_cfg *cfg);
+void switchtec_health_free(struct switchtec_health_report *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -91,4 +91,54 @@ struct log_ftdc_retr_result {
 	uint8_t data[MRPC_MAX_DATA_LEN];
 };
 
+/*
+ * Columnar export of parsed log entries, see switchtec_parse_log_columnar().
+ *
+ * The file starts with a struct log_col_hdr, followed by row groups of at
+ * most group_rows rows. Each row group is a struct log_col_group followed
+ * by its columns, each holding nr_rows values, in this order:
+ *
+ *   uint64_t timestamp	 (ns, or device ticks if ts_factor is zero)
+ *   uint32_t arg[5]	 (one column per argument dword)
+ *   uint32_t template	 (dictionary index, LOG_COL_NO_TEMPLATE if invalid)
+ *   uint16_t module	 (module ID, 0 for mailbox logs)
+ *   uint16_t entry	 (entry ID within the module)
+ *   uint8_t  severity	 (app log severity, or 1/2 for BL1/BL2 mailbox logs)
+ *
+ * and padded to a multiple of 8 bytes. After the last row group come
+ * the template dictionary and the module name table: nr_templates and
+ * nr_modules strings, each a uint32_t length followed by that many bytes.
+ * The file ends with a struct log_col_footer. All values are in host
+ * byte order.
+ */
+#define LOG_COL_VERSION 1
+#define LOG_COL_NO_TEMPLATE 0xFFFFFFFF
+
+struct log_col_hdr {
+	uint8_t magic[8];		/* "SWLOGCOL" */
+	uint32_t version;
+	uint32_t group_rows;
+	uint32_t log_type;
+	uint32_t ts_factor;
+	uint32_t fw_version;
+	uint32_t sdk_version;
+};
+
+struct log_col_group {
+	uint64_t first_row;
+	uint32_t nr_rows;
+	uint32_t reserved;
+};
+
+struct log_col_footer {
+	uint64_t templates_off;
+	uint64_t modules_off;
+	uint64_t nr_rows;
+	uint32_t nr_groups;
+	uint32_t nr_templates;
+	uint32_t nr_modules;
+	uint32_t reserved;
+	uint8_t magic[8];		/* "SWLOGCOL" */
+};
+
 #endif
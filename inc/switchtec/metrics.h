@@ -0,0 +1,137 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef LIBSWITCHTEC_METRICS_H
+#define LIBSWITCHTEC_METRICS_H
+
+/**
+ * @file
+ * @brief Shared memory metrics segment
+ */
+
+#include <switchtec/switchtec.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SWITCHTEC_METRICS_MAGIC "SWMETRIC"
+#define SWITCHTEC_METRICS_VERSION 1
+#define SWITCHTEC_METRICS_MAX_TEMPS 4
+
+/** @brief printf() format of the default segment path of a device */
+#define SWITCHTEC_METRICS_PATH_FMT "/dev/shm/%s.metrics"
+
+/**
+ * @brief Header of a metrics segment (one cache line)
+ *
+ * \p seq is a sequence lock: it is odd while the publisher is writing
+ * and incremented again once the segment is consistent.
+ */
+struct switchtec_metrics_hdr {
+	char magic[8];		//!< SWITCHTEC_METRICS_MAGIC
+	uint32_t version;	//!< SWITCHTEC_METRICS_VERSION
+	uint32_t hdr_size;	//!< Size of this header and the device line
+	uint32_t port_size;	//!< Size of each port entry
+	uint32_t max_ports;	//!< Number of port entries in the segment
+	uint32_t seq;		//!< Sequence lock
+	uint32_t publisher_pid;	//!< Process publishing, 0 once stopped
+	uint64_t update_us;	//!< Host time of the last update
+	uint64_t interval_us;	//!< Time between the last two updates
+	uint32_t nr_ports;	//!< Number of valid port entries
+	uint32_t generation;	//!< Changes when the port map changes
+	uint32_t sample_count;	//!< Number of updates so far
+	uint32_t flags;		//!< enum switchtec_pmon_flags sampled
+};
+
+/**
+ * @brief Device-wide metrics (one cache line)
+ */
+struct switchtec_metrics_dev {
+	char name[32];		//!< Device name
+	uint32_t gen;		//!< enum switchtec_gen
+	uint32_t nr_temps;	//!< Number of valid temperatures
+	float die_temp[SWITCHTEC_METRICS_MAX_TEMPS];	//!< Degrees Celsius
+	uint8_t rsvd[8];
+};
+
+/**
+ * @brief Metrics of one port (two cache lines)
+ */
+struct switchtec_metrics_port {
+	uint8_t partition;	//!< Partition the port is in
+	uint8_t stack;		//!< Stack number
+	uint8_t upstream;	//!< 1 if this is an upstream port
+	uint8_t stk_id;		//!< Port number within the stack
+	uint8_t phys_id;	//!< Physical port number
+	uint8_t log_id;		//!< Logical port number
+	uint8_t link_up;	//!< 1 if the link is up
+	uint8_t link_rate;	//!< Link rate/gen
+	uint8_t cfg_lnk_width;	//!< Configured link width
+	uint8_t neg_lnk_width;	//!< Negotiated link width
+	uint16_t ltssm;		//!< Link state
+	int32_t lat_cur_ns;	//!< Last (Gen3) or minimum latency since
+				//!< the previous update
+	int32_t lat_max_ns;	//!< Maximum latency since the previous update
+	uint8_t rsvd1[4];
+
+	/** @brief Raw bandwidth counters */
+	struct switchtec_bwcntr_res bw;
+
+	double egress_rate;	//!< Bytes per second over the last interval
+	double ingress_rate;	//!< Bytes per second over the last interval
+	uint8_t rsvd2[32];
+};
+
+/**
+ * @brief Layout of a whole metrics segment
+ */
+struct switchtec_metrics {
+	struct switchtec_metrics_hdr hdr;
+	struct switchtec_metrics_dev dev;
+	struct switchtec_metrics_port ports[SWITCHTEC_MAX_PORTS];
+};
+
+struct switchtec_metrics_pub;
+struct switchtec_metrics_reader;
+
+struct switchtec_metrics_pub *
+switchtec_metrics_pub_open(struct switchtec_dev *dev, const char *path,
+			   unsigned flags);
+int switchtec_metrics_pub_update(struct switchtec_metrics_pub *pub);
+void switchtec_metrics_pub_close(struct switchtec_metrics_pub *pub);
+
+struct switchtec_metrics_reader *switchtec_metrics_open(const char *path);
+int switchtec_metrics_read(struct switchtec_metrics_reader *r,
+			   struct switchtec_metrics *m);
+void switchtec_metrics_close(struct switchtec_metrics_reader *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
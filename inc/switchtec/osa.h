@@ -0,0 +1,129 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef LIBSWITCHTEC_OSA_H
+#define LIBSWITCHTEC_OSA_H
+
+/**
+ * @file
+ * @brief Streaming ordered set analyzer captures and binary OSA traces
+ */
+
+#include <switchtec/switchtec.h>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SWITCHTEC_OSA_TRACE_MAGIC "SWOSATRC"
+#define SWITCHTEC_OSA_TRACE_VERSION 1
+
+/**
+ * @brief Header of an OSA trace file
+ *
+ * All fields of the file are little endian.
+ */
+struct switchtec_osa_trace_hdr {
+	char magic[8];		//!< SWITCHTEC_OSA_TRACE_MAGIC
+	uint32_t version;	//!< SWITCHTEC_OSA_TRACE_VERSION
+	uint32_t hdr_size;	//!< Size of this header
+	uint32_t rec_hdr_size;	//!< Size of each record header
+	uint32_t gen;		//!< enum switchtec_gen of the switch
+	uint64_t time_us;	//!< Host time the capture was read (since the epoch)
+};
+
+/**
+ * @brief Flags of an OSA trace record
+ */
+enum switchtec_osa_trace_flags {
+	/** @brief The capture buffer of the lane wrapped */
+	SWITCHTEC_OSA_TRACE_WRAP = 1 << 0,
+};
+
+/**
+ * @brief Header of one record in an OSA trace file
+ *
+ * Each record holds the entries of one data read MRPC and is followed
+ * by \p nr_entries raw entries of SWITCHTEC_OSA_ENTRY_DWORDS dwords.
+ */
+struct switchtec_osa_trace_rec_hdr {
+	uint8_t stack_id;	//!< Stack ID
+	uint8_t lane;		//!< Lane within the stack
+	uint8_t direction;	//!< 0 for TX, 1 for RX
+	uint8_t flags;		//!< enum switchtec_osa_trace_flags
+	uint16_t first_entry;	//!< Device index of the first entry
+	uint16_t nr_entries;	//!< Number of entries
+};
+
+/**
+ * @brief A lane whose OSA capture is streamed
+ */
+struct switchtec_osa_lane {
+	int stack_id;		//!< Stack ID
+	int lane;		//!< Lane within the stack
+	int direction;		//!< 0 for TX, 1 for RX
+};
+
+/**
+ * @brief Settings of an OSA trace file
+ */
+struct switchtec_osa_trace_info {
+	enum switchtec_gen gen;	//!< Generation of the switch
+	uint64_t time_us;	//!< Host time the capture was read
+};
+
+/**
+ * @brief A decoded record of an OSA trace file
+ */
+struct switchtec_osa_trace_rec {
+	struct switchtec_osa_lane lane;	//!< Lane the entries were captured on
+	int wrap;		//!< The capture buffer of the lane wrapped
+	int first_entry;	//!< Device index of the first entry
+	int nr_entries;		//!< Number of entries
+	struct switchtec_osa_capture_entry entries[SWITCHTEC_OSA_MAX_READ];
+};
+
+struct switchtec_osa_stream;
+
+struct switchtec_osa_stream *
+switchtec_osa_stream_open(struct switchtec_dev *dev, FILE *f,
+			  const struct switchtec_osa_lane *lanes,
+			  int nr_lanes);
+int switchtec_osa_stream_poll(struct switchtec_osa_stream *s);
+int switchtec_osa_stream_lane_entries(struct switchtec_osa_stream *s,
+				      int idx, int *written, int *total);
+int switchtec_osa_stream_close(struct switchtec_osa_stream *s);
+
+int switchtec_osa_trace_read_hdr(FILE *f,
+				 struct switchtec_osa_trace_info *info);
+int switchtec_osa_trace_read(FILE *f, struct switchtec_osa_trace_rec *rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
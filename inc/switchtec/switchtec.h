@@ -47,6 +47,7 @@ extern "C" {
 #endif
 
 struct switchtec_dev;
+struct switchtec_log_follow;
 
 #define SWITCHTEC_MAX_PARTS  48
 #define SWITCHTEC_MAX_PORTS  60
@@ -254,6 +255,27 @@ struct switchtec_log_file_info {
 	bool gen_ignored;
 };
 
+/**
+ * @brief Options of switchtec_parse_log_ex()
+ */
+enum switchtec_log_parse_flags {
+	/** print UTC date and time using the log's host time correlation */
+	SWITCHTEC_LOG_PARSE_WALL_TIME = 1 << 0,
+	/** write the columnar format of switchtec_parse_log_columnar() */
+	SWITCHTEC_LOG_PARSE_COLUMNAR = 1 << 1,
+};
+
+/**
+ * @brief Selects binary app log entries
+ * @see switchtec_log_query()
+ */
+struct switchtec_log_query {
+	const char *module;		//!< module name or ID, NULL for all
+	unsigned int sev_mask;		//!< bitmask of (1 << severity), 0 for all
+	unsigned long long since_ns;	//!< only entries logged this long before
+					//!< the newest entry, 0 for all
+};
+
 /**
  * @brief Log definition data types
  */
@@ -467,11 +489,45 @@ void switchtec_perror(const char *str);
 int switchtec_log_to_file(struct switchtec_dev *dev,
 		enum switchtec_log_type type, int fd, FILE *log_def_file,
 		struct switchtec_log_file_info *info);
+struct switchtec_log_follow *switchtec_log_follow_open(
+		struct switchtec_dev *dev, enum switchtec_log_type type,
+		int fd, FILE *log_def_file,
+		struct switchtec_log_file_info *info);
+int switchtec_log_follow_poll(struct switchtec_log_follow *follow,
+			      unsigned int *lost);
+unsigned int switchtec_log_follow_interval(struct switchtec_log_follow *follow);
+void switchtec_log_follow_close(struct switchtec_log_follow *follow);
 int switchtec_parse_log(FILE *bin_log_file, FILE *log_def_file,
 			FILE *parsed_log_file,
 			enum switchtec_log_parse_type log_type,
 			enum switchtec_gen gen,
 			struct switchtec_log_file_info *info);
+int switchtec_parse_log_parallel(FILE *bin_log_file, FILE *log_def_file,
+				 FILE *parsed_log_file,
+				 enum switchtec_log_parse_type log_type,
+				 enum switchtec_gen gen,
+				 unsigned int nr_threads,
+				 struct switchtec_log_file_info *info);
+int switchtec_parse_log_ex(FILE *bin_log_file, FILE *log_def_file,
+			   FILE *parsed_log_file,
+			   enum switchtec_log_parse_type log_type,
+			   enum switchtec_gen gen, unsigned int nr_threads,
+			   unsigned int flags,
+			   struct switchtec_log_file_info *info);
+int switchtec_parse_log_merge(FILE **bin_log_files, FILE **log_def_files,
+			      const char **names, int nr_logs,
+			      FILE *parsed_log_file, enum switchtec_gen gen);
+int switchtec_parse_log_columnar(FILE *bin_log_file, FILE *log_def_file,
+				 FILE *col_file,
+				 enum switchtec_log_parse_type log_type,
+				 enum switchtec_gen gen,
+				 struct switchtec_log_file_info *info);
+int switchtec_log_index_build(FILE *bin_log_file, FILE *index_file);
+int switchtec_log_query(FILE *bin_log_file, FILE *index_file,
+			FILE *log_def_file, FILE *parsed_log_file,
+			enum switchtec_gen gen,
+			const struct switchtec_log_query *query,
+			struct switchtec_log_file_info *info);
 int switchtec_log_def_to_file(struct switchtec_dev *dev,
 			      enum switchtec_log_def_type type,
 			      FILE* file);
@@ -480,6 +536,7 @@ int switchtec_die_temps(struct switchtec_dev *dev, int nr_sensor,
 			float *sensor_readings);
 int switchtec_calc_lane_id(struct switchtec_dev *dev, int phys_port_id,
 			   int lane_id, struct switchtec_status *port);
+int switchtec_calc_status_lane_id(struct switchtec_status *port, int lane_id);
 int switchtec_calc_port_lane(struct switchtec_dev *dev, int lane_id,
 			     int *phys_port_id, int *port_lane_id,
 			     struct switchtec_status *port);
@@ -1154,6 +1211,7 @@ const char *switchtec_fw_image_type(const struct switchtec_fw_image_info *info);
 struct switchtec_fw_part_summary *
 switchtec_fw_part_summary(struct switchtec_dev *dev);
 void switchtec_fw_part_summary_free(struct switchtec_fw_part_summary *summary);
+void switchtec_fw_part_summary_invalidate(struct switchtec_dev *dev);
 int switchtec_sms_fmc_version_get(struct switchtec_dev *dev, uint32_t *info);
 int switchtec_fw_img_write_hdr(int fd, struct switchtec_fw_image_info *info);
 int switchtec_fw_is_boot_ro(struct switchtec_dev *dev);
@@ -1340,6 +1398,9 @@ const char *switchtec_evcntr_type_str(int *type_mask);
 int switchtec_evcntr_setup(struct switchtec_dev *dev, unsigned stack_id,
 			   unsigned cntr_id,
 			   struct switchtec_evcntr_setup *setup);
+int switchtec_evcntr_setup_many(struct switchtec_dev *dev, unsigned stack_id,
+				unsigned cntr_id, unsigned nr_cntrs,
+				struct switchtec_evcntr_setup *setups);
 int switchtec_evcntr_get_setup(struct switchtec_dev *dev, unsigned stack_id,
 			       unsigned cntr_id, unsigned nr_cntrs,
 			       struct switchtec_evcntr_setup *res);
@@ -1388,15 +1449,196 @@ uint64_t switchtec_bwcntr_tot(struct switchtec_bwcntr_dir *d);
 
 int switchtec_lat_setup_many(struct switchtec_dev *dev, int nr_ports,
 			     int *egress_port_ids, int *ingress_port_ids);
+int switchtec_lat_setup_all(struct switchtec_dev *dev, int ingress_port_id);
 int switchtec_lat_setup(struct switchtec_dev *dev, int egress_port_id,
 			int ingress_port_id, int clear);
 int switchtec_lat_get_many(struct switchtec_dev *dev, int nr_ports,
 			   int clear, int *egress_port_ids,
 			   int *cur_ns, int *max_ns);
+int switchtec_lat_get_all(struct switchtec_dev *dev, int clear,
+			  struct switchtec_port_id **ports,
+			  int **cur_ns, int **max_ns);
 int switchtec_lat_get(struct switchtec_dev *dev, int clear,
 		      int egress_port_ids, int *cur_ns,
 		      int *max_ns);
 
+/********** PERFORMANCE MONITOR SESSION *********/
+
+/**
+ * @brief Counters sampled by a performance monitor session
+ */
+enum switchtec_pmon_flags {
+	SWITCHTEC_PMON_BW = 1 << 0,	//!< Bandwidth counters
+	SWITCHTEC_PMON_LAT = 1 << 1,	//!< Latency counters
+	SWITCHTEC_PMON_EVCNTR = 1 << 2,	//!< Event counters of each stack
+
+	/** @brief Also fill in the PCI devices of each port's status */
+	SWITCHTEC_PMON_DEVICES = 1 << 3,
+
+	/**
+	 * @brief Clear the latency counters on every sample, so each one
+	 *	covers the time since the previous sample
+	 */
+	SWITCHTEC_PMON_LAT_CLEAR = 1 << 4,
+};
+
+struct switchtec_pmon_session;
+
+/**
+ * @brief Results of switchtec_pmon_sample()
+ *
+ * Counters that were not requested when opening the session are NULL.
+ */
+struct switchtec_pmon_sample {
+	unsigned generation;	//!< Changes when the port map is re-read
+	int nr_ports;		//!< Number of ports
+
+	const struct switchtec_status *status;	//!< Status of each port
+	const struct switchtec_port_id *ports;	//!< ID of each port
+	const struct switchtec_bwcntr_res *bw;	//!< Bandwidth of each port
+	const int *lat_cur_ns;	//!< Current latency of each port
+	const int *lat_max_ns;	//!< Maximum latency of each port
+
+	int nr_stacks;		//!< Number of stacks in \p evcntr
+	/** @brief All event counter values of each stack */
+	const unsigned (*evcntr)[SWITCHTEC_MAX_EVENT_COUNTERS];
+};
+
+struct switchtec_pmon_session *
+switchtec_pmon_session_open(struct switchtec_dev *dev, unsigned flags);
+void switchtec_pmon_session_close(struct switchtec_pmon_session *s);
+int switchtec_pmon_session_refresh(struct switchtec_pmon_session *s);
+int switchtec_pmon_session_set_bw_type(struct switchtec_pmon_session *s,
+				       enum switchtec_bw_type bw_type);
+int switchtec_pmon_sample(struct switchtec_pmon_session *s, int clear,
+			  struct switchtec_pmon_sample *sample);
+
+/********** LATENCY HISTOGRAM *********/
+
+#define SWITCHTEC_LAT_HIST_SUB_BITS 5
+#define SWITCHTEC_LAT_HIST_MAX_NS 0xFFFF
+#define SWITCHTEC_LAT_HIST_BUCKETS \
+	((16 - SWITCHTEC_LAT_HIST_SUB_BITS + 1) << SWITCHTEC_LAT_HIST_SUB_BITS)
+
+/**
+ * @brief Log-linear latency histogram with a fixed size
+ */
+struct switchtec_lat_hist {
+	uint64_t count;		//!< Number of values
+	int max_ns;		//!< Largest value
+	uint32_t buckets[SWITCHTEC_LAT_HIST_BUCKETS];
+};
+
+/**
+ * @brief Latency percentiles (-1 when there are no values)
+ */
+struct switchtec_lat_stats {
+	uint64_t count;		//!< Number of values
+	int p50_ns;		//!< Median
+	int p90_ns;		//!< 90th percentile
+	int p99_ns;		//!< 99th percentile
+	int p999_ns;		//!< 99.9th percentile
+	int max_ns;		//!< Maximum
+};
+
+struct switchtec_lat_sampler;
+
+void switchtec_lat_hist_reset(struct switchtec_lat_hist *h);
+void switchtec_lat_hist_add(struct switchtec_lat_hist *h, int ns);
+void switchtec_lat_hist_merge(struct switchtec_lat_hist *dst,
+			      const struct switchtec_lat_hist *src);
+int switchtec_lat_hist_percentile(const struct switchtec_lat_hist *h,
+				  double pct);
+void switchtec_lat_hist_stats(const struct switchtec_lat_hist *h,
+			      struct switchtec_lat_stats *st);
+
+struct switchtec_lat_sampler *
+switchtec_lat_sampler_open(struct switchtec_dev *dev, unsigned slice_ms,
+			   unsigned nr_slices);
+void switchtec_lat_sampler_close(struct switchtec_lat_sampler *s);
+int switchtec_lat_sampler_poll(struct switchtec_lat_sampler *s);
+int switchtec_lat_sampler_ports(struct switchtec_lat_sampler *s,
+				const struct switchtec_port_id **ports);
+int switchtec_lat_sampler_stats(struct switchtec_lat_sampler *s, int port,
+				struct switchtec_lat_stats *st,
+				struct switchtec_lat_hist *hist);
+
+/********** EVENT COUNTER SAMPLER *********/
+
+/** @brief Maximum number of events per port (one counter each) */
+#define SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS 8
+
+/**
+ * @brief Results of switchtec_evcntr_sampler_poll()
+ *
+ * \p deltas and \p rates hold \p nr_events values for each port in turn.
+ */
+struct switchtec_evcntr_sample {
+	uint64_t time_us;	//!< Host time of the sample (since the epoch)
+	uint64_t interval_us;	//!< Time since the previous sample
+	unsigned generation;	//!< Changes when the port map changes
+	int nr_ports;		//!< Number of ports
+	int nr_events;		//!< Number of events per port
+
+	const struct switchtec_port_id *ports;	//!< ID of each port
+	const enum switchtec_evcntr_type_mask *events;	//!< Counted events
+	const uint64_t *deltas;	//!< Events during the interval
+	const double *rates;	//!< Events per second during the interval
+};
+
+struct switchtec_evcntr_sampler;
+
+struct switchtec_evcntr_sampler *
+switchtec_evcntr_sampler_open(struct switchtec_dev *dev,
+			      const enum switchtec_evcntr_type_mask *events,
+			      int nr_events);
+void switchtec_evcntr_sampler_close(struct switchtec_evcntr_sampler *s);
+int switchtec_evcntr_sampler_poll(struct switchtec_evcntr_sampler *s,
+				  struct switchtec_evcntr_sample *sample);
+
+/********** BANDWIDTH ANALYZER *********/
+
+/**
+ * @brief Byte counters of a port, as tracked by the bandwidth analyzer
+ */
+enum switchtec_bw_series {
+	SWITCHTEC_BW_EGRESS_POSTED,
+	SWITCHTEC_BW_EGRESS_COMP,
+	SWITCHTEC_BW_EGRESS_NONPOSTED,
+	SWITCHTEC_BW_INGRESS_POSTED,
+	SWITCHTEC_BW_INGRESS_COMP,
+	SWITCHTEC_BW_INGRESS_NONPOSTED,
+	SWITCHTEC_BW_NR_SERIES,
+};
+
+/**
+ * @brief Bandwidth of one port as seen by the bandwidth analyzer
+ *
+ * All rates are in bytes per second.
+ */
+struct switchtec_bw_port_stats {
+	struct switchtec_port_id port;	//!< Port ID
+	double egress_rate;		//!< Total rate out of the port
+	double ingress_rate;		//!< Total rate into the port
+	double rate[SWITCHTEC_BW_NR_SERIES];	//!< Rate during the interval
+	double baseline[SWITCHTEC_BW_NR_SERIES];	//!< Moving average
+	double stddev[SWITCHTEC_BW_NR_SERIES];	//!< Moving standard deviation
+	/** @brief Bit (1 << series) set for every rate off its baseline */
+	unsigned anomalies;
+};
+
+struct switchtec_bw_analyzer;
+
+struct switchtec_bw_analyzer *switchtec_bw_analyzer_open(double alpha,
+							 double threshold);
+void switchtec_bw_analyzer_close(struct switchtec_bw_analyzer *a);
+int switchtec_bw_analyzer_update(struct switchtec_bw_analyzer *a,
+				 const struct switchtec_pmon_sample *sample);
+int switchtec_bw_analyzer_stats(struct switchtec_bw_analyzer *a,
+				const struct switchtec_bw_port_stats **stats);
+int switchtec_bw_analyzer_top(struct switchtec_bw_analyzer *a, int n,
+			      int *top);
+
 /********** GLOBAL ADDRESS SPACE ACCESS *********/
 
 /*
@@ -1813,10 +2055,44 @@ struct switchtec_osa_capture_data {
 	struct switchtec_osa_capture_entry entries[SWITCHTEC_OSA_MAX_ENTRIES];
 };
 
+/** @brief Dwords of each raw entry captured by the ordered set analyzer */
+#define SWITCHTEC_OSA_ENTRY_DWORDS 6
+
+/** @brief Most OSA entries returned by one data read MRPC */
+#define SWITCHTEC_OSA_MAX_READ ((MRPC_MAX_DATA_LEN - 12) / \
+				(SWITCHTEC_OSA_ENTRY_DWORDS * 4))
+
+/**
+ * @brief Raw OSA entries, from switchtec_osa_read_entries()
+ */
+struct switchtec_osa_read {
+	int entries_read;	//!< Number of entries read
+	int next_entry;		//!< Index of the entry after the last one read
+	int entries_remaining;	//!< Entries left to read from next_entry
+	int wrap;		//!< Whether the capture buffer wrapped
+	uint32_t entries[SWITCHTEC_OSA_MAX_READ][SWITCHTEC_OSA_ENTRY_DWORDS];
+};
+
 int switchtec_diag_cross_hair_enable(struct switchtec_dev *dev, int lane_id);
 int switchtec_diag_cross_hair_disable(struct switchtec_dev *dev);
 int switchtec_diag_cross_hair_get(struct switchtec_dev *dev, int start_lane_id,
 		int num_lanes, struct switchtec_diag_cross_hair *res);
+int switchtec_diag_cross_hair_w2h(const struct switchtec_diag_cross_hair *ch);
+
+/**
+ * @brief Result of one lane of a cross hair sweep
+ */
+struct switchtec_diag_cross_hair_result {
+	int port_id;		//!< Physical port, -1 if not known
+	int port_lane;		//!< Lane within the port
+	int link_rate;		//!< Link rate of the port
+	int w2h;		//!< switchtec_diag_cross_hair_w2h(), when done
+	/** @brief Final measurement, lane_id is the lane within the switch */
+	struct switchtec_diag_cross_hair ch;
+};
+
+int switchtec_diag_cross_hair_sweep(struct switchtec_dev *dev, int timeout_ms,
+		struct switchtec_diag_cross_hair_result *res, int nr_res);
 
 int switchtec_diag_eye_set_mode(struct switchtec_dev *dev,
 				enum switchtec_diag_eye_data_mode mode);
@@ -1831,6 +2107,60 @@ int switchtec_diag_eye_fetch(struct switchtec_dev *dev, double *pixels,
 			     size_t pixel_cnt, int *lane_id);
 int switchtec_diag_eye_cancel(struct switchtec_dev *dev);
 
+/** @brief Number of lanes a Gen4 eye observation lane mask can hold */
+#define SWITCHTEC_DIAG_EYE_OBSERVE_LANES 128
+
+/**
+ * @brief State of a batched Gen4 eye observation fetch, see
+ *	  switchtec_diag_eye_fetch_batch()
+ *
+ * The buffers hold lane_pixels pixels for each lane in lane_mask, in
+ * order of lane number. Only the first five fields are to be set by the
+ * caller; zero the rest before the first fetch.
+ */
+struct switchtec_diag_eye_batch {
+	int lane_mask[4];	//!< Lanes passed to switchtec_diag_eye_start()
+	size_t lane_pixels;	//!< Pixels of each lane
+	double *pixels;		//!< Error ratios, or NULL
+	uint64_t *errors;	//!< Raw error counts, or NULL
+	uint64_t *samples;	//!< Raw sample counts, or NULL
+
+	size_t fetched;		//!< Pixels fetched so far, of all lanes
+	size_t lane_cnt[SWITCHTEC_DIAG_EYE_OBSERVE_LANES];
+	unsigned wait_us;	//!< Current polling interval
+};
+
+int switchtec_diag_eye_fetch_batch(struct switchtec_dev *dev,
+				   struct switchtec_diag_eye_batch *batch);
+void switchtec_diag_eye_ratio(double *pixels, const uint64_t *errors,
+			      const uint64_t *samples, size_t cnt);
+
+/** @brief Number of bins read from each lane of a Gen5/Gen6 eye capture */
+#define SWITCHTEC_DIAG_EYE_BINS 64
+/** @brief Number of lanes a Gen5/Gen6 eye capture lane mask can hold */
+#define SWITCHTEC_DIAG_EYE_MAX_LANES 160
+
+/**
+ * @brief Gen5/Gen6 eye capture settings, see switchtec_diag_eye_start()
+ */
+struct switchtec_diag_eye_params {
+	int capture_depth;
+	int sar_sel;
+	int intleav_sel;
+	int hstep;
+	int data_mode;
+	int eye_mode;
+	uint64_t refclk;
+	int vstep;
+};
+
+int switchtec_diag_eye_capture_lanes(struct switchtec_dev *dev,
+		const int *lanes, int nr_lanes, int max_batch,
+		const struct switchtec_diag_eye_params *params,
+		int (*lane_fn)(void *ctx, int lane_id, int num_phases,
+			       const double *ber_data),
+		void *ctx);
+
 int switchtec_diag_loopback_set(struct switchtec_dev *dev, int port_id,
 				int enable, int enable_parallel,
 				int enable_external, int enable_ltssm,
@@ -1907,6 +2237,63 @@ int switchtec_osa_config_pattern(struct switchtec_dev * dev, int stack_id,
 int switchtec_osa_capture_data(struct switchtec_dev * dev, int stack_id,
 			       int lane, int direction,
 			       struct switchtec_osa_capture_data *data);
+int switchtec_osa_read_entries(struct switchtec_dev *dev, int stack_id,
+			       int lane, int direction, int start_entry,
+			       int max_entries, struct switchtec_osa_read *rd);
+void switchtec_osa_decode_entry(const uint32_t *raw,
+				struct switchtec_osa_capture_entry *entry);
+
+/********** LTSSM COLLECTOR *********/
+
+/** @brief Number of major LTSSM states tracked by the collector */
+#define SWITCHTEC_LTSSM_MAX_STATES 64
+
+/**
+ * @brief An LTSSM log entry gathered by the LTSSM collector
+ */
+struct switchtec_ltssm_entry {
+	uint64_t time_us;	//!< Host time of the poll that found the entry
+	int port;		//!< Physical port ID
+	unsigned int timestamp;	//!< Device timestamp of the transition
+	float link_rate;	//!< Link rate in GT/s
+	int link_state;		//!< State, as passed to switchtec_ltssm_str()
+	int link_width;		//!< Link width (Gen6 only)
+};
+
+/**
+ * @brief Transition statistics of one port, from switchtec_ltssm_collector_stats()
+ *
+ * \p visits and \p dwell are indexed by the major LTSSM state. Dwell
+ * times are in device timestamp ticks and only count time up to the
+ * latest entry of the port.
+ */
+struct switchtec_ltssm_stats {
+	uint64_t nr_entries;	//!< Entries collected
+	uint64_t nr_dropped;	//!< Entries overwritten in the ring
+	unsigned nr_gaps;	//!< Polls that may have missed entries
+	unsigned retrains;	//!< Transitions from L0 to Recovery
+	unsigned link_downs;	//!< Transitions from L0 or Recovery to Detect
+	unsigned speed_changes;	//!< Changes of the link rate
+	unsigned visits[SWITCHTEC_LTSSM_MAX_STATES];	//!< Entries into each state
+	uint64_t dwell[SWITCHTEC_LTSSM_MAX_STATES];	//!< Ticks in each state
+};
+
+struct switchtec_ltssm_collector;
+
+struct switchtec_ltssm_collector *
+switchtec_ltssm_collector_open(struct switchtec_dev *dev, const int *ports,
+			       int nr_ports, size_t ring_size);
+void switchtec_ltssm_collector_close(struct switchtec_ltssm_collector *c);
+int switchtec_ltssm_collector_poll(struct switchtec_ltssm_collector *c,
+				   const struct switchtec_ltssm_entry **entries);
+int switchtec_ltssm_collector_ports(struct switchtec_ltssm_collector *c,
+				    const int **ports);
+int switchtec_ltssm_collector_entries(struct switchtec_ltssm_collector *c,
+				      int port,
+				      struct switchtec_ltssm_entry *entries,
+				      size_t max_entries);
+int switchtec_ltssm_collector_stats(struct switchtec_ltssm_collector *c,
+				    int port, struct switchtec_ltssm_stats *st);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,510 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Switchtec core library functions for timed BER tests
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+#include "switchtec/switchtec.h"
+#include "switchtec/ber.h"
+#include "switchtec/errors.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+/**
+ * @defgroup BerTest BER Tests
+ * @brief Timed bit error rate tests on many ports and lanes
+ *
+ * switchtec_ber_start() enables the pattern monitor (and optionally the
+ * generator) on a set of ports and takes a baseline of every lane's
+ * error counter. The caller then calls switchtec_ber_sample() at its
+ * chosen cadence, which reads all lanes and updates the running BER and
+ * its confidence bounds, until it ends the test with
+ * switchtec_ber_stop().
+ *
+ * @{
+ */
+
+struct ber_lane_state {
+	unsigned long long last_cnt;	//!< Last value of the error counter
+	unsigned long long pending;	//!< Injected errors not yet sampled
+	unsigned long long seen;	//!< Injected errors that were sampled
+	double gtps;			//!< Lane rate in GT/s, 0 if unknown
+};
+
+struct switchtec_ber_test {
+	struct switchtec_dev *dev;
+	struct switchtec_ber_cfg cfg;
+	int nr_ports;
+	int *port_ids;
+	int nr_lanes;
+	struct switchtec_ber_lane *lanes;
+	struct ber_lane_state *state;
+	double start;
+};
+
+static const float ber_gen_transfers[] = {0, 2.5, 5, 8, 16, 32, 64};
+
+static double ber_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int ber_pattern_disabled(struct switchtec_dev *dev)
+{
+	if (switchtec_is_gen6(dev))
+		return SWITCHTEC_DIAG_GEN_6_PATTERN_PRBS_DISABLED;
+	if (switchtec_is_gen5(dev))
+		return SWITCHTEC_DIAG_GEN_5_PATTERN_PRBS_DISABLED;
+	return SWITCHTEC_DIAG_PATTERN_PRBS_DISABLED;
+}
+
+/* Regularized lower incomplete gamma function P(a, x) */
+static double ber_gamma_p(double a, double x)
+{
+	double sum, term, an, b, c, d, h;
+	int i;
+
+	if (x <= 0)
+		return 0;
+
+	if (x < a + 1) {
+		term = sum = 1 / a;
+		for (i = 1; i < 100000; i++) {
+			term *= x / (a + i);
+			sum += term;
+			if (term < sum * 1e-15)
+				break;
+		}
+		return sum * exp(-x + a * log(x) - lgamma(a));
+	}
+
+	/* continued fraction for Q(a, x) */
+	b = x + 1 - a;
+	c = 1 / 1e-300;
+	d = 1 / b;
+	h = d;
+	for (i = 1; i < 100000; i++) {
+		an = -i * (i - a);
+		b += 2;
+		d = an * d + b;
+		if (fabs(d) < 1e-300)
+			d = 1e-300;
+		c = b + an / c;
+		if (fabs(c) < 1e-300)
+			c = 1e-300;
+		d = 1 / d;
+		h *= d * c;
+		if (fabs(d * c - 1) < 1e-15)
+			break;
+	}
+	return 1 - exp(-x + a * log(x) - lgamma(a)) * h;
+}
+
+/*
+ * Find the Poisson mean at which at most k events happen with
+ * probability p. The probability falls as the mean grows.
+ */
+static double ber_poisson_mean(unsigned long long k, double p)
+{
+	double lo = 0, hi = k + 10 * sqrt(k + 1.0) + 50, mid;
+	int i;
+
+	while (1 - ber_gamma_p(k + 1.0, hi) > p)
+		hi *= 2;
+
+	for (i = 0; i < 200 && hi - lo > hi * 1e-12; i++) {
+		mid = (lo + hi) / 2;
+		if (1 - ber_gamma_p(k + 1.0, mid) > p)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return (lo + hi) / 2;
+}
+
+/*
+ * Each bound is one-sided at the configured confidence level: the BER is
+ * below ber_upper (and above ber_lower) with that probability.
+ */
+static void ber_lane_update(struct switchtec_ber_test *test,
+			    struct switchtec_ber_lane *lane,
+			    struct ber_lane_state *st)
+{
+	double cl = test->cfg.confidence;
+	unsigned long long errs;
+
+	lane->bits = lane->seconds * st->gtps * 1e9;
+	if (!lane->bits) {
+		lane->ber = lane->ber_lower = lane->ber_upper = NAN;
+		return;
+	}
+
+	/* a missed injection must not hide real errors */
+	errs = lane->errors - st->seen;
+
+	lane->ber = errs / lane->bits;
+	lane->ber_upper = ber_poisson_mean(errs, 1 - cl) / lane->bits;
+	lane->ber_lower = errs ?
+		ber_poisson_mean(errs - 1, cl) / lane->bits : 0;
+}
+
+static int ber_read_lane(struct switchtec_ber_test *test,
+			 struct switchtec_ber_lane *lane,
+			 unsigned long long *cnt)
+{
+	int ret;
+
+	ret = switchtec_diag_pattern_mon_get(test->dev, lane->port_id,
+					     lane->lane_id, NULL, cnt);
+	if (ret == ERR_PAT_MON_IS_DISABLED)
+		lane->disabled = 1;
+
+	return ret;
+}
+
+static int ber_setup_ports(struct switchtec_ber_test *test)
+{
+	int pattern = test->cfg.pattern;
+	int i, ret;
+
+	for (i = 0; i < test->nr_ports; i++) {
+		ret = switchtec_diag_pattern_mon_set(test->dev,
+						     test->port_ids[i],
+						     pattern);
+		if (ret)
+			return ret;
+
+		if (!test->cfg.generate)
+			continue;
+
+		ret = switchtec_diag_pattern_gen_set(test->dev,
+						     test->port_ids[i],
+						     pattern,
+						     test->cfg.link_rate);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Disable as much as possible, returning the first error */
+static int ber_disable_ports(struct switchtec_ber_test *test)
+{
+	int pattern = ber_pattern_disabled(test->dev);
+	int i, ret, err = 0;
+
+	for (i = 0; i < test->nr_ports; i++) {
+		ret = switchtec_diag_pattern_mon_set(test->dev,
+						     test->port_ids[i],
+						     pattern);
+		if (ret && !err)
+			err = ret;
+
+		if (!test->cfg.generate)
+			continue;
+
+		ret = switchtec_diag_pattern_gen_set(test->dev,
+						     test->port_ids[i],
+						     pattern,
+						     test->cfg.link_rate);
+		if (ret && !err)
+			err = ret;
+	}
+
+	return err;
+}
+
+static struct switchtec_status *ber_find_port(struct switchtec_status *status,
+					      int nr_status, int port_id)
+{
+	int i;
+
+	for (i = 0; i < nr_status; i++)
+		if (status[i].port.phys_id == port_id)
+			return &status[i];
+
+	errno = SWITCHTEC_ERR_INVALID_PORT;
+	return NULL;
+}
+
+static int ber_find_lanes(struct switchtec_ber_test *test)
+{
+	struct switchtec_status *status, *s;
+	struct switchtec_ber_lane *lane;
+	int nr_status, i, l, rate, ret = -1;
+
+	nr_status = switchtec_status(test->dev, &status);
+	if (nr_status < 0)
+		return -1;
+
+	for (i = 0; i < test->nr_ports; i++) {
+		s = ber_find_port(status, nr_status, test->port_ids[i]);
+		if (!s)
+			goto out;
+		test->nr_lanes += s->cfg_lnk_width;
+	}
+
+	test->lanes = calloc(test->nr_lanes, sizeof(*test->lanes));
+	test->state = calloc(test->nr_lanes, sizeof(*test->state));
+	if (!test->lanes || !test->state)
+		goto out;
+
+	lane = test->lanes;
+	for (i = 0; i < test->nr_ports; i++) {
+		s = ber_find_port(status, nr_status, test->port_ids[i]);
+
+		/* the generator rate only applies to ports it drives */
+		rate = test->cfg.generate && test->cfg.link_rate ?
+			test->cfg.link_rate : s->link_rate;
+		if (rate >= ARRAY_SIZE(ber_gen_transfers))
+			rate = 0;
+
+		for (l = 0; l < s->cfg_lnk_width; l++, lane++) {
+			lane->port_id = test->port_ids[i];
+			lane->lane_id = l;
+			lane->ber = lane->ber_lower = lane->ber_upper = NAN;
+			test->state[lane - test->lanes].gtps =
+				ber_gen_transfers[rate];
+		}
+	}
+
+	ret = 0;
+
+out:
+	switchtec_status_free(status, nr_status);
+	return ret;
+}
+
+static void ber_free(struct switchtec_ber_test *test)
+{
+	free(test->port_ids);
+	free(test->lanes);
+	free(test->state);
+	free(test);
+}
+
+/**
+ * @brief Start a BER test
+ * @param[in] dev	Switchtec device handle
+ * @param[in] port_ids	Physical IDs of the ports to test
+ * @param[in] nr_ports	Number of ports
+ * @param[in] cfg	Test settings
+ * @return The test on success, NULL on failure
+ *
+ * Enables the pattern monitor, and the generator if \p cfg->generate is
+ * set, on every port and reads the error counter of each configured
+ * lane as the baseline. Lanes whose monitor is disabled are marked as
+ * such and not read again. The test must be ended with
+ * switchtec_ber_stop(), which also disables the monitors and generators.
+ */
+struct switchtec_ber_test *switchtec_ber_start(struct switchtec_dev *dev,
+		const int *port_ids, int nr_ports,
+		const struct switchtec_ber_cfg *cfg)
+{
+	struct switchtec_ber_test *test;
+	int i, ret;
+
+	if (nr_ports <= 0 || cfg->confidence <= 0 || cfg->confidence >= 1) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	test = calloc(1, sizeof(*test));
+	if (!test)
+		return NULL;
+
+	test->dev = dev;
+	test->cfg = *cfg;
+	test->nr_ports = nr_ports;
+	test->port_ids = malloc(nr_ports * sizeof(*port_ids));
+	if (!test->port_ids)
+		goto err_free;
+	memcpy(test->port_ids, port_ids, nr_ports * sizeof(*port_ids));
+
+	if (ber_find_lanes(test))
+		goto err_free;
+
+	ret = ber_setup_ports(test);
+	if (ret)
+		goto err_disable;
+
+	for (i = 0; i < test->nr_lanes; i++) {
+		ret = ber_read_lane(test, &test->lanes[i],
+				    &test->state[i].last_cnt);
+		if (ret < 0)
+			goto err_disable;
+	}
+
+	test->start = ber_now();
+
+	return test;
+
+err_disable:
+	ber_disable_ports(test);
+err_free:
+	ber_free(test);
+	return NULL;
+}
+
+/**
+ * @brief Read the error counters of all lanes of a BER test
+ * @param[in] test	BER test
+ * @return The number of lanes read, or -1 on failure
+ *
+ * Updates the errors, BER and confidence bounds of every lane. A lane
+ * the switch refuses to report is counted in its \p nr_failed and keeps
+ * its previous results. If a counter goes backwards it is taken to have
+ * been reset and its new value is added to the errors.
+ */
+int switchtec_ber_sample(struct switchtec_ber_test *test)
+{
+	struct switchtec_ber_lane *lane;
+	struct ber_lane_state *st;
+	unsigned long long cnt, delta;
+	int i, ret, nr = 0;
+
+	for (i = 0; i < test->nr_lanes; i++) {
+		lane = &test->lanes[i];
+		st = &test->state[i];
+
+		if (lane->disabled)
+			continue;
+
+		ret = ber_read_lane(test, lane, &cnt);
+		if (ret < 0)
+			return -1;
+
+		if (ret) {
+			lane->nr_failed++;
+			continue;
+		}
+
+		delta = cnt >= st->last_cnt ? cnt - st->last_cnt : cnt;
+		st->last_cnt = cnt;
+
+		if (delta < st->pending) {
+			lane->inject_missed = 1;
+			st->seen += delta;
+		} else {
+			st->seen += st->pending;
+		}
+		st->pending = 0;
+
+		lane->errors += delta;
+		lane->nr_samples++;
+		lane->seconds = ber_now() - test->start;
+		ber_lane_update(test, lane, st);
+		nr++;
+	}
+
+	return nr;
+}
+
+/**
+ * @brief Inject errors into the generators of a BER test
+ * @param[in] test	BER test
+ * @param[in] port_id	Physical port ID, or -1 for all ports of the test
+ * @param[in] err_cnt	Errors to inject into each lane
+ * @return 0 on success, error code on failure
+ *
+ * Meant to validate the checkers when each port's TX is looped back to
+ * its RX: the errors are expected on the same port's lanes at the next
+ * switchtec_ber_sample(), which sets \p inject_missed on lanes that saw
+ * fewer. As many errors as were injected and are found by that sample
+ * are left out of the BER. Inject right after a sample so the next one
+ * covers all of them. The firmware limits \p err_cnt to less than 1000.
+ */
+int switchtec_ber_inject(struct switchtec_ber_test *test, int port_id,
+			 unsigned int err_cnt)
+{
+	int i, ret;
+
+	for (i = 0; i < test->nr_ports; i++) {
+		if (port_id >= 0 && test->port_ids[i] != port_id)
+			continue;
+
+		ret = switchtec_diag_pattern_inject(test->dev,
+						    test->port_ids[i],
+						    err_cnt);
+		if (ret)
+			return ret;
+	}
+
+	for (i = 0; i < test->nr_lanes; i++) {
+		if (port_id >= 0 && test->lanes[i].port_id != port_id)
+			continue;
+
+		test->lanes[i].injected += err_cnt;
+		test->state[i].pending += err_cnt;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Get the per-lane results of a BER test
+ * @param[in]  test	BER test
+ * @param[out] lanes	Results, valid until switchtec_ber_stop()
+ * @return The number of lanes
+ */
+int switchtec_ber_lanes(struct switchtec_ber_test *test,
+			const struct switchtec_ber_lane **lanes)
+{
+	*lanes = test->lanes;
+	return test->nr_lanes;
+}
+
+/**
+ * @brief End a BER test
+ * @param[in] test	BER test
+ * @return 0 on success, error code if the monitors or generators could
+ *	not all be disabled
+ *
+ * The test is freed in either case.
+ */
+int switchtec_ber_stop(struct switchtec_ber_test *test)
+{
+	int ret;
+
+	ret = ber_disable_ports(test);
+	ber_free(test);
+
+	return ret;
+}
+
+/**@}*/
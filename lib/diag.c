@@ -33,18 +33,24 @@
 #define EYE_CAP_STATUS_POLL_MS 2000
 #define EYE_CAP_STATUS_RETRY_MS 6000
 #define EYE_CAP_PROGRESS_INTERVAL 5
+#define EYE_SCHED_RETRIES 8
+#define EYE_SCHED_RETRY_MS 100
+#define EYE_SCHED_RETRY_MAX_MS 5000
 
 #include "switchtec_priv.h"
 #include "switchtec/diag.h"
 #include "switchtec/endian.h"
+#include "switchtec/errors.h"
 #include "switchtec/switchtec.h"
 #include "switchtec/utils.h"
 
 #include <errno.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 /**
@@ -133,6 +139,178 @@ int switchtec_diag_cross_hair_get(struct switchtec_dev *dev, int start_lane_id,
 	return 0;
 }
 
+/**
+ * @brief Get the width to height figure of a cross hair measurement
+ * @param[in]  ch	Cross hair data in the DONE state
+ *
+ * @return The eye width times the sum of its heights on either side
+ */
+int switchtec_diag_cross_hair_w2h(const struct switchtec_diag_cross_hair *ch)
+{
+	return (ch->eye_right_lim - ch->eye_left_lim) *
+		(ch->eye_top_right_lim - ch->eye_bot_right_lim +
+		 ch->eye_top_left_lim - ch->eye_bot_left_lim);
+}
+
+#define CROSS_HAIR_SWEEP_POLL_MIN_MS	50
+#define CROSS_HAIR_SWEEP_POLL_MAX_MS	1000
+
+static bool cross_hair_pending(const struct switchtec_diag_cross_hair *ch)
+{
+	return ch->state != SWITCHTEC_DIAG_CROSS_HAIR_DISABLED &&
+		ch->state != SWITCHTEC_DIAG_CROSS_HAIR_DONE &&
+		ch->state != SWITCHTEC_DIAG_CROSS_HAIR_ERROR;
+}
+
+/*
+ * Get the state of all lanes that are still measuring, as few lanes
+ * per MRPC as the command allows. Returns the number of lanes still
+ * measuring, or -1 on failure, and sets *changed if any lane changed
+ * state.
+ */
+static int cross_hair_sweep_poll(struct switchtec_dev *dev,
+				 struct switchtec_diag_cross_hair *ch,
+				 bool first, bool *changed)
+{
+	struct switchtec_diag_cross_hair prev[SWITCHTEC_DIAG_CROSS_HAIR_MAX_LANES];
+	int l, i, n, pending = 0;
+
+	for (l = 0; l < SWITCHTEC_MAX_LANES;
+	     l += SWITCHTEC_DIAG_CROSS_HAIR_MAX_LANES) {
+		n = SWITCHTEC_MAX_LANES - l;
+		if (n > SWITCHTEC_DIAG_CROSS_HAIR_MAX_LANES)
+			n = SWITCHTEC_DIAG_CROSS_HAIR_MAX_LANES;
+
+		for (i = 0; !first && i < n; i++)
+			if (cross_hair_pending(&ch[l + i]))
+				break;
+		if (!first && i == n)
+			continue;
+
+		memcpy(prev, &ch[l], n * sizeof(*ch));
+		if (switchtec_diag_cross_hair_get(dev, l, n, &ch[l]))
+			return -1;
+
+		for (i = 0; i < n; i++) {
+			if (ch[l + i].state != prev[i].state)
+				*changed = true;
+			if (cross_hair_pending(&ch[l + i]))
+				pending++;
+		}
+	}
+
+	return pending;
+}
+
+/* Fill in the port of each lane of the results */
+static void cross_hair_sweep_ports(struct switchtec_dev *dev,
+				   struct switchtec_diag_cross_hair_result *res,
+				   int nr_res)
+{
+	struct switchtec_status *status;
+	int nr_ports, p, l, i, lane;
+
+	nr_ports = switchtec_status(dev, &status);
+	if (nr_ports < 0)
+		return;
+
+	for (p = 0; p < nr_ports; p++) {
+		if (!status[p].link_up)
+			continue;
+
+		for (l = 0; l < status[p].neg_lnk_width; l++) {
+			lane = switchtec_calc_status_lane_id(&status[p], l);
+
+			for (i = 0; i < nr_res; i++) {
+				if (res[i].ch.lane_id != lane)
+					continue;
+
+				res[i].port_id = status[p].port.phys_id;
+				res[i].port_lane = l;
+				res[i].link_rate = status[p].link_rate;
+			}
+		}
+	}
+
+	switchtec_status_free(status, nr_ports);
+}
+
+/**
+ * @brief Measure the cross hair of every lane of the switch at once
+ * @param[in]  dev		Switchtec device handle
+ * @param[in]  timeout_ms	Give up on lanes that are still measuring
+ *				after this long, 0 to wait for all
+ * @param[out] res		Result of each lane that was measured
+ * @param[in]  nr_res		Space in res
+ *
+ * @return Number of results on success, -1 on failure
+ *
+ * Cross hair is enabled on all lanes together and the lanes still
+ * measuring are polled in batches, more often while their states are
+ * changing and less often while they are not. Lanes the firmware did not
+ * measure are left out. Lanes that failed are in the ERROR state, and
+ * lanes that timed out in the state they were in. Cross hair is
+ * disabled again afterwards.
+ */
+int switchtec_diag_cross_hair_sweep(struct switchtec_dev *dev, int timeout_ms,
+		struct switchtec_diag_cross_hair_result *res, int nr_res)
+{
+	struct switchtec_diag_cross_hair ch[SWITCHTEC_MAX_LANES] = {};
+	int interval = CROSS_HAIR_SWEEP_POLL_MIN_MS, elapsed_ms = 0;
+	int i, n = 0, pending, err;
+	bool changed;
+
+	switchtec_diag_cross_hair_disable(dev);
+
+	if (switchtec_diag_cross_hair_enable(dev,
+			SWITCHTEC_DIAG_CROSS_HAIR_ALL_LANES))
+		return -1;
+
+	do {
+		usleep(interval * 1000);
+		elapsed_ms += interval;
+
+		changed = false;
+		pending = cross_hair_sweep_poll(dev, ch, !n++, &changed);
+		if (pending < 0)
+			goto err_disable;
+
+		if (changed)
+			interval /= 2;
+		else
+			interval *= 2;
+
+		if (interval < CROSS_HAIR_SWEEP_POLL_MIN_MS)
+			interval = CROSS_HAIR_SWEEP_POLL_MIN_MS;
+		if (interval > CROSS_HAIR_SWEEP_POLL_MAX_MS)
+			interval = CROSS_HAIR_SWEEP_POLL_MAX_MS;
+	} while (pending && (!timeout_ms || elapsed_ms < timeout_ms));
+
+	switchtec_diag_cross_hair_disable(dev);
+
+	for (i = 0, n = 0; i < SWITCHTEC_MAX_LANES && n < nr_res; i++) {
+		if (ch[i].state == SWITCHTEC_DIAG_CROSS_HAIR_DISABLED)
+			continue;
+
+		memset(&res[n], 0, sizeof(res[n]));
+		res[n].ch = ch[i];
+		res[n].ch.lane_id = i;
+		res[n].port_id = -1;
+		if (ch[i].state == SWITCHTEC_DIAG_CROSS_HAIR_DONE)
+			res[n].w2h = switchtec_diag_cross_hair_w2h(&ch[i]);
+		n++;
+	}
+
+	cross_hair_sweep_ports(dev, res, n);
+	return n;
+
+err_disable:
+	err = errno;
+	switchtec_diag_cross_hair_disable(dev);
+	errno = err;
+	return -1;
+}
+
 static int switchtec_diag_eye_status_gen5(struct switchtec_dev *dev)
 {
 	int ret;
@@ -430,6 +608,94 @@ static uint64_t hi_lo_to_uint64(uint32_t lo, uint32_t hi)
 	return ret;
 }
 
+#define EYE_FETCH_WAIT_US	5000
+#define EYE_FETCH_WAIT_MIN_US	500
+#define EYE_FETCH_WAIT_MAX_US	64000
+
+/*
+ * Poll for the next chunk of eye observation data. While the capture is
+ * busy, sleep *wait_us and double it for the next poll, unless nowait is
+ * set. Returns 1 if busy and nowait is set, 0 if out holds data, -1 on
+ * failure.
+ */
+static int eye_fetch_poll(struct switchtec_dev *dev,
+			  struct switchtec_diag_port_eye_fetch *out,
+			  unsigned *wait_us, bool nowait)
+{
+	struct switchtec_diag_port_eye_cmd in = {
+		.sub_cmd = MRPC_EYE_OBSERVE_FETCH,
+	};
+	int ret;
+
+	while (1) {
+		ret = switchtec_cmd(dev, MRPC_EYE_OBSERVE, &in, sizeof(in),
+				    out, sizeof(*out));
+		if (ret)
+			return -1;
+
+		if (out->status != 1)
+			break;
+
+		if (nowait)
+			return 1;
+
+		usleep(*wait_us);
+		if (*wait_us < EYE_FETCH_WAIT_MAX_US)
+			*wait_us *= 2;
+	}
+
+	if (switchtec_diag_eye_status(out->status))
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Decode cnt pixels of a chunk of eye observation data. errors and
+ * samples must be given in raw mode and receive the counts, pixels must
+ * be given in ratio mode.
+ */
+static int eye_fetch_decode(const struct switchtec_diag_port_eye_fetch *out,
+			     size_t cnt, double *pixels, uint64_t *errors,
+			     uint64_t *samples)
+{
+	size_t i;
+
+	switch (out->data_mode) {
+	case SWITCHTEC_DIAG_EYE_RAW:
+		for (i = 0; i < cnt; i++) {
+			errors[i] = hi_lo_to_uint64(out->raw[i].error_cnt_lo,
+						    out->raw[i].error_cnt_hi);
+			samples[i] = hi_lo_to_uint64(out->raw[i].sample_cnt_lo,
+						     out->raw[i].sample_cnt_hi);
+		}
+
+		if (pixels)
+			switchtec_diag_eye_ratio(pixels, errors, samples, cnt);
+		break;
+	case SWITCHTEC_DIAG_EYE_RATIO:
+		if (!pixels) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		for (i = 0; i < cnt; i++)
+			pixels[i] = le16toh(out->ratio[i].ratio) / 65536.;
+		break;
+	}
+
+	return 0;
+}
+
+static size_t eye_fetch_count(const struct switchtec_diag_port_eye_fetch *out)
+{
+	size_t cnt = out->data_count_lo | ((size_t)out->data_count_hi << 8);
+	size_t max = out->data_mode == SWITCHTEC_DIAG_EYE_RAW ?
+		ARRAY_SIZE(out->raw) : ARRAY_SIZE(out->ratio);
+
+	return cnt < max ? cnt : max;
+}
+
 /**
  * @brief Start a PCIe Eye Capture
  * @param[in]  dev	       Switchtec device handle
@@ -446,25 +712,13 @@ static uint64_t hi_lo_to_uint64(uint32_t lo, uint32_t hi)
 int switchtec_diag_eye_fetch(struct switchtec_dev *dev, double *pixels,
 			     size_t pixel_cnt, int *lane_id)
 {
-	struct switchtec_diag_port_eye_cmd in = {
-		.sub_cmd = MRPC_EYE_OBSERVE_FETCH,
-	};
 	struct switchtec_diag_port_eye_fetch out;
-	uint64_t samples, errors;
-	int i, ret, data_count;
-
-retry:
-	ret = switchtec_cmd(dev, MRPC_EYE_OBSERVE, &in, sizeof(in), &out,
-			    sizeof(out));
-	if (ret)
-		return ret;
-
-	if (out.status == 1) {
-		usleep(5000);
-		goto retry;
-	}
+	uint64_t errors[ARRAY_SIZE(out.raw)], samples[ARRAY_SIZE(out.raw)];
+	unsigned wait_us = EYE_FETCH_WAIT_US;
+	size_t cnt;
+	int i, ret;
 
-	ret = switchtec_diag_eye_status(out.status);
+	ret = eye_fetch_poll(dev, &out, &wait_us, false);
 	if (ret)
 		return ret;
 
@@ -474,27 +728,149 @@ retry:
 			break;
 	}
 
-	data_count = out.data_count_lo | ((int)out.data_count_hi << 8);
+	cnt = eye_fetch_count(&out);
+	if (eye_fetch_decode(&out, cnt < pixel_cnt ? cnt : pixel_cnt, pixels,
+			     errors, samples))
+		return -1;
+
+	return out.data_count_lo | ((int)out.data_count_hi << 8);
+}
+
+/* Index of the lane of a chunk among the lanes of the batch */
+static int eye_batch_lane(const struct switchtec_diag_eye_batch *b,
+			  const struct switchtec_diag_port_eye_fetch *out)
+{
+	int i, bit, idx = 0;
+	uint32_t mask;
 
-	for (i = 0; i < data_count && i < pixel_cnt; i++) {
-		switch (out.data_mode) {
-		case SWITCHTEC_DIAG_EYE_RAW:
-			errors = hi_lo_to_uint64(out.raw[i].error_cnt_lo,
-						 out.raw[i].error_cnt_hi);
-			samples = hi_lo_to_uint64(out.raw[i].sample_cnt_lo,
-						  out.raw[i].sample_cnt_hi);
-			if (samples)
-				pixels[i] = (double)errors / samples;
-			else
-				pixels[i] = nan("");
+	for (i = 0; i < 4; i++) {
+		mask = le32toh(out->lane_mask[i]);
+		if (mask)
 			break;
-		case SWITCHTEC_DIAG_EYE_RATIO:
-			pixels[i] = le32toh(out.ratio[i].ratio) / 65536.;
+		idx += __builtin_popcount(b->lane_mask[i]);
+	}
+
+	if (i == 4)
+		return -1;
+
+	bit = ffs(mask) - 1;
+	if (!(b->lane_mask[i] & (1U << bit)))
+		return -1;
+
+	return idx + __builtin_popcount(b->lane_mask[i] & ((1U << bit) - 1));
+}
+
+/**
+ * @brief Fetch all eye observation data that is ready
+ * @param[in]     dev	Switchtec device handle
+ * @param[in,out] batch	Buffers and progress of the fetch
+ *
+ * @return Number of pixels fetched by this call on success, -1 on
+ *	   failure. 0 means every lane is complete.
+ *
+ * If no data is ready, this waits for some, polling less often the
+ * longer the capture takes; then it keeps fetching until the capture is
+ * busy again. Call it until batch->fetched reaches lane_pixels times the
+ * number of lanes, e.g. to report progress in between.
+ *
+ * Raw counts are only available from captures in
+ * SWITCHTEC_DIAG_EYE_RAW mode. They let callers add up repeated
+ * captures before switchtec_diag_eye_ratio(). Captures in
+ * SWITCHTEC_DIAG_EYE_RATIO mode need batch->pixels and fail with EINVAL
+ * without it.
+ */
+int switchtec_diag_eye_fetch_batch(struct switchtec_dev *dev,
+				   struct switchtec_diag_eye_batch *batch)
+{
+	struct switchtec_diag_port_eye_fetch out;
+	uint64_t errors[ARRAY_SIZE(out.raw)], samples[ARRAY_SIZE(out.raw)];
+	size_t total = 0, fetched = 0, off, cnt;
+	int i, lane, ret;
+
+	for (i = 0; i < 4; i++)
+		total += __builtin_popcount(batch->lane_mask[i]);
+
+	if (total > SWITCHTEC_DIAG_EYE_OBSERVE_LANES) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	total *= batch->lane_pixels;
+
+	if (!batch->wait_us)
+		batch->wait_us = EYE_FETCH_WAIT_MIN_US;
+
+	while (batch->fetched < total) {
+		ret = eye_fetch_poll(dev, &out, &batch->wait_us, fetched);
+		if (ret < 0)
+			return -1;
+		if (ret)
 			break;
+
+		/* data was ready without waiting, so poll faster */
+		if (!fetched && batch->wait_us > EYE_FETCH_WAIT_MIN_US)
+			batch->wait_us /= 2;
+
+		lane = eye_batch_lane(batch, &out);
+		if (lane < 0) {
+			errno = EPROTO;
+			return -1;
+		}
+
+		cnt = eye_fetch_count(&out);
+		if (!cnt) {
+			errno = ENODATA;
+			return -1;
+		}
+
+		if (cnt > batch->lane_pixels - batch->lane_cnt[lane]) {
+			errno = EOVERFLOW;
+			return -1;
+		}
+
+		if (out.data_mode != SWITCHTEC_DIAG_EYE_RAW &&
+		    (batch->errors || batch->samples)) {
+			errno = ENODATA;
+			return -1;
 		}
+
+		off = lane * batch->lane_pixels + batch->lane_cnt[lane];
+		ret = eye_fetch_decode(&out, cnt,
+				batch->pixels ? &batch->pixels[off] : NULL,
+				batch->errors ? &batch->errors[off] : errors,
+				batch->samples ? &batch->samples[off] : samples);
+		if (ret)
+			return -1;
+
+		batch->lane_cnt[lane] += cnt;
+		batch->fetched += cnt;
+		fetched += cnt;
 	}
 
-	return data_count;
+	return fetched;
+}
+
+/**
+ * @brief Convert raw eye counts to error ratios
+ * @param[out] pixels	Error ratio of each pixel
+ * @param[in]  errors	Error count of each pixel
+ * @param[in]  samples	Sample count of each pixel
+ * @param[in]  cnt	Number of pixels
+ *
+ * Pixels without samples become NaN.
+ */
+void switchtec_diag_eye_ratio(double *pixels, const uint64_t *errors,
+			      const uint64_t *samples, size_t cnt)
+{
+	size_t i;
+
+	/*
+	 * A select rather than a branch, so the compiler can still
+	 * vectorize this. Errors without samples would otherwise give Inf.
+	 */
+	for (i = 0; i < cnt; i++)
+		pixels[i] = samples[i] ?
+			(double)errors[i] / (double)samples[i] : NAN;
 }
 
 /**
@@ -521,6 +897,179 @@ int switchtec_diag_eye_cancel(struct switchtec_dev *dev)
 	return ret;
 }
 
+static bool eye_sched_mrpc_err(int err, int code)
+{
+	return (err & SWITCHTEC_ERRNO_MRPC_FLAG_BIT) && ERRNO_MRPC(err) == code;
+}
+
+/* A previous capture that is still winding down, worth waiting for */
+static bool eye_sched_transient(void)
+{
+	return errno == EBUSY ||
+		eye_sched_mrpc_err(errno, ERR_EYE_CAP_STATE_INVAL);
+}
+
+static bool eye_sched_backoff(int *tries)
+{
+	int ms;
+
+	if (*tries >= EYE_SCHED_RETRIES)
+		return false;
+
+	ms = EYE_SCHED_RETRY_MS << *tries;
+	if (ms > EYE_SCHED_RETRY_MAX_MS)
+		ms = EYE_SCHED_RETRY_MAX_MS;
+
+	(*tries)++;
+	usleep(ms * 1000);
+	return true;
+}
+
+static int eye_sched_start(struct switchtec_dev *dev, const int *lanes,
+			   int nr_lanes,
+			   const struct switchtec_diag_eye_params *p)
+{
+	int lane_mask[5] = {};
+	int i, ret, tries = 0;
+
+	for (i = 0; i < nr_lanes; i++)
+		lane_mask[lanes[i] / 32] |= 1U << (lanes[i] % 32);
+
+	do {
+		ret = switchtec_diag_eye_start(dev, lane_mask, NULL, NULL, 0,
+					       p->capture_depth, p->sar_sel,
+					       p->intleav_sel, p->hstep,
+					       p->data_mode, p->eye_mode,
+					       p->refclk, p->vstep);
+	} while (ret && eye_sched_transient() && eye_sched_backoff(&tries));
+
+	return ret;
+}
+
+static int eye_sched_read_lane(struct switchtec_dev *dev, int lane_id,
+			       double *ber_data, int *num_phases)
+{
+	double tmp[SWITCHTEC_DIAG_EYE_BINS];
+	int bin, n, ret, tries;
+
+	for (bin = 0; bin < SWITCHTEC_DIAG_EYE_BINS; bin++) {
+		tries = 0;
+		do {
+			ret = switchtec_diag_eye_read(dev, lane_id, bin, &n,
+						      tmp);
+		} while (ret && eye_sched_transient() &&
+			 eye_sched_backoff(&tries));
+		if (ret)
+			return ret;
+
+		if (n > SWITCHTEC_DIAG_EYE_BINS || (bin && n != *num_phases)) {
+			errno = EPROTO;
+			return -1;
+		}
+
+		*num_phases = n;
+		memcpy(&ber_data[bin * n], tmp, n * sizeof(*tmp));
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Capture the eyes of many lanes with as few runs as possible
+ * @param[in]  dev	  Switchtec device handle
+ * @param[in]  lanes	  Lanes to capture, as switch-wide lane IDs
+ * @param[in]  nr_lanes	  Number of entries in \p lanes
+ * @param[in]  max_batch  Most lanes to capture in one run, 0 for as
+ *			  many as the hardware accepts
+ * @param[in]  params	  Capture settings
+ * @param[in]  lane_fn	  Called with the BER data of each lane: 64 bins
+ *			  of \p num_phases values each. A non-zero return
+ *			  value stops the capture and is returned.
+ * @param[in]  ctx	  Passed to \p lane_fn
+ *
+ * @return 0 on success, error code on failure
+ *
+ * Lanes are captured in ascending order, packing up to \p max_batch of
+ * them into the lane mask of each run. If the firmware rejects a run for
+ * having too many lanes, the runs are halved until it accepts them.
+ * Runs and reads that fail because a previous capture is still winding
+ * down are retried with an increasing delay.
+ *
+ * Every lane is handed to \p lane_fn as soon as its bins have been read,
+ * so only one lane is held in memory at a time. Only Gen5 and Gen6
+ * switches are supported.
+ */
+int switchtec_diag_eye_capture_lanes(struct switchtec_dev *dev,
+		const int *lanes, int nr_lanes, int max_batch,
+		const struct switchtec_diag_eye_params *params,
+		int (*lane_fn)(void *ctx, int lane_id, int num_phases,
+			       const double *ber_data),
+		void *ctx)
+{
+	bool wanted[SWITCHTEC_DIAG_EYE_MAX_LANES] = {};
+	int order[SWITCHTEC_DIAG_EYE_MAX_LANES];
+	int i, j, n = 0, batch, max_lanes, num_phases = 0, ret = 0;
+	double *ber_data;
+
+	if (switchtec_is_gen5(dev)) {
+		max_lanes = 128;
+	} else if (switchtec_is_gen6(dev)) {
+		max_lanes = SWITCHTEC_DIAG_EYE_MAX_LANES;
+	} else {
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	for (i = 0; i < nr_lanes; i++) {
+		if (lanes[i] < 0 || lanes[i] >= max_lanes) {
+			errno = EINVAL;
+			return -1;
+		}
+		wanted[lanes[i]] = true;
+	}
+
+	for (i = 0; i < max_lanes; i++)
+		if (wanted[i])
+			order[n++] = i;
+
+	if (max_batch <= 0 || max_batch > n)
+		max_batch = n;
+
+	ber_data = malloc(SWITCHTEC_DIAG_EYE_BINS * SWITCHTEC_DIAG_EYE_BINS *
+			  sizeof(*ber_data));
+	if (!ber_data)
+		return -1;
+
+	for (i = 0; i < n; i += batch) {
+		batch = n - i < max_batch ? n - i : max_batch;
+
+		ret = eye_sched_start(dev, &order[i], batch, params);
+		if (ret && max_batch > 1 &&
+		    eye_sched_mrpc_err(errno, ERR_EYE_CAP_TOO_MANY_LANES)) {
+			max_batch /= 2;
+			batch = 0;
+			continue;
+		}
+		if (ret)
+			break;
+
+		for (j = 0; j < batch; j++) {
+			ret = eye_sched_read_lane(dev, order[i + j], ber_data,
+						  &num_phases);
+			if (ret)
+				goto out;
+
+			ret = lane_fn(ctx, order[i + j], num_phases, ber_data);
+			if (ret)
+				goto out;
+		}
+	}
+
+out:
+	free(ber_data);
+	return ret;
+}
+
 static int switchtec_diag_loopback_set_gen56(struct switchtec_dev *dev,
 					int port_id, int enable_parallel,
 					int enable_external,
@@ -1767,443 +2316,758 @@ static void switchtec_diag_ltssm_set_log_data_gen6(struct switchtec_diag_ltssm_l
 	}
 }
 
-/**
- * @brief Get the LTSSM log of a port on a gen5 switchtec device
- * @param[in]	dev    Switchtec device handle
- * @param[in]	port   Switchtec Port
- * @param[inout] log_count number of log entries
- * @param[out] log    A pointer to an array containing the log
- */
-static int switchtec_diag_ltssm_log_gen5(struct switchtec_dev *dev,
-				 int port, int *log_count,
-				 struct switchtec_diag_ltssm_log *log_data)
+static int switchtec_diag_ltssm_freeze(struct switchtec_dev *dev, int port,
+				       int freeze)
 {
 	struct {
 		uint8_t sub_cmd;
 		uint8_t port;
 		uint8_t freeze;
 		uint8_t unused;
-	} ltssm_freeze;
+	} ltssm_freeze = {
+		.sub_cmd = MRPC_LTMON_FREEZE,
+		.port = port,
+		.freeze = freeze,
+	};
 
+	return switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &ltssm_freeze,
+			     sizeof(ltssm_freeze), NULL, 0);
+}
+
+/**
+ * @brief Get the number of entries in the frozen LTSSM log of a port
+ * @param[in]	dev    Switchtec device handle
+ * @param[in]	port   Switchtec Port
+ * @param[out]	count  Number of log entries
+ */
+static int switchtec_diag_ltssm_count(struct switchtec_dev *dev, int port,
+				      int *count)
+{
 	struct {
 		uint8_t sub_cmd;
 		uint8_t port;
-	} status;
-
+	} status = {
+		.port = port,
+	};
+	struct {
+		uint32_t w0_trigger_count;
+		uint32_t w1_trigger_count;
+		uint8_t log_num;
+	} status_gen4;
 	struct {
 		uint16_t log_count;
 		uint16_t w0_trigger_count;
 		uint16_t w1_trigger_count;
-	} status_output;
+	} status_gen5;
+	int ret;
 
-	struct {
-		uint8_t sub_cmd;
-		uint8_t port;
-		uint16_t log_index;
-		uint16_t no_of_logs;
-	} log_dump;
+	if (switchtec_is_gen4(dev)) {
+		status.sub_cmd = MRPC_LTMON_GET_STATUS_GEN4;
+		ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &status,
+				    sizeof(status), &status_gen4,
+				    sizeof(status_gen4));
+		*count = status_gen4.log_num;
+	} else {
+		status.sub_cmd = MRPC_LTMON_GET_STATUS_GEN5;
+		ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &status,
+				    sizeof(status), &status_gen5,
+				    sizeof(status_gen5));
+		*count = status_gen5.log_count;
+	}
 
-	uint8_t log_buffer[1024];
+	return ret;
+}
 
-	struct switchtec_diag_ltssm_log_dmp_out *log_dump_out_ptr = NULL;
+static int switchtec_diag_ltssm_read_gen4(struct switchtec_dev *dev,
+				int port, int index, int count,
+				struct switchtec_diag_ltssm_log *log_data)
+{
+	struct {
+		uint8_t sub_cmd;
+		uint8_t port;
+		uint8_t log_index;
+		uint8_t no_of_logs;
+	} log_dump = {
+		.sub_cmd = MRPC_LTMON_LOG_DUMP_GEN4,
+		.port = port,
+	};
+	struct {
+		uint32_t dw0;
+		uint32_t dw1;
+	} log_dump_out[126];
 
+	uint32_t dw1;
+	uint32_t dw0;
+	int major;
+	int minor;
+	int rate;
 	int ret;
-	int log_dmp_size = sizeof(struct switchtec_diag_ltssm_log_dmp_out);
+	int i, n;
 
-	/* freeze logs */
-	ltssm_freeze.sub_cmd = MRPC_LTMON_FREEZE;
-	ltssm_freeze.port = port;
-	ltssm_freeze.freeze = 1;
+	for (; count > 0; index += n, count -= n, log_data += n) {
+		n = count < ARRAY_SIZE(log_dump_out) ?
+			count : ARRAY_SIZE(log_dump_out);
 
-	ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &ltssm_freeze,
-			    sizeof(ltssm_freeze), NULL, 0);
-	if (ret)
-		return ret;
+		log_dump.log_index = index;
+		log_dump.no_of_logs = n;
+		ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &log_dump,
+				    sizeof(log_dump), log_dump_out,
+				    sizeof(log_dump_out[0]) * n);
+		if (ret)
+			return ret;
 
-	/* get number of entries */
-	status.sub_cmd = MRPC_LTMON_GET_STATUS_GEN5;
-	status.port = port;
-	ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &status,
-			    sizeof(status), &status_output,
-			    sizeof(status_output));
-	if (ret)
-		return ret;
+		for (i = 0; i < n; i++) {
+			dw1 = log_dump_out[i].dw1;
+			dw0 = log_dump_out[i].dw0;
+			rate = (dw0 >> 13) & 0x3;
+			major = (dw0 >> 7) & 0xf;
+			minor = (dw0 >> 3) & 0xf;
+
+			log_data[i].timestamp = dw1 & 0x3ffffff;
+			log_data[i].link_rate =
+				switchtec_gen_transfers[rate + 1];
+			log_data[i].link_state = major | (minor << 8);
+		}
+	}
+
+	return 0;
+}
+
+static int switchtec_diag_ltssm_read_gen5(struct switchtec_dev *dev,
+				int port, int index, int count,
+				struct switchtec_diag_ltssm_log *log_data)
+{
+	struct {
+		uint8_t sub_cmd;
+		uint8_t port;
+		uint16_t log_index;
+		uint16_t no_of_logs;
+	} log_dump = {
+		.sub_cmd = MRPC_LTMON_LOG_DUMP_GEN5,
+		.port = port,
+	};
+
+	uint8_t log_buffer[1024];
+
+	struct switchtec_diag_ltssm_log_dmp_out *log_dump_out_ptr =
+		(struct switchtec_diag_ltssm_log_dmp_out *)&log_buffer[4];
 
-	*log_count = status_output.log_count;
+	int log_dmp_size = sizeof(struct switchtec_diag_ltssm_log_dmp_out);
+	int ret, n;
 
-	/* get log data */
-	log_dump.sub_cmd = MRPC_LTMON_LOG_DUMP_GEN5;
-	log_dump.port = port;
-	log_dump.log_index = 0;
-	log_dump.no_of_logs = *log_count;
+	for (; count > 0; index += n, count -= n, log_data += n) {
+		n = count < SWITCHTEC_LTSSM_MAX_LOGS ?
+			count : SWITCHTEC_LTSSM_MAX_LOGS;
 
-	if (log_dump.no_of_logs <= SWITCHTEC_LTSSM_MAX_LOGS) {
-		/* Single buffer log case */
+		log_dump.log_index = index;
+		log_dump.no_of_logs = n;
 		ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &log_dump,
 				    sizeof(log_dump), &log_buffer[0],
-				    log_dump.no_of_logs * log_dmp_size + 4);
+				    n * log_dmp_size + 4);
 		if (ret)
 			return ret;
-		log_dump_out_ptr =
-			(struct switchtec_diag_ltssm_log_dmp_out *)
-			&(log_buffer[4]);
-
-		switchtec_diag_ltssm_set_log_data_gen5(log_data,
-						  log_dump_out_ptr,
-						  0, log_dump.no_of_logs);
-	} else {
-		/* Multiple buffer log case */
-		int buff_count = log_dump.no_of_logs / SWITCHTEC_LTSSM_MAX_LOGS;
-		int curr_idx = 0;
-		int buffer_size = SWITCHTEC_LTSSM_MAX_LOGS * log_dmp_size + 4;
-
-		for (int i = 0; i < buff_count; i++) {
-			log_dump.no_of_logs = SWITCHTEC_LTSSM_MAX_LOGS;
-			ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG,
-					    &log_dump, sizeof(log_dump),
-					    &log_buffer[0], buffer_size);
-			if (ret)
-				return ret;
-			log_dump_out_ptr =
-				(struct switchtec_diag_ltssm_log_dmp_out *)
-				&(log_buffer[4]);
-
-			switchtec_diag_ltssm_set_log_data_gen5(log_data,
-							  log_dump_out_ptr,
-							  curr_idx,
-							  log_dump.no_of_logs);
-			curr_idx += SWITCHTEC_LTSSM_MAX_LOGS;
-			log_dump.log_index = curr_idx;
-		}
-		if (*log_count % SWITCHTEC_LTSSM_MAX_LOGS) {
-			log_dump.no_of_logs = *log_count - curr_idx;
-			buffer_size = log_dump.no_of_logs * log_dmp_size + 4;
-			ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG,
-					    &log_dump, sizeof(log_dump),
-					    &log_buffer[0], buffer_size);
-			if (ret)
-				return ret;
-			log_dump_out_ptr =
-				(struct switchtec_diag_ltssm_log_dmp_out *)
-				&(log_buffer[4]);
 
+		if (switchtec_is_gen6(dev))
+			switchtec_diag_ltssm_set_log_data_gen6(log_data,
+						log_dump_out_ptr, 0, n);
+		else
 			switchtec_diag_ltssm_set_log_data_gen5(log_data,
-							  log_dump_out_ptr,
-							  curr_idx,
-							  log_dump.no_of_logs);
-		}
+						log_dump_out_ptr, 0, n);
 	}
 
-	/* unfreeze logs */
-	ltssm_freeze.sub_cmd = MRPC_LTMON_FREEZE;
-	ltssm_freeze.port = port;
-	ltssm_freeze.freeze = 0;
-
-	ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &ltssm_freeze,
-			    sizeof(ltssm_freeze), NULL, 0);
+	return 0;
+}
 
-	return ret;
+/**
+ * @brief Read entries of the frozen LTSSM log of a port
+ * @param[in]	dev    Switchtec device handle
+ * @param[in]	port   Switchtec Port
+ * @param[in]	index  Index of the first entry to read
+ * @param[in]	count  Number of entries to read
+ * @param[out] log_data  The entries
+ */
+static int switchtec_diag_ltssm_read(struct switchtec_dev *dev, int port,
+				     int index, int count,
+				     struct switchtec_diag_ltssm_log *log_data)
+{
+	if (switchtec_is_gen4(dev))
+		return switchtec_diag_ltssm_read_gen4(dev, port, index, count,
+						      log_data);
+	else
+		return switchtec_diag_ltssm_read_gen5(dev, port, index, count,
+						      log_data);
 }
 
 /**
- * @brief Get the LTSSM log of a port on a gen6 switchtec device
+ * @brief Get the LTSSM log of a port
  * @param[in]	dev    Switchtec device handle
  * @param[in]	port   Switchtec Port
  * @param[inout] log_count number of log entries
  * @param[out] log    A pointer to an array containing the log
+ *
+ * On input, \p log_count is the space in \p log_data. The log is frozen
+ * while it is read.
  */
-static int switchtec_diag_ltssm_log_gen6(struct switchtec_dev *dev,
-				 int port, int *log_count,
-				 struct switchtec_diag_ltssm_log *log_data)
+int switchtec_diag_ltssm_log(struct switchtec_dev *dev,
+			    int port, int *log_count,
+			    struct switchtec_diag_ltssm_log *log_data)
 {
-	struct {
-		uint8_t sub_cmd;
-		uint8_t port;
-		uint8_t freeze;
-		uint8_t unused;
-	} ltssm_freeze;
+	int ret, err, count;
 
-	struct {
-		uint8_t sub_cmd;
-		uint8_t port;
-	} status;
+	ret = switchtec_diag_ltssm_freeze(dev, port, 1);
+	if (ret)
+		return ret;
 
-	struct {
-		uint16_t log_count;
-		uint16_t w0_trigger_count;
-		uint16_t w1_trigger_count;
-	} status_output;
+	ret = switchtec_diag_ltssm_count(dev, port, &count);
+	if (!ret) {
+		if (count < *log_count)
+			*log_count = count;
 
-	struct {
-		uint8_t sub_cmd;
-		uint8_t port;
-		uint16_t log_index;
-		uint16_t no_of_logs;
-	} log_dump;
+		ret = switchtec_diag_ltssm_read(dev, port, 0, *log_count,
+						log_data);
+	}
 
-	uint8_t log_buffer[1024];
+	err = errno;
+	if (switchtec_diag_ltssm_freeze(dev, port, 0) && !ret)
+		return -1;
+	errno = err;
 
-	struct switchtec_diag_ltssm_log_dmp_out *log_dump_out_ptr = NULL;
+	return ret;
+}
 
+/**
+ * @brief Call the LTSSM clear MRPC command
+ * @param[in]	dev    Switchtec device handle
+ * @param[in]	port   Switchtec Port
+ */
+int switchtec_diag_ltssm_clear(struct switchtec_dev *dev, int port)
+{
 	int ret;
-	int log_dmp_size = sizeof(struct switchtec_diag_ltssm_log_dmp_out);
+	struct {
+		uint8_t subcmd;
+		uint8_t port_id;
+		uint16_t reserved;
+	} ltssm_clear;
 
-	/* freeze logs */
-	ltssm_freeze.sub_cmd = MRPC_LTMON_FREEZE;
-	ltssm_freeze.port = port;
-	ltssm_freeze.freeze = 1;
+	ltssm_clear.subcmd = MRPC_LTMON_CLEAR_LOG;
+	ltssm_clear.port_id = port;
 
-	ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &ltssm_freeze,
-			    sizeof(ltssm_freeze), NULL, 0);
-	if (ret)
-		return ret;
+	ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &ltssm_clear,
+			    sizeof(ltssm_clear), NULL, 0);
+	return ret;
+}
 
-	/* get number of entries */
-	status.sub_cmd = MRPC_LTMON_GET_STATUS_GEN5;
-	status.port = port;
-	ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &status,
-			    sizeof(status), &status_output,
-			    sizeof(status_output));
-	if (ret)
-		return ret;
+/* Largest LTSSM log of any generation */
+#define LTSSM_COLLECTOR_WINDOW 512
 
-	*log_count = status_output.log_count;
+enum ltssm_class {
+	LTSSM_CLASS_OTHER,
+	LTSSM_CLASS_DETECT,
+	LTSSM_CLASS_L0,
+	LTSSM_CLASS_RECOVERY,
+};
 
-	/* get log data */
-	log_dump.sub_cmd = MRPC_LTMON_LOG_DUMP_GEN5;
-	log_dump.port = port;
-	log_dump.log_index = 0;
-	log_dump.no_of_logs = *log_count;
+struct ltssm_collector_port {
+	int port;
+	int prev_count;		//!< log entries on the device at the last poll
 
-	if (log_dump.no_of_logs <= SWITCHTEC_LTSSM_MAX_LOGS) {
-		/* Single buffer log case */
-		ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &log_dump,
-				    sizeof(log_dump), &log_buffer[0],
-				    log_dump.no_of_logs * log_dmp_size + 4);
-		if (ret)
-			return ret;
-		log_dump_out_ptr =
-			(struct switchtec_diag_ltssm_log_dmp_out *)
-			&(log_buffer[4]);
+	/* the device log as of the last poll, oldest first */
+	struct switchtec_diag_ltssm_log *win;
+	int win_len;
 
-		switchtec_diag_ltssm_set_log_data_gen6(log_data,
-						  log_dump_out_ptr,
-						  0, log_dump.no_of_logs);
-	} else {
-		/* Multiple buffer log case */
-		int buff_count = log_dump.no_of_logs / SWITCHTEC_LTSSM_MAX_LOGS;
-		int curr_idx = 0;
-		int buffer_size = SWITCHTEC_LTSSM_MAX_LOGS * log_dmp_size + 4;
-
-		for (int i = 0; i < buff_count; i++) {
-			log_dump.no_of_logs = SWITCHTEC_LTSSM_MAX_LOGS;
-			ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG,
-					    &log_dump, sizeof(log_dump),
-					    &log_buffer[0], buffer_size);
-			if (ret)
-				return ret;
-			log_dump_out_ptr =
-				(struct switchtec_diag_ltssm_log_dmp_out *)
-				&(log_buffer[4]);
+	struct switchtec_ltssm_entry *ring;
+	size_t ring_head;
+	size_t ring_len;
 
-			switchtec_diag_ltssm_set_log_data_gen6(log_data,
-							  log_dump_out_ptr,
-							  curr_idx,
-							  log_dump.no_of_logs);
-			curr_idx += SWITCHTEC_LTSSM_MAX_LOGS;
-			log_dump.log_index = curr_idx;
+	struct switchtec_ltssm_stats stats;
+};
+
+struct switchtec_ltssm_collector {
+	struct switchtec_dev *dev;
+	int gen6;
+	unsigned int ts_mask;
+	size_t ring_size;
+
+	int nr_ports;
+	int *port_ids;
+	struct ltssm_collector_port *ports;
+
+	struct switchtec_diag_ltssm_log buf[LTSSM_COLLECTOR_WINDOW];
+
+	struct switchtec_ltssm_entry *new_ents;
+	size_t nr_new;
+	size_t new_cap;
+};
+
+static int ltssm_major(struct switchtec_ltssm_collector *c, int state)
+{
+	return c->gen6 ? state : state & 0xff;
+}
+
+static enum ltssm_class ltssm_class(struct switchtec_ltssm_collector *c,
+				    int major)
+{
+	if (!c->gen6) {
+		switch (major) {
+		case 0: return LTSSM_CLASS_DETECT;
+		case 3: return LTSSM_CLASS_L0;
+		case 4: return LTSSM_CLASS_RECOVERY;
+		default: return LTSSM_CLASS_OTHER;
 		}
-		if (*log_count % SWITCHTEC_LTSSM_MAX_LOGS) {
-			log_dump.no_of_logs = *log_count - curr_idx;
-			buffer_size = log_dump.no_of_logs * log_dmp_size + 4;
-			ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG,
-					    &log_dump, sizeof(log_dump),
-					    &log_buffer[0], buffer_size);
+	}
+
+	switch (major) {
+	case 0x00:
+	case 0x01:
+	case 0x05:
+	case 0x06:
+		return LTSSM_CLASS_DETECT;
+	case 0x11:
+		return LTSSM_CLASS_L0;
+	case 0x0D:
+	case 0x0E:
+	case 0x0F:
+	case 0x10:
+	case 0x20:
+	case 0x21:
+	case 0x22:
+	case 0x23:
+		return LTSSM_CLASS_RECOVERY;
+	default:
+		return LTSSM_CLASS_OTHER;
+	}
+}
+
+static int ltssm_log_eq(const struct switchtec_diag_ltssm_log *a,
+			const struct switchtec_diag_ltssm_log *b)
+{
+	return a->timestamp == b->timestamp &&
+		a->link_state == b->link_state &&
+		a->link_rate == b->link_rate &&
+		a->link_width == b->link_width;
+}
+
+/*
+ * Find the number of entries at the start of log that were already at
+ * the end of the window
+ */
+static int ltssm_log_overlap(const struct switchtec_diag_ltssm_log *win,
+			     int win_len,
+			     const struct switchtec_diag_ltssm_log *log,
+			     int count)
+{
+	int m, i;
+
+	m = win_len < count ? win_len : count;
+	for (; m > 0; m--) {
+		for (i = 0; i < m; i++)
+			if (!ltssm_log_eq(&win[win_len - m + i], &log[i]))
+				break;
+		if (i == m)
+			return m;
+	}
+
+	return 0;
+}
+
+static struct ltssm_collector_port *
+ltssm_collector_port(struct switchtec_ltssm_collector *c, int port)
+{
+	int i;
+
+	for (i = 0; i < c->nr_ports; i++)
+		if (c->ports[i].port == port)
+			return &c->ports[i];
+
+	errno = EINVAL;
+	return NULL;
+}
+
+static void ltssm_collector_stats(struct switchtec_ltssm_collector *c,
+				  struct ltssm_collector_port *p,
+				  const struct switchtec_diag_ltssm_log *prev,
+				  const struct switchtec_diag_ltssm_log *e)
+{
+	struct switchtec_ltssm_stats *st = &p->stats;
+	int major = ltssm_major(c, e->link_state);
+	int prev_major;
+	enum ltssm_class from, to;
+
+	st->nr_entries++;
+
+	if (!prev) {
+		if (major < SWITCHTEC_LTSSM_MAX_STATES)
+			st->visits[major]++;
+		return;
+	}
+
+	prev_major = ltssm_major(c, prev->link_state);
+	if (prev_major < SWITCHTEC_LTSSM_MAX_STATES)
+		st->dwell[prev_major] +=
+			(e->timestamp - prev->timestamp) & c->ts_mask;
+
+	if (e->link_rate != prev->link_rate)
+		st->speed_changes++;
+
+	if (major == prev_major)
+		return;
+
+	if (major < SWITCHTEC_LTSSM_MAX_STATES)
+		st->visits[major]++;
+
+	from = ltssm_class(c, prev_major);
+	to = ltssm_class(c, major);
+	if (from == LTSSM_CLASS_L0 && to == LTSSM_CLASS_RECOVERY)
+		st->retrains++;
+	else if ((from == LTSSM_CLASS_L0 || from == LTSSM_CLASS_RECOVERY) &&
+		 to == LTSSM_CLASS_DETECT)
+		st->link_downs++;
+}
+
+/*
+ * After a gap, the first new entry does not follow the last one seen,
+ * so it gets no dwell time or transition from it.
+ */
+static int ltssm_collector_add(struct switchtec_ltssm_collector *c,
+			       struct ltssm_collector_port *p,
+			       const struct switchtec_diag_ltssm_log *log,
+			       int count, int gap, uint64_t time_us)
+{
+	struct switchtec_ltssm_entry *e, *new_ents;
+	size_t cap;
+	int i;
+
+	if (c->nr_new + count > c->new_cap) {
+		cap = c->new_cap ? c->new_cap : LTSSM_COLLECTOR_WINDOW;
+		while (cap < c->nr_new + count)
+			cap *= 2;
+
+		new_ents = realloc(c->new_ents, cap * sizeof(*new_ents));
+		if (!new_ents)
+			return -1;
+
+		c->new_ents = new_ents;
+		c->new_cap = cap;
+	}
+
+	for (i = 0; i < count; i++) {
+		e = &c->new_ents[c->nr_new++];
+		e->time_us = time_us;
+		e->port = p->port;
+		e->timestamp = log[i].timestamp;
+		e->link_rate = log[i].link_rate;
+		e->link_state = log[i].link_state;
+		e->link_width = log[i].link_width;
+
+		p->ring[(p->ring_head + p->ring_len) % c->ring_size] = *e;
+		if (p->ring_len < c->ring_size) {
+			p->ring_len++;
+		} else {
+			p->ring_head = (p->ring_head + 1) % c->ring_size;
+			p->stats.nr_dropped++;
+		}
+
+		ltssm_collector_stats(c, p, i ? &log[i - 1] :
+				      p->win_len && !gap ?
+				      &p->win[p->win_len - 1] : NULL, &log[i]);
+	}
+
+	return 0;
+}
+
+/* Read the entries of one port's log that were not seen before */
+static int ltssm_collector_drain(struct switchtec_ltssm_collector *c,
+				 struct ltssm_collector_port *p,
+				 uint64_t time_us)
+{
+	struct switchtec_diag_ltssm_log *log = c->buf;
+	int ret, count, first, skip, keep, gap;
+
+	ret = switchtec_diag_ltssm_count(c->dev, p->port, &count);
+	if (ret)
+		return ret;
+
+	if (count > LTSSM_COLLECTOR_WINDOW)
+		count = LTSSM_COLLECTOR_WINDOW;
+
+	/*
+	 * If the log only grew, the entry last seen is still in the same
+	 * place and only the entries after it need to be read.
+	 */
+	if (p->win_len && p->prev_count && count >= p->prev_count) {
+		first = p->prev_count - 1;
+		ret = switchtec_diag_ltssm_read(c->dev, p->port, first,
+						count - first, log);
+		if (ret)
+			return ret;
+
+		if (ltssm_log_eq(&log[0], &p->win[p->win_len - 1])) {
+			ret = ltssm_collector_add(c, p, log + 1,
+						  count - first - 1, 0,
+						  time_us);
 			if (ret)
 				return ret;
-			log_dump_out_ptr =
-				(struct switchtec_diag_ltssm_log_dmp_out *)
-				&(log_buffer[4]);
 
-			switchtec_diag_ltssm_set_log_data_gen6(log_data,
-							  log_dump_out_ptr,
-							  curr_idx,
-							  log_dump.no_of_logs);
+			keep = p->win_len + count - first - 1 -
+				LTSSM_COLLECTOR_WINDOW;
+			if (keep > 0) {
+				memmove(p->win, p->win + keep,
+					(p->win_len - keep) * sizeof(*p->win));
+				p->win_len -= keep;
+			}
+			memcpy(p->win + p->win_len, log + 1,
+			       (count - first - 1) * sizeof(*p->win));
+			p->win_len += count - first - 1;
+			p->prev_count = count;
+			return 0;
 		}
 	}
 
-	/* unfreeze logs */
-	ltssm_freeze.sub_cmd = MRPC_LTMON_FREEZE;
-	ltssm_freeze.port = port;
-	ltssm_freeze.freeze = 0;
+	/* The log wrapped or was cleared: read all of it and de-duplicate */
+	ret = switchtec_diag_ltssm_read(c->dev, p->port, 0, count, log);
+	if (ret)
+		return ret;
 
-	ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &ltssm_freeze,
-			    sizeof(ltssm_freeze), NULL, 0);
+	skip = ltssm_log_overlap(p->win, p->win_len, log, count);
+	gap = p->win_len && !skip && count;
+	if (gap)
+		p->stats.nr_gaps++;
 
-	return ret;
+	ret = ltssm_collector_add(c, p, log + skip, count - skip, gap,
+				  time_us);
+	if (ret)
+		return ret;
+
+	if (count) {
+		memcpy(p->win, log, count * sizeof(*p->win));
+		p->win_len = count;
+	}
+	p->prev_count = count;
+
+	return 0;
 }
 
 /**
- * @brief Get the LTSSM log of a port on a gen4 switchtec device
- * @param[in]	dev    Switchtec device handle
- * @param[in]	port   Switchtec Port
- * @param[inout] log_count number of log entries
- * @param[out] log    A pointer to an array containing the log
+ * @brief Start collecting the LTSSM logs of a set of ports
+ * @param[in] dev	Switchtec device handle
+ * @param[in] ports	Physical port IDs, or NULL for every port
+ * @param[in] nr_ports	Number of entries in \p ports
+ * @param[in] ring_size	Number of entries kept for each port
+ * @return The collector on success, NULL on failure
+ *
+ * Each call to switchtec_ltssm_collector_poll() drains the LTSSM logs of
+ * all the ports. Entries already seen in an earlier poll are dropped, so
+ * every transition is reported once even though the device keeps
+ * returning the whole log. Logs are not cleared, but each poll freezes
+ * and then unfreezes every log it reads, which also unfreezes a log
+ * another tool froze to inspect it.
+ *
+ * The collector must be freed with switchtec_ltssm_collector_close().
  */
-static int switchtec_diag_ltssm_log_gen4(struct switchtec_dev *dev,
-				 int port, int *log_count,
-				 struct switchtec_diag_ltssm_log *log_data)
+struct switchtec_ltssm_collector *
+switchtec_ltssm_collector_open(struct switchtec_dev *dev, const int *ports,
+			       int nr_ports, size_t ring_size)
 {
-	struct {
-		uint8_t sub_cmd;
-		uint8_t port;
-		uint8_t freeze;
-		uint8_t unused;
-	} ltssm_freeze;
+	struct switchtec_ltssm_collector *c;
+	struct switchtec_status *status = NULL;
+	int nr_status = 0;
+	int i;
 
-	struct {
-		uint8_t sub_cmd;
-		uint8_t port;
-	} status;
-	struct {
-		uint32_t w0_trigger_count;
-		uint32_t w1_trigger_count;
-		uint8_t log_num;
-	} status_output;
+	if (!ring_size || (ports && nr_ports <= 0)) {
+		errno = EINVAL;
+		return NULL;
+	}
 
-	struct {
-		uint8_t sub_cmd;
-		uint8_t port;
-		uint8_t log_index;
-		uint8_t no_of_logs;
-	} log_dump;
-	struct {
-		uint32_t dw0;
-		uint32_t dw1;
-	} log_dump_out[256];
+	if (!ports) {
+		nr_status = switchtec_status(dev, &status);
+		if (nr_status < 0)
+			return NULL;
+		nr_ports = nr_status;
+	}
 
-	uint32_t dw1;
-	uint32_t dw0;
-	int major;
-	int minor;
-	int rate;
-	int ret;
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		goto err;
+
+	c->dev = dev;
+	c->gen6 = switchtec_is_gen6(dev);
+	c->ts_mask = switchtec_is_gen4(dev) ? 0x3ffffff : 0xffffffff;
+	c->ring_size = ring_size;
+	c->nr_ports = nr_ports;
+
+	c->port_ids = calloc(nr_ports, sizeof(*c->port_ids));
+	c->ports = calloc(nr_ports, sizeof(*c->ports));
+	if (!c->port_ids || !c->ports)
+		goto err;
+
+	for (i = 0; i < nr_ports; i++) {
+		c->port_ids[i] = ports ? ports[i] : status[i].port.phys_id;
+		c->ports[i].port = c->port_ids[i];
+		c->ports[i].win = calloc(LTSSM_COLLECTOR_WINDOW,
+					 sizeof(*c->ports[i].win));
+		c->ports[i].ring = calloc(ring_size, sizeof(*c->ports[i].ring));
+		if (!c->ports[i].win || !c->ports[i].ring)
+			goto err;
+	}
+
+	if (status)
+		switchtec_status_free(status, nr_status);
+
+	return c;
+
+err:
+	if (status)
+		switchtec_status_free(status, nr_status);
+	switchtec_ltssm_collector_close(c);
+	return NULL;
+}
+
+/**
+ * @brief Free an LTSSM collector
+ * @param[in] c		LTSSM collector
+ */
+void switchtec_ltssm_collector_close(struct switchtec_ltssm_collector *c)
+{
 	int i;
 
-	/* freeze logs */
-	ltssm_freeze.sub_cmd = MRPC_LTMON_FREEZE;
-	ltssm_freeze.port = port;
-	ltssm_freeze.freeze = 1;
+	if (!c)
+		return;
 
-	ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &ltssm_freeze,
-			    sizeof(ltssm_freeze), NULL, 0);
-	if (ret)
-		return ret;
+	if (c->ports) {
+		for (i = 0; i < c->nr_ports; i++) {
+			free(c->ports[i].win);
+			free(c->ports[i].ring);
+		}
+	}
 
-	/* get number of entries */
-	status.sub_cmd = MRPC_LTMON_GET_STATUS_GEN4;
-	status.port = port;
-	ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &status,
-			    sizeof(status), &status_output,
-			    sizeof(status_output));
-	if (ret)
-		return ret;
+	free(c->ports);
+	free(c->port_ids);
+	free(c->new_ents);
+	free(c);
+}
 
-	if (status_output.log_num < *log_count)
-		*log_count = status_output.log_num;
+/**
+ * @brief Drain the LTSSM logs of all ports of a collector
+ * @param[in]  c	LTSSM collector
+ * @param[out] entries	Entries found by this poll, port by port and
+ *	oldest first within each port (valid until the next call)
+ * @return The number of new entries, or a negative value on failure
+ *
+ * Each log is frozen while it is read and unfrozen afterwards, even if
+ * it was frozen before. The new entries are also added to the ring of
+ * their port and counted in its statistics.
+ *
+ * The logs only hold device timestamps, so \p time_us of every entry is
+ * the host time of this poll. Polling more often than the logs fill up
+ * bounds the error of the host time and avoids gaps, which are counted
+ * in switchtec_ltssm_stats.nr_gaps when no overlap with the previous
+ * poll could be found.
+ *
+ * On failure, ports drained before the failing one keep their new
+ * entries in their ring and statistics.
+ */
+int switchtec_ltssm_collector_poll(struct switchtec_ltssm_collector *c,
+				   const struct switchtec_ltssm_entry **entries)
+{
+	struct ltssm_collector_port *p;
+	struct timeval tv;
+	uint64_t time_us;
+	int ret, err, i;
 
-	/* get log data */
-	log_dump.sub_cmd = MRPC_LTMON_LOG_DUMP_GEN4;
-	log_dump.port = port;
-	log_dump.log_index = 0;
-	log_dump.no_of_logs = *log_count;
-	if (log_dump.no_of_logs <= 126) {
-		ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &log_dump,
-				    sizeof(log_dump), log_dump_out,
-				    8 * log_dump.no_of_logs);
-		if (ret)
-			return ret;
-	} else {
-		log_dump.no_of_logs = 126;
-		ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &log_dump,
-				    sizeof(log_dump), log_dump_out,
-				    8 * log_dump.no_of_logs);
-		if (ret)
-			return ret;
+	gettimeofday(&tv, NULL);
+	time_us = tv.tv_sec * 1000000ULL + tv.tv_usec;
 
-		log_dump.log_index = 126;
-		log_dump.no_of_logs = *log_count - 126;
+	c->nr_new = 0;
 
-		ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &log_dump,
-				    sizeof(log_dump), log_dump_out + 126,
-				    8 * log_dump.no_of_logs);
+	for (i = 0; i < c->nr_ports; i++) {
+		p = &c->ports[i];
+
+		ret = switchtec_diag_ltssm_freeze(c->dev, p->port, 1);
 		if (ret)
-			return ret;
-	}
-	for (i = 0; i < *log_count; i++) {
-		dw1 = log_dump_out[i].dw1;
-		dw0 = log_dump_out[i].dw0;
-		rate = (dw0 >> 13) & 0x3;
-		major = (dw0 >> 7) & 0xf;
-		minor = (dw0 >> 3) & 0xf;
+			return ret < 0 ? ret : -1;
+
+		ret = ltssm_collector_drain(c, p, time_us);
 
-		log_data[i].timestamp = dw1 & 0x3ffffff;
-		log_data[i].link_rate = switchtec_gen_transfers[rate + 1];
-		log_data[i].link_state = major | (minor << 8);
+		err = errno;
+		if (switchtec_diag_ltssm_freeze(c->dev, p->port, 0) && !ret)
+			ret = -1;
+		else
+			errno = err;
+
+		if (ret)
+			return ret < 0 ? ret : -1;
 	}
 
-	/* unfreeze logs */
-	ltssm_freeze.sub_cmd = MRPC_LTMON_FREEZE;
-	ltssm_freeze.port = port;
-	ltssm_freeze.freeze = 0;
+	if (entries)
+		*entries = c->new_ents;
 
-	ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &ltssm_freeze,
-			    sizeof(ltssm_freeze), NULL, 0);
+	return c->nr_new;
+}
 
-	return ret;
+/**
+ * @brief Get the ports of an LTSSM collector
+ * @param[in]  c	LTSSM collector
+ * @param[out] ports	Physical port IDs (valid until the collector is
+ *	closed)
+ * @return The number of ports
+ */
+int switchtec_ltssm_collector_ports(struct switchtec_ltssm_collector *c,
+				    const int **ports)
+{
+	*ports = c->port_ids;
+	return c->nr_ports;
 }
 
 /**
- * @brief Determine the generation and call the related LTSSM log func
- * @param[in]	dev    Switchtec device handle
- * @param[in]	port   Switchtec Port
- * @param[inout] log_count number of log entries
- * @param[out] log    A pointer to an array containing the log
+ * @brief Copy the entries in the ring of a port
+ * @param[in]  c		LTSSM collector
+ * @param[in]  port		Physical port ID
+ * @param[out] entries		Entries, oldest first
+ * @param[in]  max_entries	Space in \p entries
+ * @return The number of entries copied, or -1 on failure
+ *
+ * If the ring holds more than \p max_entries entries, the newest ones
+ * are copied.
  */
-int switchtec_diag_ltssm_log(struct switchtec_dev *dev,
-			    int port, int *log_count,
-			    struct switchtec_diag_ltssm_log *log_data)
+int switchtec_ltssm_collector_entries(struct switchtec_ltssm_collector *c,
+				      int port,
+				      struct switchtec_ltssm_entry *entries,
+				      size_t max_entries)
 {
-	int ret;
-	if (switchtec_is_gen6(dev))
-		ret = switchtec_diag_ltssm_log_gen6(dev, port, log_count, log_data);
-	else if (switchtec_is_gen5(dev))
-		ret = switchtec_diag_ltssm_log_gen5(dev, port, log_count, log_data);
-	else
-		ret = switchtec_diag_ltssm_log_gen4(dev, port, log_count, log_data);
-	return ret;
+	struct ltssm_collector_port *p;
+	size_t i, skip, count;
+
+	p = ltssm_collector_port(c, port);
+	if (!p)
+		return -1;
+
+	count = p->ring_len < max_entries ? p->ring_len : max_entries;
+	skip = p->ring_len - count;
+
+	for (i = 0; i < count; i++)
+		entries[i] = p->ring[(p->ring_head + skip + i) % c->ring_size];
+
+	return count;
 }
 
 /**
- * @brief Call the LTSSM clear MRPC command
- * @param[in]	dev    Switchtec device handle
- * @param[in]	port   Switchtec Port
+ * @brief Get the transition statistics of a port
+ * @param[in]  c	LTSSM collector
+ * @param[in]  port	Physical port ID
+ * @param[out] st	Statistics since the collector was opened
+ * @return 0 on success, -1 on failure
  */
-int switchtec_diag_ltssm_clear(struct switchtec_dev *dev, int port)
+int switchtec_ltssm_collector_stats(struct switchtec_ltssm_collector *c,
+				    int port, struct switchtec_ltssm_stats *st)
 {
-	int ret;
-	struct {
-		uint8_t subcmd;
-		uint8_t port_id;
-		uint16_t reserved;
-	} ltssm_clear;
+	struct ltssm_collector_port *p;
 
-	ltssm_clear.subcmd = MRPC_LTMON_CLEAR_LOG;
-	ltssm_clear.port_id = port;
+	p = ltssm_collector_port(c, port);
+	if (!p)
+		return -1;
 
-	ret = switchtec_cmd(dev, MRPC_DIAG_PORT_LTSSM_LOG, &ltssm_clear,
-			    sizeof(ltssm_clear), NULL, 0);
-	return ret;
+	*st = p->stats;
+	return 0;
 }
 
 int switchtec_tlp_inject(struct switchtec_dev *dev, int port_id, int tlp_type,
@@ -2419,11 +3283,23 @@ int switchtec_inject_err_cto(struct switchtec_dev *dev, int phys_port_id)
 			     sizeof(cmd), &output, sizeof(output));
 }
 
-int switchtec_osa_capture_data(struct switchtec_dev *dev, int stack_id,
-			       int lane, int direction,
-			       struct switchtec_osa_capture_data *data)
+/**
+ * @brief Read raw entries captured by the ordered set analyzer
+ * @param[in]  dev		Switchtec device handle
+ * @param[in]  stack_id		Stack ID
+ * @param[in]  lane		Lane within the stack
+ * @param[in]  direction	0 for TX, 1 for RX
+ * @param[in]  start_entry	Index of the first entry to read
+ * @param[in]  max_entries	Number of entries to read, at most
+ *	SWITCHTEC_OSA_MAX_READ. With 0, nothing is read but \p rd reports
+ *	the first entry and the number of entries captured.
+ * @param[out] rd		Entries read and position of the next ones
+ * @return 0 on success, error code on failure
+ */
+int switchtec_osa_read_entries(struct switchtec_dev *dev, int stack_id,
+			       int lane, int direction, int start_entry,
+			       int max_entries, struct switchtec_osa_read *rd)
 {
-	int ret = 0;
 	struct {
 		uint8_t sub_cmd;
 		uint8_t stack_id;
@@ -2432,8 +3308,14 @@ int switchtec_osa_capture_data(struct switchtec_dev *dev, int stack_id,
 		uint16_t start_entry;
 		uint8_t num_entries;
 		uint8_t reserved;
-	} osa_data_read_in;
-
+	} in = {
+		.sub_cmd = MRPC_OSA_DATA_READ,
+		.stack_id = stack_id,
+		.lane = lane,
+		.direction = direction,
+		.start_entry = htole16(start_entry),
+		.num_entries = max_entries,
+	};
 	struct {
 		uint8_t entries_read;
 		uint8_t stack_id;
@@ -2443,15 +3325,64 @@ int switchtec_osa_capture_data(struct switchtec_dev *dev, int stack_id,
 		uint16_t entries_remaining;
 		uint16_t wrap;
 		uint16_t reserved;
-	} osa_data_entries_out;
+		uint32_t entry_dwords[SWITCHTEC_OSA_MAX_READ]
+				     [SWITCHTEC_OSA_ENTRY_DWORDS];
+	} out;
+	int ret, i, j;
+
+	if (max_entries < 0 || max_entries > SWITCHTEC_OSA_MAX_READ) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	ret = switchtec_cmd(dev, MRPC_ORDERED_SET_ANALYZER, &in, sizeof(in),
+			    &out, sizeof(out) - sizeof(out.entry_dwords) +
+			    max_entries * sizeof(out.entry_dwords[0]));
+	if (ret)
+		return ret;
+
+	rd->entries_read = out.entries_read;
+	if (rd->entries_read > max_entries)
+		rd->entries_read = max_entries;
+	rd->next_entry = le16toh(out.next_entry);
+	rd->entries_remaining = le16toh(out.entries_remaining);
+	rd->wrap = le16toh(out.wrap);
+
+	for (i = 0; i < rd->entries_read; i++)
+		for (j = 0; j < SWITCHTEC_OSA_ENTRY_DWORDS; j++)
+			rd->entries[i][j] = le32toh(out.entry_dwords[i][j]);
 
-	osa_data_read_in.sub_cmd = MRPC_OSA_DATA_READ;
-	osa_data_read_in.stack_id = stack_id;
-	osa_data_read_in.lane = lane;
-	osa_data_read_in.direction = direction;
+	return 0;
+}
+
+/**
+ * @brief Decode a raw entry captured by the ordered set analyzer
+ * @param[in]  raw	SWITCHTEC_OSA_ENTRY_DWORDS dwords of the entry
+ * @param[out] entry	Decoded entry
+ */
+void switchtec_osa_decode_entry(const uint32_t *raw,
+				struct switchtec_osa_capture_entry *entry)
+{
+	entry->osa_data[0] = raw[0];
+	entry->osa_data[1] = raw[1];
+	entry->osa_data[2] = raw[2];
+	entry->osa_data[3] = raw[3];
+
+	/* the same fields osa-dump-data has always decoded */
+	entry->link_rate = raw[4] & 0x3;
+	entry->counter = (raw[4] >> 3) & 0x12;
+	entry->timestamp = (raw[5] & 0x1A) | ((raw[4] >> 22) & 0x3FF);
+	entry->trigger_indication = (raw[5] >> 28) & 0x1;
+	entry->os_dropped = (raw[5] >> 29) & 0x1;
+}
 
-	osa_data_read_in.start_entry = 0;
-	osa_data_read_in.num_entries = 0;
+int switchtec_osa_capture_data(struct switchtec_dev *dev, int stack_id,
+			       int lane, int direction,
+			       struct switchtec_osa_capture_data *data)
+{
+	struct switchtec_osa_read *rd;
+	int ret = 0;
+	int i, n;
 
 	struct {
 		uint8_t sub_cmd;
@@ -2477,97 +3408,51 @@ int switchtec_osa_capture_data(struct switchtec_dev *dev, int stack_id,
 			    sizeof(osa_status_query_in), &osa_status_query_out,
 			    sizeof(osa_status_query_out));
 
-	ret = switchtec_cmd(dev, MRPC_ORDERED_SET_ANALYZER, &osa_data_read_in,
-			    sizeof(osa_data_read_in), &osa_data_entries_out,
-			    sizeof(osa_data_entries_out));
+	rd = malloc(sizeof(*rd));
+	if (!rd)
+		return -1;
+
+	ret = switchtec_osa_read_entries(dev, stack_id, lane, direction, 0, 0,
+					 rd);
 	if (ret) {
 		switchtec_perror("OSA data dump");
-		return ret;
+		goto out;
 	}
 
-	struct {
-		uint8_t entries_read;
-		uint8_t stack_id;
-		uint8_t lane;
-		uint8_t direction;
-		uint16_t next_entry;
-		uint16_t entries_remaining;
-		uint16_t wrap;
-		uint16_t reserved;
-		uint32_t entry_dwords[osa_data_entries_out.entries_remaining * 6];
-	} osa_data_read_out;
-
-	osa_data_read_out.entries_remaining = osa_data_entries_out.entries_remaining;
-	osa_data_read_out.next_entry = osa_data_entries_out.next_entry;
-
 	if (data) {
 		data->stack_id = stack_id;
 		data->lane = lane;
 		data->direction = direction;
-		data->total_entries = osa_data_entries_out.entries_remaining;
-		data->wrap_occurred = osa_data_entries_out.wrap;
+		data->total_entries = rd->entries_remaining;
+		data->wrap_occurred = rd->wrap;
 		data->entry_count = 0;
 	}
 
-	int total_dword = 0;
-	int total_entries = 0;
-	int curr_entry_dword = 0;
-	uint64_t timestamp;
-	uint32_t timestamp_lower, timestamp_upper, counter;
-	uint8_t link_rate, trigger, os_droppped;
-	uint32_t osa_data_dwords[4];
-	int osa_data_idx = 0;
-
-	while (osa_data_read_out.entries_remaining != 0) {
-		if (data && total_entries >= SWITCHTEC_OSA_MAX_ENTRIES)
+	while (rd->entries_remaining) {
+		if (data && data->entry_count >= SWITCHTEC_OSA_MAX_ENTRIES)
 			break;
 
-		osa_data_read_in.num_entries = osa_data_read_out.entries_remaining;
-		osa_data_read_in.start_entry = osa_data_read_out.next_entry;
+		n = rd->entries_remaining < SWITCHTEC_OSA_MAX_READ ?
+			rd->entries_remaining : SWITCHTEC_OSA_MAX_READ;
+		ret = switchtec_osa_read_entries(dev, stack_id, lane,
+						 direction, rd->next_entry,
+						 n, rd);
+		if (ret) {
+			ret = -1;
+			goto out;
+		}
 
-		ret = switchtec_cmd(dev, MRPC_ORDERED_SET_ANALYZER,
-				    &osa_data_read_in, sizeof(osa_data_read_in),
-				    &osa_data_read_out, sizeof(osa_data_read_out));
-		if (ret)
-			return -1;
+		if (!rd->entries_read)
+			break;
 
-		for (int i = total_dword; i < total_dword + (osa_data_read_out.entries_read * 6); i++) {
-			if (curr_entry_dword < 4) {
-				osa_data_dwords[osa_data_idx++] = osa_data_read_out.entry_dwords[i];
-			} else if (curr_entry_dword == 4) {
-				timestamp_lower = (osa_data_read_out.entry_dwords[i] >> 22) & 0x3FF;
-				timestamp_upper = (osa_data_read_out.entry_dwords[i+1] & 0x1A);
-				timestamp = timestamp_upper | timestamp_lower;
-
-				link_rate = osa_data_read_out.entry_dwords[i] & 0x3;
-				counter = (osa_data_read_out.entry_dwords[i] >> 3) & 0x12;
-				trigger	= (osa_data_read_out.entry_dwords[i+1] >> 28) & 0x1;
-				os_droppped = (osa_data_read_out.entry_dwords[i+1] >> 29) & 0x1;
-
-				if (data && total_entries < SWITCHTEC_OSA_MAX_ENTRIES) {
-					data->entries[total_entries].timestamp = timestamp;
-					data->entries[total_entries].link_rate = link_rate;
-					data->entries[total_entries].counter = counter;
-					data->entries[total_entries].trigger_indication = trigger;
-					data->entries[total_entries].os_dropped = os_droppped;
-					data->entries[total_entries].osa_data[0] = osa_data_dwords[0];
-					data->entries[total_entries].osa_data[1] = osa_data_dwords[1];
-					data->entries[total_entries].osa_data[2] = osa_data_dwords[2];
-					data->entries[total_entries].osa_data[3] = osa_data_dwords[3];
-					data->entry_count++;
-				}
-
-				osa_data_idx = 0;
-				total_entries++;
-			}
-			curr_entry_dword++;
-			if (i != 0 && i % 5 == 0) {
-				curr_entry_dword = 0;
-			}
-		}
-		total_dword += osa_data_read_out.entries_read;
+		for (i = 0; data && i < rd->entries_read &&
+		     data->entry_count < SWITCHTEC_OSA_MAX_ENTRIES; i++)
+			switchtec_osa_decode_entry(rd->entries[i],
+				&data->entries[data->entry_count++]);
 	}
 
+out:
+	free(rd);
 	return ret;
 }
 
@@ -0,0 +1,816 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Switchtec core library functions for equalization snapshots
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+#include "switchtec/switchtec.h"
+#include "switchtec/eq.h"
+#include "switchtec/endian.h"
+#include "switchtec/errors.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+/**
+ * @defgroup EqSnapshot Equalization Snapshots
+ * @brief Capture, store and compare the SerDes settings of a whole switch
+ *
+ * switchtec_eq_snapshot() reads the receiver objects, TX coefficients,
+ * FS/LF values and far end TX EQ table of every link-up port into one
+ * structure. Snapshots can be saved with switchtec_eq_snapshot_write()
+ * (binary, readable with switchtec_eq_snapshot_read()) or
+ * switchtec_eq_snapshot_write_json(), and switchtec_eq_snapshot_diff()
+ * lists the values that changed between two of them, e.g. before and
+ * after a thermal event.
+ *
+ * @{
+ */
+
+/**
+ * @brief Header of an equalization snapshot file
+ *
+ * It is followed, for each port, by a port record, the steps of the TX
+ * EQ table and the lane records. All fields are little endian 32-bit
+ * words. Lane records hold nr_lane_fields values, so files with more
+ * fields than this version knows can still be read.
+ */
+struct eq_file_hdr {
+	char magic[8];		//!< SWITCHTEC_EQ_FILE_MAGIC
+	uint32_t version;	//!< SWITCHTEC_EQ_FILE_VERSION
+	uint32_t hdr_size;	//!< Size of this header
+	uint32_t gen;		//!< enum switchtec_gen of the switch
+	uint32_t nr_ports;
+	uint32_t time_us_lo;
+	uint32_t time_us_hi;
+	uint32_t nr_lane_fields;	//!< Values in each lane record
+	uint32_t rsvd;
+};
+
+struct eq_file_port {
+	uint32_t port_id;
+	uint32_t link_rate;
+	uint32_t link_width;
+	uint32_t valid;
+	uint32_t nr_lanes;
+	uint32_t step_cnt;	//!< Steps of the TX EQ table that follow
+};
+
+#define EQ_STEP_WORDS	8
+#define EQ_LANE_HDR	2	//!< lane_id and valid, ahead of the fields
+
+struct eq_field {
+	const char *name;
+	size_t off;
+	unsigned valid;
+};
+
+#define EQ_FIELD(name, member, valid) \
+	{name, offsetof(struct switchtec_eq_lane, member), valid}
+
+static const struct eq_field eq_lane_fields[] = {
+	EQ_FIELD("ctle", ctle, SWITCHTEC_EQ_RCVR_OBJ),
+	EQ_FIELD("target_amplitude", target_amplitude, SWITCHTEC_EQ_RCVR_OBJ),
+	EQ_FIELD("speculative_dfe", speculative_dfe, SWITCHTEC_EQ_RCVR_OBJ),
+	EQ_FIELD("dfe0", dynamic_dfe[0], SWITCHTEC_EQ_RCVR_OBJ),
+	EQ_FIELD("dfe1", dynamic_dfe[1], SWITCHTEC_EQ_RCVR_OBJ),
+	EQ_FIELD("dfe2", dynamic_dfe[2], SWITCHTEC_EQ_RCVR_OBJ),
+	EQ_FIELD("dfe3", dynamic_dfe[3], SWITCHTEC_EQ_RCVR_OBJ),
+	EQ_FIELD("dfe4", dynamic_dfe[4], SWITCHTEC_EQ_RCVR_OBJ),
+	EQ_FIELD("dfe5", dynamic_dfe[5], SWITCHTEC_EQ_RCVR_OBJ),
+	EQ_FIELD("dfe6", dynamic_dfe[6], SWITCHTEC_EQ_RCVR_OBJ),
+	EQ_FIELD("ctle2_rx_mode", ctle2_rx_mode, SWITCHTEC_EQ_RCVR_EXT),
+	EQ_FIELD("dtclk_5", dtclk_5, SWITCHTEC_EQ_RCVR_EXT),
+	EQ_FIELD("dtclk_8_6", dtclk_8_6, SWITCHTEC_EQ_RCVR_EXT),
+	EQ_FIELD("dtclk_9", dtclk_9, SWITCHTEC_EQ_RCVR_EXT),
+	EQ_FIELD("local_pre", local_pre, SWITCHTEC_EQ_LOCAL_COEFF),
+	EQ_FIELD("local_post", local_post, SWITCHTEC_EQ_LOCAL_COEFF),
+	EQ_FIELD("far_pre", far_pre, SWITCHTEC_EQ_FAR_COEFF),
+	EQ_FIELD("far_post", far_post, SWITCHTEC_EQ_FAR_COEFF),
+	EQ_FIELD("local_fs", local_fs, SWITCHTEC_EQ_LOCAL_FSLF),
+	EQ_FIELD("local_lf", local_lf, SWITCHTEC_EQ_LOCAL_FSLF),
+	EQ_FIELD("far_fs", far_fs, SWITCHTEC_EQ_FAR_FSLF),
+	EQ_FIELD("far_lf", far_lf, SWITCHTEC_EQ_FAR_FSLF),
+};
+
+#define EQ_NR_LANE_FIELDS ARRAY_SIZE(eq_lane_fields)
+
+static int *eq_lane_field(struct switchtec_eq_lane *lane,
+			  const struct eq_field *f)
+{
+	return (int *)((char *)lane + f->off);
+}
+
+static int eq_lane_value(const struct switchtec_eq_lane *lane,
+			 const struct eq_field *f)
+{
+	return *(const int *)((const char *)lane + f->off);
+}
+
+static void eq_snapshot_coeff(struct switchtec_dev *dev,
+			      struct switchtec_eq_port *p,
+			      enum switchtec_diag_end end)
+{
+	struct switchtec_port_eq_coeff coeff;
+	struct switchtec_eq_lane *lane;
+	int i;
+
+	if (switchtec_diag_port_eq_tx_coeff(dev, p->port_id, 0, end,
+					    SWITCHTEC_DIAG_LINK_CURRENT,
+					    &coeff))
+		return;
+
+	for (i = 0; i < p->nr_lanes && i < coeff.lane_cnt &&
+	     i < ARRAY_SIZE(coeff.cursors); i++) {
+		lane = &p->lanes[i];
+		if (end == SWITCHTEC_DIAG_LOCAL) {
+			lane->local_pre = coeff.cursors[i].pre;
+			lane->local_post = coeff.cursors[i].post;
+			lane->valid |= SWITCHTEC_EQ_LOCAL_COEFF;
+		} else {
+			lane->far_pre = coeff.cursors[i].pre;
+			lane->far_post = coeff.cursors[i].post;
+			lane->valid |= SWITCHTEC_EQ_FAR_COEFF;
+		}
+	}
+}
+
+/*
+ * Read the per-lane parts of a lane. Parts in skip were refused for an
+ * earlier lane of the port and are not asked for again.
+ */
+static unsigned eq_snapshot_lane(struct switchtec_dev *dev, int port_id,
+				 struct switchtec_eq_lane *lane, unsigned skip)
+{
+	struct switchtec_port_eq_tx_fslf fslf;
+	struct switchtec_rcvr_obj obj;
+	struct switchtec_rcvr_ext ext;
+	unsigned tried = 0;
+	int i;
+
+	if (!(skip & SWITCHTEC_EQ_RCVR_OBJ)) {
+		tried |= SWITCHTEC_EQ_RCVR_OBJ;
+		if (!switchtec_diag_rcvr_obj(dev, port_id, lane->lane_id,
+					     SWITCHTEC_DIAG_LINK_CURRENT,
+					     &obj)) {
+			lane->ctle = obj.ctle;
+			lane->target_amplitude = obj.target_amplitude;
+			lane->speculative_dfe = obj.speculative_dfe;
+			for (i = 0; i < ARRAY_SIZE(lane->dynamic_dfe); i++)
+				lane->dynamic_dfe[i] = obj.dynamic_dfe[i];
+			lane->valid |= SWITCHTEC_EQ_RCVR_OBJ;
+		}
+	}
+
+	if (!(skip & SWITCHTEC_EQ_RCVR_EXT)) {
+		tried |= SWITCHTEC_EQ_RCVR_EXT;
+		if (!switchtec_diag_rcvr_ext(dev, port_id, lane->lane_id,
+					     SWITCHTEC_DIAG_LINK_CURRENT,
+					     &ext)) {
+			lane->ctle2_rx_mode = ext.ctle2_rx_mode;
+			lane->dtclk_5 = ext.dtclk_5;
+			lane->dtclk_8_6 = ext.dtclk_8_6;
+			lane->dtclk_9 = ext.dtclk_9;
+			lane->valid |= SWITCHTEC_EQ_RCVR_EXT;
+		}
+	}
+
+	if (!(skip & SWITCHTEC_EQ_LOCAL_FSLF)) {
+		tried |= SWITCHTEC_EQ_LOCAL_FSLF;
+		if (!switchtec_diag_port_eq_tx_fslf(dev, port_id, 0,
+						    lane->lane_id,
+						    SWITCHTEC_DIAG_LOCAL,
+						    SWITCHTEC_DIAG_LINK_CURRENT,
+						    &fslf)) {
+			lane->local_fs = fslf.fs;
+			lane->local_lf = fslf.lf;
+			lane->valid |= SWITCHTEC_EQ_LOCAL_FSLF;
+		}
+	}
+
+	if (!(skip & SWITCHTEC_EQ_FAR_FSLF)) {
+		tried |= SWITCHTEC_EQ_FAR_FSLF;
+		if (!switchtec_diag_port_eq_tx_fslf(dev, port_id, 0,
+						    lane->lane_id,
+						    SWITCHTEC_DIAG_FAR_END,
+						    SWITCHTEC_DIAG_LINK_CURRENT,
+						    &fslf)) {
+			lane->far_fs = fslf.fs;
+			lane->far_lf = fslf.lf;
+			lane->valid |= SWITCHTEC_EQ_FAR_FSLF;
+		}
+	}
+
+	return tried & ~lane->valid;
+}
+
+static int eq_snapshot_port(struct switchtec_dev *dev,
+			    const struct switchtec_status *status,
+			    struct switchtec_eq_port *p)
+{
+	unsigned skip = 0;
+	int i;
+
+	p->port_id = status->port.phys_id;
+	p->link_rate = status->link_rate;
+	p->link_width = status->neg_lnk_width;
+	p->nr_lanes = status->neg_lnk_width;
+
+	p->lanes = calloc(p->nr_lanes, sizeof(*p->lanes));
+	if (!p->lanes)
+		return -1;
+
+	for (i = 0; i < p->nr_lanes; i++)
+		p->lanes[i].lane_id = i;
+
+	/* the coefficients of all lanes come back in one MRPC */
+	eq_snapshot_coeff(dev, p, SWITCHTEC_DIAG_LOCAL);
+	eq_snapshot_coeff(dev, p, SWITCHTEC_DIAG_FAR_END);
+
+	if (!switchtec_diag_port_eq_tx_table(dev, p->port_id, 0,
+					     SWITCHTEC_DIAG_LINK_CURRENT,
+					     &p->table))
+		p->valid |= SWITCHTEC_EQ_TX_TABLE;
+
+	for (i = 0; i < p->nr_lanes; i++) {
+		if (i == 0)
+			skip = eq_snapshot_lane(dev, p->port_id, &p->lanes[i], 0);
+		else
+			eq_snapshot_lane(dev, p->port_id, &p->lanes[i], skip);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Read the equalization settings of every link-up port
+ * @param[in] dev	Switchtec device handle
+ * @return The snapshot on success, NULL on failure
+ *
+ * Each port costs one MRPC for each end's TX coefficients and one for
+ * its TX EQ table, plus the per-lane receiver objects and FS/LF values.
+ * A part the switch refuses for the first lane of a port is not asked
+ * for on its other lanes; refused parts are left out of the snapshot,
+ * see switchtec_eq_lane.valid.
+ *
+ * The snapshot must be freed with switchtec_eq_snapshot_free().
+ */
+struct switchtec_eq_snapshot *switchtec_eq_snapshot(struct switchtec_dev *dev)
+{
+	struct switchtec_eq_snapshot *snap;
+	struct switchtec_status *status;
+	struct timeval tv;
+	int nr_status, i;
+
+	nr_status = switchtec_status(dev, &status);
+	if (nr_status < 0)
+		return NULL;
+
+	snap = calloc(1, sizeof(*snap));
+	if (!snap)
+		goto out;
+
+	snap->ports = calloc(nr_status, sizeof(*snap->ports));
+	if (!snap->ports)
+		goto err;
+
+	snap->gen = switchtec_gen(dev);
+	gettimeofday(&tv, NULL);
+	snap->time_us = tv.tv_sec * 1000000ULL + tv.tv_usec;
+
+	for (i = 0; i < nr_status; i++) {
+		if (!status[i].link_up)
+			continue;
+
+		if (eq_snapshot_port(dev, &status[i],
+				     &snap->ports[snap->nr_ports++]))
+			goto err;
+	}
+
+	goto out;
+
+err:
+	switchtec_eq_snapshot_free(snap);
+	snap = NULL;
+out:
+	switchtec_status_free(status, nr_status);
+	return snap;
+}
+
+/**
+ * @brief Free an equalization snapshot
+ * @param[in] snap	Snapshot
+ */
+void switchtec_eq_snapshot_free(struct switchtec_eq_snapshot *snap)
+{
+	int i;
+
+	if (!snap)
+		return;
+
+	for (i = 0; snap->ports && i < snap->nr_ports; i++)
+		free(snap->ports[i].lanes);
+
+	free(snap->ports);
+	free(snap);
+}
+
+static int eq_write_words(FILE *f, uint32_t *words, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		words[i] = htole32(words[i]);
+
+	return fwrite(words, sizeof(*words), n, f) == n ? 0 : -1;
+}
+
+/**
+ * @brief Write an equalization snapshot to a binary file
+ * @param[in] snap	Snapshot
+ * @param[in] f		File to write to
+ * @return 0 on success, -1 on failure
+ */
+int switchtec_eq_snapshot_write(const struct switchtec_eq_snapshot *snap,
+				FILE *f)
+{
+	struct eq_file_hdr hdr = {
+		.version = htole32(SWITCHTEC_EQ_FILE_VERSION),
+		.hdr_size = htole32(sizeof(hdr)),
+		.gen = htole32(snap->gen),
+		.nr_ports = htole32(snap->nr_ports),
+		.time_us_lo = htole32(snap->time_us),
+		.time_us_hi = htole32(snap->time_us >> 32),
+		.nr_lane_fields = htole32(EQ_NR_LANE_FIELDS),
+	};
+	uint32_t words[EQ_LANE_HDR + EQ_NR_LANE_FIELDS];
+	const struct switchtec_eq_port *p;
+	const struct switchtec_eq_lane *l;
+	struct eq_file_port fp;
+	int i, step_cnt;
+
+	memcpy(hdr.magic, SWITCHTEC_EQ_FILE_MAGIC, sizeof(hdr.magic));
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1)
+		return -1;
+
+	for (p = snap->ports; p < snap->ports + snap->nr_ports; p++) {
+		step_cnt = p->valid & SWITCHTEC_EQ_TX_TABLE ?
+			p->table.step_cnt : 0;
+
+		fp.port_id = p->port_id;
+		fp.link_rate = p->link_rate;
+		fp.link_width = p->link_width;
+		fp.valid = p->valid;
+		fp.nr_lanes = p->nr_lanes;
+		fp.step_cnt = step_cnt;
+		if (eq_write_words(f, (uint32_t *)&fp, sizeof(fp) / 4))
+			return -1;
+
+		for (i = 0; i < step_cnt; i++) {
+			words[0] = p->table.steps[i].pre_cursor;
+			words[1] = p->table.steps[i].post_cursor;
+			words[2] = p->table.steps[i].fom;
+			words[3] = p->table.steps[i].pre_cursor_up;
+			words[4] = p->table.steps[i].post_cursor_up;
+			words[5] = p->table.steps[i].error_status;
+			words[6] = p->table.steps[i].active_status;
+			words[7] = p->table.steps[i].speed;
+			if (eq_write_words(f, words, EQ_STEP_WORDS))
+				return -1;
+		}
+
+		for (l = p->lanes; l < p->lanes + p->nr_lanes; l++) {
+			words[0] = l->lane_id;
+			words[1] = l->valid;
+			for (i = 0; i < EQ_NR_LANE_FIELDS; i++)
+				words[EQ_LANE_HDR + i] =
+					eq_lane_value(l, &eq_lane_fields[i]);
+			if (eq_write_words(f, words, ARRAY_SIZE(words)))
+				return -1;
+		}
+	}
+
+	return fflush(f) ? -1 : 0;
+}
+
+static int eq_read_words(FILE *f, uint32_t *words, size_t n)
+{
+	size_t i;
+
+	if (fread(words, sizeof(*words), n, f) != n)
+		return -1;
+
+	for (i = 0; i < n; i++)
+		words[i] = le32toh(words[i]);
+
+	return 0;
+}
+
+static int eq_read_port(FILE *f, struct switchtec_eq_port *p,
+			size_t nr_fields)
+{
+	uint32_t words[EQ_LANE_HDR + EQ_NR_LANE_FIELDS];
+	struct eq_file_port fp;
+	struct switchtec_eq_lane *l;
+	size_t i;
+
+	if (eq_read_words(f, (uint32_t *)&fp, sizeof(fp) / 4) ||
+	    fp.nr_lanes > 16 ||
+	    fp.step_cnt > ARRAY_SIZE(p->table.steps))
+		return -1;
+
+	p->port_id = fp.port_id;
+	p->link_rate = fp.link_rate;
+	p->link_width = fp.link_width;
+	p->valid = fp.valid;
+	p->table.lane_id = 0;
+	p->table.step_cnt = fp.step_cnt;
+
+	for (i = 0; i < fp.step_cnt; i++) {
+		if (eq_read_words(f, words, EQ_STEP_WORDS))
+			return -1;
+
+		p->table.steps[i].pre_cursor = words[0];
+		p->table.steps[i].post_cursor = words[1];
+		p->table.steps[i].fom = words[2];
+		p->table.steps[i].pre_cursor_up = words[3];
+		p->table.steps[i].post_cursor_up = words[4];
+		p->table.steps[i].error_status = words[5];
+		p->table.steps[i].active_status = words[6];
+		p->table.steps[i].speed = words[7];
+	}
+
+	p->lanes = calloc(fp.nr_lanes, sizeof(*p->lanes));
+	if (!p->lanes)
+		return -1;
+	p->nr_lanes = fp.nr_lanes;
+
+	for (l = p->lanes; l < p->lanes + p->nr_lanes; l++) {
+		if (eq_read_words(f, words, EQ_LANE_HDR +
+				  (nr_fields < EQ_NR_LANE_FIELDS ?
+				   nr_fields : EQ_NR_LANE_FIELDS)))
+			return -1;
+
+		/* fields added by later versions */
+		if (nr_fields > EQ_NR_LANE_FIELDS &&
+		    fseek(f, (nr_fields - EQ_NR_LANE_FIELDS) * 4, SEEK_CUR))
+			return -1;
+
+		l->lane_id = words[0];
+		l->valid = words[1];
+		for (i = 0; i < nr_fields && i < EQ_NR_LANE_FIELDS; i++)
+			*eq_lane_field(l, &eq_lane_fields[i]) =
+				words[EQ_LANE_HDR + i];
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Read an equalization snapshot from a binary file
+ * @param[in] f		File written by switchtec_eq_snapshot_write()
+ * @return The snapshot on success, NULL on failure
+ *
+ * The snapshot must be freed with switchtec_eq_snapshot_free().
+ */
+struct switchtec_eq_snapshot *switchtec_eq_snapshot_read(FILE *f)
+{
+	struct switchtec_eq_snapshot *snap;
+	struct eq_file_hdr hdr;
+	uint32_t nr_ports, hdr_size;
+	int i;
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1)
+		goto inval;
+
+	hdr_size = le32toh(hdr.hdr_size);
+	nr_ports = le32toh(hdr.nr_ports);
+	if (memcmp(hdr.magic, SWITCHTEC_EQ_FILE_MAGIC, sizeof(hdr.magic)) ||
+	    le32toh(hdr.version) != SWITCHTEC_EQ_FILE_VERSION ||
+	    hdr_size < sizeof(hdr) || nr_ports > SWITCHTEC_MAX_PORTS)
+		goto inval;
+
+	if (hdr_size > sizeof(hdr) &&
+	    fseek(f, hdr_size - sizeof(hdr), SEEK_CUR))
+		goto inval;
+
+	snap = calloc(1, sizeof(*snap));
+	if (!snap)
+		return NULL;
+
+	snap->gen = le32toh(hdr.gen);
+	snap->time_us = le32toh(hdr.time_us_lo) |
+		(uint64_t)le32toh(hdr.time_us_hi) << 32;
+
+	snap->ports = calloc(nr_ports, sizeof(*snap->ports));
+	if (!snap->ports) {
+		switchtec_eq_snapshot_free(snap);
+		return NULL;
+	}
+
+	for (i = 0; i < nr_ports; i++) {
+		snap->nr_ports++;
+		if (eq_read_port(f, &snap->ports[i],
+				 le32toh(hdr.nr_lane_fields))) {
+			switchtec_eq_snapshot_free(snap);
+			goto inval;
+		}
+	}
+
+	return snap;
+
+inval:
+	errno = SWITCHTEC_ERR_EQ_FILE_INVAL;
+	return NULL;
+}
+
+/**
+ * @brief Write an equalization snapshot as JSON
+ * @param[in] snap	Snapshot
+ * @param[in] f		File to write to
+ * @return 0 on success, -1 on failure
+ *
+ * Only the parts that were read are written. JSON files are meant for
+ * other tools; switchtec_eq_snapshot_read() only reads binary files.
+ */
+int switchtec_eq_snapshot_write_json(const struct switchtec_eq_snapshot *snap,
+				     FILE *f)
+{
+	const struct switchtec_eq_port *p;
+	const struct switchtec_eq_lane *l;
+	int i;
+
+	fprintf(f, "{\n  \"version\": %d,\n  \"gen\": %d,\n"
+		"  \"time_us\": %llu,\n  \"ports\": [",
+		SWITCHTEC_EQ_FILE_VERSION, snap->gen,
+		(unsigned long long)snap->time_us);
+
+	for (p = snap->ports; p < snap->ports + snap->nr_ports; p++) {
+		fprintf(f, "%s\n    {\n      \"port_id\": %d,\n"
+			"      \"link_rate\": %d,\n      \"link_width\": %d,\n",
+			p == snap->ports ? "" : ",", p->port_id,
+			p->link_rate, p->link_width);
+
+		if (p->valid & SWITCHTEC_EQ_TX_TABLE) {
+			fprintf(f, "      \"tx_table\": [");
+			for (i = 0; i < p->table.step_cnt; i++)
+				fprintf(f, "%s\n        {\"pre_cursor\": %d, "
+					"\"post_cursor\": %d, \"fom\": %d, "
+					"\"pre_cursor_up\": %d, "
+					"\"post_cursor_up\": %d, "
+					"\"error_status\": %d, "
+					"\"active_status\": %d, "
+					"\"speed\": %d}",
+					i ? "," : "",
+					p->table.steps[i].pre_cursor,
+					p->table.steps[i].post_cursor,
+					p->table.steps[i].fom,
+					p->table.steps[i].pre_cursor_up,
+					p->table.steps[i].post_cursor_up,
+					p->table.steps[i].error_status,
+					p->table.steps[i].active_status,
+					p->table.steps[i].speed);
+			fprintf(f, "\n      ],\n");
+		}
+
+		fprintf(f, "      \"lanes\": [");
+		for (l = p->lanes; l < p->lanes + p->nr_lanes; l++) {
+			fprintf(f, "%s\n        {\"lane_id\": %d",
+				l == p->lanes ? "" : ",", l->lane_id);
+			for (i = 0; i < EQ_NR_LANE_FIELDS; i++)
+				if (l->valid & eq_lane_fields[i].valid)
+					fprintf(f, ", \"%s\": %d",
+						eq_lane_fields[i].name,
+						eq_lane_value(l,
+							&eq_lane_fields[i]));
+			fprintf(f, "}");
+		}
+		fprintf(f, "\n      ]\n    }");
+	}
+
+	fprintf(f, "\n  ]\n}\n");
+
+	return ferror(f) || fflush(f) ? -1 : 0;
+}
+
+struct eq_step_field {
+	const char *name;
+	size_t off;
+};
+
+#define EQ_STEP_FIELD(name, member) \
+	{name, offsetof(struct switchtec_port_eq_table, steps[0].member) - \
+	       offsetof(struct switchtec_port_eq_table, steps[0])}
+
+static const struct eq_step_field eq_step_fields[] = {
+	EQ_STEP_FIELD("tx_pre_cursor", pre_cursor),
+	EQ_STEP_FIELD("tx_post_cursor", post_cursor),
+	EQ_STEP_FIELD("tx_fom", fom),
+	EQ_STEP_FIELD("tx_pre_cursor_up", pre_cursor_up),
+	EQ_STEP_FIELD("tx_post_cursor_up", post_cursor_up),
+	EQ_STEP_FIELD("tx_error_status", error_status),
+	EQ_STEP_FIELD("tx_active_status", active_status),
+	EQ_STEP_FIELD("tx_speed", speed),
+};
+
+static int eq_step_value(const struct switchtec_port_eq_table *t, int step,
+			 const struct eq_step_field *f)
+{
+	return *(const int *)((const char *)&t->steps[step] + f->off);
+}
+
+static int eq_diff_add(struct switchtec_eq_diff **diffs, int *nr, int *cap,
+		       int port_id, int lane_id, int step_id,
+		       const char *field, int old_val, int new_val)
+{
+	struct switchtec_eq_diff *d;
+	int new_cap;
+
+	if (*nr == *cap) {
+		new_cap = *cap ? *cap * 2 : 64;
+		d = realloc(*diffs, new_cap * sizeof(*d));
+		if (!d)
+			return -1;
+		*diffs = d;
+		*cap = new_cap;
+	}
+
+	d = &(*diffs)[(*nr)++];
+	d->port_id = port_id;
+	d->lane_id = lane_id;
+	d->step_id = step_id;
+	d->field = field;
+	d->old_val = old_val;
+	d->new_val = new_val;
+
+	return 0;
+}
+
+static const struct switchtec_eq_port *
+eq_find_port(const struct switchtec_eq_snapshot *snap, int port_id)
+{
+	int i;
+
+	for (i = 0; i < snap->nr_ports; i++)
+		if (snap->ports[i].port_id == port_id)
+			return &snap->ports[i];
+
+	return NULL;
+}
+
+static int eq_diff_table(const struct switchtec_eq_port *pa,
+			 const struct switchtec_eq_port *pb, int threshold,
+			 struct switchtec_eq_diff **diffs, int *nr, int *cap)
+{
+	const struct switchtec_port_eq_table *ta = &pa->table, *tb = &pb->table;
+	const struct eq_step_field *f;
+	int va, vb, i;
+
+	if (ta->step_cnt != tb->step_cnt &&
+	    eq_diff_add(diffs, nr, cap, pa->port_id, -1, -1,
+			"tx_table_steps", ta->step_cnt, tb->step_cnt))
+		return -1;
+
+	for (i = 0; i < ta->step_cnt && i < tb->step_cnt; i++) {
+		for (f = eq_step_fields; f < eq_step_fields +
+		     ARRAY_SIZE(eq_step_fields); f++) {
+			va = eq_step_value(ta, i, f);
+			vb = eq_step_value(tb, i, f);
+			if (abs(va - vb) > threshold &&
+			    eq_diff_add(diffs, nr, cap, pa->port_id, -1, i,
+					f->name, va, vb))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int eq_diff_port(const struct switchtec_eq_port *pa,
+			const struct switchtec_eq_port *pb, int threshold,
+			struct switchtec_eq_diff **diffs, int *nr, int *cap)
+{
+	const struct switchtec_eq_lane *la, *lb;
+	const struct eq_field *f;
+	int va, vb, i;
+
+	if (pa->link_rate != pb->link_rate &&
+	    eq_diff_add(diffs, nr, cap, pa->port_id, -1, -1, "link_rate",
+			pa->link_rate, pb->link_rate))
+		return -1;
+
+	if (pa->link_width != pb->link_width &&
+	    eq_diff_add(diffs, nr, cap, pa->port_id, -1, -1, "link_width",
+			pa->link_width, pb->link_width))
+		return -1;
+
+	if (pa->valid & pb->valid & SWITCHTEC_EQ_TX_TABLE &&
+	    eq_diff_table(pa, pb, threshold, diffs, nr, cap))
+		return -1;
+
+	for (i = 0; i < pa->nr_lanes || i < pb->nr_lanes; i++) {
+		if (i >= pa->nr_lanes || i >= pb->nr_lanes) {
+			if (eq_diff_add(diffs, nr, cap, pa->port_id, i, -1,
+					"present", i < pa->nr_lanes,
+					i < pb->nr_lanes))
+				return -1;
+			continue;
+		}
+
+		la = &pa->lanes[i];
+		lb = &pb->lanes[i];
+		for (f = eq_lane_fields; f < eq_lane_fields +
+		     EQ_NR_LANE_FIELDS; f++) {
+			if (!(la->valid & lb->valid & f->valid))
+				continue;
+
+			va = eq_lane_value(la, f);
+			vb = eq_lane_value(lb, f);
+			if (abs(va - vb) > threshold &&
+			    eq_diff_add(diffs, nr, cap, pa->port_id, i, -1,
+					f->name, va, vb))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief List the values that differ between two snapshots
+ * @param[in]  a	 First (older) snapshot
+ * @param[in]  b	 Second (newer) snapshot
+ * @param[in]  threshold Lane values must change by more than this to
+ *	be listed
+ * @param[out] diffs	 Differences, port by port, to be freed with free()
+ * @return The number of differences, or -1 on failure
+ *
+ * Ports and lanes found in only one snapshot are listed with the field
+ * "present". Lane values are only compared if both snapshots read them.
+ * The steps of the TX EQ table are compared one by one, up to the
+ * shorter of the two tables, with the same threshold.
+ */
+int switchtec_eq_snapshot_diff(const struct switchtec_eq_snapshot *a,
+			       const struct switchtec_eq_snapshot *b,
+			       int threshold, struct switchtec_eq_diff **diffs)
+{
+	const struct switchtec_eq_port *pa, *pb;
+	int nr = 0, cap = 0;
+
+	*diffs = NULL;
+
+	for (pa = a->ports; pa < a->ports + a->nr_ports; pa++) {
+		pb = eq_find_port(b, pa->port_id);
+		if (pb) {
+			if (eq_diff_port(pa, pb, threshold, diffs, &nr, &cap))
+				goto err;
+		} else if (eq_diff_add(diffs, &nr, &cap, pa->port_id, -1, -1,
+				       "present", 1, 0)) {
+			goto err;
+		}
+	}
+
+	for (pb = b->ports; pb < b->ports + b->nr_ports; pb++)
+		if (!eq_find_port(a, pb->port_id) &&
+		    eq_diff_add(diffs, &nr, &cap, pb->port_id, -1, -1,
+				"present", 0, 1))
+			goto err;
+
+	return nr;
+
+err:
+	free(*diffs);
+	*diffs = NULL;
+	return -1;
+}
+
+/**@}*/
@@ -0,0 +1,1007 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Switchtec core library functions for eye data files and metrics
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+#include "switchtec/switchtec.h"
+#include "switchtec/eye.h"
+#include "switchtec/endian.h"
+#include "switchtec/errors.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/**
+ * @defgroup EyeFile Eye Data Files
+ * @brief Store eye captures compactly and read them back quickly
+ *
+ * switchtec_eye_writer_open() and switchtec_eye_writer_add() write the
+ * lanes of a capture to a file one at a time as they complete, so a
+ * capture loop never has to hold more than one lane.
+ * switchtec_eye_file_open() maps such a file into memory and
+ * switchtec_eye_file_pixels() decodes any of its lanes on demand.
+ *
+ * @{
+ */
+
+#define EYE_RLE_RUN		(1U << 31)
+#define EYE_RLE_MAX		(EYE_RLE_RUN - 1)
+#define EYE_RLE_MIN_RUN		3
+
+#define EYE_ALIGN(x)		(((x) + 7) & ~(size_t)7)
+
+struct switchtec_eye_writer {
+	FILE *f;
+	unsigned flags;
+	long start;		//!< offset of the file header, -1 if unknown
+	uint32_t nr_lanes;
+
+	uint32_t *words;	//!< lane data as little endian words
+	uint32_t *enc;		//!< run-length encoded lane data
+	size_t cap;		//!< words that fit into words and enc
+};
+
+struct switchtec_eye_file {
+	const uint8_t *map;
+	size_t len;
+	int mapped;
+
+	const struct switchtec_eye_file_hdr *hdr;
+	size_t *lanes;		//!< offsets of the lane headers
+	int nr_lanes;
+};
+
+union eye_float_word {
+	float f;
+	uint32_t u;
+};
+
+/*
+ * Both functions return the number of words written to out, which must
+ * have room for n + 1 words (encoding) or expect words (decoding).
+ * Decoding returns -1 if the data does not decode to exactly that many.
+ */
+static size_t eye_rle_encode(const uint32_t *in, size_t n, uint32_t *out)
+{
+	size_t i = 0, lit = 0, o = 0, run;
+
+	while (i < n) {
+		for (run = 1; i + run < n && run < EYE_RLE_MAX &&
+		     in[i + run] == in[i]; run++)
+			;
+
+		if (run < EYE_RLE_MIN_RUN && i - lit < EYE_RLE_MAX) {
+			i += run;
+			continue;
+		}
+
+		if (i > lit) {
+			out[o++] = htole32(i - lit);
+			memcpy(&out[o], &in[lit], (i - lit) * sizeof(*in));
+			o += i - lit;
+		}
+
+		if (run >= EYE_RLE_MIN_RUN) {
+			out[o++] = htole32(EYE_RLE_RUN | run);
+			out[o++] = in[i];
+			i += run;
+		}
+
+		lit = i;
+	}
+
+	if (n > lit) {
+		out[o++] = htole32(n - lit);
+		memcpy(&out[o], &in[lit], (n - lit) * sizeof(*in));
+		o += n - lit;
+	}
+
+	return o;
+}
+
+static int eye_rle_decode(const uint32_t *in, size_t n, uint32_t *out,
+			  size_t expect)
+{
+	size_t i = 0, o = 0, cnt;
+	uint32_t tok;
+
+	while (i < n) {
+		tok = le32toh(in[i++]);
+		cnt = tok & EYE_RLE_MAX;
+
+		if (tok & EYE_RLE_RUN) {
+			if (i >= n || cnt > expect - o)
+				return -1;
+
+			while (cnt--)
+				out[o++] = in[i];
+			i++;
+		} else {
+			if (cnt > n - i || cnt > expect - o)
+				return -1;
+
+			memcpy(&out[o], &in[i], cnt * sizeof(*in));
+			o += cnt;
+			i += cnt;
+		}
+	}
+
+	return o == expect ? 0 : -1;
+}
+
+static size_t eye_data_words(enum switchtec_eye_data_type type,
+			     size_t nr_pixels)
+{
+	return type == SWITCHTEC_EYE_DATA_RAW ? nr_pixels * 4 : nr_pixels;
+}
+
+/**
+ * @brief Start writing an eye data file
+ * @param[in] f		File to write to
+ * @param[in] info	Settings of the capture
+ * @param[in] flags	enum switchtec_eye_writer_flags
+ * @return The writer on success, NULL on failure
+ *
+ * The file header is written right away and every lane as it is added.
+ * If \p f is seekable, the number of lanes is filled into the header by
+ * switchtec_eye_writer_close(), otherwise readers count them. The file
+ * is not closed by the writer.
+ */
+struct switchtec_eye_writer *
+switchtec_eye_writer_open(FILE *f, const struct switchtec_eye_capture_info *info,
+			  unsigned flags)
+{
+	const struct switchtec_diag_eye_params *p = &info->params;
+	struct switchtec_eye_file_hdr hdr = {
+		.version = htole32(SWITCHTEC_EYE_FILE_VERSION),
+		.hdr_size = htole32(sizeof(hdr)),
+		.lane_hdr_size = htole32(sizeof(struct switchtec_eye_lane_hdr)),
+		.gen = htole32(info->gen),
+		.interval_ms = htole32(info->interval_ms),
+		.capture_depth = htole32(p->capture_depth),
+		.sar_sel = htole32(p->sar_sel),
+		.intleav_sel = htole32(p->intleav_sel),
+		.hstep = htole32(p->hstep),
+		.data_mode = htole32(p->data_mode),
+		.eye_mode = htole32(p->eye_mode),
+		.vstep = htole32(p->vstep),
+		.refclk = htole64(p->refclk),
+	};
+	struct switchtec_eye_writer *w;
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return NULL;
+
+	w->f = f;
+	w->flags = flags;
+	w->start = ftell(f);
+
+	memcpy(hdr.magic, SWITCHTEC_EYE_FILE_MAGIC, sizeof(hdr.magic));
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+		free(w);
+		return NULL;
+	}
+
+	return w;
+}
+
+static int eye_writer_reserve(struct switchtec_eye_writer *w, size_t words)
+{
+	uint32_t *buf;
+
+	if (words + 1 <= w->cap)
+		return 0;
+
+	buf = realloc(w->words, words * sizeof(*buf));
+	if (!buf)
+		return -1;
+	w->words = buf;
+
+	buf = realloc(w->enc, (words + 1) * sizeof(*buf));
+	if (!buf)
+		return -1;
+	w->enc = buf;
+
+	w->cap = words + 1;
+	return 0;
+}
+
+static int eye_writer_put(struct switchtec_eye_writer *w,
+			  const struct switchtec_eye_lane *lane,
+			  enum switchtec_eye_data_type type, size_t words)
+{
+	static const uint8_t pad[8];
+	struct switchtec_eye_lane_hdr hdr = {
+		.data_type = htole16(type),
+		.encoding = htole16(SWITCHTEC_EYE_ENC_NONE),
+		.port_id = htole16(lane->port_id),
+		.lane_id = htole16(lane->lane_id),
+		.switch_lane = htole16(lane->switch_lane),
+		.link_gen = htole16(lane->link_gen),
+		.x_start = htole16(lane->x.start),
+		.x_end = htole16(lane->x.end),
+		.x_step = htole16(lane->x.step),
+		.y_start = htole16(lane->y.start),
+		.y_end = htole16(lane->y.end),
+		.y_step = htole16(lane->y.step),
+		.nr_pixels = htole32(lane->nr_pixels),
+	};
+	const uint32_t *data = w->words;
+	size_t len;
+
+	if (w->flags & SWITCHTEC_EYE_WRITER_COMPRESS) {
+		len = eye_rle_encode(w->words, words, w->enc);
+		if (len < words) {
+			hdr.encoding = htole16(SWITCHTEC_EYE_ENC_RLE);
+			data = w->enc;
+			words = len;
+		}
+	}
+
+	len = words * sizeof(*data);
+	hdr.data_size = htole32(len);
+
+	if (fwrite(&hdr, sizeof(hdr), 1, w->f) != 1 ||
+	    fwrite(data, sizeof(*data), words, w->f) != words ||
+	    fwrite(pad, 1, EYE_ALIGN(len) - len, w->f) != EYE_ALIGN(len) - len)
+		return -1;
+
+	w->nr_lanes++;
+	return 0;
+}
+
+static int eye_lane_check(const struct switchtec_eye_lane *lane)
+{
+	if (lane->x.step <= 0 || lane->y.step <= 0 ||
+	    lane->x.end < lane->x.start || lane->y.end < lane->y.start ||
+	    lane->nr_pixels != (size_t)RANGE_CNT(&lane->x) * RANGE_CNT(&lane->y)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Add a lane of BER or ratio pixels to an eye data file
+ * @param[in] w		Eye data file writer
+ * @param[in] lane	Lane the pixels belong to
+ * @param[in] pixels	lane->nr_pixels pixels, x major within y
+ * @return 0 on success, -1 on failure
+ *
+ * Pixels are stored as float32.
+ */
+int switchtec_eye_writer_add(struct switchtec_eye_writer *w,
+			     const struct switchtec_eye_lane *lane,
+			     const double *pixels)
+{
+	union eye_float_word v;
+	size_t i;
+
+	if (eye_lane_check(lane) || eye_writer_reserve(w, lane->nr_pixels))
+		return -1;
+
+	for (i = 0; i < lane->nr_pixels; i++) {
+		v.f = pixels[i];
+		w->words[i] = htole32(v.u);
+	}
+
+	return eye_writer_put(w, lane, SWITCHTEC_EYE_DATA_FLOAT32,
+			      lane->nr_pixels);
+}
+
+/**
+ * @brief Add a lane of raw error and sample counts to an eye data file
+ * @param[in] w		Eye data file writer
+ * @param[in] lane	Lane the counts belong to
+ * @param[in] errors	lane->nr_pixels error counts, x major within y
+ * @param[in] samples	lane->nr_pixels sample counts, x major within y
+ * @return 0 on success, -1 on failure
+ */
+int switchtec_eye_writer_add_raw(struct switchtec_eye_writer *w,
+				 const struct switchtec_eye_lane *lane,
+				 const uint64_t *errors,
+				 const uint64_t *samples)
+{
+	size_t i, n = lane->nr_pixels;
+
+	if (eye_lane_check(lane) || eye_writer_reserve(w, n * 4))
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		w->words[i] = htole32(errors[i]);
+		w->words[n + i] = htole32(errors[i] >> 32);
+		w->words[2 * n + i] = htole32(samples[i]);
+		w->words[3 * n + i] = htole32(samples[i] >> 32);
+	}
+
+	return eye_writer_put(w, lane, SWITCHTEC_EYE_DATA_RAW, n * 4);
+}
+
+/**
+ * @brief Finish an eye data file
+ * @param[in] w		Eye data file writer
+ * @return 0 on success, -1 on failure
+ *
+ * The writer is freed even on failure, the file is left open.
+ */
+int switchtec_eye_writer_close(struct switchtec_eye_writer *w)
+{
+	uint32_t nr_lanes = htole32(w->nr_lanes);
+	int ret = 0;
+	long end;
+
+	end = ftell(w->f);
+	if (w->start >= 0 && end >= 0 &&
+	    !fseek(w->f, w->start + offsetof(struct switchtec_eye_file_hdr,
+					     nr_lanes), SEEK_SET)) {
+		if (fwrite(&nr_lanes, sizeof(nr_lanes), 1, w->f) != 1)
+			ret = -1;
+		if (fseek(w->f, end, SEEK_SET))
+			ret = -1;
+	}
+
+	if (fflush(w->f))
+		ret = -1;
+
+	free(w->words);
+	free(w->enc);
+	free(w);
+	return ret;
+}
+
+static int eye_file_load(struct switchtec_eye_file *f, const char *path)
+{
+#ifdef __linux__
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st)) {
+		close(fd);
+		return -1;
+	}
+
+	if (!st.st_size) {
+		close(fd);
+		errno = SWITCHTEC_ERR_EYE_FILE_INVAL;
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	f->map = map;
+	f->len = st.st_size;
+	f->mapped = 1;
+	return 0;
+#else
+	uint8_t *buf = NULL, *tmp;
+	size_t cap = 0, n;
+	FILE *file;
+
+	file = fopen(path, "rb");
+	if (!file)
+		return -1;
+
+	do {
+		tmp = realloc(buf, cap + 65536);
+		if (!tmp) {
+			free(buf);
+			fclose(file);
+			return -1;
+		}
+		buf = tmp;
+
+		n = fread(buf + cap, 1, 65536, file);
+		cap += n;
+	} while (n == 65536);
+
+	fclose(file);
+	f->map = buf;
+	f->len = cap;
+	return 0;
+#endif
+}
+
+static int eye_file_index(struct switchtec_eye_file *f)
+{
+	const struct switchtec_eye_lane_hdr *lane;
+	size_t off, lane_hdr_size, nr_alloc = 0, *tmp;
+
+	if (f->len < sizeof(*f->hdr))
+		goto inval;
+
+	f->hdr = (const void *)f->map;
+	if (memcmp(f->hdr->magic, SWITCHTEC_EYE_FILE_MAGIC,
+		   sizeof(f->hdr->magic)) ||
+	    le32toh(f->hdr->version) != SWITCHTEC_EYE_FILE_VERSION ||
+	    le32toh(f->hdr->hdr_size) < sizeof(*f->hdr) ||
+	    le32toh(f->hdr->lane_hdr_size) < sizeof(*lane))
+		goto inval;
+
+	off = EYE_ALIGN(le32toh(f->hdr->hdr_size));
+	lane_hdr_size = le32toh(f->hdr->lane_hdr_size);
+
+	/* a truncated last lane, e.g. of an interrupted capture, is ignored */
+	while (off + lane_hdr_size <= f->len) {
+		lane = (const void *)(f->map + off);
+		if (le32toh(lane->data_size) > f->len - off - lane_hdr_size)
+			break;
+
+		if (f->nr_lanes == nr_alloc) {
+			nr_alloc = nr_alloc ? nr_alloc * 2 : 64;
+			tmp = realloc(f->lanes, nr_alloc * sizeof(*tmp));
+			if (!tmp)
+				return -1;
+			f->lanes = tmp;
+		}
+
+		f->lanes[f->nr_lanes++] = off;
+		off += EYE_ALIGN(lane_hdr_size + le32toh(lane->data_size));
+	}
+
+	return 0;
+
+inval:
+	errno = SWITCHTEC_ERR_EYE_FILE_INVAL;
+	return -1;
+}
+
+/**
+ * @brief Open an eye data file for reading
+ * @param[in] path	Path of the file
+ * @return The file on success, NULL on failure
+ *
+ * The file is mapped into memory and its lanes are indexed; their data
+ * is only decoded when asked for. It must be closed with
+ * switchtec_eye_file_close().
+ */
+struct switchtec_eye_file *switchtec_eye_file_open(const char *path)
+{
+	struct switchtec_eye_file *f;
+
+	f = calloc(1, sizeof(*f));
+	if (!f)
+		return NULL;
+
+	if (eye_file_load(f, path) || eye_file_index(f)) {
+		switchtec_eye_file_close(f);
+		return NULL;
+	}
+
+	return f;
+}
+
+/**
+ * @brief Close an eye data file
+ * @param[in] f		Eye data file
+ */
+void switchtec_eye_file_close(struct switchtec_eye_file *f)
+{
+	int err = errno;
+
+	if (!f)
+		return;
+
+#ifdef __linux__
+	if (f->mapped)
+		munmap((void *)f->map, f->len);
+#else
+	free((void *)f->map);
+#endif
+
+	free(f->lanes);
+	free(f);
+	errno = err;
+}
+
+/**
+ * @brief Get the settings an eye data file was captured with
+ * @param[in]  f	Eye data file
+ * @param[out] info	Capture settings
+ * @return Number of lanes in the file
+ */
+int switchtec_eye_file_info(struct switchtec_eye_file *f,
+			    struct switchtec_eye_capture_info *info)
+{
+	const struct switchtec_eye_file_hdr *h = f->hdr;
+
+	info->gen = le32toh(h->gen);
+	info->interval_ms = (int32_t)le32toh(h->interval_ms);
+	info->params.capture_depth = (int32_t)le32toh(h->capture_depth);
+	info->params.sar_sel = (int32_t)le32toh(h->sar_sel);
+	info->params.intleav_sel = (int32_t)le32toh(h->intleav_sel);
+	info->params.hstep = (int32_t)le32toh(h->hstep);
+	info->params.data_mode = (int32_t)le32toh(h->data_mode);
+	info->params.eye_mode = (int32_t)le32toh(h->eye_mode);
+	info->params.vstep = (int32_t)le32toh(h->vstep);
+	info->params.refclk = le64toh(h->refclk);
+
+	return f->nr_lanes;
+}
+
+static const struct switchtec_eye_lane_hdr *
+eye_file_lane_hdr(struct switchtec_eye_file *f, int idx)
+{
+	if (idx < 0 || idx >= f->nr_lanes) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return (const void *)(f->map + f->lanes[idx]);
+}
+
+/**
+ * @brief Get a lane of an eye data file
+ * @param[in]  f	Eye data file
+ * @param[in]  idx	Index of the lane in the file
+ * @param[out] lane	The lane
+ * @return 0 on success, -1 on failure
+ *
+ * Fails with SWITCHTEC_ERR_EYE_FILE_INVAL if the ranges of the lane are
+ * empty or do not match its number of pixels.
+ */
+int switchtec_eye_file_lane(struct switchtec_eye_file *f, int idx,
+			    struct switchtec_eye_lane *lane)
+{
+	const struct switchtec_eye_lane_hdr *h;
+
+	h = eye_file_lane_hdr(f, idx);
+	if (!h)
+		return -1;
+
+	lane->port_id = le16toh(h->port_id);
+	lane->lane_id = le16toh(h->lane_id);
+	lane->switch_lane = le16toh(h->switch_lane);
+	lane->link_gen = le16toh(h->link_gen);
+	lane->x.start = (int16_t)le16toh(h->x_start);
+	lane->x.end = (int16_t)le16toh(h->x_end);
+	lane->x.step = (int16_t)le16toh(h->x_step);
+	lane->y.start = (int16_t)le16toh(h->y_start);
+	lane->y.end = (int16_t)le16toh(h->y_end);
+	lane->y.step = (int16_t)le16toh(h->y_step);
+	lane->data_type = le16toh(h->data_type);
+	lane->nr_pixels = le32toh(h->nr_pixels);
+
+	if (eye_lane_check(lane)) {
+		errno = SWITCHTEC_ERR_EYE_FILE_INVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Get the little endian words of a lane, decoding them into a new
+ * buffer if needed. *buf is set to whatever the caller has to free.
+ */
+static const uint32_t *eye_file_words(struct switchtec_eye_file *f, int idx,
+				      enum switchtec_eye_data_type *type,
+				      size_t *nr_pixels, uint32_t **buf)
+{
+	const struct switchtec_eye_lane_hdr *h;
+	const uint32_t *data;
+	size_t words, len;
+
+	*buf = NULL;
+
+	h = eye_file_lane_hdr(f, idx);
+	if (!h)
+		return NULL;
+
+	*type = le16toh(h->data_type);
+	*nr_pixels = le32toh(h->nr_pixels);
+	len = le32toh(h->data_size);
+	data = (const void *)((const uint8_t *)h +
+			      le32toh(f->hdr->lane_hdr_size));
+
+	if (*type != SWITCHTEC_EYE_DATA_FLOAT32 &&
+	    *type != SWITCHTEC_EYE_DATA_RAW)
+		goto inval;
+
+	words = eye_data_words(*type, *nr_pixels);
+
+	switch (le16toh(h->encoding)) {
+	case SWITCHTEC_EYE_ENC_NONE:
+		if (len != words * sizeof(*data))
+			goto inval;
+		return data;
+	case SWITCHTEC_EYE_ENC_RLE:
+		*buf = malloc(words * sizeof(**buf));
+		if (!*buf)
+			return NULL;
+
+		if (eye_rle_decode(data, len / sizeof(*data), *buf, words)) {
+			free(*buf);
+			*buf = NULL;
+			goto inval;
+		}
+		return *buf;
+	}
+
+inval:
+	errno = SWITCHTEC_ERR_EYE_FILE_INVAL;
+	return NULL;
+}
+
+static uint64_t eye_word64(const uint32_t *lo, const uint32_t *hi, size_t i)
+{
+	return (uint64_t)le32toh(hi[i]) << 32 | le32toh(lo[i]);
+}
+
+/**
+ * @brief Get the pixels of a lane of an eye data file
+ * @param[in]  f	Eye data file
+ * @param[in]  idx	Index of the lane in the file
+ * @param[out] pixels	Pixels of the lane, x major within y. Must have
+ *			room for the lane's nr_pixels.
+ * @return Number of pixels on success, -1 on failure
+ *
+ * Raw counts are returned as the ratio of errors to samples, or NaN for
+ * pixels without samples, like switchtec_diag_eye_fetch() does.
+ */
+int switchtec_eye_file_pixels(struct switchtec_eye_file *f, int idx,
+			      double *pixels)
+{
+	enum switchtec_eye_data_type type;
+	const uint32_t *words;
+	union eye_float_word v;
+	uint64_t samples;
+	uint32_t *buf;
+	size_t i, n;
+
+	words = eye_file_words(f, idx, &type, &n, &buf);
+	if (!words)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		if (type == SWITCHTEC_EYE_DATA_FLOAT32) {
+			v.u = le32toh(words[i]);
+			pixels[i] = v.f;
+			continue;
+		}
+
+		samples = eye_word64(&words[2 * n], &words[3 * n], i);
+		if (samples)
+			pixels[i] = (double)eye_word64(words, &words[n], i) /
+				samples;
+		else
+			pixels[i] = nan("");
+	}
+
+	free(buf);
+	return n;
+}
+
+/**
+ * @brief Get the raw counts of a lane of an eye data file
+ * @param[in]  f	Eye data file
+ * @param[in]  idx	Index of the lane in the file
+ * @param[out] errors	Error count of each pixel
+ * @param[out] samples	Sample count of each pixel
+ * @return Number of pixels on success, -1 on failure
+ *
+ * Fails with ENODATA if the lane only holds BER or ratio values.
+ */
+int switchtec_eye_file_raw(struct switchtec_eye_file *f, int idx,
+			   uint64_t *errors, uint64_t *samples)
+{
+	enum switchtec_eye_data_type type;
+	const uint32_t *words;
+	uint32_t *buf;
+	size_t i, n;
+
+	words = eye_file_words(f, idx, &type, &n, &buf);
+	if (!words)
+		return -1;
+
+	if (type != SWITCHTEC_EYE_DATA_RAW) {
+		free(buf);
+		errno = ENODATA;
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		errors[i] = eye_word64(words, &words[n], i);
+		samples[i] = eye_word64(&words[2 * n], &words[3 * n], i);
+	}
+
+	free(buf);
+	return n;
+}
+
+/**@}*/
+
+/**
+ * @defgroup EyeMetrics Eye Metrics
+ * @brief Measure the opening of captured eyes
+ *
+ * These work on the pixel grids returned by switchtec_diag_eye_fetch()
+ * and switchtec_diag_eye_read(): one row of RANGE_CNT(X) pixels per Y
+ * value. Each grid is first reduced to a byte mask in one pass over
+ * contiguous memory, then the rows of the mask are scanned for runs, so
+ * hundreds of lanes take milliseconds and may be checked as they are
+ * captured.
+ *
+ * @{
+ */
+
+struct eye_scan {
+	int nx, ny;
+	uint8_t *mask;
+	int *run_start;		//!< start of the longest run of each row
+	int *run_len;		//!< length of the longest run of each row
+
+	/* the eye found by eye_scan_find(), as indexes into the grid */
+	int cx, cy;
+	int y0, y1;		//!< first and last row of the eye
+};
+
+static int eye_scan_init(struct eye_scan *s, const struct range *X,
+			 const struct range *Y)
+{
+	if (X->step <= 0 || Y->step <= 0 || X->end < X->start ||
+	    Y->end < Y->start) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	s->nx = RANGE_CNT(X);
+	s->ny = RANGE_CNT(Y);
+	s->mask = malloc((size_t)s->nx * s->ny);
+	s->run_start = malloc(s->ny * sizeof(*s->run_start));
+	s->run_len = malloc(s->ny * sizeof(*s->run_len));
+
+	if (!s->mask || !s->run_start || !s->run_len) {
+		free(s->mask);
+		free(s->run_start);
+		free(s->run_len);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void eye_scan_free(struct eye_scan *s)
+{
+	free(s->mask);
+	free(s->run_start);
+	free(s->run_len);
+}
+
+/*
+ * Find the eye: mask the pixels at or below ber (NaN, i.e. no samples,
+ * is outside), center it on the middle of the widest row and grow it up
+ * and down from there. Returns 0 if no pixel is inside.
+ */
+static int eye_scan_find(struct eye_scan *s, const double *pixels,
+			 double ber)
+{
+	size_t i, n = (size_t)s->nx * s->ny;
+	int x, y, run, len, start, best = 0, first = 0, last = 0, mid, d;
+	const uint8_t *row;
+	uint8_t *mask = s->mask;
+
+	/* no branches, so the compiler can vectorize this */
+	for (i = 0; i < n; i++)
+		mask[i] = pixels[i] <= ber;
+
+	for (y = 0; y < s->ny; y++) {
+		row = &mask[y * s->nx];
+		run = len = start = 0;
+
+		for (x = 0; x < s->nx; x++) {
+			run = row[x] ? run + 1 : 0;
+			if (run > len) {
+				len = run;
+				start = x - run + 1;
+			}
+		}
+
+		s->run_start[y] = start;
+		s->run_len[y] = len;
+
+		if (len > best) {
+			best = len;
+			first = last = y;
+		} else if (len && len == best) {
+			last = y;
+		}
+	}
+
+	if (!best)
+		return 0;
+
+	/* of the widest rows, take the one nearest the middle of them */
+	mid = (first + last) / 2;
+	for (d = 0; ; d++) {
+		if (mid - d >= first && s->run_len[mid - d] == best) {
+			s->cy = mid - d;
+			break;
+		}
+		if (mid + d <= last && s->run_len[mid + d] == best) {
+			s->cy = mid + d;
+			break;
+		}
+	}
+
+	s->cx = s->run_start[s->cy] + (best - 1) / 2;
+
+	for (s->y0 = s->cy; s->y0 > 0 &&
+	     mask[(s->y0 - 1) * s->nx + s->cx]; s->y0--)
+		;
+	for (s->y1 = s->cy; s->y1 < s->ny - 1 &&
+	     mask[(s->y1 + 1) * s->nx + s->cx]; s->y1++)
+		;
+
+	return 1;
+}
+
+/* Get the edges of the run of a row of the eye through the center */
+static void eye_scan_row(struct eye_scan *s, int y, int *left, int *right)
+{
+	const uint8_t *row = &s->mask[y * s->nx];
+	int l = s->cx, r = s->cx;
+
+	while (l > 0 && row[l - 1])
+		l--;
+	while (r < s->nx - 1 && row[r + 1])
+		r++;
+
+	*left = l;
+	*right = r;
+}
+
+static void eye_scan_metrics(struct eye_scan *s, const double *pixels,
+			     const struct range *X, const struct range *Y,
+			     double ber, struct switchtec_eye_metrics *m)
+{
+	int y, l, r, cl = 0, cr = 0;
+	size_t area = 0;
+
+	memset(m, 0, sizeof(*m));
+	m->ber = ber;
+
+	if (!eye_scan_find(s, pixels, ber))
+		return;
+
+	for (y = s->y0; y <= s->y1; y++) {
+		eye_scan_row(s, y, &l, &r);
+		area += r - l + 1;
+		if (y == s->cy) {
+			cl = l;
+			cr = r;
+		}
+	}
+
+	m->open = 1;
+	m->center_x = X->start + s->cx * X->step;
+	m->center_y = Y->start + s->cy * Y->step;
+	m->width = (cr - cl + 1) * X->step;
+	m->height = (s->y1 - s->y0 + 1) * Y->step;
+	m->left = (s->cx - cl) * X->step;
+	m->right = (cr - s->cx) * X->step;
+	m->top = (s->y1 - s->cy) * Y->step;
+	m->bottom = (s->cy - s->y0) * Y->step;
+	m->area = (double)area * X->step * Y->step;
+	m->center_ber = pixels[s->cy * s->nx + s->cx];
+}
+
+/**
+ * @brief Measure the opening of eyes at BER thresholds
+ * @param[in]  pixels	Pixels of nr_lanes lanes, one after another,
+ *			x major within y
+ * @param[in]  nr_lanes	Number of lanes
+ * @param[in]  X	Time (Gen4) or phase range of the pixels
+ * @param[in]  Y	Voltage (Gen4) or bin range of the pixels
+ * @param[in]  ber	BER thresholds to measure at
+ * @param[in]  nr_ber	Number of thresholds
+ * @param[out] metrics	nr_lanes * nr_ber results, all thresholds of the
+ *			first lane first
+ * @return 0 on success, -1 on failure
+ */
+int switchtec_eye_metrics(const double *pixels, int nr_lanes,
+			  const struct range *X, const struct range *Y,
+			  const double *ber, int nr_ber,
+			  struct switchtec_eye_metrics *metrics)
+{
+	struct eye_scan s;
+	size_t stride;
+	int l, b;
+
+	if (eye_scan_init(&s, X, Y))
+		return -1;
+
+	stride = (size_t)s.nx * s.ny;
+	for (l = 0; l < nr_lanes; l++)
+		for (b = 0; b < nr_ber; b++)
+			eye_scan_metrics(&s, &pixels[l * stride], X, Y, ber[b],
+					 &metrics[l * nr_ber + b]);
+
+	eye_scan_free(&s);
+	return 0;
+}
+
+/**
+ * @brief Get the contour of an eye at a BER threshold
+ * @param[in]  pixels	Pixels of the lane, x major within y
+ * @param[in]  X	Time (Gen4) or phase range of the pixels
+ * @param[in]  Y	Voltage (Gen4) or bin range of the pixels
+ * @param[in]  ber	BER threshold
+ * @param[out] rows	Rows of the eye from the lowest Y value up. Must
+ *			have room for RANGE_CNT(Y) rows.
+ * @return Number of rows on success, 0 if the eye is closed, -1 on
+ *	   failure
+ *
+ * Each row holds the edges of the opening around the center found by
+ * switchtec_eye_metrics().
+ */
+int switchtec_eye_contour(const double *pixels, const struct range *X,
+			  const struct range *Y, double ber,
+			  struct switchtec_eye_contour_row *rows)
+{
+	struct eye_scan s;
+	int y, l, r, n = 0;
+
+	if (eye_scan_init(&s, X, Y))
+		return -1;
+
+	if (eye_scan_find(&s, pixels, ber)) {
+		for (y = s.y0; y <= s.y1; y++, n++) {
+			eye_scan_row(&s, y, &l, &r);
+			rows[n].y = Y->start + y * Y->step;
+			rows[n].left = X->start + l * X->step;
+			rows[n].right = X->start + r * X->step;
+		}
+	}
+
+	eye_scan_free(&s);
+	return n;
+}
+
+/**@}*/
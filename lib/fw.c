@@ -40,6 +40,7 @@
 #include <sys/time.h>
 
 #include <errno.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -610,6 +611,9 @@ static int switchtec_cmd_nopoll(struct switchtec_dev *dev, uint32_t cmd_id,
 {
 	struct mrpc_regs __gas *mrpc = &dev->gas_map->mrpc;
 
+	/* only used for toggles, which bypass switchtec_cmd() */
+	switchtec_fw_part_summary_invalidate(dev);
+
 	__memcpy_to_gas(dev, &mrpc->input_data, payload, payload_len);
 	__gas_write32_no_retry(dev, cmd_id, &mrpc->cmd);
 	return 0;
@@ -779,6 +783,8 @@ int switchtec_fw_write_fd(struct switchtec_dev *dev, int img_fd,
 	uint32_t cmd_id = MRPC_FWDNLD;
 	gasptr_t gas_map;
 
+	switchtec_fw_part_summary_invalidate(dev);
+
 	if (switchtec_boot_phase(dev) != SWITCHTEC_BOOT_PHASE_FW)
 		cmd_id = get_fw_tx_id(dev);
 
@@ -923,6 +929,8 @@ int switchtec_fw_write_file(struct switchtec_dev *dev, FILE *fimg,
 	uint32_t cmd_id = MRPC_FWDNLD;
 	gasptr_t gas_map;
 
+	switchtec_fw_part_summary_invalidate(dev);
+
 	if (switchtec_boot_phase(dev) != SWITCHTEC_BOOT_PHASE_FW)
 		cmd_id = get_fw_tx_id(dev);
 
@@ -1484,33 +1492,47 @@ const char *switchtec_fw_image_type(const struct switchtec_fw_image_info *info)
 	}
 }
 
-static int switchtec_fw_map_get_active(struct switchtec_dev *dev,
-				       struct switchtec_fw_image_info *info)
-{
+/*
+ * State shared by all gen3 partitions. It is read once per summary
+ * rather than once per partition.
+ */
+struct switchtec_flash_info_gen3 {
+	int boot_ro;
 	uint32_t map0_update_index;
 	uint32_t map1_update_index;
+};
+
+static int switchtec_fw_info_gen3(struct switchtec_dev *dev,
+				  struct switchtec_flash_info_gen3 *all)
+{
 	int ret;
 
+	all->boot_ro = switchtec_fw_is_boot_ro(dev);
+
 	ret = switchtec_fw_read(dev, SWITCHTEC_FLASH_MAP0_PART_START,
-				sizeof(uint32_t), &map0_update_index);
+				sizeof(uint32_t), &all->map0_update_index);
 	if (ret < 0)
 		return ret;
 
 	ret = switchtec_fw_read(dev, SWITCHTEC_FLASH_MAP1_PART_START,
-				sizeof(uint32_t), &map1_update_index);
+				sizeof(uint32_t), &all->map1_update_index);
 	if (ret < 0)
 		return ret;
 
+	return 0;
+}
+
+static void switchtec_fw_map_get_active(struct switchtec_fw_image_info *info,
+					struct switchtec_flash_info_gen3 *all)
+{
 	info->active = 0;
-	if (map0_update_index > map1_update_index) {
+	if (all->map0_update_index > all->map1_update_index) {
 		if (info->part_addr == SWITCHTEC_FLASH_MAP0_PART_START)
 			info->active = 1;
 	} else {
 		if (info->part_addr == SWITCHTEC_FLASH_MAP1_PART_START)
 			info->active = 1;
 	}
-
-	return 0;
 }
 
 static int switchtec_fw_info_metadata_gen3(struct switchtec_dev *dev,
@@ -1551,11 +1573,12 @@ err_out:
 }
 
 static int switchtec_fw_part_info_gen3(struct switchtec_dev *dev,
-				       struct switchtec_fw_image_info *inf)
+				       struct switchtec_fw_image_info *inf,
+				       struct switchtec_flash_info_gen3 *all)
 {
 	int ret = 0;
 
-	inf->read_only = switchtec_fw_is_boot_ro(dev);
+	inf->read_only = all->boot_ro;
 
 	switch (inf->part_id) {
 		case SWITCHTEC_FW_PART_ID_G3_BOOT:
@@ -1566,12 +1589,12 @@ static int switchtec_fw_part_info_gen3(struct switchtec_dev *dev,
 		case SWITCHTEC_FW_PART_ID_G3_MAP0:
 			inf->part_addr = SWITCHTEC_FLASH_MAP0_PART_START;
 			inf->part_len = SWITCHTEC_FLASH_PART_LEN;
-			ret = switchtec_fw_map_get_active(dev, inf);
+			switchtec_fw_map_get_active(inf, all);
 			break;
 		case SWITCHTEC_FW_PART_ID_G3_MAP1:
 			inf->part_addr = SWITCHTEC_FLASH_MAP1_PART_START;
 			inf->part_len = SWITCHTEC_FLASH_PART_LEN;
-			ret = switchtec_fw_map_get_active(dev, inf);
+			switchtec_fw_map_get_active(inf, all);
 			break;
 		default:
 			ret = switchtec_flash_part(dev, inf, inf->part_id);
@@ -2063,6 +2086,7 @@ static int switchtec_fw_part_info(struct switchtec_dev *dev, int nr_info,
 	int ret;
 	int i;
 	uint8_t subcmd = MRPC_PART_INFO_GET_ALL_INFO;
+	struct switchtec_flash_info_gen3 all_info_gen3;
 	struct switchtec_flash_info_gen4 all_info_gen4;
 	struct switchtec_flash_info_gen5 all_info_gen5;
 	struct switchtec_flash_info_gen6 all_info_gen6;
@@ -2070,7 +2094,11 @@ static int switchtec_fw_part_info(struct switchtec_dev *dev, int nr_info,
 	if (info == NULL || nr_info == 0)
 		return -EINVAL;
 
-	if (dev->gen == SWITCHTEC_GEN4) {
+	if (dev->gen == SWITCHTEC_GEN3) {
+		ret = switchtec_fw_info_gen3(dev, &all_info_gen3);
+		if (ret)
+			return ret;
+	} else if (dev->gen == SWITCHTEC_GEN4) {
 		ret = switchtec_cmd(dev, MRPC_PART_INFO, &subcmd,
 				    sizeof(subcmd), &all_info_gen4,
 				    sizeof(all_info_gen4));
@@ -2116,7 +2144,8 @@ static int switchtec_fw_part_info(struct switchtec_dev *dev, int nr_info,
 
 		switch (info->gen) {
 		case SWITCHTEC_GEN3:
-			ret = switchtec_fw_part_info_gen3(dev, inf);
+			ret = switchtec_fw_part_info_gen3(dev, inf,
+							  &all_info_gen3);
 			break;
 		case SWITCHTEC_GEN4:
 			ret = switchtec_fw_part_info_gen4(dev, inf,
@@ -2376,14 +2405,6 @@ switchtec_fw_type_ptr(struct switchtec_fw_part_summary *summary,
 	}
 }
 
-/**
- * @brief Return firmware summary information structure for the flash
- *	partitfons in the device
- * @param[in]  dev	Switchtec device handle
- *	\p nr_info entries
- * @return pointer to the structure on success, NULL on error. Free the
- *	the structure with \ref switchtec_fw_part_summary_free.
- */
 int switchtec_sms_fmc_version_get(struct switchtec_dev *dev, uint32_t *info)
 {
 	uint32_t cmd = htole32(MRPC_PART_INFO_GET_SMS_FMC_VERSION_GEN6);
@@ -2404,12 +2425,88 @@ int switchtec_sms_fmc_version_get(struct switchtec_dev *dev, uint32_t *info)
 	return 0;
 }
 
-struct switchtec_fw_part_summary *
-switchtec_fw_part_summary(struct switchtec_dev *dev)
+static int switchtec_fw_summary_link(struct switchtec_fw_part_summary *summary,
+				     int nr_mcfg)
 {
-	struct switchtec_fw_part_summary *summary;
 	struct switchtec_fw_image_info **infp;
 	struct switchtec_fw_part_type *type;
+	int nr_info = summary->nr_info;
+	int i;
+
+	for (i = 0; i < nr_info; i++) {
+		type = switchtec_fw_type_ptr(summary, &summary->all[i]);
+		if (type == NULL)
+			return -1;
+		if (summary->all[i].active)
+			type->active = &summary->all[i];
+		else
+			type->inactive = &summary->all[i];
+	}
+
+	infp = &summary->mult_cfg;
+	for (; i < nr_info + nr_mcfg; i++) {
+		*infp = &summary->all[i];
+		infp = &summary->all[i].next;
+	}
+
+	return 0;
+}
+
+static size_t switchtec_fw_metadata_size(enum switchtec_gen gen)
+{
+	switch (gen) {
+	case SWITCHTEC_GEN3:	return sizeof(struct switchtec_fw_footer_gen3);
+	case SWITCHTEC_GEN4:	return sizeof(struct switchtec_fw_metadata_gen4);
+	case SWITCHTEC_GEN5:	return sizeof(struct switchtec_fw_metadata_gen5);
+	case SWITCHTEC_GEN6:	return sizeof(struct switchtec_fw_metadata_gen6);
+	default:		return 0;
+	}
+}
+
+static struct switchtec_fw_part_summary *
+switchtec_fw_summary_dup(struct switchtec_dev *dev)
+{
+	struct switchtec_fw_part_summary *summary;
+	struct switchtec_fw_image_info *inf;
+	size_t md_sz;
+	int i;
+
+	summary = malloc(dev->fw_summary_size);
+	if (!summary)
+		return NULL;
+
+	memcpy(summary, dev->fw_summary, dev->fw_summary_size);
+	memset(summary, 0, offsetof(struct switchtec_fw_part_summary, nr_info));
+
+	for (i = 0; i < summary->nr_info + dev->fw_summary_nr_mcfg; i++)
+		summary->all[i].next = NULL;
+
+	switchtec_fw_summary_link(summary, dev->fw_summary_nr_mcfg);
+
+	for (i = 0; i < summary->nr_info; i++) {
+		inf = &summary->all[i];
+		if (!inf->metadata)
+			continue;
+
+		md_sz = switchtec_fw_metadata_size(inf->gen);
+		inf->metadata = malloc(md_sz);
+		if (!inf->metadata) {
+			summary->nr_info = i;
+			switchtec_fw_part_summary_free(summary);
+			return NULL;
+		}
+
+		memcpy(inf->metadata, dev->fw_summary->all[i].metadata, md_sz);
+	}
+
+	return summary;
+}
+
+static struct switchtec_fw_part_summary *
+switchtec_fw_summary_read(struct switchtec_dev *dev, size_t *st_sz_out,
+			  int *nr_mcfg_out)
+{
+	struct switchtec_fw_part_summary *summary;
 	int nr_info, nr_mcfg = 16;
 	size_t st_sz;
 	int ret, i;
@@ -2480,27 +2577,70 @@ switchtec_fw_part_summary(struct switchtec_dev *dev)
 		errno = 0;
 	}
 
-	for (i = 0; i < nr_info; i++) {
-		type = switchtec_fw_type_ptr(summary, &summary->all[i]);
-		if (type == NULL) {
-			free(summary);
-			return NULL;
-		}
-		if (summary->all[i].active)
-			type->active = &summary->all[i];
-		else
-			type->inactive = &summary->all[i];
+	ret = switchtec_fw_summary_link(summary, nr_mcfg);
+	if (ret) {
+		switchtec_fw_part_summary_free(summary);
+		return NULL;
 	}
 
-	infp = &summary->mult_cfg;
-	for (; i < nr_info + nr_mcfg; i++) {
-		*infp = &summary->all[i];
-		infp = &summary->all[i].next;
-	}
+	*st_sz_out = st_sz;
+	*nr_mcfg_out = nr_mcfg;
 
 	return summary;
 }
 
+/**
+ * @brief Return firmware summary information structure for the flash
+ *	partitions in the device
+ * @param[in]  dev	Switchtec device handle
+ * @return pointer to the structure on success, NULL on error. Free the
+ *	the structure with \ref switchtec_fw_part_summary_free.
+ *
+ * The partition information is read from the device the first time this
+ * is called and kept on the device handle. Later calls return a copy of
+ * the cached summary without issuing any MRPC commands until the cache
+ * is dropped by a firmware download, partition toggle, reset or an
+ * explicit call to switchtec_fw_part_summary_invalidate().
+ */
+struct switchtec_fw_part_summary *
+switchtec_fw_part_summary(struct switchtec_dev *dev)
+{
+	struct switchtec_fw_part_summary *summary;
+	size_t st_sz;
+	int nr_mcfg;
+
+	if (!dev->fw_summary) {
+		summary = switchtec_fw_summary_read(dev, &st_sz, &nr_mcfg);
+		if (!summary)
+			return NULL;
+
+		dev->fw_summary = summary;
+		dev->fw_summary_size = st_sz;
+		dev->fw_summary_nr_mcfg = nr_mcfg;
+	}
+
+	return switchtec_fw_summary_dup(dev);
+}
+
+/**
+ * @brief Drop the firmware partition summary cached on a device handle
+ * @param[in]  dev	Switchtec device handle
+ *
+ * The library does this itself whenever it sends a command that may
+ * change the flash partitions. Callers only need this if the partitions
+ * may have been changed through another handle or process.
+ */
+void switchtec_fw_part_summary_invalidate(struct switchtec_dev *dev)
+{
+	if (!dev->fw_summary)
+		return;
+
+	switchtec_fw_part_summary_free(dev->fw_summary);
+	dev->fw_summary = NULL;
+	dev->fw_summary_size = 0;
+	dev->fw_summary_nr_mcfg = 0;
+}
+
 /**
  * @brief Free a firmware part summary data structure
  * @param[in]  summary	The data structure to free.
@@ -0,0 +1,424 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Switchtec core library functions for link health sweeps
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+#include "switchtec/switchtec.h"
+#include "switchtec/health.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/**
+ * @defgroup Health Link Health
+ * @brief Rank the links of a switch by how unhealthy they look
+ *
+ * switchtec_health_sweep() reads the port status once and then, as far
+ * as the time budget allows, counts link errors over a window, reads
+ * the LTSSM log of each port and reads the receiver objects of the
+ * least healthy links. The LTSSM logs are read while the error window
+ * runs, and ports that already look degraded are read first, followed
+ * by the remaining links that are up, so a tight budget still covers
+ * the links most likely to matter before any empty slots.
+ *
+ * Each port gets a score that grows with:
+ * - the link being down (100), if it is an upstream port or the LTSSM
+ *   log shows the link was up before; empty slots are not scored
+ * - missing lanes (up to 50, in proportion to the configured width)
+ * - a link rate below the one the caller expects (10 per generation)
+ * - link errors (10 * log10(1 + events per second), weighted by event)
+ * - retrains (5 each, at most 50) and link downs (20 each, at most 60)
+ *   found in the LTSSM log
+ *
+ * @{
+ */
+
+/**
+ * @brief Events counted by a health sweep, most important first
+ *
+ * If the switch cannot count all of them for every port, the sweep
+ * counts as many as it can from the start of this list.
+ */
+const enum switchtec_evcntr_type_mask
+switchtec_health_events[SWITCHTEC_HEALTH_NR_EVENTS] = {
+	RCVR_ERR,
+	BAD_TLP,
+	BAD_DLLP,
+	REPLAY_TMR_TIMEOUT,
+	DATA_LINK_PROTO_ERR,
+	SURPRISE_DOWN_ERR,
+	REPLAY_NUM_ROLLOVER,
+	NAK_RCVD,
+};
+
+static const double health_event_weight[SWITCHTEC_HEALTH_NR_EVENTS] = {
+	1, 1, 1, 1, 3, 3, 2, 1,
+};
+
+struct health_sweep {
+	struct switchtec_dev *dev;
+	struct switchtec_health_cfg cfg;
+	struct switchtec_health_report *report;
+	uint64_t deadline_us;
+};
+
+static uint64_t health_now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static int health_over_budget(struct health_sweep *h)
+{
+	if (!h->deadline_us || health_now_us() < h->deadline_us)
+		return 0;
+
+	h->report->budget_exceeded = 1;
+	return 1;
+}
+
+/*
+ * A down port only matters if a link is expected there: the upstream
+ * port always carries one, other ports only once the LTSSM log shows
+ * they trained at some point. Anything else is treated as an empty slot.
+ */
+static int health_link_expected(const struct switchtec_health_port *p)
+{
+	return p->port.upstream || p->retrains || p->link_downs;
+}
+
+static void health_score(struct switchtec_health_port *p)
+{
+	int i;
+
+	p->score = 0;
+	p->issues = 0;
+
+	if (!p->link_up) {
+		if (health_link_expected(p)) {
+			p->issues |= SWITCHTEC_HEALTH_LINK_DOWN;
+			p->score += 100;
+		}
+	} else {
+		if (p->neg_width < p->cfg_width) {
+			p->issues |= SWITCHTEC_HEALTH_WIDTH;
+			p->score += 50.0 * (p->cfg_width - p->neg_width) /
+				p->cfg_width;
+		}
+
+		if (p->expected_rate && p->link_rate < p->expected_rate) {
+			p->issues |= SWITCHTEC_HEALTH_SPEED;
+			p->score += 10 * (p->expected_rate - p->link_rate);
+		}
+	}
+
+	for (i = 0; i < SWITCHTEC_HEALTH_NR_EVENTS; i++) {
+		if (!p->errors[i])
+			continue;
+
+		p->issues |= SWITCHTEC_HEALTH_ERRORS;
+		p->score += health_event_weight[i] * 10 *
+			log10(1 + p->error_rates[i]);
+	}
+
+	if (p->retrains) {
+		p->issues |= SWITCHTEC_HEALTH_RETRAINS;
+		p->score += p->retrains < 10 ? 5 * p->retrains : 50;
+	}
+
+	if (p->link_downs) {
+		p->issues |= SWITCHTEC_HEALTH_FLAPS;
+		p->score += p->link_downs < 3 ? 20 * p->link_downs : 60;
+	}
+}
+
+static int health_cmp(const void *a, const void *b)
+{
+	const struct switchtec_health_port *pa = a, *pb = b;
+
+	if (pa->score != pb->score)
+		return pa->score < pb->score ? 1 : -1;
+
+	if (pa->link_up != pb->link_up)
+		return pb->link_up - pa->link_up;
+
+	return pa->port.phys_id - pb->port.phys_id;
+}
+
+static int health_read_status(struct health_sweep *h)
+{
+	struct switchtec_health_report *r = h->report;
+	struct switchtec_health_port *p;
+	struct switchtec_status *status;
+	int nr_status, i;
+
+	nr_status = switchtec_status(h->dev, &status);
+	if (nr_status < 0)
+		return -1;
+
+	r->ports = calloc(nr_status, sizeof(*r->ports));
+	if (!r->ports) {
+		switchtec_status_free(status, nr_status);
+		return -1;
+	}
+
+	for (i = 0; i < nr_status; i++) {
+		p = &r->ports[i];
+		p->port = status[i].port;
+		p->link_up = status[i].link_up;
+		p->cfg_width = status[i].cfg_lnk_width;
+		p->neg_width = status[i].neg_lnk_width;
+		p->link_rate = status[i].link_rate;
+		p->expected_rate = h->cfg.expected_rate;
+		health_score(p);
+	}
+	r->nr_ports = nr_status;
+
+	switchtec_status_free(status, nr_status);
+
+	/* so that the LTSSM logs of suspect ports are read first */
+	qsort(r->ports, r->nr_ports, sizeof(*r->ports), health_cmp);
+
+	return 0;
+}
+
+static struct switchtec_evcntr_sampler *
+health_open_sampler(struct health_sweep *h)
+{
+	struct switchtec_evcntr_sampler *s;
+	int n;
+
+	for (n = SWITCHTEC_HEALTH_NR_EVENTS; n; n /= 2) {
+		s = switchtec_evcntr_sampler_open(h->dev,
+						  switchtec_health_events, n);
+		if (s) {
+			h->report->nr_events = n;
+			return s;
+		}
+
+		if (errno != EINVAL)
+			break;
+	}
+
+	return NULL;
+}
+
+static void health_read_ltssm(struct health_sweep *h)
+{
+	struct switchtec_ltssm_collector *c;
+	const struct switchtec_ltssm_entry *entries;
+	struct switchtec_ltssm_stats st;
+	struct switchtec_health_port *p;
+	int port_id;
+
+	for (p = h->report->ports; p < h->report->ports + h->report->nr_ports;
+	     p++) {
+		if (health_over_budget(h))
+			return;
+
+		port_id = p->port.phys_id;
+		c = switchtec_ltssm_collector_open(h->dev, &port_id, 1, 1);
+		if (!c)
+			continue;
+
+		if (switchtec_ltssm_collector_poll(c, &entries) >= 0 &&
+		    !switchtec_ltssm_collector_stats(c, port_id, &st)) {
+			p->retrains = st.retrains;
+			p->link_downs = st.link_downs;
+			p->speed_changes = st.speed_changes;
+			p->done |= SWITCHTEC_HEALTH_LTSSM;
+		}
+
+		switchtec_ltssm_collector_close(c);
+	}
+}
+
+static void health_read_errors(struct health_sweep *h,
+			       struct switchtec_evcntr_sampler *s,
+			       uint64_t window_end)
+{
+	struct switchtec_health_report *r = h->report;
+	struct switchtec_evcntr_sample sample;
+	struct switchtec_health_port *p;
+	uint64_t now, end = window_end;
+	int i, j, k;
+
+	if (h->deadline_us && h->deadline_us < end)
+		end = h->deadline_us;
+
+	now = health_now_us();
+	if (now < end) {
+		sleep((end - now) / 1000000);
+		usleep((end - now) % 1000000);
+	}
+
+	if (switchtec_evcntr_sampler_poll(s, &sample) || !sample.interval_us)
+		return;
+
+	r->window_us = sample.interval_us;
+
+	for (i = 0; i < sample.nr_ports; i++) {
+		for (p = r->ports; p < r->ports + r->nr_ports; p++)
+			if (p->port.phys_id == sample.ports[i].phys_id)
+				break;
+
+		if (p == r->ports + r->nr_ports)
+			continue;
+
+		for (j = 0; j < sample.nr_events; j++) {
+			k = i * sample.nr_events + j;
+			p->errors[j] = sample.deltas[k];
+			p->error_rates[j] = sample.rates[k];
+		}
+		p->done |= SWITCHTEC_HEALTH_EVCNTR;
+	}
+}
+
+static void health_read_rcvr(struct health_sweep *h)
+{
+	struct switchtec_health_report *r = h->report;
+	struct switchtec_health_port *p;
+	int n = 0, lane;
+
+	for (p = r->ports; p < r->ports + r->nr_ports; p++) {
+		if (n >= h->cfg.max_rcvr_ports || !p->score)
+			return;
+
+		if (!p->link_up)
+			continue;
+		n++;
+
+		for (lane = 0; lane < p->neg_width &&
+		     lane < ARRAY_SIZE(p->rcvr); lane++) {
+			if (health_over_budget(h))
+				return;
+
+			if (switchtec_diag_rcvr_obj(h->dev, p->port.phys_id,
+						    lane,
+						    SWITCHTEC_DIAG_LINK_CURRENT,
+						    &p->rcvr[lane]))
+				break;
+			p->nr_rcvr++;
+		}
+
+		if (p->nr_rcvr == p->neg_width)
+			p->done |= SWITCHTEC_HEALTH_RCVR;
+	}
+}
+
+/**
+ * @brief Check the health of every link of a switch
+ * @param[in] dev	Switchtec device handle
+ * @param[in] cfg	Sweep settings
+ * @return The report on success, NULL on failure
+ *
+ * Only reading the port status can fail the sweep. Parts that fail or
+ * do not fit in \p cfg->budget_ms are skipped and left out of the
+ * \p done mask of the affected ports. With a budget, the error window
+ * is limited to half of it.
+ *
+ * The report must be freed with switchtec_health_free().
+ */
+struct switchtec_health_report *
+switchtec_health_sweep(struct switchtec_dev *dev,
+		       const struct switchtec_health_cfg *cfg)
+{
+	struct switchtec_evcntr_sampler *sampler = NULL;
+	struct health_sweep h = {
+		.dev = dev,
+		.cfg = *cfg,
+	};
+	uint64_t start, window_us, window_end = 0;
+	int i;
+
+	h.report = calloc(1, sizeof(*h.report));
+	if (!h.report)
+		return NULL;
+
+	start = health_now_us();
+	h.report->time_us = start;
+	if (cfg->budget_ms)
+		h.deadline_us = start + cfg->budget_ms * 1000ULL;
+
+	window_us = cfg->window_ms * 1000ULL;
+	if (cfg->budget_ms && window_us > cfg->budget_ms * 500ULL)
+		window_us = cfg->budget_ms * 500ULL;
+
+	if (health_read_status(&h)) {
+		switchtec_health_free(h.report);
+		return NULL;
+	}
+
+	if (cfg->parts & SWITCHTEC_HEALTH_EVCNTR && window_us) {
+		sampler = health_open_sampler(&h);
+		window_end = health_now_us() + window_us;
+	}
+
+	if (cfg->parts & SWITCHTEC_HEALTH_LTSSM)
+		health_read_ltssm(&h);
+
+	if (sampler) {
+		health_read_errors(&h, sampler, window_end);
+		switchtec_evcntr_sampler_close(sampler);
+	}
+
+	for (i = 0; i < h.report->nr_ports; i++)
+		health_score(&h.report->ports[i]);
+	qsort(h.report->ports, h.report->nr_ports, sizeof(*h.report->ports),
+	      health_cmp);
+
+	if (cfg->parts & SWITCHTEC_HEALTH_RCVR)
+		health_read_rcvr(&h);
+
+	h.report->elapsed_ms = (health_now_us() - start) / 1000;
+
+	return h.report;
+}
+
+/**
+ * @brief Free a health report
+ * @param[in] report	Report
+ */
+void switchtec_health_free(struct switchtec_health_report *report)
+{
+	if (!report)
+		return;
+
+	free(report->ports);
+	free(report);
+}
+
+/**@}*/
@@ -0,0 +1,2073 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Switchtec core library functions for log definition handling
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec/switchtec.h"
+#include "switchtec/errors.h"
+#include "switchtec/utils.h"
+
+#include "lib/crc.h"
+#include "lib/log.h"
+#include "config.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+#endif
+
+/**
+ * @brief Free log definition data
+ * @param[in] defs - log definition data to free
+ */
+static void free_log_defs(struct log_defs *defs)
+{
+	int i, j;
+
+	if (!defs->module_defs)
+		return;
+
+	for (i = 0; i < defs->num_alloc; i++) {
+		free(defs->module_defs[i].mod_name);
+
+		for (j = 0; j < defs->module_defs[i].num_entries; j++)
+			free(defs->module_defs[i].entries[j]);
+
+		free(defs->module_defs[i].entries);
+	}
+
+	free(defs->module_defs);
+}
+
+/**
+ * @brief Allocate / reallocate log definition data
+ * @param[in] defs 	  - log definition data
+ * @param[in] num_modules - number of modules to allocate for
+ * @return 0 on success, negative value on failure
+ */
+static int realloc_log_defs(struct log_defs *defs, int num_modules)
+{
+	int i;
+
+	defs->module_defs = realloc(defs->module_defs,
+				    (num_modules *
+				     sizeof(struct module_log_defs)));
+	if (!defs->module_defs) {
+		free_log_defs(defs);
+		return -1;
+	}
+
+	for (i = defs->num_alloc; i < num_modules; i++)
+		memset(&defs->module_defs[i], 0,
+		       sizeof(struct module_log_defs));
+
+	defs->num_alloc = num_modules;
+
+	return 0;
+}
+
+/**
+ * @brief Parse an integer from a string
+ * @param[in] str  - string to parse
+ * @param[out] val - integer
+ * @return true on success, false on failure
+ */
+static bool parse_int(char *str, int *val)
+{
+	char *endptr;
+
+	errno = 0;
+	*val = strtol(str, &endptr, 0);
+
+	if ((endptr == str) || (*endptr != '\0') || (errno != 0))
+		return false;
+
+	return true;
+}
+
+/**
+ * @brief Read an app log definition file and store the definitions
+ * @param[in] log_def_file - log definition file
+ * @param[out] defs 	   - log definitions
+ * @return 0 on success, negative value on failure
+ */
+static int read_app_log_defs(FILE *log_def_file, struct log_defs *defs)
+{
+	int ret;
+	char line[512];
+	char *tok;
+	int mod_id;
+	struct module_log_defs *mod_defs;
+	int num_entries;
+	int i;
+
+	/* allocate some log definition entries */
+	ret = realloc_log_defs(defs, 200);
+	if (ret < 0)
+		return ret;
+
+	while (fgets(line, sizeof(line), log_def_file)) {
+
+		/* ignore comments */
+		if (line[0] == '#')
+			continue;
+
+		/* strip any newline characters */
+		line[strcspn(line, "\r\n")] = '\0';
+
+		/*
+		 * Tokenize and parse the line. Module headings are of the form:
+		 * mod_name    mod_id    num_entries
+		 */
+		tok = strtok(line, " \t");
+		if (!tok)
+			continue;
+
+		tok = strtok(NULL, " \t");
+		if (!tok)
+			continue;
+
+		if (!parse_int(tok, &mod_id)) {
+			errno = SWITCHTEC_ERR_LOG_DEF_DATA_INVAL;
+			goto err_free_log_defs;
+		}
+
+		/* reallocate more log definition entries if needed */
+		if (mod_id > defs->num_alloc) {
+			ret = realloc_log_defs(defs, mod_id * 2);
+			if (ret < 0)
+				return ret;
+		}
+
+		mod_defs = &defs->module_defs[mod_id];
+
+		tok = strtok(NULL, " \t");
+		if (!tok)
+			continue;
+
+		if (!parse_int(tok, &num_entries)) {
+			errno = SWITCHTEC_ERR_LOG_DEF_DATA_INVAL;
+			goto err_free_log_defs;
+		}
+
+		/*
+		 * Skip this module if it has already been done. This can happen
+		 * if the module is duplicated in the log definition file.
+		 */
+		if (mod_defs->mod_name != NULL) {
+			for (i = 0; i < num_entries; i++) {
+				if (!fgets(line, sizeof(line),
+					  log_def_file))
+					break;
+			}
+			continue;
+		}
+
+		mod_defs->mod_name = strdup(line);
+		mod_defs->num_entries = num_entries;
+		mod_defs->entries = calloc(mod_defs->num_entries,
+					   sizeof(*mod_defs->entries));
+		if (!mod_defs->entries)
+			goto err_free_log_defs;
+
+		for (i = 0; i < mod_defs->num_entries; i++) {
+			if (fgets(line, sizeof(line), log_def_file) == NULL) {
+				errno = SWITCHTEC_ERR_LOG_DEF_READ_ERROR;
+				goto err_free_log_defs;
+			}
+
+			mod_defs->entries[i] = strdup(line);
+			if (!mod_defs->entries[i])
+				goto err_free_log_defs;
+		}
+	}
+
+	if (ferror(log_def_file)) {
+		errno = SWITCHTEC_ERR_LOG_DEF_READ_ERROR;
+		goto err_free_log_defs;
+	}
+
+	return 0;
+
+err_free_log_defs:
+	free_log_defs(defs);
+	return -1;
+}
+
+/**
+ * @brief Read a mailbox log definition file and store the definitions
+ * @param[in] log_def_file - log definition file
+ * @param[out] defs 	   - log definitions
+ * @return 0 on success, negative value on failure
+ */
+static int read_mailbox_log_defs(FILE *log_def_file, struct log_defs *defs)
+{
+	int ret;
+	char line[512];
+	struct module_log_defs *mod_defs;
+	int num_entries_alloc;
+
+	/*
+	 * The mailbox log definitions don't keep track of modules. Allocate a
+	 * single log definition entry for all definitions.
+	 */
+	ret = realloc_log_defs(defs, 1);
+	if (ret < 0)
+		return ret;
+
+	mod_defs = &defs->module_defs[0];
+	mod_defs->num_entries = 0;
+
+	/* allocate some entries */
+	num_entries_alloc = 100;
+	mod_defs->entries = calloc(num_entries_alloc,
+				   sizeof(*mod_defs->entries));
+	if (!mod_defs->entries)
+		goto err_free_log_defs;
+
+	while (fgets(line, sizeof(line), log_def_file)) {
+		/* ignore comments */
+		if (line[0] == '#')
+			continue;
+
+		if (mod_defs->num_entries >= num_entries_alloc) {
+			/* allocate more entries */
+			num_entries_alloc *= 2;
+			mod_defs->entries = realloc(mod_defs->entries,
+						    (num_entries_alloc *
+						     sizeof(*mod_defs->entries)));
+			if (!mod_defs->entries)
+				goto err_free_log_defs;
+		}
+
+		mod_defs->entries[mod_defs->num_entries] = strdup(line);
+		if (!mod_defs->entries[mod_defs->num_entries])
+			goto err_free_log_defs;
+
+		mod_defs->num_entries++;
+	}
+
+	if (ferror(log_def_file)) {
+		errno = SWITCHTEC_ERR_LOG_DEF_READ_ERROR;
+		goto err_free_log_defs;
+	}
+
+	return 0;
+
+err_free_log_defs:
+	free_log_defs(defs);
+	return -1;
+}
+
+/**
+ * @brief Read the FW and SDK versions from a log definition file header
+ * @param[in]  log_def_file - log definition file
+ * @param[out] fw_version   - FW version the definitions were built for
+ * @param[out] sdk_version  - SDK version the definitions were built for
+ * @return 0 on success, negative value on failure
+ */
+int log_def_parse_header(FILE *log_def_file, uint32_t *fw_version,
+			 uint32_t *sdk_version)
+{
+	char line[512];
+	int i;
+
+	*fw_version = 0;
+	*sdk_version = 0;
+	while (fgets(line, sizeof(line), log_def_file)) {
+		if (line[0] != '#')
+			continue;
+
+		i = 0;
+		while (line[i] == ' ' || line[i] == '#') i++;
+
+		if (strncasecmp(line + i, "SDK Version:", 12) == 0) {
+			i += 12;
+			while (line[i] == ' ') i++;
+			sscanf(line + i, "%i", (int*)sdk_version);
+		}
+		else if (strncasecmp(line + i, "FW Version:", 11) == 0) {
+			i += 11;
+			while (line[i] == ' ') i++;
+			sscanf(line + i, "%i", (int*)fw_version);
+		}
+	}
+
+	rewind(log_def_file);
+	return 0;
+}
+
+
+/**
+ * @brief Locate the conversion specifiers in a log entry format string
+ * @param[in]  fmt	 - printf-style format string
+ * @param[out] spec	 - conversion locations, may be NULL
+ * @param[in]  max_specs - number of entries available in \p spec
+ * @return number of conversions in the format string ("%%" excluded)
+ */
+int log_def_split_fmt(const char *fmt, struct log_def_spec *spec,
+		      int max_specs)
+{
+	const char *p = fmt;
+	const char *start;
+	int n = 0;
+
+	while ((p = strchr(p, '%'))) {
+		start = p++;
+
+		if (*p == '%') {
+			p++;
+			continue;
+		}
+
+		while (*p && strchr("-+ #0", *p))
+			p++;
+		while (*p == '*' || (*p >= '0' && *p <= '9'))
+			p++;
+		if (*p == '.') {
+			p++;
+			while (*p == '*' || (*p >= '0' && *p <= '9'))
+				p++;
+		}
+		while (*p && strchr("hlLqjzt", *p))
+			p++;
+		if (!*p)
+			break;
+		p++;
+
+		if (spec && n < max_specs) {
+			spec[n].off = start - fmt;
+			spec[n].len = p - start;
+		}
+		n++;
+	}
+
+	return n;
+}
+
+#ifdef __linux__
+
+/*
+ * Compiled log definitions
+ *
+ * Parsing a text definition file costs a few thousand small allocations.
+ * After a text file has been parsed once, its definitions are written to
+ * a cache directory in the layout below and later runs with the same
+ * definition file map it directly:
+ *
+ *   struct log_def_bin_hdr
+ *   struct log_def_bin_mod  mods[num_modules]
+ *   struct log_def_fmt      fmts[num_entries]
+ *   char                    arena[arena_len]
+ *
+ * All strings live in the arena and are referred to by offset. The cache
+ * file name carries the FW/SDK version from the definition file header
+ * and a CRC of its contents, so an edited file is never matched against
+ * a stale cache entry.
+ */
+
+#define LOG_DEF_BIN_VERSION 1
+#define LOG_DEF_BIN_NONE 0xFFFFFFFF
+
+static const char log_def_bin_magic[8] = {'S', 'W', 'L', 'O', 'G', 'D',
+					  'E', 'F'};
+
+struct log_def_bin_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t type;
+	uint32_t fw_version;
+	uint32_t sdk_version;
+	uint32_t src_size;
+	uint32_t src_crc;
+	uint32_t num_modules;
+	uint32_t num_entries;
+	uint32_t arena_len;
+	uint32_t rsvd;
+};
+
+struct log_def_bin_mod {
+	uint32_t name;
+	uint32_t first_entry;
+	uint32_t num_entries;
+	uint32_t rsvd;
+};
+
+struct log_def_key {
+	enum switchtec_log_def_type type;
+	uint32_t fw_version;
+	uint32_t sdk_version;
+	uint32_t src_size;
+	uint32_t src_crc;
+};
+
+static int log_def_file_key(FILE *log_def_file, struct log_def_key *key)
+{
+	uint8_t buf[65536];
+	size_t len;
+	int init = 1;
+	int ret;
+
+	key->src_size = 0;
+	key->src_crc = 0;
+
+	while ((len = fread(buf, 1, sizeof(buf), log_def_file)) > 0) {
+		key->src_crc = crc32(buf, len, key->src_crc, init, 0);
+		key->src_size += len;
+		init = 0;
+	}
+
+	ret = ferror(log_def_file) ? -1 : 0;
+	rewind(log_def_file);
+
+	return ret;
+}
+
+static int log_def_cache_dir(char *dir, size_t len)
+{
+	const char *env;
+
+	env = getenv("SWITCHTEC_LOG_DEF_CACHE");
+	if (env) {
+		if (!*env)
+			return -1;
+		snprintf(dir, len, "%s", env);
+		return 0;
+	}
+
+	env = getenv("XDG_CACHE_HOME");
+	if (env && *env) {
+		snprintf(dir, len, "%s/switchtec", env);
+		return 0;
+	}
+
+	env = getenv("HOME");
+	if (env && *env) {
+		snprintf(dir, len, "%s/.cache/switchtec", env);
+		return 0;
+	}
+
+	return -1;
+}
+
+static int log_def_cache_path(struct log_def_key *key, char *path,
+			      size_t len)
+{
+	char dir[PATH_MAX];
+
+	if (log_def_cache_dir(dir, sizeof(dir)))
+		return -1;
+
+	if (snprintf(path, len, "%s/logdef-%s-%08x-%08x-%08x.bin", dir,
+		     key->type == SWITCHTEC_LOG_DEF_TYPE_APP ? "app" : "mailbox",
+		     key->fw_version, key->sdk_version,
+		     key->src_crc) >= len)
+		return -1;
+
+	return 0;
+}
+
+static int log_def_mkdir_p(const char *path)
+{
+	char tmp[PATH_MAX];
+	char *p;
+
+	snprintf(tmp, sizeof(tmp), "%s", path);
+	p = strrchr(tmp, '/');
+	if (!p)
+		return 0;
+	*p = '\0';
+
+	for (p = tmp + 1; *p; p++) {
+		if (*p != '/')
+			continue;
+		*p = '\0';
+		if (mkdir(tmp, 0755) && errno != EEXIST)
+			return -1;
+		*p = '/';
+	}
+
+	if (mkdir(tmp, 0755) && errno != EEXIST)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * The pre-split specs are used as-is when formatting, so a stale or
+ * corrupt cache must not be able to point them outside the string.
+ * Formats with more than LOG_DEF_MAX_SPECS conversions are stored with
+ * LOG_DEF_MAX_SPECS + 1 and fall back to the C library printf.
+ */
+static int log_def_bin_fmt_check(const struct log_def_fmt *fmt,
+				 const char *arena, uint32_t arena_len)
+{
+	size_t len, end = 0;
+	int k;
+
+	if (fmt->str >= arena_len)
+		return -1;
+
+	len = strlen(arena + fmt->str);
+	if (fmt->len != (len > UINT16_MAX ? UINT16_MAX : len) ||
+	    fmt->nr_specs > LOG_DEF_MAX_SPECS + 1)
+		return -1;
+
+	for (k = 0; k < fmt->nr_specs && k < LOG_DEF_MAX_SPECS; k++) {
+		if (!fmt->spec[k].len || fmt->spec[k].off < end ||
+		    fmt->spec[k].off + fmt->spec[k].len > len)
+			return -1;
+		end = fmt->spec[k].off + fmt->spec[k].len;
+	}
+
+	return 0;
+}
+
+static int log_defs_attach_bin(struct log_defs *defs, void *bin,
+			       size_t bin_len, struct log_def_key *key)
+{
+	struct log_def_bin_hdr *hdr = bin;
+	struct log_def_bin_mod *mods;
+	struct log_def_fmt *fmts;
+	struct module_log_defs *mod_defs;
+	const char *arena;
+	size_t expected;
+	uint32_t i, j;
+
+	if (bin_len < sizeof(*hdr))
+		return -1;
+
+	if (memcmp(hdr->magic, log_def_bin_magic, sizeof(hdr->magic)) ||
+	    hdr->version != LOG_DEF_BIN_VERSION ||
+	    hdr->type != key->type ||
+	    hdr->fw_version != key->fw_version ||
+	    hdr->sdk_version != key->sdk_version ||
+	    hdr->src_size != key->src_size ||
+	    hdr->src_crc != key->src_crc)
+		return -1;
+
+	expected = sizeof(*hdr) + (size_t)hdr->num_modules * sizeof(*mods) +
+		(size_t)hdr->num_entries * sizeof(*fmts) + hdr->arena_len;
+	if (expected != bin_len || !hdr->num_modules || !hdr->arena_len)
+		return -1;
+
+	mods = (void *)(hdr + 1);
+	fmts = (void *)(mods + hdr->num_modules);
+	arena = (const char *)(fmts + hdr->num_entries);
+
+	if (arena[hdr->arena_len - 1] != '\0')
+		return -1;
+
+	for (i = 0; i < hdr->num_entries; i++)
+		if (log_def_bin_fmt_check(&fmts[i], arena, hdr->arena_len))
+			return -1;
+
+	defs->module_defs = calloc(hdr->num_modules, sizeof(*defs->module_defs));
+	defs->bin_entries = calloc(hdr->num_entries + 1,
+				   sizeof(*defs->bin_entries));
+	if (!defs->module_defs || !defs->bin_entries)
+		goto err_free;
+
+	for (i = 0; i < hdr->num_entries; i++)
+		defs->bin_entries[i] = (char *)arena + fmts[i].str;
+
+	for (i = 0; i < hdr->num_modules; i++) {
+		mod_defs = &defs->module_defs[i];
+		j = mods[i].first_entry;
+
+		if (mods[i].name == LOG_DEF_BIN_NONE && !mods[i].num_entries)
+			continue;
+
+		if ((mods[i].name != LOG_DEF_BIN_NONE &&
+		     mods[i].name >= hdr->arena_len) ||
+		    j > hdr->num_entries ||
+		    mods[i].num_entries > hdr->num_entries - j)
+			goto err_free;
+
+		/* mailbox definitions have no module name */
+		if (mods[i].name != LOG_DEF_BIN_NONE)
+			mod_defs->mod_name = (char *)arena + mods[i].name;
+		mod_defs->entries = &defs->bin_entries[j];
+		mod_defs->num_entries = mods[i].num_entries;
+		mod_defs->fmts = &fmts[j];
+	}
+
+	defs->num_alloc = hdr->num_modules;
+	defs->bin = bin;
+	defs->bin_len = bin_len;
+
+	return 0;
+
+err_free:
+	free(defs->module_defs);
+	free(defs->bin_entries);
+	defs->module_defs = NULL;
+	defs->bin_entries = NULL;
+	return -1;
+}
+
+static int log_defs_load_bin(const char *path, struct log_def_key *key,
+			     struct log_defs *defs)
+{
+	struct stat st;
+	void *bin;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) || st.st_size < sizeof(struct log_def_bin_hdr)) {
+		close(fd);
+		return -1;
+	}
+
+	bin = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (bin == MAP_FAILED)
+		return -1;
+
+	if (log_defs_attach_bin(defs, bin, st.st_size, key)) {
+		munmap(bin, st.st_size);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int log_defs_write_bin(const char *path, struct log_def_key *key,
+			      struct log_defs *defs)
+{
+	struct log_def_bin_hdr hdr = {
+		.version = LOG_DEF_BIN_VERSION,
+		.type = key->type,
+		.fw_version = key->fw_version,
+		.sdk_version = key->sdk_version,
+		.src_size = key->src_size,
+		.src_crc = key->src_crc,
+	};
+	struct module_log_defs *mod_defs;
+	struct log_def_bin_mod *mods = NULL;
+	struct log_def_fmt *fmts = NULL;
+	char *arena = NULL;
+	char tmp_path[PATH_MAX];
+	size_t arena_len = 0, len;
+	uint32_t entry = 0;
+	FILE *f = NULL;
+	int i, j, specs, ret = -1;
+
+	memcpy(hdr.magic, log_def_bin_magic, sizeof(hdr.magic));
+
+	for (i = 0; i < defs->num_alloc; i++) {
+		mod_defs = &defs->module_defs[i];
+
+		if (mod_defs->mod_name)
+			arena_len += strlen(mod_defs->mod_name) + 1;
+		for (j = 0; j < mod_defs->num_entries; j++)
+			arena_len += strlen(mod_defs->entries[j]) + 1;
+		hdr.num_entries += mod_defs->num_entries;
+	}
+
+	if (!arena_len || arena_len > UINT32_MAX)
+		return -1;
+
+	hdr.num_modules = defs->num_alloc;
+	hdr.arena_len = arena_len;
+
+	mods = calloc(hdr.num_modules, sizeof(*mods));
+	fmts = calloc(hdr.num_entries + 1, sizeof(*fmts));
+	arena = malloc(arena_len);
+	if (!mods || !fmts || !arena)
+		goto out;
+
+	arena_len = 0;
+	for (i = 0; i < defs->num_alloc; i++) {
+		mod_defs = &defs->module_defs[i];
+		mods[i].name = LOG_DEF_BIN_NONE;
+
+		if (mod_defs->mod_name) {
+			len = strlen(mod_defs->mod_name) + 1;
+			memcpy(arena + arena_len, mod_defs->mod_name, len);
+			mods[i].name = arena_len;
+			arena_len += len;
+		}
+
+		mods[i].first_entry = entry;
+		mods[i].num_entries = mod_defs->num_entries;
+
+		for (j = 0; j < mod_defs->num_entries; j++, entry++) {
+			len = strlen(mod_defs->entries[j]) + 1;
+			memcpy(arena + arena_len, mod_defs->entries[j], len);
+			fmts[entry].str = arena_len;
+			fmts[entry].len = len - 1 > UINT16_MAX ?
+				UINT16_MAX : len - 1;
+			specs = log_def_split_fmt(mod_defs->entries[j],
+						  fmts[entry].spec,
+						  LOG_DEF_MAX_SPECS);
+			fmts[entry].nr_specs = specs > LOG_DEF_MAX_SPECS ?
+				LOG_DEF_MAX_SPECS + 1 : specs;
+			arena_len += len;
+		}
+	}
+
+	if (log_def_mkdir_p(path))
+		goto out;
+
+	if (snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path,
+		     getpid()) >= sizeof(tmp_path))
+		goto out;
+
+	f = fopen(tmp_path, "wb");
+	if (!f)
+		goto out;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    fwrite(mods, sizeof(*mods), hdr.num_modules, f) !=
+			hdr.num_modules ||
+	    fwrite(fmts, sizeof(*fmts), hdr.num_entries, f) !=
+			hdr.num_entries ||
+	    fwrite(arena, 1, hdr.arena_len, f) != hdr.arena_len) {
+		fclose(f);
+		unlink(tmp_path);
+		goto out;
+	}
+
+	if (fclose(f) || rename(tmp_path, path)) {
+		unlink(tmp_path);
+		goto out;
+	}
+
+	ret = 0;
+
+out:
+	free(mods);
+	free(fmts);
+	free(arena);
+	return ret;
+}
+
+#endif
+
+/**
+ * @brief Read a log definition file
+ * @param[in]  log_def_file - log definition file
+ * @param[in]  type	    - app or mailbox definitions
+ * @param[in]  fw_version   - FW version from log_def_parse_header()
+ * @param[in]  sdk_version  - SDK version from log_def_parse_header()
+ * @param[out] defs	    - log definitions, free with log_defs_free()
+ * @return 0 on success, negative value on failure
+ *
+ * On Linux, a compiled copy of the definitions is kept in
+ * $SWITCHTEC_LOG_DEF_CACHE (or $XDG_CACHE_HOME/switchtec, or
+ * ~/.cache/switchtec). It is created the first time a definition file is
+ * parsed and mapped directly on later calls. Setting
+ * SWITCHTEC_LOG_DEF_CACHE to an empty string disables the cache.
+ */
+int log_defs_read(FILE *log_def_file, enum switchtec_log_def_type type,
+		  uint32_t fw_version, uint32_t sdk_version,
+		  struct log_defs *defs)
+{
+	int ret;
+#ifdef __linux__
+	struct log_def_key key = {
+		.type = type,
+		.fw_version = fw_version,
+		.sdk_version = sdk_version,
+	};
+	char path[PATH_MAX];
+	bool cache;
+
+	memset(defs, 0, sizeof(*defs));
+
+	cache = !log_def_file_key(log_def_file, &key) &&
+		!log_def_cache_path(&key, path, sizeof(path));
+
+	if (cache && !log_defs_load_bin(path, &key, defs))
+		return 0;
+#else
+	memset(defs, 0, sizeof(*defs));
+#endif
+
+	if (type == SWITCHTEC_LOG_DEF_TYPE_APP)
+		ret = read_app_log_defs(log_def_file, defs);
+	else
+		ret = read_mailbox_log_defs(log_def_file, defs);
+
+	if (ret < 0)
+		return ret;
+
+#ifdef __linux__
+	if (cache)
+		log_defs_write_bin(path, &key, defs);
+#endif
+
+	return 0;
+}
+
+/**
+ * @brief Free log definition data
+ * @param[in] defs - log definition data to free
+ */
+void log_defs_free(struct log_defs *defs)
+{
+	if (!defs->bin) {
+		free_log_defs(defs);
+		return;
+	}
+
+	free(defs->module_defs);
+	free(defs->bin_entries);
+#ifdef __linux__
+	munmap(defs->bin, defs->bin_len);
+#endif
+	memset(defs, 0, sizeof(*defs));
+}
+
+/*
+ * Log formatter
+ *
+ * Every definition entry is compiled once into a list of literal copies
+ * and integer conversions, which are rendered without going through
+ * printf. Entries using anything other than plain integer conversions
+ * (length modifiers, '*' widths, strings, ...) fall back to snprintf.
+ * Output is collected in a large buffer and written in big blocks.
+ */
+
+#define LOG_FMT_BUF_SIZE	(1 << 20)
+#define LOG_FMT_WIDTH_MAX	256
+/* widest possible rendering of one conversion */
+#define LOG_FMT_CONV_MAX	(LOG_FMT_WIDTH_MAX + 16)
+/* widest possible index, timestamp, severity and event ID columns */
+#define LOG_FMT_PREFIX_MAX	96
+
+enum {
+	LOG_OP_LIT,
+	LOG_OP_INT,
+};
+
+enum {
+	LOG_FLAG_LEFT = 1 << 0,
+	LOG_FLAG_ZERO = 1 << 1,
+	LOG_FLAG_PLUS = 1 << 2,
+	LOG_FLAG_SPACE = 1 << 3,
+	LOG_FLAG_ALT = 1 << 4,
+};
+
+static const char *const log_sev_strs[] = {
+	"DISABLED", "HIGHEST", "HIGH", "MEDIUM", "LOW", "LOWEST",
+};
+
+struct log_ops_vec {
+	struct log_fmt_op *ops;
+	size_t nr, alloc;
+};
+
+static struct log_fmt_op *log_ops_push(struct log_ops_vec *v)
+{
+	struct log_fmt_op *ops;
+
+	if (v->nr == v->alloc) {
+		v->alloc = v->alloc ? v->alloc * 2 : 1024;
+		ops = realloc(v->ops, v->alloc * sizeof(*ops));
+		if (!ops)
+			return NULL;
+		v->ops = ops;
+	}
+
+	memset(&v->ops[v->nr], 0, sizeof(*v->ops));
+	return &v->ops[v->nr++];
+}
+
+static int log_ops_lit(struct log_ops_vec *v, const char *fmt, size_t start,
+		       size_t end)
+{
+	struct log_fmt_op *op;
+	const char *pct;
+
+	while (start < end) {
+		pct = memchr(fmt + start, '%', end - start);
+
+		/* a literal "%%" copies its second '%' */
+		op = log_ops_push(v);
+		if (!op)
+			return -1;
+
+		op->type = LOG_OP_LIT;
+		op->off = start;
+		op->len = pct ? pct - fmt - start + 1 : end - start;
+		start += op->len + (pct ? 1 : 0);
+	}
+
+	return 0;
+}
+
+static int log_ops_conv(struct log_fmt_op *op, const char *s, size_t len,
+			int arg)
+{
+	const char *end = s + len - 1;
+	int n;
+
+	op->type = LOG_OP_INT;
+	op->arg = arg;
+	op->prec = -1;
+
+	for (s++; s < end; s++) {
+		if (*s == '-')
+			op->flags |= LOG_FLAG_LEFT;
+		else if (*s == '0')
+			op->flags |= LOG_FLAG_ZERO;
+		else if (*s == '+')
+			op->flags |= LOG_FLAG_PLUS;
+		else if (*s == ' ')
+			op->flags |= LOG_FLAG_SPACE;
+		else if (*s == '#')
+			op->flags |= LOG_FLAG_ALT;
+		else
+			break;
+	}
+
+	for (n = 0; s < end && *s >= '0' && *s <= '9'; s++)
+		n = n * 10 + *s - '0';
+	if (n > LOG_FMT_WIDTH_MAX)
+		return -1;
+	op->width = n;
+
+	if (s < end && *s == '.') {
+		for (n = 0, s++; s < end && *s >= '0' && *s <= '9'; s++)
+			n = n * 10 + *s - '0';
+		if (n > LOG_FMT_WIDTH_MAX)
+			return -1;
+		op->prec = n;
+	}
+
+	/* length modifiers and '*' are left to the C library */
+	if (s != end || !strchr("diouxXc", *end))
+		return -1;
+
+	op->conv = *end;
+	return 0;
+}
+
+static int log_fmt_compile(struct log_ops_vec *v, struct log_fmt_entry *ent,
+			   const char *fmt, const struct log_def_fmt *pre)
+{
+	struct log_def_spec spec[LOG_DEF_MAX_SPECS];
+	const struct log_def_spec *sp = spec;
+	size_t pos = 0, fmt_len = strlen(fmt);
+	struct log_fmt_op *op;
+	int nr_specs, i;
+
+	ent->fmt = fmt;
+	ent->first_op = v->nr;
+	ent->fallback = 1;
+
+	if (pre) {
+		nr_specs = pre->nr_specs;
+		sp = pre->spec;
+	} else {
+		nr_specs = log_def_split_fmt(fmt, spec, LOG_DEF_MAX_SPECS);
+	}
+
+	if (nr_specs > LOG_DEF_MAX_SPECS || fmt_len > UINT16_MAX)
+		goto fallback;
+
+	for (i = 0; i < nr_specs; i++) {
+		if (log_ops_lit(v, fmt, pos, sp[i].off))
+			return -1;
+
+		op = log_ops_push(v);
+		if (!op)
+			return -1;
+
+		if (log_ops_conv(op, fmt + sp[i].off, sp[i].len, i))
+			goto fallback;
+
+		pos = sp[i].off + sp[i].len;
+	}
+
+	if (log_ops_lit(v, fmt, pos, fmt_len))
+		return -1;
+
+	if (v->nr - ent->first_op > UINT16_MAX)
+		goto fallback;
+
+	ent->nr_ops = v->nr - ent->first_op;
+	ent->max_len = fmt_len;
+	for (i = ent->first_op; i < v->nr; i++)
+		if (v->ops[i].type == LOG_OP_INT)
+			ent->max_len += LOG_FMT_CONV_MAX;
+	ent->fallback = 0;
+	return 0;
+
+fallback:
+	v->nr = ent->first_op;
+	return 0;
+}
+
+/**
+ * @brief Compile log definitions for formatting
+ * @param[out] prog	 - compiled definitions
+ * @param[in]  defs	 - log definitions, must outlive \p prog
+ * @param[in]  log_type	 - log type
+ * @param[in]  ts_factor - timestamp conversion factor
+ * @return 0 on success, negative value on failure
+ */
+int log_fmt_prog_init(struct log_fmt_prog *prog, struct log_defs *defs,
+		      enum switchtec_log_parse_type log_type, int ts_factor)
+{
+	struct module_log_defs *mod_defs;
+	struct log_ops_vec v = {};
+	uint32_t nr_ents = 0;
+	int i, j;
+
+	memset(prog, 0, sizeof(*prog));
+	prog->defs = defs;
+	prog->log_type = log_type;
+	prog->ts_factor = ts_factor;
+
+	prog->mod_base = calloc(defs->num_alloc + 1, sizeof(*prog->mod_base));
+	if (!prog->mod_base)
+		return -1;
+
+	for (i = 0; i < defs->num_alloc; i++) {
+		prog->mod_base[i] = nr_ents;
+		nr_ents += defs->module_defs[i].num_entries;
+	}
+
+	prog->mod_base[defs->num_alloc] = nr_ents;
+
+	prog->ents = calloc(nr_ents + 1, sizeof(*prog->ents));
+	if (!prog->ents)
+		goto err_free;
+
+	for (i = 0; i < defs->num_alloc; i++) {
+		mod_defs = &defs->module_defs[i];
+
+		for (j = 0; j < mod_defs->num_entries; j++) {
+			if (log_fmt_compile(&v,
+					&prog->ents[prog->mod_base[i] + j],
+					mod_defs->entries[j],
+					mod_defs->fmts ? &mod_defs->fmts[j] :
+							 NULL))
+				goto err_free;
+		}
+	}
+
+	prog->ops = v.ops;
+	return 0;
+
+err_free:
+	free(v.ops);
+	log_fmt_prog_free(prog);
+	return -1;
+}
+
+/**
+ * @brief Free compiled log definitions
+ * @param[in] prog - compiled definitions
+ */
+void log_fmt_prog_free(struct log_fmt_prog *prog)
+{
+	free(prog->mod_base);
+	free(prog->ents);
+	free(prog->ops);
+	memset(prog, 0, sizeof(*prog));
+}
+
+/**
+ * @brief Set up an output buffer for formatted log entries
+ * @param[out] out  - output buffer
+ * @param[in]  file - file to write to, or NULL to keep the output in memory
+ * @return 0 on success, negative value on failure
+ */
+int log_fmt_out_init(struct log_fmt_out *out, FILE *file)
+{
+	out->file = file;
+	out->len = 0;
+	out->cap = LOG_FMT_BUF_SIZE;
+	out->buf = malloc(out->cap);
+	if (!out->buf)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * @brief Write any buffered output to the output file
+ * @param[in] out - output buffer
+ * @return 0 on success, negative value on failure
+ */
+int log_fmt_out_flush(struct log_fmt_out *out)
+{
+	if (!out->file || !out->len)
+		return 0;
+
+	if (fwrite(out->buf, 1, out->len, out->file) != out->len) {
+		errno = SWITCHTEC_ERR_PARSED_LOG_WRITE_ERROR;
+		return -1;
+	}
+
+	out->len = 0;
+	return 0;
+}
+
+/**
+ * @brief Free an output buffer, without flushing it
+ * @param[in] out - output buffer
+ */
+void log_fmt_out_free(struct log_fmt_out *out)
+{
+	free(out->buf);
+	out->buf = NULL;
+	out->len = out->cap = 0;
+}
+
+static char *log_fmt_reserve(struct log_fmt_out *out, size_t n)
+{
+	size_t cap;
+	char *buf;
+
+	if (out->len + n <= out->cap)
+		return out->buf + out->len;
+
+	if (out->file) {
+		if (log_fmt_out_flush(out))
+			return NULL;
+		if (n <= out->cap)
+			return out->buf;
+	}
+
+	cap = out->cap;
+	while (cap < out->len + n)
+		cap *= 2;
+
+	buf = realloc(out->buf, cap);
+	if (!buf)
+		return NULL;
+
+	out->buf = buf;
+	out->cap = cap;
+	return out->buf + out->len;
+}
+
+static inline char *put_str(char *p, const char *s, size_t len)
+{
+	memcpy(p, s, len);
+	return p + len;
+}
+
+static inline char *put_pad(char *p, char c, int n)
+{
+	while (n-- > 0)
+		*p++ = c;
+	return p;
+}
+
+/* Zero padded decimal with at least min_digits digits */
+static inline char *put_udec(char *p, unsigned long long v, int min_digits)
+{
+	char tmp[24];
+	int n = 0;
+
+	do {
+		tmp[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+
+	p = put_pad(p, '0', min_digits - n);
+	while (n)
+		*p++ = tmp[--n];
+
+	return p;
+}
+
+static inline char *put_dec3(char *p, unsigned int v)
+{
+	p[0] = '0' + v / 100;
+	p[1] = '0' + v / 10 % 10;
+	p[2] = '0' + v % 10;
+	return p + 3;
+}
+
+static inline char *put_hex(char *p, unsigned int v, int min_digits)
+{
+	static const char digits[] = "0123456789abcdef";
+	char tmp[8];
+	int n = 0;
+
+	do {
+		tmp[n++] = digits[v & 0xF];
+		v >>= 4;
+	} while (v);
+
+	p = put_pad(p, '0', min_digits - n);
+	while (n)
+		*p++ = tmp[--n];
+
+	return p;
+}
+
+/* Print a day number since the epoch as YYYY-MM-DD */
+static char *put_date(char *p, unsigned long long days)
+{
+	unsigned int doe, yoe, doy, mp, d, m;
+	unsigned long long era, y;
+
+	/* civil-from-days, counting from 0000-03-01 */
+	days += 719468;
+	era = days / 146097;
+	doe = days - era * 146097;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp = (5 * doy + 2) / 153;
+	d = doy - (153 * mp + 2) / 5 + 1;
+	m = mp < 10 ? mp + 3 : mp - 9;
+	y = yoe + era * 400 + (m <= 2);
+
+	p = put_udec(p, y, 4);
+	*p++ = '-';
+	p = put_udec(p, m, 2);
+	*p++ = '-';
+	return put_udec(p, d, 2);
+}
+
+static char *put_conv(char *p, const struct log_fmt_op *op, uint32_t arg)
+{
+	const char *digits = "0123456789abcdef";
+	char tmp[16], prefix[2];
+	int n = 0, plen = 0, zeros, pad;
+	unsigned int base = 10;
+	uint32_t v = arg;
+
+	switch (op->conv) {
+	case 'd':
+	case 'i':
+		if ((int32_t)arg < 0) {
+			prefix[plen++] = '-';
+			v = -arg;
+		} else if (op->flags & LOG_FLAG_PLUS) {
+			prefix[plen++] = '+';
+		} else if (op->flags & LOG_FLAG_SPACE) {
+			prefix[plen++] = ' ';
+		}
+		break;
+	case 'o':
+		base = 8;
+		break;
+	case 'X':
+		digits = "0123456789ABCDEF";
+		/* fallthrough */
+	case 'x':
+		base = 16;
+		if ((op->flags & LOG_FLAG_ALT) && arg) {
+			prefix[plen++] = '0';
+			prefix[plen++] = op->conv;
+		}
+		break;
+	case 'c':
+		pad = op->width - 1;
+		if (!(op->flags & LOG_FLAG_LEFT))
+			p = put_pad(p, ' ', pad);
+		*p++ = (unsigned char)arg;
+		if (op->flags & LOG_FLAG_LEFT)
+			p = put_pad(p, ' ', pad);
+		return p;
+	}
+
+	if (op->prec || v) {
+		do {
+			tmp[n++] = digits[v % base];
+			v /= base;
+		} while (v);
+	}
+
+	zeros = op->prec > n ? op->prec - n : 0;
+	if (op->conv == 'o' && (op->flags & LOG_FLAG_ALT) && !zeros &&
+	    (!n || tmp[n - 1] != '0'))
+		zeros = 1;
+
+	pad = op->width - plen - zeros - n;
+
+	if (op->flags & LOG_FLAG_LEFT) {
+		p = put_str(p, prefix, plen);
+		p = put_pad(p, '0', zeros);
+		while (n)
+			*p++ = tmp[--n];
+		p = put_pad(p, ' ', pad);
+	} else if ((op->flags & LOG_FLAG_ZERO) && op->prec < 0) {
+		p = put_str(p, prefix, plen);
+		p = put_pad(p, '0', pad + zeros);
+		while (n)
+			*p++ = tmp[--n];
+	} else {
+		p = put_pad(p, ' ', pad);
+		p = put_str(p, prefix, plen);
+		p = put_pad(p, '0', zeros);
+		while (n)
+			*p++ = tmp[--n];
+	}
+
+	return p;
+}
+
+static int log_fmt_printf(struct log_fmt_out *out, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static int log_fmt_printf(struct log_fmt_out *out, const char *fmt, ...)
+{
+	va_list ap;
+	char *p;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		goto err;
+
+	p = log_fmt_reserve(out, n + 1);
+	if (!p)
+		goto err;
+
+	va_start(ap, fmt);
+	vsnprintf(p, n + 1, fmt, ap);
+	va_end(ap);
+
+	out->len += n;
+	return 0;
+
+err:
+	errno = SWITCHTEC_ERR_PARSED_LOG_WRITE_ERROR;
+	return -1;
+}
+
+static int log_fmt_entry(const struct log_fmt_prog *prog,
+			 struct log_fmt_out *out,
+			 const struct log_fmt_entry *ent, const uint32_t *args)
+{
+	const struct log_fmt_op *op;
+	char *p;
+	int i;
+
+	if (ent->fallback)
+		return log_fmt_printf(out, ent->fmt, args[0], args[1],
+				      args[2], args[3], args[4]);
+
+	p = log_fmt_reserve(out, ent->max_len);
+	if (!p) {
+		errno = SWITCHTEC_ERR_PARSED_LOG_WRITE_ERROR;
+		return -1;
+	}
+
+	op = &prog->ops[ent->first_op];
+	for (i = 0; i < ent->nr_ops; i++, op++) {
+		if (op->type == LOG_OP_LIT)
+			p = put_str(p, ent->fmt + op->off, op->len);
+		else
+			p = put_conv(p, op, args[op->arg]);
+	}
+
+	out->len = p - out->buf;
+	return 0;
+}
+
+/**
+ * @brief Write the column heading of the parsed log
+ * @param[in] prog - compiled log definitions
+ * @param[in] out  - output buffer
+ * @return 0 on success, negative value on failure
+ */
+int log_fmt_write_heading(const struct log_fmt_prog *prog,
+			  struct log_fmt_out *out)
+{
+	return log_fmt_printf(out, "%s   #|%s|%s\n",
+		prog->src ? "Device       |" : "",
+		prog->wall_time ? "Timestamp (UTC)                " :
+				  "Timestamp                ",
+		prog->log_type != SWITCHTEC_LOG_PARSE_TYPE_MAILBOX ?
+			"Module       |Severity |Event ID |Event" :
+			"Source |Event ID |Event");
+}
+
+/**
+ * @brief Format app log or mailbox log entries
+ * @param[in] prog	- compiled log definitions
+ * @param[in] out	- output buffer
+ * @param[in] log_data	- logging data
+ * @param[in] count	- number of entries
+ * @param[in] entry_idx	- index of the first entry
+ * @return 0 on success, negative value on failure
+ *
+ * Entry \p i is numbered \p entry_idx + \p i. The column heading is
+ * not included, see log_fmt_write_heading().
+ */
+int log_fmt_write(const struct log_fmt_prog *prog, struct log_fmt_out *out,
+		  const struct log_a_data *log_data, size_t count,
+		  unsigned int entry_idx)
+{
+	const struct log_defs *defs = prog->defs;
+	const struct module_log_defs *mod_defs;
+	bool app = prog->log_type != SWITCHTEC_LOG_PARSE_TYPE_MAILBOX;
+	unsigned long long time, secs;
+	unsigned int sub, mod_id, log_sev = 0, entry_num;
+	const uint32_t *d;
+	size_t i, len, name_len = 0;
+	bool is_bl1 = false;
+	char *p;
+
+	for (i = 0; i < count; i++, entry_idx++) {
+		d = log_data[i].data;
+
+		if (prog->src && log_fmt_printf(out, "%-12s |", prog->src))
+			return -1;
+
+		if (app) {
+			/*
+			 * app log: module ID and log severity are in the 3rd
+			 * DWord
+			 */
+			mod_id = (d[2] >> 16) & 0xFFF;
+			log_sev = (d[2] >> 28) & 0xF;
+
+			if ((mod_id >= defs->num_alloc) ||
+			    (defs->module_defs[mod_id].mod_name == NULL) ||
+			    (defs->module_defs[mod_id].mod_name[0] == '\0')) {
+				if (log_fmt_printf(out,
+					"(Invalid module ID: 0x%x)\n", mod_id))
+					return -1;
+				continue;
+			}
+
+			if (log_sev >= ARRAY_SIZE(log_sev_strs)) {
+				if (log_fmt_printf(out,
+					"(Invalid log severity: %d)\n", log_sev))
+					return -1;
+				continue;
+			}
+		} else {
+			/*
+			 * mailbox log: BL1/BL2 indication is in the 3rd
+			 * DWord
+			 */
+			is_bl1 = (((d[2] >> 27) & 1) == 0);
+
+			/* mailbox log definitions are all in the first entry */
+			mod_id = 0;
+		}
+
+		mod_defs = &defs->module_defs[mod_id];
+
+		/* entry number is in the 3rd DWord */
+		entry_num = d[2] & 0x0000FFFF;
+
+		if (entry_num >= mod_defs->num_entries) {
+			if (log_fmt_printf(out,
+				"(Invalid log entry number: %d (module 0x%x))\n",
+				entry_num, mod_id))
+				return -1;
+			continue;
+		}
+
+		if (app)
+			name_len = strlen(mod_defs->mod_name);
+
+		p = log_fmt_reserve(out, LOG_FMT_PREFIX_MAX + name_len);
+		if (!p)
+			goto err;
+
+		/* entry index and timestamp */
+		p = put_udec(p, entry_idx, 4);
+		*p++ = '|';
+
+		if (prog->ts_factor == 0) {
+			p = put_str(p, "xxxd xx:xx:xx.xxx,xxx,xxx|", 26);
+		} else {
+			/* timestamp is in the first 2 DWords */
+			time = (((unsigned long long)d[0] << 32) | d[1]) *
+				prog->ts_factor / 100;
+			if (prog->wall_time)
+				time += prog->boot_ns;
+
+			secs = time / 1000000000;
+			sub = time % 1000000000;
+
+			if (prog->wall_time) {
+				p = put_date(p, secs / 86400);
+				*p++ = ' ';
+			} else {
+				p = put_udec(p, (unsigned int)(secs / 86400),
+					     3);
+				*p++ = 'd';
+				*p++ = ' ';
+			}
+
+			p = put_udec(p, secs / 3600 % 24, 2);
+			*p++ = ':';
+			p = put_udec(p, secs / 60 % 60, 2);
+			*p++ = ':';
+			p = put_udec(p, secs % 60, 2);
+			*p++ = '.';
+			p = put_dec3(p, sub / 1000000);
+			*p++ = ',';
+			p = put_dec3(p, sub / 1000 % 1000);
+			*p++ = ',';
+			p = put_dec3(p, sub % 1000);
+			*p++ = '|';
+		}
+
+		if (app) {
+			/* module name and log severity */
+			p = put_str(p, mod_defs->mod_name, name_len);
+			p = put_pad(p, ' ', 12 - (int)name_len);
+			p = put_str(p, " |", 2);
+			len = strlen(log_sev_strs[log_sev]);
+			p = put_str(p, log_sev_strs[log_sev], len);
+			p = put_pad(p, ' ', 8 - (int)len);
+			p = put_str(p, " |0x", 4);
+		} else {
+			/* log source (BL1/BL2) */
+			p = put_str(p, is_bl1 ? "BL1    |0x" : "BL2    |0x",
+				    10);
+		}
+
+		p = put_hex(p, entry_num, 4);
+		p = put_str(p, "   |", 4);
+		out->len = p - out->buf;
+
+		/* the log entry */
+		if (log_fmt_entry(prog, out,
+				  &prog->ents[prog->mod_base[mod_id] + entry_num],
+				  &d[3]))
+			return -1;
+	}
+
+	return 0;
+
+err:
+	errno = SWITCHTEC_ERR_PARSED_LOG_WRITE_ERROR;
+	return -1;
+}
+
+/* Rows per row group of the columnar export */
+#define LOG_COL_GROUP_ROWS 65536
+
+static const uint8_t log_col_magic[8] = {
+	'S', 'W', 'L', 'O', 'G', 'C', 'O', 'L'
+};
+
+static int log_col_put(struct log_col_writer *w, const void *buf, size_t len)
+{
+	if (len && fwrite(buf, len, 1, w->file) != 1) {
+		errno = SWITCHTEC_ERR_PARSED_LOG_WRITE_ERROR;
+		return -1;
+	}
+
+	w->off += len;
+	return 0;
+}
+
+static int log_col_put_str(struct log_col_writer *w, const char *str)
+{
+	uint32_t len = str ? strlen(str) : 0;
+
+	if (log_col_put(w, &len, sizeof(len)))
+		return -1;
+
+	return log_col_put(w, str, len);
+}
+
+/**
+ * @brief Start a columnar export
+ * @param[out] w	   - writer
+ * @param[in]  prog	   - compiled log definitions
+ * @param[in]  file	   - output file
+ * @param[in]  fw_version  - firmware version of the log
+ * @param[in]  sdk_version - SDK version of the log
+ * @return 0 on success, negative value on failure
+ */
+int log_col_init(struct log_col_writer *w, const struct log_fmt_prog *prog,
+		 FILE *file, uint32_t fw_version, uint32_t sdk_version)
+{
+	uint32_t nr_ents = prog->mod_base[prog->defs->num_alloc];
+	struct log_col_hdr hdr = {
+		.version = LOG_COL_VERSION,
+		.group_rows = LOG_COL_GROUP_ROWS,
+		.log_type = prog->log_type,
+		.ts_factor = prog->ts_factor,
+		.fw_version = fw_version,
+		.sdk_version = sdk_version,
+	};
+	int i;
+
+	memset(w, 0, sizeof(*w));
+	w->prog = prog;
+	w->file = file;
+
+	w->hash_mask = 1;
+	while (w->hash_mask < nr_ents * 2)
+		w->hash_mask <<= 1;
+
+	w->ts = malloc(LOG_COL_GROUP_ROWS * sizeof(*w->ts));
+	w->args[0] = malloc(LOG_COL_GROUP_ROWS * sizeof(uint32_t) *
+			    (LOG_DEF_MAX_SPECS + 1));
+	w->mod = malloc(LOG_COL_GROUP_ROWS * sizeof(uint16_t) * 2);
+	w->sev = malloc(LOG_COL_GROUP_ROWS);
+	w->ent_tmpl = calloc(nr_ents + 1, sizeof(*w->ent_tmpl));
+	w->hash = calloc(w->hash_mask, sizeof(*w->hash));
+	w->strs = calloc(nr_ents + 1, sizeof(*w->strs));
+	w->hash_mask--;
+
+	if (!w->ts || !w->args[0] || !w->mod || !w->sev || !w->ent_tmpl ||
+	    !w->hash || !w->strs) {
+		log_col_free(w);
+		return -1;
+	}
+
+	for (i = 1; i < LOG_DEF_MAX_SPECS; i++)
+		w->args[i] = w->args[i - 1] + LOG_COL_GROUP_ROWS;
+	w->tmpl = w->args[LOG_DEF_MAX_SPECS - 1] + LOG_COL_GROUP_ROWS;
+	w->ent = w->mod + LOG_COL_GROUP_ROWS;
+
+	memcpy(hdr.magic, log_col_magic, sizeof(hdr.magic));
+	return log_col_put(w, &hdr, sizeof(hdr));
+}
+
+/*
+ * Return the dictionary index of an entry's format string, adding it the
+ * first time it is seen. Identical strings share one index.
+ */
+static uint32_t log_col_template(struct log_col_writer *w, uint32_t ent)
+{
+	const char *str, *c;
+	uint32_t h = 2166136261u;
+
+	if (w->ent_tmpl[ent])
+		return w->ent_tmpl[ent] - 1;
+
+	str = w->prog->ents[ent].fmt;
+	for (c = str; *c; c++)
+		h = (h ^ (uint8_t)*c) * 16777619u;
+
+	for (h &= w->hash_mask; w->hash[h]; h = (h + 1) & w->hash_mask)
+		if (!strcmp(w->strs[w->hash[h] - 1], str))
+			break;
+
+	if (!w->hash[h]) {
+		w->strs[w->nr_strs++] = str;
+		w->hash[h] = w->nr_strs;
+	}
+
+	w->ent_tmpl[ent] = w->hash[h];
+	return w->hash[h] - 1;
+}
+
+static int log_col_flush(struct log_col_writer *w)
+{
+	static const uint8_t pad[8];
+	struct log_col_group grp = {
+		.first_row = w->nr_rows,
+		.nr_rows = w->len,
+	};
+	size_t n = w->len;
+	int i;
+
+	if (!n)
+		return 0;
+
+	if (log_col_put(w, &grp, sizeof(grp)) ||
+	    log_col_put(w, w->ts, n * sizeof(*w->ts)))
+		return -1;
+
+	for (i = 0; i < LOG_DEF_MAX_SPECS; i++)
+		if (log_col_put(w, w->args[i], n * sizeof(uint32_t)))
+			return -1;
+
+	if (log_col_put(w, w->tmpl, n * sizeof(*w->tmpl)) ||
+	    log_col_put(w, w->mod, n * sizeof(*w->mod)) ||
+	    log_col_put(w, w->ent, n * sizeof(*w->ent)) ||
+	    log_col_put(w, w->sev, n * sizeof(*w->sev)) ||
+	    log_col_put(w, pad, -w->off & 7))
+		return -1;
+
+	w->nr_rows += n;
+	w->nr_groups++;
+	w->len = 0;
+	return 0;
+}
+
+/**
+ * @brief Add binary log entries to a columnar export
+ * @param[in] w	       - writer
+ * @param[in] log_data - logging data
+ * @param[in] count    - number of entries
+ * @return 0 on success, negative value on failure
+ */
+int log_col_write(struct log_col_writer *w,
+		  const struct log_a_data *log_data, size_t count)
+{
+	const struct log_fmt_prog *prog = w->prog;
+	const struct log_defs *defs = prog->defs;
+	bool app = prog->log_type != SWITCHTEC_LOG_PARSE_TYPE_MAILBOX;
+	unsigned long long ticks;
+	unsigned int mod_id, entry_num;
+	const uint32_t *d;
+	uint32_t row;
+	size_t i;
+	int j;
+
+	for (i = 0; i < count; i++) {
+		d = log_data[i].data;
+		row = w->len;
+
+		ticks = ((unsigned long long)d[0] << 32) | d[1];
+		w->ts[row] = prog->ts_factor ?
+			ticks * prog->ts_factor / 100 : ticks;
+
+		if (app) {
+			mod_id = (d[2] >> 16) & 0xFFF;
+			w->sev[row] = (d[2] >> 28) & 0xF;
+		} else {
+			mod_id = 0;
+			w->sev[row] = ((d[2] >> 27) & 1) ? 2 : 1;
+		}
+
+		entry_num = d[2] & 0xFFFF;
+		w->mod[row] = mod_id;
+		w->ent[row] = entry_num;
+
+		for (j = 0; j < LOG_DEF_MAX_SPECS; j++)
+			w->args[j][row] = d[3 + j];
+
+		if (mod_id < defs->num_alloc &&
+		    entry_num < defs->module_defs[mod_id].num_entries &&
+		    (!app || (defs->module_defs[mod_id].mod_name &&
+			      defs->module_defs[mod_id].mod_name[0])))
+			w->tmpl[row] = log_col_template(w,
+					prog->mod_base[mod_id] + entry_num);
+		else
+			w->tmpl[row] = LOG_COL_NO_TEMPLATE;
+
+		if (++w->len == LOG_COL_GROUP_ROWS && log_col_flush(w))
+			return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Write the last row group, the dictionaries and the footer
+ * @param[in] w - writer
+ * @return 0 on success, negative value on failure
+ */
+int log_col_finish(struct log_col_writer *w)
+{
+	const struct log_defs *defs = w->prog->defs;
+	struct log_col_footer ftr = {
+		.nr_templates = w->nr_strs,
+		.nr_modules = defs->num_alloc,
+	};
+	uint32_t i;
+
+	if (log_col_flush(w))
+		return -1;
+
+	ftr.templates_off = w->off;
+	for (i = 0; i < w->nr_strs; i++)
+		if (log_col_put_str(w, w->strs[i]))
+			return -1;
+
+	ftr.modules_off = w->off;
+	for (i = 0; i < defs->num_alloc; i++)
+		if (log_col_put_str(w, defs->module_defs[i].mod_name))
+			return -1;
+
+	ftr.nr_rows = w->nr_rows;
+	ftr.nr_groups = w->nr_groups;
+	memcpy(ftr.magic, log_col_magic, sizeof(ftr.magic));
+
+	return log_col_put(w, &ftr, sizeof(ftr));
+}
+
+/**
+ * @brief Free a columnar export writer
+ * @param[in] w - writer
+ */
+void log_col_free(struct log_col_writer *w)
+{
+	free(w->ts);
+	free(w->args[0]);
+	free(w->mod);
+	free(w->sev);
+	free(w->ent_tmpl);
+	free(w->hash);
+	free(w->strs);
+	memset(w, 0, sizeof(*w));
+}
+
+#if defined(__linux__) && HAVE_LIBPTHREAD
+
+/* Number of binary log entries formatted by one worker at a time */
+#define LOG_PAR_CHUNK 16384
+
+struct log_par_slot {
+	struct log_fmt_out out;
+	bool done;
+};
+
+struct log_par {
+	const struct log_fmt_prog *prog;
+	const struct log_a_data *data;
+	size_t count;
+	size_t nr_chunks;
+	size_t next;		//!< next chunk to be claimed by a worker
+	size_t written;		//!< chunks already written to the output
+	unsigned int window;	//!< chunks allowed to be in flight
+	struct log_par_slot *slots;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int err;		//!< errno of the first failed worker
+};
+
+static void *log_par_worker(void *arg)
+{
+	struct log_par *par = arg;
+	struct log_par_slot *slot;
+	size_t chunk, first, n;
+	int ret;
+
+	pthread_mutex_lock(&par->lock);
+	while (!par->err && par->next < par->nr_chunks) {
+		/* don't run too far ahead of the writer */
+		if (par->next >= par->written + par->window) {
+			pthread_cond_wait(&par->cond, &par->lock);
+			continue;
+		}
+
+		chunk = par->next++;
+		slot = &par->slots[chunk % par->window];
+		pthread_mutex_unlock(&par->lock);
+
+		first = chunk * LOG_PAR_CHUNK;
+		n = par->count - first;
+		if (n > LOG_PAR_CHUNK)
+			n = LOG_PAR_CHUNK;
+
+		slot->out.len = 0;
+		ret = 0;
+		if (!chunk)
+			ret = log_fmt_write_heading(par->prog, &slot->out);
+		if (!ret)
+			ret = log_fmt_write(par->prog, &slot->out,
+					    par->data + first, n, first);
+
+		pthread_mutex_lock(&par->lock);
+		if (ret && !par->err)
+			par->err = errno;
+		slot->done = true;
+		pthread_cond_broadcast(&par->cond);
+	}
+	pthread_mutex_unlock(&par->lock);
+
+	return NULL;
+}
+
+static int log_par_run(struct log_par *par, FILE *file,
+		       unsigned int nr_threads)
+{
+	struct log_par_slot *slot;
+	pthread_t *threads;
+	unsigned int i, started = 0;
+	int err = 0;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		return -1;
+
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, log_par_worker, par))
+			break;
+		started++;
+	}
+
+	if (!started) {
+		free(threads);
+		return -1;
+	}
+
+	/* write the chunks out in order as the workers finish them */
+	pthread_mutex_lock(&par->lock);
+	while (!par->err && par->written < par->nr_chunks) {
+		slot = &par->slots[par->written % par->window];
+		if (!slot->done) {
+			pthread_cond_wait(&par->cond, &par->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&par->lock);
+
+		if (fwrite(slot->out.buf, 1, slot->out.len, file) !=
+		    slot->out.len)
+			err = SWITCHTEC_ERR_PARSED_LOG_WRITE_ERROR;
+
+		pthread_mutex_lock(&par->lock);
+		if (err && !par->err)
+			par->err = err;
+		slot->done = false;
+		par->written++;
+		pthread_cond_broadcast(&par->cond);
+	}
+	err = par->err;
+	pthread_mutex_unlock(&par->lock);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	if (err) {
+		errno = err;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Format a binary log file using several threads
+ * @param[in]  prog	  - compiled log definitions
+ * @param[in]  out	  - output buffer, flushed before any entry is written
+ * @param[in]  bin	  - binary log file, positioned at the first entry
+ * @param[in]  nr_threads - number of worker threads, 0 for one per CPU
+ * @param[out] nr_entries - number of entries formatted
+ * @return 0 on success, 1 if \p bin can't be parsed in parallel,
+ *	negative value on failure
+ *
+ * The entries are mapped into memory and split into fixed-size chunks
+ * that the workers format into their own buffers. Chunks are written
+ * to the output in order, so the result is identical to log_fmt_write()
+ * over the whole file. On success \p bin is left after the last entry.
+ */
+int log_fmt_write_parallel(const struct log_fmt_prog *prog,
+			   struct log_fmt_out *out, FILE *bin,
+			   unsigned int nr_threads, size_t *nr_entries)
+{
+	struct log_par par = {
+		.prog = prog,
+	};
+	struct stat st;
+	void *map;
+	long off, cpus;
+	unsigned int i;
+	int fd, ret = -1;
+
+	if (!nr_threads) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nr_threads = cpus > 0 ? cpus : 1;
+	}
+
+	if (nr_threads < 2 || !out->file)
+		return 1;
+
+	fd = fileno(bin);
+	off = ftell(bin);
+	if (fd < 0 || off < 0 || fstat(fd, &st) || !S_ISREG(st.st_mode) ||
+	    st.st_size <= off)
+		return 1;
+
+	par.count = (st.st_size - off) / sizeof(*par.data);
+	par.nr_chunks = (par.count + LOG_PAR_CHUNK - 1) / LOG_PAR_CHUNK;
+	if (par.nr_chunks < 2)
+		return 1;
+
+	if (nr_threads > par.nr_chunks)
+		nr_threads = par.nr_chunks;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return 1;
+
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	par.data = (const void *)((const char *)map + off);
+
+	if (log_fmt_out_flush(out))
+		goto out_unmap;
+
+	par.window = nr_threads * 2;
+	par.slots = calloc(par.window, sizeof(*par.slots));
+	if (!par.slots)
+		goto out_unmap;
+
+	for (i = 0; i < par.window; i++)
+		if (log_fmt_out_init(&par.slots[i].out, NULL))
+			goto out_free_slots;
+
+	pthread_mutex_init(&par.lock, NULL);
+	pthread_cond_init(&par.cond, NULL);
+
+	ret = log_par_run(&par, out->file, nr_threads);
+
+	pthread_cond_destroy(&par.cond);
+	pthread_mutex_destroy(&par.lock);
+
+	if (!ret) {
+		*nr_entries = par.count;
+		fseek(bin, off + par.count * sizeof(*par.data), SEEK_SET);
+	}
+
+out_free_slots:
+	for (i = 0; i < par.window; i++)
+		log_fmt_out_free(&par.slots[i].out);
+	free(par.slots);
+out_unmap:
+	munmap(map, st.st_size);
+	return ret;
+}
+
+#else
+
+int log_fmt_write_parallel(const struct log_fmt_prog *prog,
+			   struct log_fmt_out *out, FILE *bin,
+			   unsigned int nr_threads, size_t *nr_entries)
+{
+	return 1;
+}
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef LIBSWITCHTEC_LOG_PRIV_H
+#define LIBSWITCHTEC_LOG_PRIV_H
+
+#include "switchtec/switchtec.h"
+#include "switchtec/log.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Maximum number of arguments an app/mailbox log entry carries */
+#define LOG_DEF_MAX_SPECS 5
+
+/**
+ * @brief Location of one conversion specifier within a format string
+ */
+struct log_def_spec {
+	uint16_t off;		//!< offset of the '%'
+	uint16_t len;		//!< length up to and including the conversion
+};
+
+/**
+ * @brief A log entry format string with its conversions pre-split
+ */
+struct log_def_fmt {
+	uint32_t str;		//!< arena offset of the format string
+	uint16_t len;		//!< length of the format string
+	uint8_t nr_specs;	//!< number of conversions (excluding "%%")
+	uint8_t rsvd;
+	struct log_def_spec spec[LOG_DEF_MAX_SPECS];
+};
+
+/**
+ * @brief Module-specific log definitions
+ */
+struct module_log_defs {
+	char *mod_name;		//!< module name
+	char **entries;		//!< log entry array
+	int num_entries;	//!< number of log entries
+
+	/** pre-split formats, only set when loaded from a compiled file */
+	const struct log_def_fmt *fmts;
+};
+
+/**
+ * @brief Log definitions for all modules
+ */
+struct log_defs {
+	struct module_log_defs *module_defs;	//!< per-module log definitions
+	int num_alloc;				//!< number of modules allocated
+
+	void *bin;		//!< compiled definition image, if any
+	size_t bin_len;		//!< length of the compiled image
+	char **bin_entries;	//!< entry pointers into the compiled image
+};
+
+/**
+ * @brief One step of a compiled log entry format
+ */
+struct log_fmt_op {
+	uint16_t off;		//!< literal: offset in the format string
+	uint16_t len;		//!< literal: number of bytes to copy
+	uint16_t width;		//!< conversion: minimum field width
+	int16_t prec;		//!< conversion: precision, -1 if not given
+	uint8_t type;		//!< literal or integer conversion
+	uint8_t conv;		//!< conversion character
+	uint8_t flags;		//!< conversion flags
+	uint8_t arg;		//!< conversion: argument dword index
+};
+
+/**
+ * @brief Compiled form of one log entry format
+ */
+struct log_fmt_entry {
+	const char *fmt;	//!< original format string
+	uint32_t first_op;	//!< index of the first op
+	uint32_t max_len;	//!< upper bound of the formatted length
+	uint16_t nr_ops;	//!< number of ops
+	uint16_t fallback;	//!< format needs the C library printf
+};
+
+/**
+ * @brief Log definitions compiled for formatting
+ *
+ * Read-only once built, so it may be shared between threads.
+ */
+struct log_fmt_prog {
+	struct log_defs *defs;
+	enum switchtec_log_parse_type log_type;
+	int ts_factor;
+
+	bool wall_time;		//!< print timestamps as UTC date and time
+	uint64_t boot_ns;	//!< wall clock time of device tick zero
+	const char *src;	//!< source name printed in front of each entry
+
+	uint32_t *mod_base;		//!< first entry of each module, and the total
+	struct log_fmt_entry *ents;	//!< all entries
+	struct log_fmt_op *ops;		//!< ops of all entries
+};
+
+/* log_file_header.flags: the header holds a host time correlation */
+#define LOG_FILE_HDR_TIME_SYNC	(1 << 0)
+
+/**
+ * @brief Header of binary log files
+ *
+ * With LOG_FILE_HDR_TIME_SYNC set, the wall clock time (ns since the
+ * epoch) of device tick zero is stored in boot_ns_lo/hi and the
+ * uncertainty of that correlation in sync_err_us.
+ */
+struct log_file_header {
+	uint8_t magic[8];
+	uint32_t fw_version;
+	uint32_t sdk_version;
+	uint32_t flags;
+	uint32_t boot_ns_lo;
+	uint32_t boot_ns_hi;
+	uint32_t sync_err_us;
+};
+
+/**
+ * @brief Output buffer for formatted log entries
+ *
+ * If \p file is set the buffer is written out whenever it fills up,
+ * otherwise it grows to hold all of the output.
+ */
+struct log_fmt_out {
+	FILE *file;
+	char *buf;
+	size_t len;
+	size_t cap;
+};
+
+/**
+ * @brief Writer of the columnar log export format
+ *
+ * Entries are buffered one row group at a time, so memory use does not
+ * depend on the size of the log.
+ */
+struct log_col_writer {
+	const struct log_fmt_prog *prog;
+	FILE *file;
+	uint64_t off;		//!< bytes written so far
+	uint64_t nr_rows;
+	uint32_t nr_groups;
+	uint32_t len;		//!< rows in the current group
+
+	/* columns of the current group */
+	uint64_t *ts;
+	uint32_t *args[LOG_DEF_MAX_SPECS];
+	uint32_t *tmpl;
+	uint16_t *mod;
+	uint16_t *ent;
+	uint8_t *sev;
+
+	/* template dictionary */
+	uint32_t *ent_tmpl;	//!< template of each entry, +1 (0 = unseen)
+	uint32_t *hash;		//!< template ids + 1, by string hash
+	uint32_t hash_mask;
+	const char **strs;
+	uint32_t nr_strs;
+};
+
+int log_def_parse_header(FILE *log_def_file, uint32_t *fw_version,
+			 uint32_t *sdk_version);
+int log_def_split_fmt(const char *fmt, struct log_def_spec *spec,
+		      int max_specs);
+int log_defs_read(FILE *log_def_file, enum switchtec_log_def_type type,
+		  uint32_t fw_version, uint32_t sdk_version,
+		  struct log_defs *defs);
+void log_defs_free(struct log_defs *defs);
+
+int log_fmt_prog_init(struct log_fmt_prog *prog, struct log_defs *defs,
+		      enum switchtec_log_parse_type log_type, int ts_factor);
+void log_fmt_prog_free(struct log_fmt_prog *prog);
+int log_fmt_out_init(struct log_fmt_out *out, FILE *file);
+int log_fmt_out_flush(struct log_fmt_out *out);
+void log_fmt_out_free(struct log_fmt_out *out);
+int log_fmt_write_heading(const struct log_fmt_prog *prog,
+			  struct log_fmt_out *out);
+int log_fmt_write(const struct log_fmt_prog *prog, struct log_fmt_out *out,
+		  const struct log_a_data *log_data, size_t count,
+		  unsigned int entry_idx);
+int log_fmt_write_parallel(const struct log_fmt_prog *prog,
+			   struct log_fmt_out *out, FILE *bin,
+			   unsigned int nr_threads, size_t *nr_entries);
+int log_col_init(struct log_col_writer *w, const struct log_fmt_prog *prog,
+		 FILE *file, uint32_t fw_version, uint32_t sdk_version);
+int log_col_write(struct log_col_writer *w,
+		  const struct log_a_data *log_data, size_t count);
+int log_col_finish(struct log_col_writer *w);
+void log_col_free(struct log_col_writer *w);
+
+#endif
@@ -0,0 +1,470 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+/**
+ * @file
+ * @brief Switchtec core library functions for the shared memory metrics
+ *	segment
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+#include "switchtec/switchtec.h"
+#include "switchtec/metrics.h"
+#include "switchtec/errors.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @defgroup Metrics Shared Memory Metrics
+ * @brief Publish device metrics for any number of local readers
+ *
+ * switchtec_metrics_pub_open() and switchtec_metrics_pub_update() sample
+ * the performance counters, die temperatures and link status of a
+ * device and write them into a file in /dev/shm laid out as struct
+ * switchtec_metrics. switchtec_metrics_open() and
+ * switchtec_metrics_read() let other processes get a consistent copy of
+ * the latest values without sending any commands to the device.
+ *
+ * @{
+ */
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define METRICS_READ_TRIES 1000
+
+/* readers built against other versions rely on this exact layout */
+_Static_assert(sizeof(struct switchtec_metrics_hdr) == 64,
+	       "metrics header must be one cache line");
+_Static_assert(sizeof(struct switchtec_metrics_dev) == 64,
+	       "metrics device data must be one cache line");
+_Static_assert(sizeof(struct switchtec_metrics_port) == 128,
+	       "metrics port entries must be two cache lines");
+
+struct switchtec_metrics_pub {
+	struct switchtec_dev *dev;
+	struct switchtec_pmon_session *session;
+	struct switchtec_metrics *seg;
+	char *path;
+	int fd;
+
+	/* the next contents of the segment, built before taking the lock */
+	struct switchtec_metrics next;
+};
+
+struct switchtec_metrics_reader {
+	const struct switchtec_metrics *seg;
+	int fd;
+};
+
+static uint64_t metrics_now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static void metrics_write(struct switchtec_metrics *seg,
+			  const struct switchtec_metrics *m)
+{
+	const size_t start = sizeof(m->hdr.magic);
+	const size_t seq_off = offsetof(struct switchtec_metrics, hdr.seq);
+	const size_t rest = seq_off + sizeof(m->hdr.seq);
+	/* a publisher that died while writing may have left it odd */
+	uint32_t seq = seg->hdr.seq & ~1U;
+
+	__atomic_store_n(&seg->hdr.seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	/* everything but the magic and the sequence lock itself */
+	memcpy((char *)seg + start, (const char *)m + start, seq_off - start);
+	memcpy((char *)seg + rest, (const char *)m + rest, sizeof(*m) - rest);
+
+	__atomic_store_n(&seg->hdr.seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Start publishing the metrics of a device
+ * @param[in] dev	Switchtec device handle
+ * @param[in] path	File to publish to, usually in /dev/shm
+ * @param[in] flags	Performance counters to sample (see
+ *	enum switchtec_pmon_flags)
+ * @return The publisher on success, NULL on failure
+ *
+ * The file is created if needed. Only one publisher can hold a file at
+ * a time, a second one fails with EBUSY. Nothing is sampled until the
+ * first call to switchtec_metrics_pub_update().
+ */
+struct switchtec_metrics_pub *
+switchtec_metrics_pub_open(struct switchtec_dev *dev, const char *path,
+			   unsigned flags)
+{
+	struct switchtec_metrics_pub *pub;
+	struct switchtec_metrics_hdr *hdr;
+
+	pub = calloc(1, sizeof(*pub));
+	if (!pub)
+		return NULL;
+
+	pub->fd = -1;
+	pub->dev = dev;
+	pub->path = strdup(path);
+	if (!pub->path)
+		goto err;
+
+	/* latency is published per update, bandwidth as running totals */
+	pub->session = switchtec_pmon_session_open(dev, (flags &
+			(SWITCHTEC_PMON_BW | SWITCHTEC_PMON_LAT)) |
+			SWITCHTEC_PMON_LAT_CLEAR);
+	if (!pub->session)
+		goto err;
+
+	pub->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (pub->fd < 0)
+		goto err;
+
+	/* held until the file is closed, readers do not take it */
+	if (flock(pub->fd, LOCK_EX | LOCK_NB)) {
+		if (errno == EWOULDBLOCK)
+			errno = EBUSY;
+		goto err;
+	}
+
+	if (ftruncate(pub->fd, sizeof(*pub->seg)))
+		goto err;
+
+	pub->seg = mmap(NULL, sizeof(*pub->seg), PROT_READ | PROT_WRITE,
+			MAP_SHARED, pub->fd, 0);
+	if (pub->seg == MAP_FAILED) {
+		pub->seg = NULL;
+		goto err;
+	}
+
+	hdr = &pub->next.hdr;
+	hdr->version = SWITCHTEC_METRICS_VERSION;
+	hdr->hdr_size = sizeof(pub->next.hdr) + sizeof(pub->next.dev);
+	hdr->port_size = sizeof(pub->next.ports[0]);
+	hdr->max_ports = SWITCHTEC_MAX_PORTS;
+	hdr->publisher_pid = getpid();
+	hdr->flags = flags & (SWITCHTEC_PMON_BW | SWITCHTEC_PMON_LAT);
+
+	strncpy(pub->next.dev.name, switchtec_name(dev),
+		sizeof(pub->next.dev.name) - 1);
+	pub->next.dev.gen = switchtec_gen(dev);
+
+	/*
+	 * Readers check the magic last, so it is only written once the
+	 * rest of the header is in place.
+	 */
+	metrics_write(pub->seg, &pub->next);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(pub->seg->hdr.magic, SWITCHTEC_METRICS_MAGIC,
+	       sizeof(pub->seg->hdr.magic));
+
+	return pub;
+
+err:
+	switchtec_metrics_pub_close(pub);
+	return NULL;
+}
+
+static void metrics_fill_ports(struct switchtec_metrics *m,
+			       const struct switchtec_pmon_sample *sample,
+			       int new_map)
+{
+	const struct switchtec_status *s;
+	struct switchtec_metrics_port *mp;
+	struct switchtec_bwcntr_res delta;
+	int i;
+
+	for (i = 0; i < sample->nr_ports; i++) {
+		s = &sample->status[i];
+		mp = &m->ports[i];
+
+		mp->partition = s->port.partition;
+		mp->stack = s->port.stack;
+		mp->upstream = s->port.upstream;
+		mp->stk_id = s->port.stk_id;
+		mp->phys_id = s->port.phys_id;
+		mp->log_id = s->port.log_id;
+		mp->link_up = s->link_up;
+		mp->link_rate = s->link_rate;
+		mp->cfg_lnk_width = s->cfg_lnk_width;
+		mp->neg_lnk_width = s->neg_lnk_width;
+		mp->ltssm = s->ltssm;
+
+		if (sample->lat_cur_ns) {
+			mp->lat_cur_ns = sample->lat_cur_ns[i];
+			mp->lat_max_ns = sample->lat_max_ns[i];
+		}
+
+		if (!sample->bw)
+			continue;
+
+		delta = sample->bw[i];
+		switchtec_bwcntr_sub(&delta, &mp->bw);
+		mp->bw = sample->bw[i];
+
+		if (new_map || !delta.time_us) {
+			mp->egress_rate = 0;
+			mp->ingress_rate = 0;
+			continue;
+		}
+
+		mp->egress_rate = switchtec_bwcntr_tot(&delta.egress) /
+			(delta.time_us * 1e-6);
+		mp->ingress_rate = switchtec_bwcntr_tot(&delta.ingress) /
+			(delta.time_us * 1e-6);
+	}
+}
+
+/**
+ * @brief Sample the device and publish the results
+ * @param[in] pub	Metrics publisher
+ * @return 0 on success, error code on failure
+ *
+ * Readers see either the previous or the new contents of the segment,
+ * never a mix of both. The latency counters are cleared by each update,
+ * so the published latencies cover the time since the previous update.
+ */
+int switchtec_metrics_pub_update(struct switchtec_metrics_pub *pub)
+{
+	struct switchtec_metrics *m = &pub->next;
+	struct switchtec_pmon_sample sample;
+	uint64_t now;
+	int ret, new_map;
+
+	ret = switchtec_pmon_sample(pub->session, 0, &sample);
+	if (ret)
+		return ret;
+
+	ret = switchtec_die_temps(pub->dev, SWITCHTEC_METRICS_MAX_TEMPS,
+				  m->dev.die_temp);
+	m->dev.nr_temps = ret > 0 ? ret : 0;
+
+	new_map = !m->hdr.sample_count ||
+		sample.generation != m->hdr.generation;
+	if (new_map)
+		memset(m->ports, 0, sizeof(m->ports));
+
+	metrics_fill_ports(m, &sample, new_map);
+
+	now = metrics_now_us();
+	m->hdr.interval_us = m->hdr.update_us ? now - m->hdr.update_us : 0;
+	m->hdr.update_us = now;
+	m->hdr.nr_ports = sample.nr_ports;
+	m->hdr.generation = sample.generation;
+	m->hdr.sample_count++;
+
+	metrics_write(pub->seg, m);
+
+	return 0;
+}
+
+/**
+ * @brief Stop publishing metrics
+ * @param[in] pub	Metrics publisher
+ *
+ * The segment is left in place with its publisher_pid cleared, so
+ * readers can tell that its values are no longer updated.
+ */
+void switchtec_metrics_pub_close(struct switchtec_metrics_pub *pub)
+{
+	if (!pub)
+		return;
+
+	if (pub->seg) {
+		pub->next.hdr.publisher_pid = 0;
+		metrics_write(pub->seg, &pub->next);
+		munmap(pub->seg, sizeof(*pub->seg));
+	}
+
+	if (pub->fd >= 0)
+		close(pub->fd);
+
+	switchtec_pmon_session_close(pub->session);
+	free(pub->path);
+	free(pub);
+}
+
+/**
+ * @brief Open a metrics segment for reading
+ * @param[in] path	File the metrics are published to
+ * @return The reader on success, NULL on failure
+ *
+ * Fails with SWITCHTEC_ERR_METRICS_INVAL if the file is not a metrics
+ * segment of a compatible version.
+ */
+struct switchtec_metrics_reader *switchtec_metrics_open(const char *path)
+{
+	struct switchtec_metrics_reader *r;
+	const struct switchtec_metrics_hdr *hdr;
+	struct stat st;
+
+	r = calloc(1, sizeof(*r));
+	if (!r)
+		return NULL;
+
+	r->fd = open(path, O_RDONLY);
+	if (r->fd < 0)
+		goto err;
+
+	if (fstat(r->fd, &st))
+		goto err;
+
+	if (st.st_size < sizeof(*r->seg)) {
+		errno = SWITCHTEC_ERR_METRICS_INVAL;
+		goto err;
+	}
+
+	r->seg = mmap(NULL, sizeof(*r->seg), PROT_READ, MAP_SHARED, r->fd, 0);
+	if (r->seg == MAP_FAILED) {
+		r->seg = NULL;
+		goto err;
+	}
+
+	hdr = &r->seg->hdr;
+	if (memcmp(hdr->magic, SWITCHTEC_METRICS_MAGIC, sizeof(hdr->magic)))
+		goto inval;
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	if (hdr->version != SWITCHTEC_METRICS_VERSION ||
+	    hdr->hdr_size != sizeof(r->seg->hdr) + sizeof(r->seg->dev) ||
+	    hdr->port_size != sizeof(r->seg->ports[0]) ||
+	    hdr->max_ports != SWITCHTEC_MAX_PORTS)
+		goto inval;
+
+	return r;
+
+inval:
+	errno = SWITCHTEC_ERR_METRICS_INVAL;
+err:
+	switchtec_metrics_close(r);
+	return NULL;
+}
+
+/**
+ * @brief Get a consistent copy of the latest published metrics
+ * @param[in]  r	Metrics reader
+ * @param[out] m	Copy of the segment
+ * @return 0 on success, error code on failure
+ *
+ * This does not communicate with the device at all. Check
+ * m->hdr.update_us and m->hdr.publisher_pid to see how current the values
+ * are.
+ */
+int switchtec_metrics_read(struct switchtec_metrics_reader *r,
+			   struct switchtec_metrics *m)
+{
+	uint32_t seq;
+	int i;
+
+	for (i = 0; i < METRICS_READ_TRIES; i++) {
+		seq = __atomic_load_n(&r->seg->hdr.seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+
+		memcpy(m, r->seg, sizeof(*m));
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&r->seg->hdr.seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
+
+/**
+ * @brief Close a metrics segment
+ * @param[in] r		Metrics reader
+ */
+void switchtec_metrics_close(struct switchtec_metrics_reader *r)
+{
+	if (!r)
+		return;
+
+	if (r->seg)
+		munmap((void *)r->seg, sizeof(*r->seg));
+	if (r->fd >= 0)
+		close(r->fd);
+	free(r);
+}
+
+#else /* __linux__ */
+
+struct switchtec_metrics_pub *
+switchtec_metrics_pub_open(struct switchtec_dev *dev, const char *path,
+			   unsigned flags)
+{
+	errno = ENOTSUP;
+	return NULL;
+}
+
+int switchtec_metrics_pub_update(struct switchtec_metrics_pub *pub)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+void switchtec_metrics_pub_close(struct switchtec_metrics_pub *pub)
+{
+}
+
+struct switchtec_metrics_reader *switchtec_metrics_open(const char *path)
+{
+	errno = ENOTSUP;
+	return NULL;
+}
+
+int switchtec_metrics_read(struct switchtec_metrics_reader *r,
+			   struct switchtec_metrics *m)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+void switchtec_metrics_close(struct switchtec_metrics_reader *r)
+{
+}
+
+#endif /* __linux__ */
+
+/**@}*/
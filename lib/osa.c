@@ -0,0 +1,349 @@
+/*
+ * Microsemi Switchtec(tm) PCIe Management Library
+ * Copyright (c) 2017, Microsemi Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @file
+ * @brief Switchtec core library functions for streaming OSA captures
+ */
+
+#define SWITCHTEC_LIB_CORE
+
+#include "switchtec_priv.h"
+#include "switchtec/switchtec.h"
+#include "switchtec/osa.h"
+#include "switchtec/endian.h"
+#include "switchtec/errors.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+/**
+ * @defgroup OSAStream Streaming OSA Captures
+ * @brief Drain ordered set analyzer captures straight to a binary trace
+ *
+ * switchtec_osa_stream_open() and switchtec_osa_stream_poll() read the
+ * captures of any number of lanes, on one or more stacks, in the largest
+ * chunks an MRPC can carry. Each chunk is written to the trace as it
+ * arrives, as the raw entries the switch returned, so reading a capture
+ * costs no formatting and no memory beyond one chunk.
+ *
+ * switchtec_osa_trace_read_hdr() and switchtec_osa_trace_read() decode
+ * such a trace offline, one chunk at a time.
+ *
+ * @{
+ */
+
+struct osa_stream_lane {
+	struct switchtec_osa_lane id;
+	int started;		//!< the first and total entries are known
+	int done;
+	int wrap;
+	int next_entry;
+	int remaining;
+	int total;
+	int written;
+};
+
+struct switchtec_osa_stream {
+	struct switchtec_dev *dev;
+	FILE *f;
+	int nr_lanes;
+	struct osa_stream_lane *lanes;
+	struct switchtec_osa_read rd;
+};
+
+/**
+ * @brief Start streaming the OSA captures of a set of lanes to a file
+ * @param[in] dev	Switchtec device handle
+ * @param[in] f		File to write the trace to
+ * @param[in] lanes	Lanes to read the captures of
+ * @param[in] nr_lanes	Number of lanes
+ * @return The stream on success, NULL on failure
+ *
+ * The analyzer should be stopped on the stacks of all \p lanes. The
+ * stream must be finished with switchtec_osa_stream_close(), which does
+ * not close \p f.
+ */
+struct switchtec_osa_stream *
+switchtec_osa_stream_open(struct switchtec_dev *dev, FILE *f,
+			  const struct switchtec_osa_lane *lanes,
+			  int nr_lanes)
+{
+	struct switchtec_osa_trace_hdr hdr = {
+		.version = htole32(SWITCHTEC_OSA_TRACE_VERSION),
+		.hdr_size = htole32(sizeof(hdr)),
+		.rec_hdr_size = htole32(sizeof(struct switchtec_osa_trace_rec_hdr)),
+		.gen = htole32(switchtec_gen(dev)),
+	};
+	struct switchtec_osa_stream *s;
+	struct timeval tv;
+	int i;
+
+	if (nr_lanes <= 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	s->lanes = calloc(nr_lanes, sizeof(*s->lanes));
+	if (!s->lanes)
+		goto err;
+
+	s->dev = dev;
+	s->f = f;
+	s->nr_lanes = nr_lanes;
+	for (i = 0; i < nr_lanes; i++)
+		s->lanes[i].id = lanes[i];
+
+	gettimeofday(&tv, NULL);
+	hdr.time_us = htole64(tv.tv_sec * 1000000ULL + tv.tv_usec);
+	memcpy(hdr.magic, SWITCHTEC_OSA_TRACE_MAGIC, sizeof(hdr.magic));
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1)
+		goto err;
+
+	return s;
+
+err:
+	free(s->lanes);
+	free(s);
+	return NULL;
+}
+
+static int osa_stream_write(struct switchtec_osa_stream *s,
+			    struct osa_stream_lane *l, int first_entry)
+{
+	struct switchtec_osa_trace_rec_hdr hdr = {
+		.stack_id = l->id.stack_id,
+		.lane = l->id.lane,
+		.direction = l->id.direction,
+		.flags = l->wrap ? SWITCHTEC_OSA_TRACE_WRAP : 0,
+		.first_entry = htole16(first_entry),
+		.nr_entries = htole16(s->rd.entries_read),
+	};
+	int i, j;
+
+	for (i = 0; i < s->rd.entries_read; i++)
+		for (j = 0; j < SWITCHTEC_OSA_ENTRY_DWORDS; j++)
+			s->rd.entries[i][j] = htole32(s->rd.entries[i][j]);
+
+	if (fwrite(&hdr, sizeof(hdr), 1, s->f) != 1 ||
+	    fwrite(s->rd.entries, sizeof(s->rd.entries[0]),
+		   s->rd.entries_read, s->f) != s->rd.entries_read)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * @brief Read the next chunk of every lane of an OSA stream
+ * @param[in] s		OSA stream
+ * @return The number of entries written, 0 once every capture has been
+ *	read, or a negative value on failure
+ *
+ * Lanes take turns, so all captures progress together.
+ */
+int switchtec_osa_stream_poll(struct switchtec_osa_stream *s)
+{
+	struct osa_stream_lane *l;
+	int ret, n, first, written = 0;
+
+	for (l = s->lanes; l < s->lanes + s->nr_lanes; l++) {
+		if (l->done)
+			continue;
+
+		if (!l->started) {
+			ret = switchtec_osa_read_entries(s->dev, l->id.stack_id,
+					l->id.lane, l->id.direction, 0, 0,
+					&s->rd);
+			if (ret)
+				return ret < 0 ? ret : -1;
+
+			l->started = 1;
+			l->next_entry = s->rd.next_entry;
+			l->remaining = s->rd.entries_remaining;
+			l->total = s->rd.entries_remaining;
+			l->wrap = s->rd.wrap;
+		}
+
+		if (!l->remaining) {
+			l->done = 1;
+			continue;
+		}
+
+		n = l->remaining < SWITCHTEC_OSA_MAX_READ ?
+			l->remaining : SWITCHTEC_OSA_MAX_READ;
+		first = l->next_entry;
+		ret = switchtec_osa_read_entries(s->dev, l->id.stack_id,
+						 l->id.lane, l->id.direction,
+						 first, n, &s->rd);
+		if (ret)
+			return ret < 0 ? ret : -1;
+
+		/* the switch has nothing more, even if it said otherwise */
+		if (!s->rd.entries_read) {
+			l->done = 1;
+			continue;
+		}
+
+		ret = osa_stream_write(s, l, first);
+		if (ret)
+			return ret;
+
+		l->next_entry = s->rd.next_entry;
+		l->remaining = s->rd.entries_remaining;
+		l->written += s->rd.entries_read;
+		written += s->rd.entries_read;
+	}
+
+	return written;
+}
+
+/**
+ * @brief Get the progress of a lane of an OSA stream
+ * @param[in]  s	OSA stream
+ * @param[in]  idx	Index of the lane, as passed to
+ *	switchtec_osa_stream_open()
+ * @param[out] written	Entries written so far
+ * @param[out] total	Entries the capture held when it was first read
+ * @return 0 on success, -1 on failure
+ */
+int switchtec_osa_stream_lane_entries(struct switchtec_osa_stream *s,
+				      int idx, int *written, int *total)
+{
+	if (idx < 0 || idx >= s->nr_lanes) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	*written = s->lanes[idx].written;
+	*total = s->lanes[idx].total;
+	return 0;
+}
+
+/**
+ * @brief Finish an OSA stream
+ * @param[in] s		OSA stream
+ * @return 0 on success, -1 if the trace could not be flushed
+ */
+int switchtec_osa_stream_close(struct switchtec_osa_stream *s)
+{
+	int ret;
+
+	if (!s)
+		return 0;
+
+	ret = fflush(s->f) ? -1 : 0;
+	free(s->lanes);
+	free(s);
+
+	return ret;
+}
+
+/**
+ * @brief Read the header of an OSA trace file
+ * @param[in]  f	Trace file, positioned at its start
+ * @param[out] info	Settings of the trace
+ * @return 0 on success, -1 on failure
+ */
+int switchtec_osa_trace_read_hdr(FILE *f,
+				 struct switchtec_osa_trace_info *info)
+{
+	struct switchtec_osa_trace_hdr hdr;
+	size_t hdr_size;
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1)
+		goto inval;
+
+	hdr_size = le32toh(hdr.hdr_size);
+	if (memcmp(hdr.magic, SWITCHTEC_OSA_TRACE_MAGIC, sizeof(hdr.magic)) ||
+	    le32toh(hdr.version) != SWITCHTEC_OSA_TRACE_VERSION ||
+	    hdr_size < sizeof(hdr) ||
+	    le32toh(hdr.rec_hdr_size) !=
+			sizeof(struct switchtec_osa_trace_rec_hdr))
+		goto inval;
+
+	if (hdr_size > sizeof(hdr) &&
+	    fseek(f, hdr_size - sizeof(hdr), SEEK_CUR))
+		return -1;
+
+	info->gen = le32toh(hdr.gen);
+	info->time_us = le64toh(hdr.time_us);
+	return 0;
+
+inval:
+	errno = SWITCHTEC_ERR_OSA_TRACE_INVAL;
+	return -1;
+}
+
+/**
+ * @brief Read and decode the next record of an OSA trace file
+ * @param[in]  f	Trace file, positioned after the header
+ * @param[out] rec	Decoded record
+ * @return 1 if a record was read, 0 at the end of the file, -1 on
+ *	failure
+ */
+int switchtec_osa_trace_read(FILE *f, struct switchtec_osa_trace_rec *rec)
+{
+	struct switchtec_osa_trace_rec_hdr hdr;
+	uint32_t raw[SWITCHTEC_OSA_MAX_READ][SWITCHTEC_OSA_ENTRY_DWORDS];
+	size_t len;
+	int i, j;
+
+	len = fread(&hdr, 1, sizeof(hdr), f);
+	if (!len && !ferror(f))
+		return 0;
+	if (len != sizeof(hdr))
+		goto inval;
+
+	rec->lane.stack_id = hdr.stack_id;
+	rec->lane.lane = hdr.lane;
+	rec->lane.direction = hdr.direction;
+	rec->wrap = !!(hdr.flags & SWITCHTEC_OSA_TRACE_WRAP);
+	rec->first_entry = le16toh(hdr.first_entry);
+	rec->nr_entries = le16toh(hdr.nr_entries);
+
+	if (rec->nr_entries > SWITCHTEC_OSA_MAX_READ ||
+	    fread(raw, sizeof(raw[0]), rec->nr_entries, f) != rec->nr_entries)
+		goto inval;
+
+	for (i = 0; i < rec->nr_entries; i++) {
+		for (j = 0; j < SWITCHTEC_OSA_ENTRY_DWORDS; j++)
+			raw[i][j] = le32toh(raw[i][j]);
+		switchtec_osa_decode_entry(raw[i], &rec->entries[i]);
+	}
+
+	return 1;
+
+inval:
+	if (!ferror(f))
+		errno = SWITCHTEC_ERR_OSA_TRACE_INVAL;
+	return -1;
+}
+
+/**@}*/
@@ -615,7 +615,7 @@ struct switchtec_dev *switchtec_open_eth(const char *ip, const int inst)
 {
 	struct switchtec_eth *edev;
 
-	edev = malloc(sizeof(*edev));
+	edev = calloc(1, sizeof(*edev));
 	if (!edev)
 		return NULL;
 
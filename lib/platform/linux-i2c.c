@@ -659,7 +659,7 @@ struct switchtec_dev *switchtec_open_i2c(const char *path, int i2c_addr)
 {
 	struct switchtec_i2c *idev;
 
-	idev = malloc(sizeof(*idev));
+	idev = calloc(1, sizeof(*idev));
 	if (!idev)
 		return NULL;
 
@@ -505,7 +505,7 @@ struct switchtec_dev *switchtec_open_uart(int fd)
 	int ret;
 	struct switchtec_uart *udev;
 
-	udev = malloc(sizeof(*udev));
+	udev = calloc(1, sizeof(*udev));
 	if (!udev)
 		return NULL;
 
@@ -1056,7 +1056,7 @@ struct switchtec_dev *switchtec_open_by_path(const char *path)
 	else
 		errno = 0;
 
-	ldev = malloc(sizeof(*ldev));
+	ldev = calloc(1, sizeof(*ldev));
 	if (!ldev)
 		return NULL;
 
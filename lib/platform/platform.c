@@ -103,6 +103,7 @@ void switchtec_close(struct switchtec_dev *dev)
 	if (!dev)
 		return;
 
+	switchtec_fw_part_summary_invalidate(dev);
 	dev->ops->close(dev);
 }
 
@@ -185,6 +186,10 @@ int switchtec_cmd(struct switchtec_dev *dev,  uint32_t cmd,
 	if (!switchtec_is_gen6(dev))
 		cmd |= dev->pax_id << SWITCHTEC_PAX_ID_SHIFT;
 
+	if (dev->fw_summary && switchtec_fw_cmd_changes_parts(cmd, payload,
+							 payload_len))
+		switchtec_fw_part_summary_invalidate(dev);
+
 	ret = dev->ops->cmd(dev, cmd, payload, payload_len, resp, resp_len);
 	if (ret > 0) {
 		mrpc_error_cmd = cmd & SWITCHTEC_CMD_MASK;
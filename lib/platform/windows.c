@@ -462,7 +462,7 @@ struct switchtec_dev *switchtec_open_by_path(const char *path)
 	if (sscanf(path, "/dev/switchtec%d", &idx) == 1)
 		return switchtec_open_by_index(idx);
 
-	wdev = malloc(sizeof(*wdev));
+	wdev = calloc(1, sizeof(*wdev));
 	if (!wdev)
 		return NULL;
 
@@ -33,9 +33,14 @@
 #include "switchtec_priv.h"
 #include "switchtec/switchtec.h"
 #include "switchtec/endian.h"
+#include "switchtec/utils.h"
 
 #include <stddef.h>
 #include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
 
 /**
  * @defgroup PMON Performance Monitor
@@ -54,6 +59,20 @@
  * and query latency counter measurements to find out how long packets
  * take to traverse the switch.
  *
+ * switchtec_pmon_session_open() and switchtec_pmon_sample() may be used
+ * to repeatedly sample the counters of all ports without querying the
+ * port map every time.
+ *
+ * switchtec_lat_sampler_open() and switchtec_lat_sampler_poll() may be
+ * used to collect the latency distribution of every port and report
+ * its percentiles over a sliding window.
+ *
+ * switchtec_evcntr_sampler_open() and switchtec_evcntr_sampler_poll()
+ * may be used to track per-port event rates over time.
+ *
+ * switchtec_bw_analyzer_update() and switchtec_bw_analyzer_top() may be
+ * used to rank ports by bandwidth and flag sudden changes in traffic.
+ *
  * @{
  */
 
@@ -167,6 +186,70 @@ int switchtec_evcntr_setup(struct switchtec_dev *dev, unsigned stack_id,
 			     NULL, 0);
 }
 
+/**
+ * @brief Setup a number of consecutive event counters
+ * @param[in] dev	Switchtec device handle
+ * @param[in] stack_id	Stack to setup the counters in
+ * @param[in] cntr_id   First counter ID to setup
+ * @param[in] nr_cntrs	Number of counters to setup
+ * @param[in] setups	Event counter setup structures
+ *	(at least \p nr_cntrs elements)
+ * @return 0 on success, error code on failure
+ *
+ * As many counters as fit are set up with each command.
+ */
+int switchtec_evcntr_setup_many(struct switchtec_dev *dev, unsigned stack_id,
+				unsigned cntr_id, unsigned nr_cntrs,
+				struct switchtec_evcntr_setup *setups)
+{
+	struct pmon_event_counter_setup cmd = {
+		.sub_cmd_id = MRPC_PMON_SETUP_EV_COUNTER,
+		.stack_id = stack_id,
+	};
+	unsigned cmd_max_count = ARRAY_SIZE(cmd.counters);
+	struct switchtec_evcntr_setup *setup;
+	size_t cmd_size;
+	int i, ret;
+
+	if (cntr_id >= SWITCHTEC_MAX_EVENT_COUNTERS ||
+	    nr_cntrs > SWITCHTEC_MAX_EVENT_COUNTERS - cntr_id) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	while (nr_cntrs) {
+		cmd.counter_id = cntr_id;
+		cmd.num_counters = nr_cntrs;
+		if (cmd.num_counters > cmd_max_count)
+			cmd.num_counters = cmd_max_count;
+
+		for (i = 0; i < cmd.num_counters; i++) {
+			setup = &setups[i];
+			cmd.counters[i].mask = htole32((setup->type_mask << 8) |
+						(setup->port_mask & 0xFF));
+			cmd.counters[i].ieg = (setup->egress ?
+					SWITCHTEC_PMON_EVENT_EGRESS :
+					SWITCHTEC_PMON_EVENT_INGRESS) |
+				((setup->type_mask >> 24) & 0x7F);
+			cmd.counters[i].thresh = htole32(setup->threshold);
+		}
+
+		cmd_size = offsetof(struct pmon_event_counter_setup,
+				    counters) +
+			sizeof(cmd.counters[0]) * cmd.num_counters;
+
+		ret = switchtec_cmd(dev, MRPC_PMON, &cmd, cmd_size, NULL, 0);
+		if (ret)
+			return ret;
+
+		cntr_id += cmd.num_counters;
+		nr_cntrs -= cmd.num_counters;
+		setups += cmd.num_counters;
+	}
+
+	return 0;
+}
+
 static int evcntr_get(struct switchtec_dev *dev, int sub_cmd,
 		      unsigned stack_id, unsigned cntr_id, unsigned nr_cntrs,
 		      void *res, size_t res_size, int clear)
@@ -528,26 +611,79 @@ uint64_t switchtec_bwcntr_tot(struct switchtec_bwcntr_dir *d)
  * @param[in]  ingress_port_ids	A list of port ids for the ingress of the TLP
  *	(may be SWITCHTEC_LAT_ALL_INGRESS for all ports)
  * @return 0 on success, error code on failure
+ *
+ * Counters that do not fit in one command are set up with as many
+ * commands as needed.
  */
 int switchtec_lat_setup_many(struct switchtec_dev *dev, int nr_ports,
 			     int *egress_port_ids, int *ingress_port_ids)
 {
 	int i;
+	int ret;
+	int remain = nr_ports;
 	size_t cmd_size;
 	struct pmon_lat_setup cmd = {
 		.sub_cmd_id = MRPC_PMON_SETUP_LAT_COUNTER,
-		.count = nr_ports,
 	};
+	int cmd_max_count = ARRAY_SIZE(cmd.ports);
 
-	for (i = 0; i < nr_ports; i++) {
-		cmd.ports[i].egress = egress_port_ids[i];
-		cmd.ports[i].ingress = ingress_port_ids[i];
+	while (remain) {
+		cmd.count = remain;
+		if (cmd.count > cmd_max_count)
+			cmd.count = cmd_max_count;
+
+		for (i = 0; i < cmd.count; i++) {
+			cmd.ports[i].egress = egress_port_ids[i];
+			cmd.ports[i].ingress = ingress_port_ids[i];
+		}
+
+		cmd_size = offsetof(struct pmon_lat_setup, ports) +
+			sizeof(cmd.ports[0]) * cmd.count;
+
+		ret = switchtec_cmd(dev, MRPC_PMON, &cmd, cmd_size, NULL, 0);
+		if (ret)
+			return ret;
+
+		remain -= cmd.count;
+		egress_port_ids += cmd.count;
+		ingress_port_ids += cmd.count;
 	}
 
-	cmd_size = offsetof(struct pmon_lat_setup, ports) +
-		sizeof(cmd.ports[0]) * nr_ports;
+	return 0;
+}
 
-	return switchtec_cmd(dev, MRPC_PMON, &cmd, cmd_size, NULL, 0);
+/**
+ * @brief Setup the latency counters of all the ports in the system
+ * @param[in]  dev		Switchtec device handle
+ * @param[in]  ingress_port_id	The port id for the ingress of the TLPs
+ *	(may be SWITCHTEC_LAT_ALL_INGRESS for all ports)
+ * @return 0 on success, error code on failure
+ *
+ * Each port's counter measures the TLPs leaving through that port.
+ */
+int switchtec_lat_setup_all(struct switchtec_dev *dev, int ingress_port_id)
+{
+	int ret, i, nr_status, nr_ports;
+	struct switchtec_status *status;
+	int egress[SWITCHTEC_MAX_PORTS];
+	int ingress[SWITCHTEC_MAX_PORTS];
+
+	nr_status = switchtec_status(dev, &status);
+	if (nr_status < 0)
+		return nr_status;
+
+	nr_ports = nr_status;
+	if (nr_ports > SWITCHTEC_MAX_PORTS)
+		nr_ports = SWITCHTEC_MAX_PORTS;
+
+	for (i = 0; i < nr_ports; i++) {
+		egress[i] = status[i].port.phys_id;
+		ingress[i] = ingress_port_id;
+	}
+
+	ret = switchtec_lat_setup_many(dev, nr_ports, egress, ingress);
+	switchtec_status_free(status, nr_status);
+	return ret;
 }
 
 /**
@@ -585,44 +721,116 @@ int switchtec_lat_setup(struct switchtec_dev *dev, int egress_port_id,
  * @param[out] max_ns		A list of maximum latency values
  * @return nr_ports on success, error code on failure
  *
- * Results are reported in nanoseconds.
+ * Results are reported in nanoseconds. Counters that do not fit in one
+ * command are retrieved with as many commands as needed.
  */
 int switchtec_lat_get_many(struct switchtec_dev *dev, int nr_ports,
 			   int clear, int *egress_port_ids,
 			   int *cur_ns, int *max_ns)
 {
 	int ret, i;
+	int remain = nr_ports;
 	size_t cmd_size;
-	struct pmon_lat_data resp[nr_ports];
 	struct pmon_lat_get cmd = {
 		.sub_cmd_id = MRPC_PMON_GET_LAT_COUNTER,
-		.count = nr_ports,
 		.clear = clear,
 	};
+	struct pmon_lat_data resp[ARRAY_SIZE(cmd.port_ids)];
+	int cmd_max_count = ARRAY_SIZE(cmd.port_ids);
+
+	while (remain) {
+		cmd.count = remain;
+		if (cmd.count > cmd_max_count)
+			cmd.count = cmd_max_count;
 
-	for (i = 0; i < nr_ports; i++)
-		cmd.port_ids[i] = egress_port_ids[i];
+		for (i = 0; i < cmd.count; i++)
+			cmd.port_ids[i] = egress_port_ids[i];
 
-	cmd_size = offsetof(struct pmon_lat_get, port_ids) +
-		sizeof(cmd.port_ids[0]) * nr_ports;
+		cmd_size = offsetof(struct pmon_lat_get, port_ids) +
+			sizeof(cmd.port_ids[0]) * cmd.count;
 
-	ret = switchtec_cmd(dev, MRPC_PMON, &cmd, cmd_size, resp,
-			    sizeof(*resp) * nr_ports);
+		ret = switchtec_cmd(dev, MRPC_PMON, &cmd, cmd_size, resp,
+				    sizeof(*resp) * cmd.count);
+		if (ret)
+			return -1;
 
-	if (ret)
-		return -1;
+		if (cur_ns) {
+			for (i = 0; i < cmd.count; i++)
+				cur_ns[i] = resp[i].cur_ns;
+			cur_ns += cmd.count;
+		}
 
-	if (cur_ns)
-		for (i = 0; i < nr_ports; i++)
-			cur_ns[i] = resp[i].cur_ns;
+		if (max_ns) {
+			for (i = 0; i < cmd.count; i++)
+				max_ns[i] = resp[i].max_ns;
+			max_ns += cmd.count;
+		}
 
-	if (max_ns)
-		for (i = 0; i < nr_ports; i++)
-			max_ns[i] = resp[i].max_ns;
+		remain -= cmd.count;
+		egress_port_ids += cmd.count;
+	}
 
 	return nr_ports;
 }
 
+/**
+ * @brief Get the latency counter results of all the ports in the system
+ * @param[in]  dev	Switchtec device handle
+ * @param[in]  clear	If non-zero, clear all the retrieved counters
+ * @param[out] ports	Allocated array of ports retrieved
+ * @param[out] cur_ns	Allocated array of current latency values
+ * @param[out] max_ns	Allocated array of maximum latency values
+ * @return number of ports retrieved on success, negative error
+ *	code on failure
+ *
+ * \p ports, \p cur_ns and \p max_ns should be freed with free() once they
+ * are finished with. To sample latency repeatedly, or together with the
+ * bandwidth counters, use switchtec_pmon_sample() which does not query
+ * the port map or allocate memory each time.
+ */
+int switchtec_lat_get_all(struct switchtec_dev *dev, int clear,
+			  struct switchtec_port_id **ports,
+			  int **cur_ns, int **max_ns)
+{
+	int ret, i, nr_status, nr_ports;
+	struct switchtec_status *status;
+	int ids[SWITCHTEC_MAX_PORTS];
+
+	nr_status = switchtec_status(dev, &status);
+	if (nr_status < 0)
+		return nr_status;
+
+	nr_ports = nr_status;
+	if (nr_ports > SWITCHTEC_MAX_PORTS)
+		nr_ports = SWITCHTEC_MAX_PORTS;
+
+	*ports = calloc(nr_ports, sizeof(**ports));
+	*cur_ns = calloc(nr_ports, sizeof(**cur_ns));
+	*max_ns = calloc(nr_ports, sizeof(**max_ns));
+	if (!*ports || !*cur_ns || !*max_ns) {
+		ret = -1;
+		goto out;
+	}
+
+	for (i = 0; i < nr_ports; i++) {
+		ids[i] = status[i].port.phys_id;
+		(*ports)[i] = status[i].port;
+	}
+
+	ret = switchtec_lat_get_many(dev, nr_ports, clear, ids, *cur_ns,
+				     *max_ns);
+
+out:
+	if (ret < 0) {
+		free(*ports);
+		free(*cur_ns);
+		free(*max_ns);
+	}
+
+	switchtec_status_free(status, nr_status);
+	return ret;
+}
+
 /**
  * @brief Get a single latency counter result
  * @param[in]  dev		Switchtec device handle
@@ -643,4 +851,1169 @@ int switchtec_lat_get(struct switchtec_dev *dev, int clear,
 				      cur_ns, max_ns);
 }
 
+/**
+ * @brief Performance monitor session
+ *
+ * All result arrays are sized for the largest switch so refreshing the
+ * port map never reallocates them.
+ */
+struct switchtec_pmon_session {
+	struct switchtec_dev *dev;
+	unsigned flags;
+	unsigned generation;
+	int link_events;	//!< link state events are available
+	uint8_t link_cnt[SWITCHTEC_MAX_PFF_CSR];	//!< last seen event counts
+	int bw_type_set;	//!< bw_type was set and is reapplied on refresh
+	enum switchtec_bw_type bw_type;
+
+	int nr_ports;
+	int nr_stacks;
+	struct switchtec_status *status;
+	struct switchtec_event_summary link_chk;
+
+	int phys_ids[SWITCHTEC_MAX_PORTS];
+	struct switchtec_port_id ports[SWITCHTEC_MAX_PORTS];
+	struct switchtec_bwcntr_res bw[SWITCHTEC_MAX_PORTS];
+	int lat_cur_ns[SWITCHTEC_MAX_PORTS];
+	int lat_max_ns[SWITCHTEC_MAX_PORTS];
+	unsigned evcntr[SWITCHTEC_MAX_STACKS_GEN6][SWITCHTEC_MAX_EVENT_COUNTERS];
+};
+
+static int pmon_lat_setup_all(struct switchtec_pmon_session *s)
+{
+	int ingress[SWITCHTEC_MAX_PORTS];
+	int i;
+
+	for (i = 0; i < s->nr_ports; i++)
+		ingress[i] = SWITCHTEC_LAT_ALL_INGRESS;
+
+	return switchtec_lat_setup_many(s->dev, s->nr_ports, s->phys_ids,
+					ingress);
+}
+
+/**
+ * @brief Re-read the port map of a performance monitor session
+ * @param[in] s		Performance monitor session
+ * @return 0 on success, error code on failure
+ *
+ * switchtec_pmon_sample() calls this automatically when a link state
+ * change event is seen, so it only needs to be called directly on
+ * platforms that do not report events. If the session samples latency,
+ * the latency counters of the new port map are set up again, and a
+ * bandwidth type set with switchtec_pmon_session_set_bw_type() is
+ * applied to the new port map too.
+ */
+int switchtec_pmon_session_refresh(struct switchtec_pmon_session *s)
+{
+	struct switchtec_status *status;
+	int ret, i;
+
+	ret = switchtec_status(s->dev, &status);
+	if (ret < 0)
+		return ret;
+
+	if (ret > SWITCHTEC_MAX_PORTS) {
+		switchtec_status_free(status, ret);
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	/* device information is best effort, it is only used for display */
+	if (s->flags & SWITCHTEC_PMON_DEVICES)
+		switchtec_get_devices(s->dev, status, ret);
+
+	if (s->status)
+		switchtec_status_free(s->status, s->nr_ports);
+
+	s->status = status;
+	s->nr_ports = ret;
+	s->nr_stacks = 0;
+
+	for (i = 0; i < s->nr_ports; i++) {
+		s->ports[i] = status[i].port;
+		s->phys_ids[i] = status[i].port.phys_id;
+		if (status[i].port.stack >= s->nr_stacks)
+			s->nr_stacks = status[i].port.stack + 1;
+	}
+
+	if (s->nr_stacks > SWITCHTEC_MAX_STACKS_GEN6)
+		s->nr_stacks = SWITCHTEC_MAX_STACKS_GEN6;
+
+	s->generation++;
+
+	if (s->flags & SWITCHTEC_PMON_LAT) {
+		ret = pmon_lat_setup_all(s);
+		if (ret)
+			return -1;
+	}
+
+	if (s->bw_type_set) {
+		ret = switchtec_bwcntr_set_many(s->dev, s->nr_ports,
+						s->phys_ids, s->bw_type);
+		if (ret)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * The link state event stays flagged in the summary once it has fired,
+ * so a change is only reported when the event count of a flagged port
+ * function moved since the last check. Nothing is cleared.
+ */
+static int pmon_link_changed(struct switchtec_pmon_session *s)
+{
+	struct switchtec_event_summary res;
+	int ret, i, changed = 0;
+
+	ret = switchtec_event_check(s->dev, &s->link_chk, &res);
+	if (ret <= 0)
+		return ret;
+
+	for (i = 0; i < SWITCHTEC_MAX_PFF_CSR; i++) {
+		if (!switchtec_event_summary_test(&res,
+				SWITCHTEC_PFF_EVT_LINK_STATE, i))
+			continue;
+
+		ret = switchtec_event_ctl(s->dev, SWITCHTEC_PFF_EVT_LINK_STATE,
+					  i, 0, NULL);
+		if (ret < 0)
+			return ret;
+
+		if (s->link_cnt[i] != (uint8_t)ret)
+			changed = 1;
+		s->link_cnt[i] = ret;
+	}
+
+	return changed;
+}
+
+/**
+ * @brief Start a performance monitor session
+ * @param[in] dev	Switchtec device handle
+ * @param[in] flags	Counters to sample (see enum switchtec_pmon_flags)
+ * @return The session on success, NULL on failure
+ *
+ * The port map is read once here and then only again after a link
+ * state change event, so switchtec_pmon_sample() costs one command per
+ * counter type instead of a full status query. Link state changes are
+ * detected from the event counts, the events themselves are left alone
+ * for other readers. With SWITCHTEC_PMON_LAT, the latency
+ * counter of every port is set up to measure TLPs from all ingress
+ * ports.
+ *
+ * The session must be freed with switchtec_pmon_session_close().
+ */
+struct switchtec_pmon_session *
+switchtec_pmon_session_open(struct switchtec_dev *dev, unsigned flags)
+{
+	struct switchtec_pmon_session *s;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	s->dev = dev;
+	s->flags = flags;
+
+	switchtec_event_summary_set(&s->link_chk, SWITCHTEC_PFF_EVT_LINK_STATE,
+				    SWITCHTEC_EVT_IDX_ALL);
+	s->link_events = pmon_link_changed(s) >= 0;
+
+	if (switchtec_pmon_session_refresh(s)) {
+		switchtec_pmon_session_close(s);
+		return NULL;
+	}
+
+	return s;
+}
+
+/**
+ * @brief Free a performance monitor session
+ * @param[in] s		Performance monitor session
+ */
+void switchtec_pmon_session_close(struct switchtec_pmon_session *s)
+{
+	if (!s)
+		return;
+
+	if (s->status)
+		switchtec_status_free(s->status, s->nr_ports);
+	free(s);
+}
+
+/**
+ * @brief Set the bandwidth type of all the ports in a session
+ * @param[in] s		Performance monitor session
+ * @param[in] bw_type	Type of bandwidth to set
+ * @return 0 on success, error code on failure
+ *
+ * The type is remembered and set again on the ports of a refreshed
+ * port map, so it keeps applying after a link state change.
+ */
+int switchtec_pmon_session_set_bw_type(struct switchtec_pmon_session *s,
+				       enum switchtec_bw_type bw_type)
+{
+	s->bw_type = bw_type;
+	s->bw_type_set = 1;
+
+	return switchtec_bwcntr_set_many(s->dev, s->nr_ports, s->phys_ids,
+					 bw_type);
+}
+
+/**
+ * @brief Sample the counters of all the ports in a session
+ * @param[in]  s	Performance monitor session
+ * @param[in]  clear	If non-zero, clear all the retrieved counters
+ * @param[out] sample	Results, pointing into the session
+ * @return 0 on success, error code on failure
+ *
+ * With SWITCHTEC_PMON_LAT_CLEAR, the latency counters are cleared on
+ * every sample, whatever \p clear is, while the other counters keep
+ * counting up.
+ *
+ * The arrays in \p sample stay valid until the next call or until the
+ * session is closed. sample->generation changes whenever the port map
+ * was re-read, in which case previous results no longer line up with
+ * the current ports.
+ *
+ * Unless the port map has to be refreshed, this does not allocate any
+ * memory.
+ */
+int switchtec_pmon_sample(struct switchtec_pmon_session *s, int clear,
+			  struct switchtec_pmon_sample *sample)
+{
+	int ret, i, lat_clear;
+
+	ret = s->link_events ? pmon_link_changed(s) : 0;
+	if (ret < 0)
+		return ret;
+
+	if (ret) {
+		ret = switchtec_pmon_session_refresh(s);
+		if (ret)
+			return ret;
+	}
+
+	if (s->flags & SWITCHTEC_PMON_BW) {
+		ret = switchtec_bwcntr_many(s->dev, s->nr_ports, s->phys_ids,
+					    clear, s->bw);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (s->flags & SWITCHTEC_PMON_LAT) {
+		lat_clear = clear || (s->flags & SWITCHTEC_PMON_LAT_CLEAR);
+		ret = switchtec_lat_get_many(s->dev, s->nr_ports, lat_clear,
+					     s->phys_ids, s->lat_cur_ns,
+					     s->lat_max_ns);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (s->flags & SWITCHTEC_PMON_EVCNTR) {
+		for (i = 0; i < s->nr_stacks; i++) {
+			ret = switchtec_evcntr_get(s->dev, i, 0,
+						   SWITCHTEC_MAX_EVENT_COUNTERS,
+						   s->evcntr[i], clear);
+			if (ret < 0)
+				return ret;
+		}
+	}
+
+	sample->generation = s->generation;
+	sample->nr_ports = s->nr_ports;
+	sample->status = s->status;
+	sample->ports = s->ports;
+	sample->bw = s->flags & SWITCHTEC_PMON_BW ? s->bw : NULL;
+	sample->lat_cur_ns = s->flags & SWITCHTEC_PMON_LAT ?
+		s->lat_cur_ns : NULL;
+	sample->lat_max_ns = s->flags & SWITCHTEC_PMON_LAT ?
+		s->lat_max_ns : NULL;
+	sample->nr_stacks = s->nr_stacks;
+	sample->evcntr = s->flags & SWITCHTEC_PMON_EVCNTR ?
+		(const unsigned (*)[SWITCHTEC_MAX_EVENT_COUNTERS])s->evcntr :
+		NULL;
+
+	return 0;
+}
+
+/*
+ * Latency histograms are log-linear: values below
+ * 2^SWITCHTEC_LAT_HIST_SUB_BITS get a bucket each and every power of two
+ * above that is split into 2^SWITCHTEC_LAT_HIST_SUB_BITS buckets, so a
+ * percentile is never off by more than about 3%.
+ */
+#define LAT_HIST_SUB	(1 << SWITCHTEC_LAT_HIST_SUB_BITS)
+
+static int lat_hist_idx(unsigned ns)
+{
+	int o = 0;
+
+	if (ns > SWITCHTEC_LAT_HIST_MAX_NS)
+		ns = SWITCHTEC_LAT_HIST_MAX_NS;
+
+	if (ns < LAT_HIST_SUB)
+		return ns;
+
+	while ((ns >> o) >= 2 * LAT_HIST_SUB)
+		o++;
+
+	return o * LAT_HIST_SUB + (ns >> o);
+}
+
+static int lat_hist_val(int idx)
+{
+	int o, sub;
+
+	if (idx < LAT_HIST_SUB)
+		return idx;
+
+	o = idx / LAT_HIST_SUB - 1;
+	sub = idx % LAT_HIST_SUB;
+
+	/* highest value that falls into the bucket */
+	return ((LAT_HIST_SUB + sub + 1) << o) - 1;
+}
+
+/**
+ * @brief Empty a latency histogram
+ * @param[out] h	Latency histogram
+ */
+void switchtec_lat_hist_reset(struct switchtec_lat_hist *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+/**
+ * @brief Add a latency value to a histogram
+ * @param[in,out] h	Latency histogram
+ * @param[in]     ns	Latency in nanoseconds
+ */
+void switchtec_lat_hist_add(struct switchtec_lat_hist *h, int ns)
+{
+	if (ns < 0)
+		return;
+
+	h->buckets[lat_hist_idx(ns)]++;
+	h->count++;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+}
+
+/**
+ * @brief Add all the values of one latency histogram to another
+ * @param[in,out] dst	Histogram to add to
+ * @param[in]     src	Histogram to add
+ */
+void switchtec_lat_hist_merge(struct switchtec_lat_hist *dst,
+			      const struct switchtec_lat_hist *src)
+{
+	int i;
+
+	for (i = 0; i < SWITCHTEC_LAT_HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+
+	dst->count += src->count;
+	if (src->max_ns > dst->max_ns)
+		dst->max_ns = src->max_ns;
+}
+
+/**
+ * @brief Get a percentile of a latency histogram
+ * @param[in] h		Latency histogram
+ * @param[in] pct	Percentile to get (0 to 100)
+ * @return The latency in nanoseconds that \p pct percent of the values
+ *	are at or below, or -1 if the histogram is empty
+ */
+int switchtec_lat_hist_percentile(const struct switchtec_lat_hist *h,
+				  double pct)
+{
+	uint64_t rank, seen = 0;
+	int i, val;
+
+	if (!h->count)
+		return -1;
+
+	rank = (uint64_t)(h->count * pct / 100.0 + 0.5);
+	if (rank < 1)
+		rank = 1;
+	if (rank > h->count)
+		rank = h->count;
+
+	for (i = 0; i < SWITCHTEC_LAT_HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+
+	val = lat_hist_val(i);
+	if (val > h->max_ns)
+		val = h->max_ns;
+
+	return val;
+}
+
+/**
+ * @brief Summarize a latency histogram
+ * @param[in]  h	Latency histogram
+ * @param[out] st	Sample count, percentiles and maximum
+ */
+void switchtec_lat_hist_stats(const struct switchtec_lat_hist *h,
+			      struct switchtec_lat_stats *st)
+{
+	st->count = h->count;
+	st->p50_ns = switchtec_lat_hist_percentile(h, 50);
+	st->p90_ns = switchtec_lat_hist_percentile(h, 90);
+	st->p99_ns = switchtec_lat_hist_percentile(h, 99);
+	st->p999_ns = switchtec_lat_hist_percentile(h, 99.9);
+	st->max_ns = h->count ? h->max_ns : -1;
+}
+
+/**
+ * @brief Latency sampler
+ *
+ * Keeps one histogram per port for each slice of the sliding window.
+ */
+struct switchtec_lat_sampler {
+	struct switchtec_pmon_session *session;
+	unsigned generation;
+	int nr_ports;
+	const struct switchtec_port_id *ports;
+
+	uint64_t slice_us;
+	uint64_t slice_start;
+	unsigned nr_slices;
+	unsigned cur;
+
+	struct switchtec_lat_hist window;	//!< scratch for merged slices
+	struct switchtec_lat_hist *hist;	//!< [slice][port]
+};
+
+static uint64_t pmon_now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static struct switchtec_lat_hist *
+lat_sampler_hist(struct switchtec_lat_sampler *s, unsigned slice, int port)
+{
+	return &s->hist[slice * SWITCHTEC_MAX_PORTS + port];
+}
+
+static void lat_sampler_clear_slice(struct switchtec_lat_sampler *s,
+				    unsigned slice)
+{
+	memset(lat_sampler_hist(s, slice, 0), 0,
+	       sizeof(*s->hist) * SWITCHTEC_MAX_PORTS);
+}
+
+/**
+ * @brief Start sampling the latency of all ports into histograms
+ * @param[in] dev	Switchtec device handle
+ * @param[in] slice_ms	Length of one slice of the sliding window
+ * @param[in] nr_slices	Number of slices in the sliding window
+ * @return The sampler on success, NULL on failure
+ *
+ * The latency counter of every port is set up to measure TLPs from all
+ * ingress ports. Each call to switchtec_lat_sampler_poll() reads and
+ * clears the counters, so the more often it is called the more values
+ * end up in the histograms. switchtec_lat_sampler_stats() reports on the
+ * last \p nr_slices slices of \p slice_ms each.
+ *
+ * Each poll adds the maximum latency seen since the previous poll, so
+ * the percentiles describe the worst TLP of each poll interval and the
+ * tail is not hidden by the minimum that Gen4 and later switches report
+ * as the current value.
+ *
+ * The sampler must be freed with switchtec_lat_sampler_close().
+ */
+struct switchtec_lat_sampler *
+switchtec_lat_sampler_open(struct switchtec_dev *dev, unsigned slice_ms,
+			   unsigned nr_slices)
+{
+	struct switchtec_lat_sampler *s;
+	struct switchtec_pmon_sample sample;
+
+	if (!slice_ms || !nr_slices) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	s->slice_us = slice_ms * 1000ULL;
+	s->nr_slices = nr_slices;
+	s->hist = calloc(nr_slices * SWITCHTEC_MAX_PORTS, sizeof(*s->hist));
+	if (!s->hist)
+		goto err;
+
+	s->session = switchtec_pmon_session_open(dev, SWITCHTEC_PMON_LAT);
+	if (!s->session)
+		goto err;
+
+	/* throw away whatever the counters saw before */
+	if (switchtec_pmon_sample(s->session, 1, &sample))
+		goto err;
+
+	s->generation = sample.generation;
+	s->nr_ports = sample.nr_ports;
+	s->ports = sample.ports;
+	s->slice_start = pmon_now_us();
+
+	return s;
+
+err:
+	switchtec_lat_sampler_close(s);
+	return NULL;
+}
+
+/**
+ * @brief Free a latency sampler
+ * @param[in] s		Latency sampler
+ */
+void switchtec_lat_sampler_close(struct switchtec_lat_sampler *s)
+{
+	if (!s)
+		return;
+
+	switchtec_pmon_session_close(s->session);
+	free(s->hist);
+	free(s);
+}
+
+/**
+ * @brief Read the latency counters of all ports into the histograms
+ * @param[in] s		Latency sampler
+ * @return 0 on success, error code on failure
+ *
+ * Ports whose counter saw no TLPs since the last poll are skipped. If the
+ * port map changed, all histograms start over. See
+ * switchtec_lat_sampler_open() for what the recorded values mean.
+ */
+int switchtec_lat_sampler_poll(struct switchtec_lat_sampler *s)
+{
+	struct switchtec_pmon_sample sample;
+	struct switchtec_lat_hist *h;
+	uint64_t now;
+	unsigned i;
+	int ret, p;
+
+	ret = switchtec_pmon_sample(s->session, 1, &sample);
+	if (ret)
+		return ret;
+
+	if (sample.generation != s->generation) {
+		for (i = 0; i < s->nr_slices; i++)
+			lat_sampler_clear_slice(s, i);
+		s->generation = sample.generation;
+	}
+
+	s->nr_ports = sample.nr_ports;
+	s->ports = sample.ports;
+
+	now = pmon_now_us();
+	for (i = 0; now - s->slice_start >= s->slice_us; i++) {
+		s->slice_start += s->slice_us;
+		if (i >= s->nr_slices)
+			continue;
+
+		s->cur = (s->cur + 1) % s->nr_slices;
+		lat_sampler_clear_slice(s, s->cur);
+	}
+
+	for (p = 0; p < s->nr_ports; p++) {
+		if (!sample.lat_max_ns[p])
+			continue;
+
+		h = lat_sampler_hist(s, s->cur, p);
+		switchtec_lat_hist_add(h, sample.lat_max_ns[p]);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Get the ports of a latency sampler
+ * @param[in]  s	Latency sampler
+ * @param[out] ports	The ID of each port (valid until the next poll)
+ * @return The number of ports
+ */
+int switchtec_lat_sampler_ports(struct switchtec_lat_sampler *s,
+				const struct switchtec_port_id **ports)
+{
+	if (ports)
+		*ports = s->ports;
+
+	return s->nr_ports;
+}
+
+/**
+ * @brief Get the latency percentiles of a port over the sliding window
+ * @param[in]  s	Latency sampler
+ * @param[in]  port	Index of the port in switchtec_lat_sampler_ports()
+ * @param[out] st	Sample count, percentiles and maximum
+ * @param[out] hist	Merged histogram of the window (may be NULL)
+ * @return 0 on success, error code on failure
+ */
+int switchtec_lat_sampler_stats(struct switchtec_lat_sampler *s, int port,
+				struct switchtec_lat_stats *st,
+				struct switchtec_lat_hist *hist)
+{
+	unsigned i;
+
+	if (port < 0 || port >= s->nr_ports) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	switchtec_lat_hist_reset(&s->window);
+	for (i = 0; i < s->nr_slices; i++)
+		switchtec_lat_hist_merge(&s->window,
+					 lat_sampler_hist(s, i, port));
+
+	switchtec_lat_hist_stats(&s->window, st);
+	if (hist)
+		*hist = s->window;
+
+	return 0;
+}
+
+/**
+ * @brief Event counter sampler
+ *
+ * Counter (stk_id * nr_events + i) of each stack counts event i of the
+ * port with that stk_id.
+ */
+struct switchtec_evcntr_sampler {
+	struct switchtec_dev *dev;
+	struct switchtec_pmon_session *session;
+	unsigned generation;
+
+	int nr_events;
+	enum switchtec_evcntr_type_mask events[SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS];
+
+	int nr_ports;
+	const struct switchtec_port_id *ports;
+
+	uint64_t last_us;
+	unsigned last[SWITCHTEC_MAX_STACKS_GEN6][SWITCHTEC_MAX_EVENT_COUNTERS];
+	uint64_t deltas[SWITCHTEC_MAX_PORTS *
+			SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS];
+	double rates[SWITCHTEC_MAX_PORTS * SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS];
+};
+
+static int evcntr_sampler_cntr(struct switchtec_evcntr_sampler *s,
+			       const struct switchtec_port_id *port, int event)
+{
+	return port->stk_id * s->nr_events + event;
+}
+
+static int evcntr_sampler_setup(struct switchtec_evcntr_sampler *s,
+				const struct switchtec_pmon_sample *sample)
+{
+	struct switchtec_evcntr_setup setups[SWITCHTEC_MAX_EVENT_COUNTERS];
+	const struct switchtec_port_id *port;
+	int stack, first, last, cntr;
+	int p, i, ret;
+
+	for (stack = 0; stack < sample->nr_stacks; stack++) {
+		memset(setups, 0, sizeof(setups));
+		first = SWITCHTEC_MAX_EVENT_COUNTERS;
+		last = -1;
+
+		for (p = 0; p < sample->nr_ports; p++) {
+			port = &sample->ports[p];
+			if (port->stack != stack)
+				continue;
+
+			for (i = 0; i < s->nr_events; i++) {
+				cntr = evcntr_sampler_cntr(s, port, i);
+				if (cntr >= SWITCHTEC_MAX_EVENT_COUNTERS) {
+					errno = EINVAL;
+					return -1;
+				}
+
+				setups[cntr].port_mask = 1 << port->stk_id;
+				setups[cntr].type_mask = s->events[i];
+
+				if (cntr < first)
+					first = cntr;
+				if (cntr > last)
+					last = cntr;
+			}
+		}
+
+		if (last < 0)
+			continue;
+
+		ret = switchtec_evcntr_setup_many(s->dev, stack, first,
+						  last - first + 1,
+						  &setups[first]);
+		if (ret)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int evcntr_sampler_baseline(struct switchtec_evcntr_sampler *s)
+{
+	struct switchtec_pmon_sample sample;
+	int ret;
+
+	ret = switchtec_pmon_sample(s->session, 0, &sample);
+	if (ret)
+		return ret;
+
+	ret = evcntr_sampler_setup(s, &sample);
+	if (ret)
+		return ret;
+
+	ret = switchtec_pmon_sample(s->session, 0, &sample);
+	if (ret)
+		return ret;
+
+	memcpy(s->last, sample.evcntr, sizeof(s->last[0]) * sample.nr_stacks);
+	s->generation = sample.generation;
+	s->nr_ports = sample.nr_ports;
+	s->ports = sample.ports;
+	s->last_us = pmon_now_us();
+
+	return 0;
+}
+
+/**
+ * @brief Start sampling event counters of every port
+ * @param[in] dev	Switchtec device handle
+ * @param[in] events	Events to count, one type each
+ * @param[in] nr_events	Number of events (at most
+ *	SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS)
+ * @return The sampler on success, NULL on failure
+ *
+ * One counter per port and event is set up on every stack, overwriting
+ * the existing configuration of those counters. Counters are never
+ * cleared, so other readers are not disturbed; deltas are taken modulo
+ * 2^32 to handle wraparound.
+ *
+ * The sampler must be freed with switchtec_evcntr_sampler_close().
+ */
+struct switchtec_evcntr_sampler *
+switchtec_evcntr_sampler_open(struct switchtec_dev *dev,
+			      const enum switchtec_evcntr_type_mask *events,
+			      int nr_events)
+{
+	struct switchtec_evcntr_sampler *s;
+
+	if (nr_events <= 0 || nr_events > SWITCHTEC_EVCNTR_SAMPLER_MAX_EVENTS) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	s->dev = dev;
+	s->nr_events = nr_events;
+	memcpy(s->events, events, sizeof(*events) * nr_events);
+
+	s->session = switchtec_pmon_session_open(dev, SWITCHTEC_PMON_EVCNTR);
+	if (!s->session)
+		goto err;
+
+	if (evcntr_sampler_baseline(s))
+		goto err;
+
+	return s;
+
+err:
+	switchtec_evcntr_sampler_close(s);
+	return NULL;
+}
+
+/**
+ * @brief Free an event counter sampler
+ * @param[in] s		Event counter sampler
+ *
+ * The event counters stay configured.
+ */
+void switchtec_evcntr_sampler_close(struct switchtec_evcntr_sampler *s)
+{
+	if (!s)
+		return;
+
+	switchtec_pmon_session_close(s->session);
+	free(s);
+}
+
+/**
+ * @brief Read the event counters of all stacks and compute deltas
+ * @param[in]  s	Event counter sampler
+ * @param[out] sample	Deltas and rates since the previous call
+ *	(valid until the next call)
+ * @return 0 on success, error code on failure
+ *
+ * If the port map changed since the previous call, the counters are set
+ * up again and the interval restarts, so \p sample covers no time and
+ * has all deltas zero. sample->generation changes in that case, and
+ * the ports of earlier samples no longer line up with the current ones.
+ */
+int switchtec_evcntr_sampler_poll(struct switchtec_evcntr_sampler *s,
+				  struct switchtec_evcntr_sample *sample)
+{
+	struct switchtec_pmon_sample pmon;
+	const struct switchtec_port_id *port;
+	uint64_t now;
+	unsigned cur;
+	int ret, p, i, cntr, idx;
+
+	ret = switchtec_pmon_sample(s->session, 0, &pmon);
+	if (ret)
+		return ret;
+
+	now = pmon_now_us();
+
+	if (pmon.generation != s->generation) {
+		ret = evcntr_sampler_baseline(s);
+		if (ret)
+			return ret;
+
+		memset(s->deltas, 0, sizeof(s->deltas));
+		memset(s->rates, 0, sizeof(s->rates));
+		sample->interval_us = 0;
+		goto out;
+	}
+
+	sample->interval_us = now - s->last_us;
+	s->last_us = now;
+
+	for (p = 0; p < pmon.nr_ports; p++) {
+		port = &pmon.ports[p];
+
+		for (i = 0; i < s->nr_events; i++) {
+			cntr = evcntr_sampler_cntr(s, port, i);
+			idx = p * s->nr_events + i;
+
+			if (port->stack >= pmon.nr_stacks) {
+				s->deltas[idx] = 0;
+				s->rates[idx] = 0;
+				continue;
+			}
+
+			cur = pmon.evcntr[port->stack][cntr];
+			s->deltas[idx] = (uint32_t)(cur -
+					 s->last[port->stack][cntr]);
+			s->last[port->stack][cntr] = cur;
+
+			s->rates[idx] = sample->interval_us ?
+				s->deltas[idx] * 1e6 / sample->interval_us : 0;
+		}
+	}
+
+out:
+	sample->time_us = s->last_us;
+	sample->generation = s->generation;
+	sample->nr_ports = s->nr_ports;
+	sample->ports = s->ports;
+	sample->nr_events = s->nr_events;
+	sample->events = s->events;
+	sample->deltas = s->deltas;
+	sample->rates = s->rates;
+
+	return 0;
+}
+
+/*
+ * Deviations smaller than this many bytes per second are never reported,
+ * so noise on idle ports does not look like an anomaly.
+ */
+#define BW_ANOMALY_MIN_RATE	1e6
+
+struct switchtec_bw_analyzer {
+	double alpha;
+	double threshold;
+	unsigned warmup;
+
+	int have_prev;
+	unsigned generation;
+	int nr_ports;
+
+	struct switchtec_bwcntr_res prev[SWITCHTEC_MAX_PORTS];
+	unsigned nr_intervals[SWITCHTEC_MAX_PORTS];
+	double var[SWITCHTEC_MAX_PORTS][SWITCHTEC_BW_NR_SERIES];
+	struct switchtec_bw_port_stats stats[SWITCHTEC_MAX_PORTS];
+};
+
+/**
+ * @brief Start analyzing the bandwidth of all ports
+ * @param[in] alpha	Weight of a new interval in the moving averages,
+ *			between 0 and 1
+ * @param[in] threshold	Number of standard deviations a rate has to be
+ *			off its baseline to be flagged
+ * @return The analyzer on success, NULL on failure
+ *
+ * The analyzer is fed with samples of a performance monitor session
+ * opened with SWITCHTEC_PMON_BW, which must not clear the bandwidth
+ * counters. It keeps an exponentially weighted moving average and
+ * variance of every byte counter of every port, and flags rates that
+ * deviate from them once about 1 / \p alpha intervals have been seen.
+ *
+ * Its memory is allocated once, so updates take a fixed amount of time
+ * per port. The analyzer must be freed with
+ * switchtec_bw_analyzer_close().
+ */
+struct switchtec_bw_analyzer *switchtec_bw_analyzer_open(double alpha,
+							 double threshold)
+{
+	struct switchtec_bw_analyzer *a;
+
+	if (!(alpha > 0 && alpha <= 1) || !(threshold > 0)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	a = calloc(1, sizeof(*a));
+	if (!a)
+		return NULL;
+
+	a->alpha = alpha;
+	a->threshold = threshold;
+	a->warmup = ceil(1 / alpha);
+	if (a->warmup < 2)
+		a->warmup = 2;
+
+	return a;
+}
+
+/**
+ * @brief Free a bandwidth analyzer
+ * @param[in] a		Bandwidth analyzer
+ */
+void switchtec_bw_analyzer_close(struct switchtec_bw_analyzer *a)
+{
+	free(a);
+}
+
+static void bw_series(const struct switchtec_bwcntr_res *r,
+		      uint64_t v[SWITCHTEC_BW_NR_SERIES])
+{
+	v[SWITCHTEC_BW_EGRESS_POSTED] = r->egress.posted;
+	v[SWITCHTEC_BW_EGRESS_COMP] = r->egress.comp;
+	v[SWITCHTEC_BW_EGRESS_NONPOSTED] = r->egress.nonposted;
+	v[SWITCHTEC_BW_INGRESS_POSTED] = r->ingress.posted;
+	v[SWITCHTEC_BW_INGRESS_COMP] = r->ingress.comp;
+	v[SWITCHTEC_BW_INGRESS_NONPOSTED] = r->ingress.nonposted;
+}
+
+static void bw_analyzer_restart(struct switchtec_bw_analyzer *a, int port)
+{
+	struct switchtec_bw_port_stats *st = &a->stats[port];
+
+	a->nr_intervals[port] = 0;
+	memset(a->var[port], 0, sizeof(a->var[port]));
+	st->egress_rate = 0;
+	st->ingress_rate = 0;
+	st->anomalies = 0;
+	memset(st->rate, 0, sizeof(st->rate));
+	memset(st->baseline, 0, sizeof(st->baseline));
+	memset(st->stddev, 0, sizeof(st->stddev));
+}
+
+static void bw_analyzer_port(struct switchtec_bw_analyzer *a, int port,
+			     const struct switchtec_bwcntr_res *cur)
+{
+	struct switchtec_bw_port_stats *st = &a->stats[port];
+	uint64_t old[SWITCHTEC_BW_NR_SERIES], new[SWITCHTEC_BW_NR_SERIES];
+	double *var = a->var[port];
+	double diff;
+	uint64_t dt;
+	int i;
+
+	bw_series(&a->prev[port], old);
+	bw_series(cur, new);
+
+	dt = cur->time_us > a->prev[port].time_us ?
+		cur->time_us - a->prev[port].time_us : 0;
+	a->prev[port] = *cur;
+
+	/* the counters were cleared by someone else, start over */
+	for (i = 0; i < SWITCHTEC_BW_NR_SERIES; i++)
+		if (new[i] < old[i])
+			dt = 0;
+
+	if (!dt) {
+		bw_analyzer_restart(a, port);
+		return;
+	}
+
+	st->anomalies = 0;
+	st->egress_rate = 0;
+	st->ingress_rate = 0;
+
+	for (i = 0; i < SWITCHTEC_BW_NR_SERIES; i++) {
+		st->rate[i] = (new[i] - old[i]) * 1e6 / dt;
+		if (i < SWITCHTEC_BW_INGRESS_POSTED)
+			st->egress_rate += st->rate[i];
+		else
+			st->ingress_rate += st->rate[i];
+
+		if (!a->nr_intervals[port]) {
+			st->baseline[i] = st->rate[i];
+			continue;
+		}
+
+		diff = st->rate[i] - st->baseline[i];
+		if (a->nr_intervals[port] >= a->warmup &&
+		    fabs(diff) > a->threshold * st->stddev[i] &&
+		    fabs(diff) > BW_ANOMALY_MIN_RATE)
+			st->anomalies |= 1 << i;
+
+		st->baseline[i] += a->alpha * diff;
+		var[i] = (1 - a->alpha) * (var[i] + a->alpha * diff * diff);
+		st->stddev[i] = sqrt(var[i]);
+	}
+
+	a->nr_intervals[port]++;
+}
+
+/**
+ * @brief Update the analysis with a new sample
+ * @param[in] a		Bandwidth analyzer
+ * @param[in] sample	Sample of a performance monitor session
+ * @return Number of ports with anomalies on success, -1 on error
+ *
+ * Rates are computed from the difference to the previous sample, so
+ * the first sample, and the first one after the port map changed, only
+ * sets the starting point.
+ */
+int switchtec_bw_analyzer_update(struct switchtec_bw_analyzer *a,
+				 const struct switchtec_pmon_sample *sample)
+{
+	int i, nr_anomalies = 0;
+
+	if (!sample->bw || sample->nr_ports > SWITCHTEC_MAX_PORTS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!a->have_prev || sample->generation != a->generation) {
+		a->have_prev = 1;
+		a->generation = sample->generation;
+		a->nr_ports = sample->nr_ports;
+
+		for (i = 0; i < a->nr_ports; i++) {
+			a->prev[i] = sample->bw[i];
+			a->stats[i].port = sample->ports[i];
+			bw_analyzer_restart(a, i);
+		}
+
+		return 0;
+	}
+
+	for (i = 0; i < a->nr_ports; i++) {
+		bw_analyzer_port(a, i, &sample->bw[i]);
+		if (a->stats[i].anomalies)
+			nr_anomalies++;
+	}
+
+	return nr_anomalies;
+}
+
+/**
+ * @brief Get the analysis of every port
+ * @param[in]  a	Bandwidth analyzer
+ * @param[out] stats	Analysis of each port, valid until the next update
+ * @return Number of ports
+ */
+int switchtec_bw_analyzer_stats(struct switchtec_bw_analyzer *a,
+				const struct switchtec_bw_port_stats **stats)
+{
+	*stats = a->stats;
+	return a->nr_ports;
+}
+
+static double bw_talker_rate(const struct switchtec_bw_analyzer *a, int port)
+{
+	return a->stats[port].egress_rate + a->stats[port].ingress_rate;
+}
+
+static void bw_heap_down(const struct switchtec_bw_analyzer *a, int *heap,
+			 int n, int i)
+{
+	int child, tmp;
+
+	while ((child = 2 * i + 1) < n) {
+		if (child + 1 < n && bw_talker_rate(a, heap[child + 1]) <
+		    bw_talker_rate(a, heap[child]))
+			child++;
+
+		if (bw_talker_rate(a, heap[i]) <= bw_talker_rate(a, heap[child]))
+			break;
+
+		tmp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = tmp;
+		i = child;
+	}
+}
+
+/**
+ * @brief Rank the ports with the most traffic
+ * @param[in]  a	Bandwidth analyzer
+ * @param[in]  n	Number of ports to rank
+ * @param[out] top	Indexes into the stats of the busiest ports, busiest
+ *			first. Must hold \p n entries.
+ * @return Number of ports in \p top
+ *
+ * Ports are ranked by their egress and ingress rates combined. Only the
+ * \p n busiest ports are kept in order while going over the ports, so
+ * this takes O(ports * log(n)) time.
+ */
+int switchtec_bw_analyzer_top(struct switchtec_bw_analyzer *a, int n,
+			      int *top)
+{
+	int i, len = 0, tmp;
+
+	if (n <= 0)
+		return 0;
+
+	/* min-heap of the busiest ports seen so far */
+	for (i = 0; i < a->nr_ports; i++) {
+		if (len < n) {
+			top[len++] = i;
+			if (len == n)
+				for (tmp = n / 2 - 1; tmp >= 0; tmp--)
+					bw_heap_down(a, top, n, tmp);
+			continue;
+		}
+
+		if (bw_talker_rate(a, i) <= bw_talker_rate(a, top[0]))
+			continue;
+
+		top[0] = i;
+		bw_heap_down(a, top, n, 0);
+	}
+
+	if (len < n)
+		for (tmp = len / 2 - 1; tmp >= 0; tmp--)
+			bw_heap_down(a, top, len, tmp);
+
+	/* sort the heap, the smallest ends up last */
+	for (i = len - 1; i > 0; i--) {
+		tmp = top[0];
+		top[0] = top[i];
+		top[i] = tmp;
+		bw_heap_down(a, top, i, 0);
+	}
+
+	return len;
+}
+
 /**@}*/
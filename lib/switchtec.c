@@ -38,10 +38,14 @@
 #include "switchtec/endian.h"
 #include "switchtec/utils.h"
 
+#include "lib/log.h"
+#include "lib/crc.h"
+
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <sys/time.h>
 
 /**
  * @defgroup Device Switchtec Management
@@ -57,23 +61,6 @@
  * @{
  */
 
-/**
- * @brief Module-specific log definitions
- */
-struct module_log_defs {
-	char *mod_name;		//!< module name
-	char **entries;		//!< log entry array
-	int num_entries;	//!< number of log entries
-};
-
-/**
- * @brief Log definitions for all modules
- */
-struct log_defs {
-	struct module_log_defs *module_defs;	//!< per-module log definitions
-	int num_alloc;				//!< number of modules allocated
-};
-
 /**
  * @brief Switchtec device id to generation/variant mapping
  */
@@ -775,6 +762,19 @@ const char *switchtec_strerror(void)
 		case SWITCHTEC_ERR_DYNAMIC_BIF_UNSUPPORTED:
 			msg = "Dynamic bifurcation not supported on this device";
 			break;
+		case SWITCHTEC_ERR_LOG_INDEX_INVAL:
+			msg = "Log index is invalid or out of date"; break;
+		case SWITCHTEC_ERR_LOG_NO_TIME_SYNC:
+			msg = "Log file has no host time correlation"; break;
+		case SWITCHTEC_ERR_METRICS_INVAL:
+			msg = "Not a metrics segment of a supported version";
+			break;
+		case SWITCHTEC_ERR_EYE_FILE_INVAL:
+			msg = "Not a valid eye data file"; break;
+		case SWITCHTEC_ERR_OSA_TRACE_INVAL:
+			msg = "Not a valid OSA trace file"; break;
+		case SWITCHTEC_ERR_EQ_FILE_INVAL:
+			msg = "Not a valid equalization snapshot file"; break;
 		default:
 			msg = "Unknown Switchtec error"; break;
 		}
@@ -951,918 +951,1651 @@ int switchtec_hard_reset(struct switchtec_dev *dev)
 			     NULL, 0);
 }
 
-/**
- * @brief Free log definition data
- * @param[in] defs - log definition data to free
- */
-static void free_log_defs(struct log_defs *defs)
+static int append_ftdc_log_header(int fd, uint32_t sdk_def_version,
+								uint32_t fw_def_version)
 {
-	int i, j;
-
-	if (!defs->module_defs)
-		return;
-
-	for (i = 0; i < defs->num_alloc; i++) {
-		free(defs->module_defs[i].mod_name);
-
-		for (j = 0; j < defs->module_defs[i].num_entries; j++)
-			free(defs->module_defs[i].entries[j]);
+	int ret;
+	char hdr_str_fmt[] = "##########################################\n"
+			     "## Parsed with FTDC log file from definition:\n"
+			     "## FW def version %08x\n"
+			     "## SDK def version %08x\n"
+			     "##########################################\n\n";
+	char hdr_str[512];
 
-		free(defs->module_defs[i].entries);
-	}
+	snprintf(hdr_str, 512, hdr_str_fmt, fw_def_version, sdk_def_version);
+	ret = write(fd, hdr_str, strlen(hdr_str));
 
-	free(defs->module_defs);
+	return ret;
 }
 
 /**
- * @brief Allocate / reallocate log definition data
- * @param[in] defs 	  - log definition data
- * @param[in] num_modules - number of modules to allocate for
- * @return 0 on success, negative value on failure
+ * @brief Correlation of device log timestamps with host wall clock time
  */
-static int realloc_log_defs(struct log_defs *defs, int num_modules)
+struct log_time_sync {
+	uint64_t boot_ns;	//!< wall clock time of device tick zero
+	uint32_t err_us;	//!< uncertainty of boot_ns
+};
+
+static const uint8_t log_file_magic[8] = {
+	'S', 'W', 'M', 'C', 'L', 'O', 'G', 'F'
+};
+
+static int append_log_header(int fd, uint32_t sdk_version,
+			     uint32_t fw_version, int binary,
+			     const struct log_time_sync *sync)
 {
-	int i;
+	int ret;
+	struct log_file_header header = {
+		.fw_version = fw_version,
+		.sdk_version = sdk_version
+	};
+	char hdr_str_fmt[] = "####################################\n"
+			     "## Parsed with definition file for\n"
+			     "## FW version %08x\n"
+			     "## SDK version %08x\n"
+			     "####################################\n\n";
+	char hdr_str[512];
 
-	defs->module_defs = realloc(defs->module_defs,
-				    (num_modules *
-				     sizeof(struct module_log_defs)));
-	if (!defs->module_defs) {
-		free_log_defs(defs);
-		return -1;
-	}
+	memcpy(header.magic, log_file_magic, sizeof(header.magic));
 
-	for (i = defs->num_alloc; i < num_modules; i++)
-		memset(&defs->module_defs[i], 0,
-		       sizeof(struct module_log_defs));
+	if (sync) {
+		header.flags |= LOG_FILE_HDR_TIME_SYNC;
+		header.boot_ns_lo = sync->boot_ns;
+		header.boot_ns_hi = sync->boot_ns >> 32;
+		header.sync_err_us = sync->err_us;
+	}
 
-	defs->num_alloc = num_modules;
+	if (binary) {
+		ret = write(fd, &header, sizeof(header));
+	} else {
+		snprintf(hdr_str, 512, hdr_str_fmt, fw_version, sdk_version);
+		ret = write(fd, hdr_str, strlen(hdr_str));
+	}
 
-	return 0;
+	return ret;
 }
 
-/**
- * @brief Parse an integer from a string
- * @param[in] str  - string to parse
- * @param[out] val - integer
- * @return true on success, false on failure
- */
-static bool parse_int(char *str, int *val)
+static int get_ts_factor(enum switchtec_gen gen)
 {
-	char *endptr;
-
-	errno = 0;
-	*val = strtol(str, &endptr, 0);
-
-	if ((endptr == str) || (*endptr != '\0') || (errno != 0))
-		return false;
-
-	return true;
+	if (gen == SWITCHTEC_GEN_UNKNOWN)
+		return 0;
+	else if (gen == SWITCHTEC_GEN3)
+		return 1000;
+	else
+		return 833;
 }
 
-/**
- * @brief Read an app log definition file and store the definitions
- * @param[in] log_def_file - log definition file
- * @param[out] defs 	   - log definitions
- * @return 0 on success, negative value on failure
+/* Number of RTC counter reads used to correlate device and host time */
+#define LOG_TIME_SYNC_SAMPLES 3
+
+/*
+ * Log timestamps count ticks of the RTC counter. Read it a few times,
+ * bracketed by the host clock, and keep the read with the shortest
+ * round trip: the counter was sampled somewhere within that window.
  */
-static int read_app_log_defs(FILE *log_def_file, struct log_defs *defs)
+static int log_time_sync_sample(struct switchtec_dev *dev,
+				struct log_time_sync *sync)
 {
-	int ret;
-	char line[512];
-	char *tok;
-	int mod_id;
-	struct module_log_defs *mod_defs;
-	int num_entries;
+	int ts_factor = get_ts_factor(dev->gen);
+	uint64_t rtc, t0, t1, best = UINT64_MAX;
+	struct timeval tv;
 	int i;
 
-	/* allocate some log definition entries */
-	ret = realloc_log_defs(defs, 200);
-	if (ret < 0)
-		return ret;
+	if (!ts_factor)
+		return -1;
 
-	while (fgets(line, sizeof(line), log_def_file)) {
+	for (i = 0; i < LOG_TIME_SYNC_SAMPLES; i++) {
+		gettimeofday(&tv, NULL);
+		t0 = tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL;
 
-		/* ignore comments */
-		if (line[0] == '#')
-			continue;
+		if (switchtec_rtc_counter_get(dev, &rtc))
+			return -1;
 
-		/* strip any newline characters */
-		line[strcspn(line, "\r\n")] = '\0';
+		gettimeofday(&tv, NULL);
+		t1 = tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL;
 
-		/*
-		 * Tokenize and parse the line. Module headings are of the form:
-		 * mod_name    mod_id    num_entries
-		 */
-		tok = strtok(line, " \t");
-		if (!tok)
+		if (t1 < t0 || t1 - t0 >= best)
 			continue;
 
-		tok = strtok(NULL, " \t");
-		if (!tok)
-			continue;
+		best = t1 - t0;
+		sync->boot_ns = t0 + best / 2 - rtc * ts_factor / 100;
+		sync->err_us = best / 2000 + 1;
+	}
 
-		if (!parse_int(tok, &mod_id)) {
-			errno = SWITCHTEC_ERR_LOG_DEF_DATA_INVAL;
-			goto err_free_log_defs;
-		}
+	return best == UINT64_MAX ? -1 : 0;
+}
 
-		/* reallocate more log definition entries if needed */
-		if (mod_id > defs->num_alloc) {
-			ret = realloc_log_defs(defs, mod_id * 2);
-			if (ret < 0)
-				return ret;
-		}
+/**
+ * @brief State for reading the app log, shared by dumping and following
+ */
+struct switchtec_log_follow {
+	struct switchtec_dev *dev;
+	int sub_cmd_id;
+	int fd;
+	bool parse;		//!< parse the entries with log definitions
+	bool hdr_done;		//!< the file header has been written
+	uint32_t start;		//!< index of the next entry to read
+	unsigned int entry_idx;	//!< number of entries written so far
+	unsigned int interval;	//!< next polling interval in ms
+	struct switchtec_log_file_info *info;
+	uint32_t fw_version;
+	uint32_t sdk_version;
+
+	struct log_defs defs;
+	struct log_fmt_prog prog;
+	struct log_fmt_out out;
+	FILE *log_file;
+};
 
-		mod_defs = &defs->module_defs[mod_id];
+static int log_a_init(struct switchtec_log_follow *lf,
+		      struct switchtec_dev *dev, int sub_cmd_id,
+		      int fd, FILE *log_def_file,
+		      struct switchtec_log_file_info *info)
+{
+	int ret;
 
-		tok = strtok(NULL, " \t");
-		if (!tok)
-			continue;
+	memset(lf, 0, sizeof(*lf));
+	lf->dev = dev;
+	lf->sub_cmd_id = sub_cmd_id;
+	lf->fd = fd;
+	lf->start = -1;
+	lf->info = info;
 
-		if (!parse_int(tok, &num_entries)) {
-			errno = SWITCHTEC_ERR_LOG_DEF_DATA_INVAL;
-			goto err_free_log_defs;
-		}
+	if (log_def_file == NULL)
+		return 0;
 
-		/*
-		 * Skip this module if it has already been done. This can happen
-		 * if the module is duplicated in the log definition file.
-		 */
-		if (mod_defs->mod_name != NULL) {
-			for (i = 0; i < num_entries; i++) {
-				if (!fgets(line, sizeof(line),
-					  log_def_file))
-					break;
-			}
-			continue;
-		}
+	lf->parse = true;
 
-		mod_defs->mod_name = strdup(line);
-		mod_defs->num_entries = num_entries;
-		mod_defs->entries = calloc(mod_defs->num_entries,
-					   sizeof(*mod_defs->entries));
-		if (!mod_defs->entries)
-			goto err_free_log_defs;
-
-		for (i = 0; i < mod_defs->num_entries; i++) {
-			if (fgets(line, sizeof(line), log_def_file) == NULL) {
-				errno = SWITCHTEC_ERR_LOG_DEF_READ_ERROR;
-				goto err_free_log_defs;
-			}
+	ret = log_def_parse_header(log_def_file, &lf->fw_version,
+				   &lf->sdk_version);
+	if (ret)
+		return ret;
 
-			mod_defs->entries[i] = strdup(line);
-			if (!mod_defs->entries[i])
-				goto err_free_log_defs;
-		}
-	}
+	/* read the log definition file into defs */
+	ret = log_defs_read(log_def_file, SWITCHTEC_LOG_DEF_TYPE_APP,
+			    lf->fw_version, lf->sdk_version, &lf->defs);
+	if (ret < 0)
+		return ret;
 
-	if (ferror(log_def_file)) {
-		errno = SWITCHTEC_ERR_LOG_DEF_READ_ERROR;
-		goto err_free_log_defs;
-	}
+	lf->log_file = fdopen(fd, "w");
+	if (!lf->log_file)
+		return -1;
 
-	return 0;
+	if (log_fmt_prog_init(&lf->prog, &lf->defs,
+			      SWITCHTEC_LOG_PARSE_TYPE_APP,
+			      get_ts_factor(dev->gen)))
+		return -1;
 
-err_free_log_defs:
-	free_log_defs(defs);
-	return -1;
+	return log_fmt_out_init(&lf->out, lf->log_file);
 }
 
-/**
- * @brief Read a mailbox log definition file and store the definitions
- * @param[in] log_def_file - log definition file
- * @param[out] defs 	   - log definitions
- * @return 0 on success, negative value on failure
- */
-static int read_mailbox_log_defs(FILE *log_def_file, struct log_defs *defs)
+static void log_a_free(struct switchtec_log_follow *lf)
 {
-	int ret;
-	char line[512];
-	struct module_log_defs *mod_defs;
-	int num_entries_alloc;
-
-	/*
-	 * The mailbox log definitions don't keep track of modules. Allocate a
-	 * single log definition entry for all definitions.
-	 */
-	ret = realloc_log_defs(defs, 1);
-	if (ret < 0)
-		return ret;
+	log_fmt_out_free(&lf->out);
+	log_fmt_prog_free(&lf->prog);
+	log_defs_free(&lf->defs);
+}
 
-	mod_defs = &defs->module_defs[0];
-	mod_defs->num_entries = 0;
+static int log_a_write_header(struct switchtec_log_follow *lf,
+			      struct log_a_retr_result *res)
+{
+	struct switchtec_log_file_info *info = lf->info;
+	struct log_time_sync sync;
+	bool synced = false;
 
-	/* allocate some entries */
-	num_entries_alloc = 100;
-	mod_defs->entries = calloc(num_entries_alloc,
-				   sizeof(*mod_defs->entries));
-	if (!mod_defs->entries)
-		goto err_free_log_defs;
+	if (lf->dev->gen < SWITCHTEC_GEN5) {
+		res->hdr.sdk_version = 0;
+		res->hdr.fw_version = 0;
+	}
 
-	while (fgets(line, sizeof(line), log_def_file)) {
-		/* ignore comments */
-		if (line[0] == '#')
-			continue;
+	if (info) {
+		info->def_fw_version = lf->fw_version;
+		info->def_sdk_version = lf->sdk_version;
+		info->log_fw_version = res->hdr.fw_version;
+		info->log_sdk_version = res->hdr.sdk_version;
+	}
 
-		if (mod_defs->num_entries >= num_entries_alloc) {
-			/* allocate more entries */
-			num_entries_alloc *= 2;
-			mod_defs->entries = realloc(mod_defs->entries,
-						    (num_entries_alloc *
-						     sizeof(*mod_defs->entries)));
-			if (!mod_defs->entries)
-				goto err_free_log_defs;
-		}
+	if (res->hdr.sdk_version != lf->sdk_version ||
+	     res->hdr.fw_version != lf->fw_version) {
+		if (info && lf->parse)
+			info->version_mismatch = true;
+	}
 
-		mod_defs->entries[mod_defs->num_entries] = strdup(line);
-		if (!mod_defs->entries[mod_defs->num_entries])
-			goto err_free_log_defs;
+	/* binary logs record their host time so they can be merged later */
+	if (!lf->parse)
+		synced = !log_time_sync_sample(lf->dev, &sync);
 
-		mod_defs->num_entries++;
-	}
+	append_log_header(lf->fd, res->hdr.sdk_version, res->hdr.fw_version,
+			  !lf->parse, synced ? &sync : NULL);
+	lf->hdr_done = true;
 
-	if (ferror(log_def_file)) {
-		errno = SWITCHTEC_ERR_LOG_DEF_READ_ERROR;
-		goto err_free_log_defs;
-	}
+	if (lf->parse)
+		return log_fmt_write_heading(&lf->prog, &lf->out);
 
 	return 0;
-
-err_free_log_defs:
-	free_log_defs(defs);
-	return -1;
 }
 
-/**
- * @brief Parse an app log or mailbox log and write the results to a file
- * @param[in] log_data	     - logging data
- * @param[in] count	     - number of entries
- * @param[in] init_entry_idx - index of the initial entry
- * @param[in] defs           - log definitions
- * @param[in] log_type       - log type
- * @param[in] log_file	     - log output file
- * @param[in] ts_factor	     - timestamp conversion factor
- * @return 0 on success, negative value on failure
+/*
+ * Read all entries from lf->start up to the newest one and write them
+ * out. Returns the number of entries read in *nr_read and, in *lost,
+ * how many were overwritten by the firmware before they could be read.
  */
-static int write_parsed_log(struct log_a_data log_data[],
-			    size_t count, int init_entry_idx,
-			    struct log_defs *defs,
-			    enum switchtec_log_parse_type log_type,
-			    FILE *log_file, int ts_factor)
+static int log_a_read(struct switchtec_log_follow *lf,
+		      unsigned int *nr_read, unsigned int *lost)
 {
-	int i;
 	int ret;
-	int entry_idx = init_entry_idx;
-	unsigned long long time;
-	unsigned int nanos, micros, millis, secs, mins, hours, days;
-	unsigned int entry_num;
-	unsigned int mod_id;
-	unsigned int log_sev = 0;
-	const char *log_sev_strs[] = {"DISABLED", "HIGHEST", "HIGH", "MEDIUM",
-				      "LOW", "LOWEST"};
-	bool is_bl1;
-	struct module_log_defs *mod_defs;
-
-	if (entry_idx == 0) {
-		if (log_type == SWITCHTEC_LOG_PARSE_TYPE_APP || log_type == SWITCHTEC_LOG_PARSE_TYPE_FTDC)
-			fputs("   #|Timestamp                |Module       |Severity |Event ID |Event\n",
-			      log_file);
-		else
-			fputs("   #|Timestamp                |Source |Event ID |Event\n",
-			      log_file);
-	}
-
-	for (i = 0; i < count; i ++) {
-		/* timestamp is in the first 2 DWords */
-		time = (((unsigned long long)log_data[i].data[0] << 32) |
-			log_data[i].data[1]) * ts_factor/100;
-		nanos = time % 1000;
-		time /= 1000;
-		micros = time % 1000;
-		time /= 1000;
-		millis = time % 1000;
-		time /= 1000;
-		secs = time % 60;
-		time /= 60;
-		mins = time % 60;
-		time /= 60;
-		hours = time % 24;
-		days = time / 24;
-
-		if (log_type == SWITCHTEC_LOG_PARSE_TYPE_APP || log_type == SWITCHTEC_LOG_PARSE_TYPE_FTDC) {
-			/*
-			 * app log: module ID and log severity are in the 3rd
-			 * DWord
-			 */
-			mod_id = (log_data[i].data[2] >> 16) & 0xFFF;
-			log_sev = (log_data[i].data[2] >> 28) & 0xF;
-
-			if ((mod_id > defs->num_alloc) ||
-			    (defs->module_defs[mod_id].mod_name == NULL) ||
-			    (strlen(defs->module_defs[mod_id].mod_name) == 0)) {
-				if (fprintf(log_file, "(Invalid module ID: 0x%x)\n",
-					mod_id) < 0)
-					goto ret_print_error;
-				continue;
-			}
+	unsigned int read = 0;
+	struct log_a_retr_result res;
+	struct log_a_retr cmd = {
+		.sub_cmd_id = lf->sub_cmd_id,
+		.start = htole32(lf->start),
+	};
+	uint32_t first;
 
-			if (log_sev >= ARRAY_SIZE(log_sev_strs)) {
-				if (fprintf(log_file, "(Invalid log severity: %d)\n",
-					log_sev) < 0)
-					goto ret_print_error;
-				continue;
-			}
-		} else {
-			/*
-			 * mailbox log: BL1/BL2 indication is in the 3rd
-			 * DWord
-			 */
-			is_bl1 = (((log_data[i].data[2] >> 27) & 1) == 0);
+	*nr_read = 0;
+	if (lost)
+		*lost = 0;
 
-			/* mailbox log definitions are all in the first entry */
-			mod_id = 0;
-		}
+	res.hdr.remain = 1;
 
-		mod_defs = &defs->module_defs[mod_id];
+	while (res.hdr.remain) {
+		ret = switchtec_cmd(lf->dev, MRPC_FWLOGRD, &cmd, sizeof(cmd),
+				    &res, sizeof(res));
+		if (ret)
+			return ret;
 
-		/* entry number is in the 3rd DWord */
-		entry_num = log_data[i].data[2] & 0x0000FFFF;
+		if (res.hdr.overflow) {
+			if (lf->info)
+				lf->info->overflow = 1;
 
-		if (entry_num >= mod_defs->num_entries) {
-			if (fprintf(log_file,
-				    "(Invalid log entry number: %d (module 0x%x))\n",
-				    entry_num, mod_id) < 0)
-				goto ret_print_error;
-			continue;
+			/*
+			 * The oldest entries have been overwritten if the
+			 * first one returned is not the one we asked for
+			 */
+			first = le32toh(res.hdr.next_start) -
+				le32toh(res.hdr.count);
+			if (lost && read == 0 && cmd.start != -1)
+				*lost = first - le32toh(cmd.start);
 		}
 
-		/* print the entry index and timestamp */
-		if (ts_factor == 0)
-			ret = fprintf(log_file,
-				      "%04d|xxxd xx:xx:xx.xxx,xxx,xxx|",
-				      entry_idx);
-		else
-			ret = fprintf(log_file,
-				      "%04d|%03dd %02d:%02d:%02d.%03d,%03d,%03d|",
-				      entry_idx, days, hours, mins, secs,
-				      millis, micros, nanos);
+		if (!lf->hdr_done && log_a_write_header(lf, &res))
+			return -1;
 
-		if (ret < 0)
-			goto ret_print_error;
-
-		if (log_type == SWITCHTEC_LOG_PARSE_TYPE_APP || log_type == SWITCHTEC_LOG_PARSE_TYPE_FTDC) {
-			/* print the module name and log severity */
-			if (fprintf(log_file, "%-12s |%-8s |0x%04x   |",
-			    mod_defs->mod_name, log_sev_strs[log_sev],
-			    entry_num) < 0)
-				goto ret_print_error;
+		if (!lf->parse) {
+			/* write the binary log data to a file */
+			ret = write(lf->fd, res.data,
+				    sizeof(*res.data) * res.hdr.count);
+			if (ret < 0)
+				return ret;
 		} else {
-			/* print the log source (BL1/BL2) */
-			if (fprintf(log_file, "%-6s |0x%04x   |",
-			    (is_bl1 ? "BL1" : "BL2"), entry_num) < 0)
-				goto ret_print_error;
+			/* parse the log data and write it to a file */
+			ret = log_fmt_write(&lf->prog, &lf->out, res.data,
+					    res.hdr.count, lf->entry_idx);
+			if (ret < 0)
+				return ret;
 		}
 
-		/* print the log entry */
-		if (fprintf(log_file, mod_defs->entries[entry_num],
-			    log_data[i].data[3], log_data[i].data[4],
-			    log_data[i].data[5], log_data[i].data[6],
-			    log_data[i].data[7]) < 0)
-			goto ret_print_error;
-
-		entry_idx++;
+		lf->entry_idx += le32toh(res.hdr.count);
+		read += le32toh(res.hdr.count);
+		cmd.start = res.hdr.next_start;
 	}
 
-	if (fflush(log_file) != 0)
+	lf->start = le32toh(cmd.start);
+	*nr_read = read;
+
+	if (lf->parse && (log_fmt_out_flush(&lf->out) ||
+			  fflush(lf->log_file))) {
+		errno = SWITCHTEC_ERR_PARSED_LOG_WRITE_ERROR;
 		return -1;
+	}
 
 	return 0;
+}
 
-ret_print_error:
-	errno = SWITCHTEC_ERR_PARSED_LOG_WRITE_ERROR;
-	return -1;
+static int log_a_to_file(struct switchtec_dev *dev, int sub_cmd_id,
+			 int fd, FILE *log_def_file,
+			 struct switchtec_log_file_info *info)
+{
+	struct switchtec_log_follow lf;
+	unsigned int read;
+	int ret;
+
+	ret = log_a_init(&lf, dev, sub_cmd_id, fd, log_def_file, info);
+	if (!ret)
+		ret = log_a_read(&lf, &read, NULL);
+
+	log_a_free(&lf);
+	return ret;
 }
 
-static int parse_def_header(FILE *log_def_file, uint32_t *fw_version,
-			    uint32_t *sdk_version)
+static int log_b_to_file(struct switchtec_dev *dev, int sub_cmd_id, int fd)
 {
-	char line[512];
-	int i;
+	int ret;
+	int read = 0;
+	struct log_b_retr_result res;
+	struct log_b_retr cmd = {
+		.sub_cmd_id = sub_cmd_id,
+		.offset = 0,
+		.length = htole32(sizeof(res.data)),
+	};
 
-	*fw_version = 0;
-	*sdk_version = 0;
-	while (fgets(line, sizeof(line), log_def_file)) {
-		if (line[0] != '#')
-			continue;
+	res.hdr.remain = sizeof(res.data);
+
+	while (res.hdr.remain) {
+		ret = switchtec_cmd(dev, MRPC_FWLOGRD, &cmd, sizeof(cmd),
+				    &res, sizeof(res));
+		if (ret)
+			return -1;
 
-		i = 0;
-		while (line[i] == ' ' || line[i] == '#') i++;
+		ret = write(fd, res.data, res.hdr.length);
+		if (ret < 0)
+			return ret;
 
-		if (strncasecmp(line + i, "SDK Version:", 12) == 0) {
-			i += 12;
-			while (line[i] == ' ') i++;
-			sscanf(line + i, "%i", (int*)sdk_version);
-		}
-		else if (strncasecmp(line + i, "FW Version:", 11) == 0) {
-			i += 11;
-			while (line[i] == ' ') i++;
-			sscanf(line + i, "%i", (int*)fw_version);
-		}
+		read += le32toh(res.hdr.length);
+		cmd.offset = htole32(read);
 	}
 
-	rewind(log_def_file);
 	return 0;
 }
 
-static int append_ftdc_log_header(int fd, uint32_t sdk_def_version,
-								uint32_t fw_def_version)
+static int log_c_to_file(struct switchtec_dev *dev, int sub_cmd_id, int fd)
 {
 	int ret;
-	char hdr_str_fmt[] = "##########################################\n"
-			     "## Parsed with FTDC log file from definition:\n"
-			     "## FW def version %08x\n"
-			     "## SDK def version %08x\n"
-			     "##########################################\n\n";
-	char hdr_str[512];
+	struct log_cmd {
+		uint8_t subcmd;
+		uint8_t rsvd[3];
+	} cmd = {};
 
-	snprintf(hdr_str, 512, hdr_str_fmt, fw_def_version, sdk_def_version);
-	ret = write(fd, hdr_str, strlen(hdr_str));
+	struct log_reply {
+		uint8_t reason;
+		uint8_t rsvd[3];
+		uint32_t nvlog_version;
+		uint32_t thread_handle;
+		uint32_t fw_version;
+		uint32_t timestamp1;
+		uint32_t timestamp2;
+	} reply;
 
-	return ret;
+	cmd.subcmd = sub_cmd_id;
+
+	ret = switchtec_cmd(dev, MRPC_FWLOGRD, &cmd, sizeof(cmd),
+			    &reply, sizeof(reply));
+	if (ret)
+		return -1;
+
+	ret = write(fd, &reply, sizeof(reply));
+	if (ret < 0)
+		return ret;
+
+	return 0;
 }
 
-static int append_log_header(int fd, uint32_t sdk_version,
-			     uint32_t fw_version, int binary)
+static int log_d_to_file(struct switchtec_dev *dev, int sub_cmd_id, int fd)
 {
 	int ret;
-	struct log_header {
-		uint8_t magic[8];
-		uint32_t fw_version;
-		uint32_t sdk_version;
-		uint32_t flags;
-		uint32_t rsvd[3];
-	} header = {
-		.magic = {'S', 'W', 'M', 'C', 'L', 'O', 'G', 'F'},
-		.fw_version = fw_version,
-		.sdk_version = sdk_version
+	int read = 0;
+
+	struct log_ftdc_retr_result res;
+	struct log_ftdc_retr cmd = {
+		.sub_cmd_id = sub_cmd_id,
+		.reserved = 0,
+		.req_seq = 0,
 	};
-	char hdr_str_fmt[] = "####################################\n"
-			     "## Parsed with definition file for\n"
-			     "## FW version %08x\n"
-			     "## SDK version %08x\n"
-			     "####################################\n\n";
-	char hdr_str[512];
+	uint32_t length = sizeof(res.data);
 
-	if (binary) {
-		ret = write(fd, &header, sizeof(header));
-	} else {
-		snprintf(hdr_str, 512, hdr_str_fmt, fw_version, sdk_version);
-		ret = write(fd, hdr_str, strlen(hdr_str));
+	cmd.req_seq = 0;
+	res.data[1] = 0;
+
+	while ( !(res.data[1]) ) {
+		ret = switchtec_cmd(dev, MRPC_FTDC_LOG_DUMP, &cmd, sizeof(cmd),
+				    &res, sizeof(res));
+		if (ret)
+			return -1;
+
+		ret = write(fd, res.data, (res.data[0]+1)*4);
+		if (ret < 0)
+			return ret;
+
+		read += length;
+		cmd.req_seq++;
 	}
 
-	return ret;
+	return 0;
 }
 
-static int get_ts_factor(enum switchtec_gen gen)
+static int log_ram_flash_to_file(struct switchtec_dev *dev,
+				 int gen5_cmd, int gen4_cmd, int gen4_cmd_lgcy,
+				 int fd, FILE *log_def_file,
+				 struct switchtec_log_file_info *info)
 {
-	if (gen == SWITCHTEC_GEN_UNKNOWN)
-		return 0;
-	else if (gen == SWITCHTEC_GEN3)
-		return 1000;
-	else
-		return 833;
+	int ret;
+
+	if (switchtec_is_gen5(dev) || switchtec_is_gen6(dev)) {
+		return log_a_to_file(dev, gen5_cmd, fd, log_def_file,
+				     info);
+	} else {
+		ret = log_a_to_file(dev, gen4_cmd, fd, log_def_file,
+				    info);
+
+		/* somehow hardware returns ERR_LOGC_PORT_ARDY_BIND
+		 * instead of ERR_SUBCMD_INVALID if this subcommand
+		 * is not supported, so we fall back to legacy
+		 * subcommand on ERR_LOGC_PORT_ARDY_BIND error as well
+		 */
+		if (ret > 0 &&
+		    (ERRNO_MRPC(errno) == ERR_LOGC_PORT_ARDY_BIND ||
+		     ERRNO_MRPC(errno) == ERR_SUBCMD_INVALID))
+			ret = log_a_to_file(dev, gen4_cmd_lgcy, fd,
+					    log_def_file, info);
+
+		return ret;
+	}
 }
 
-static int log_a_to_file(struct switchtec_dev *dev, int sub_cmd_id,
-			 int fd, FILE *log_def_file,
-			 struct switchtec_log_file_info *info)
+/**
+ * @brief Dump the Switchtec log data to a file
+ * @param[in]  dev          - Switchtec device handle
+ * @param[in]  type         - Type of log data to dump
+ * @param[in]  fd           - File descriptor to dump the data to
+ * @param[in]  log_def_file - Log definition file
+ * @param[out] info         - Log file information
+ * @return 0 on success, error code on failure
+ */
+int switchtec_log_to_file(struct switchtec_dev *dev,
+		enum switchtec_log_type type, int fd, FILE *log_def_file,
+		struct switchtec_log_file_info *info)
 {
-	int ret = -1;
-	int read = 0;
-	struct log_a_retr_result res;
-	struct log_a_retr cmd = {
-		.sub_cmd_id = sub_cmd_id,
-		.start = -1,
+	if (info)
+		memset(info, 0, sizeof(*info));
+
+	switch (type) {
+	case SWITCHTEC_LOG_RAM:
+		return log_ram_flash_to_file(dev,
+					     MRPC_FWLOGRD_RAM_GEN5,
+					     MRPC_FWLOGRD_RAM_WITH_FLAG,
+					     MRPC_FWLOGRD_RAM,
+					     fd, log_def_file, info);
+	case SWITCHTEC_LOG_FLASH:
+		return log_ram_flash_to_file(dev,
+					     MRPC_FWLOGRD_FLASH_GEN5,
+					     MRPC_FWLOGRD_FLASH_WITH_FLAG,
+					     MRPC_FWLOGRD_FLASH,
+					     fd, log_def_file, info);
+	case SWITCHTEC_LOG_FTDC:
+		return log_d_to_file(dev, MRPC_FWLOGRD_RAM, fd);
+	case SWITCHTEC_LOG_MEMLOG:
+		return log_b_to_file(dev, MRPC_FWLOGRD_MEMLOG, fd);
+	case SWITCHTEC_LOG_REGS:
+		return log_b_to_file(dev, MRPC_FWLOGRD_REGS, fd);
+	case SWITCHTEC_LOG_THRD_STACK:
+		return log_b_to_file(dev, MRPC_FWLOGRD_THRD_STACK, fd);
+	case SWITCHTEC_LOG_SYS_STACK:
+		return log_b_to_file(dev, MRPC_FWLOGRD_SYS_STACK, fd);
+	case SWITCHTEC_LOG_THRD:
+		return log_b_to_file(dev, MRPC_FWLOGRD_THRD, fd);
+	case SWITCHTEC_LOG_NVHDR:
+		return log_c_to_file(dev, MRPC_FWLOGRD_NVHDR, fd);
 	};
-	struct log_defs defs = {
-		.module_defs = NULL,
-		.num_alloc = 0};
-	FILE *log_file;
-	int entry_idx = 0;
-	uint32_t fw_version = 0;
-	uint32_t sdk_version = 0;
 
-	if (log_def_file != NULL) {
-		ret = parse_def_header(log_def_file, &fw_version,
-				       &sdk_version);
-		if (ret)
-			return ret;
-		/* read the log definition file into defs */
-		ret = read_app_log_defs(log_def_file, &defs);
-		if (ret < 0)
-			return ret;
+	errno = EINVAL;
+	return -errno;
+}
+
+/* Bounds of the adaptive polling interval when following a log, in ms */
+#define LOG_FOLLOW_MIN_INTERVAL 50
+#define LOG_FOLLOW_MAX_INTERVAL 2000
+
+/**
+ * @brief Start following the app log
+ * @param[in]  dev          - Switchtec device handle
+ * @param[in]  type         - Type of log to follow (RAM or FLASH)
+ * @param[in]  fd           - File descriptor to write the log to
+ * @param[in]  log_def_file - Log definition file, or NULL to write
+ *			      binary entries
+ * @param[out] info         - Log file information
+ * @return Follow handle on success, NULL on failure
+ *
+ * All entries currently in the log are written to \p fd, like
+ * switchtec_log_to_file(). Subsequent calls to switchtec_log_follow_poll()
+ * only retrieve and write the entries logged since the previous call.
+ */
+struct switchtec_log_follow *switchtec_log_follow_open(
+		struct switchtec_dev *dev, enum switchtec_log_type type,
+		int fd, FILE *log_def_file,
+		struct switchtec_log_file_info *info)
+{
+	struct switchtec_log_follow *lf;
+	int cmd, cmd_lgcy;
+	unsigned int read;
+	int ret;
+
+	switch (type) {
+	case SWITCHTEC_LOG_RAM:
+		cmd = MRPC_FWLOGRD_RAM_WITH_FLAG;
+		cmd_lgcy = MRPC_FWLOGRD_RAM;
+		if (switchtec_is_gen5(dev) || switchtec_is_gen6(dev))
+			cmd = MRPC_FWLOGRD_RAM_GEN5;
+		break;
+	case SWITCHTEC_LOG_FLASH:
+		cmd = MRPC_FWLOGRD_FLASH_WITH_FLAG;
+		cmd_lgcy = MRPC_FWLOGRD_FLASH;
+		if (switchtec_is_gen5(dev) || switchtec_is_gen6(dev))
+			cmd = MRPC_FWLOGRD_FLASH_GEN5;
+		break;
+	default:
+		errno = EINVAL;
+		return NULL;
 	}
 
-	res.hdr.remain = 1;
+	if (info)
+		memset(info, 0, sizeof(*info));
 
-	while (res.hdr.remain) {
-		ret = switchtec_cmd(dev, MRPC_FWLOGRD, &cmd, sizeof(cmd),
-				    &res, sizeof(res));
-		if (ret)
-			goto ret_free_log_defs;
-		if (res.hdr.overflow && info)
-			info->overflow = 1;
-		if (read == 0) {
-			if (dev->gen < SWITCHTEC_GEN5) {
-				res.hdr.sdk_version = 0;
-				res.hdr.fw_version = 0;
-			}
+	lf = malloc(sizeof(*lf));
+	if (!lf)
+		return NULL;
 
-			if (info) {
-				info->def_fw_version = fw_version;
-				info->def_sdk_version = sdk_version;
-				info->log_fw_version = res.hdr.fw_version;
-				info->log_sdk_version = res.hdr.sdk_version;
-			}
+	ret = log_a_init(lf, dev, cmd, fd, log_def_file, info);
+	if (ret)
+		goto err_free;
 
-			if (res.hdr.sdk_version != sdk_version ||
-			     res.hdr.fw_version != fw_version) {
-				if (info && log_def_file)
-					info->version_mismatch = true;
+	ret = log_a_read(lf, &read, NULL);
 
-			}
+	/* see log_ram_flash_to_file() */
+	if (ret > 0 && !switchtec_is_gen5(dev) && !switchtec_is_gen6(dev) &&
+	    (ERRNO_MRPC(errno) == ERR_LOGC_PORT_ARDY_BIND ||
+	     ERRNO_MRPC(errno) == ERR_SUBCMD_INVALID)) {
+		lf->sub_cmd_id = cmd_lgcy;
+		ret = log_a_read(lf, &read, NULL);
+	}
 
-			append_log_header(fd, res.hdr.sdk_version,
-					  res.hdr.fw_version,
-					  log_def_file == NULL? 1 : 0);
-		}
+	if (ret)
+		goto err_free;
 
-		if (log_def_file == NULL) {
-			/* write the binary log data to a file */
-			ret = write(fd, res.data,
-				    sizeof(*res.data) * res.hdr.count);
-			if (ret < 0)
-				return ret;
-		} else {
-			log_file = fdopen(fd, "w");
-			if (!log_file)
-				goto ret_free_log_defs;
+	lf->interval = LOG_FOLLOW_MIN_INTERVAL;
+	return lf;
 
-			/* parse the log data and write it to a file */
-			ret = write_parsed_log(res.data, res.hdr.count,
-					       entry_idx, &defs,
-					       SWITCHTEC_LOG_PARSE_TYPE_APP,
-					       log_file,
-					       get_ts_factor(dev->gen));
-			if (ret < 0)
-				goto ret_free_log_defs;
+err_free:
+	log_a_free(lf);
+	free(lf);
+	return NULL;
+}
 
-			entry_idx += res.hdr.count;
-		}
+/**
+ * @brief Retrieve the app log entries logged since the last poll
+ * @param[in]  follow - Follow handle
+ * @param[out] lost   - Number of entries overwritten by the firmware
+ *			before they could be retrieved (may be NULL)
+ * @return Number of new entries written on success, negative on failure
+ *
+ * Lost entries can only be detected on firmware that reports log
+ * overflow; otherwise \p lost is always zero.
+ */
+int switchtec_log_follow_poll(struct switchtec_log_follow *follow,
+			      unsigned int *lost)
+{
+	unsigned int read;
+	int ret;
 
-		read += le32toh(res.hdr.count);
-		cmd.start = res.hdr.next_start;
-	}
+	ret = log_a_read(follow, &read, lost);
+	if (ret)
+		return -1;
 
-	ret = 0;
+	/* poll faster while the log is busy and back off when it's idle */
+	if (read)
+		follow->interval /= 4;
+	else
+		follow->interval *= 2;
 
-ret_free_log_defs:
-	free_log_defs(&defs);
-	return ret;
+	if (follow->interval < LOG_FOLLOW_MIN_INTERVAL)
+		follow->interval = LOG_FOLLOW_MIN_INTERVAL;
+	if (follow->interval > LOG_FOLLOW_MAX_INTERVAL)
+		follow->interval = LOG_FOLLOW_MAX_INTERVAL;
+
+	return read;
 }
 
-static int log_b_to_file(struct switchtec_dev *dev, int sub_cmd_id, int fd)
+/**
+ * @brief Get the time to wait before the next call to
+ *	switchtec_log_follow_poll()
+ * @param[in] follow - Follow handle
+ * @return Interval in milliseconds
+ *
+ * The interval shrinks when new entries were found by the last poll and
+ * grows while the log is idle.
+ */
+unsigned int switchtec_log_follow_interval(struct switchtec_log_follow *follow)
+{
+	return follow->interval;
+}
+
+/**
+ * @brief Stop following the app log and free the handle
+ * @param[in] follow - Follow handle
+ */
+void switchtec_log_follow_close(struct switchtec_log_follow *follow)
+{
+	if (!follow)
+		return;
+
+	log_a_free(follow);
+	free(follow);
+}
+
+static int parse_log_header(FILE *bin_log_file, uint32_t *fw_version,
+			    uint32_t *sdk_version, struct log_time_sync *sync,
+			    bool *synced)
 {
+	struct log_file_header header;
 	int ret;
-	int read = 0;
-	struct log_b_retr_result res;
-	struct log_b_retr cmd = {
-		.sub_cmd_id = sub_cmd_id,
-		.offset = 0,
-		.length = htole32(sizeof(res.data)),
-	};
 
-	res.hdr.remain = sizeof(res.data);
+	if (synced)
+		*synced = false;
 
-	while (res.hdr.remain) {
-		ret = switchtec_cmd(dev, MRPC_FWLOGRD, &cmd, sizeof(cmd),
-				    &res, sizeof(res));
-		if (ret)
-			return -1;
+	ret = fread(&header, sizeof(header), 1, bin_log_file);
+	if (ret <= 0) {
+		errno = EBADF;
+		return -EBADF;
+	}
 
-		ret = write(fd, res.data, res.hdr.length);
-		if (ret < 0)
-			return ret;
+	if (memcmp(log_file_magic, header.magic, 8)) {
+		rewind(bin_log_file);
+		*fw_version = 0;
+		*sdk_version = 0;
+		return 0;
+	}
 
-		read += le32toh(res.hdr.length);
-		cmd.offset = htole32(read);
+	*fw_version = header.fw_version;
+	*sdk_version = header.sdk_version;
+
+	if (sync && (header.flags & LOG_FILE_HDR_TIME_SYNC)) {
+		sync->boot_ns = ((uint64_t)header.boot_ns_hi << 32) |
+				header.boot_ns_lo;
+		sync->err_us = header.sync_err_us;
+		*synced = true;
 	}
 
 	return 0;
 }
 
-static int log_c_to_file(struct switchtec_dev *dev, int sub_cmd_id, int fd)
+/*
+ * Pick the device generation to decode timestamps with: the one recorded
+ * in the log (or definition) file wins over the one given by the user.
+ */
+static enum switchtec_gen parse_log_gen(uint32_t fw_version_log,
+					uint32_t fw_version_def,
+					enum switchtec_gen gen,
+					bool *gen_ignored, bool *gen_unknown)
 {
-	int ret;
-	struct log_cmd {
-		uint8_t subcmd;
-		uint8_t rsvd[3];
-	} cmd = {};
+	enum switchtec_gen gen_file;
 
-	struct log_reply {
-		uint8_t reason;
-		uint8_t rsvd[3];
-		uint32_t nvlog_version;
-		uint32_t thread_handle;
-		uint32_t fw_version;
-		uint32_t timestamp1;
-		uint32_t timestamp2;
-	} reply;
+	if (fw_version_log)
+		gen_file = switchtec_fw_version_to_gen(fw_version_log);
+	else
+		gen_file = switchtec_fw_version_to_gen(fw_version_def);
+
+	if (gen_file != SWITCHTEC_GEN_UNKNOWN &&
+	    gen != SWITCHTEC_GEN_UNKNOWN) {
+		*gen_ignored = true;
+	} else if (gen_file == SWITCHTEC_GEN_UNKNOWN &&
+		   gen == SWITCHTEC_GEN_UNKNOWN) {
+		*gen_unknown = true;
+	} else if (gen != SWITCHTEC_GEN_UNKNOWN) {
+		gen_file = gen;
+	}
+
+	return gen_file;
+}
+
+/* Number of binary log entries parsed per read */
+#define PARSE_LOG_CHUNK 4096
+
+/**
+ * @brief Parse a binary app log or mailbox log to a text file
+ * @param[in] bin_log_file    - Binary log input file
+ * @param[in] log_def_file    - Log definition file
+ * @param[in] parsed_log_file - Parsed output file
+ * @param[in] log_type        - log type
+ * @param[in] gen             - device generation
+ * @param[out] info           - log file information
+ * @return 0 on success, error code on failure
+ */
+int switchtec_parse_log(FILE *bin_log_file, FILE *log_def_file,
+			FILE *parsed_log_file,
+			enum switchtec_log_parse_type log_type,
+			enum switchtec_gen gen,
+			struct switchtec_log_file_info *info)
+{
+	return switchtec_parse_log_parallel(bin_log_file, log_def_file,
+					    parsed_log_file, log_type, gen,
+					    1, info);
+}
+
+static int parse_log(FILE *bin_log_file, FILE *log_def_file,
+		     FILE *parsed_log_file,
+		     enum switchtec_log_parse_type log_type,
+		     enum switchtec_gen gen, unsigned int nr_threads,
+		     unsigned int flags, struct switchtec_log_file_info *info)
+{
+	bool columnar = flags & SWITCHTEC_LOG_PARSE_COLUMNAR;
+	bool wall_time = !columnar && (flags & SWITCHTEC_LOG_PARSE_WALL_TIME);
+	struct log_time_sync sync = {};
+	bool synced = false;
+	int ret;
+	struct log_a_data *log_data = NULL;
+	struct log_defs defs = {};
+	struct log_fmt_prog prog = {};
+	struct log_fmt_out out = {};
+	struct log_col_writer col = {};
+	size_t count;
+	int entry_idx = 0;
+	uint32_t fw_version_log = 0;
+	uint32_t sdk_version_log = 0;
+	uint32_t fw_version_def;
+	uint32_t sdk_version_def;
+	enum switchtec_gen gen_file;
+	bool gen_ignored = false;
+	bool gen_unknown = false;
+
+	if (info)
+		memset(info, 0, sizeof(*info));
+
+	if ((log_type != SWITCHTEC_LOG_PARSE_TYPE_APP) &&
+	    (log_type != SWITCHTEC_LOG_PARSE_TYPE_MAILBOX) &&
+	    (log_type != SWITCHTEC_LOG_PARSE_TYPE_FTDC)) {
+		errno = EINVAL;
+		return -errno;
+	}
+
+	if (log_type != SWITCHTEC_LOG_PARSE_TYPE_FTDC)
+	{
+		ret = parse_log_header(bin_log_file, &fw_version_log,
+			&sdk_version_log, &sync, &synced);
+		if (ret)
+			return ret;
+	}
+
+	ret = log_def_parse_header(log_def_file, &fw_version_def,
+				   &sdk_version_def);
+	if (ret)
+		return ret;
+
+	if (log_type == SWITCHTEC_LOG_PARSE_TYPE_MAILBOX) {
+		fw_version_log = fw_version_def;
+		sdk_version_log = sdk_version_def;
+	}
+
+	if (info) {
+		info->def_fw_version = fw_version_def;
+		info->def_sdk_version = sdk_version_def;
+
+		info->log_fw_version = fw_version_log;
+		info->log_sdk_version = sdk_version_log;
+	}
+	/* read the log definition file into defs */
+	if (log_type == SWITCHTEC_LOG_PARSE_TYPE_APP || log_type == SWITCHTEC_LOG_PARSE_TYPE_FTDC)
+		ret = log_defs_read(log_def_file, SWITCHTEC_LOG_DEF_TYPE_APP,
+				    fw_version_def, sdk_version_def, &defs);
+	else
+		ret = log_defs_read(log_def_file,
+				    SWITCHTEC_LOG_DEF_TYPE_MAILBOX,
+				    fw_version_def, sdk_version_def, &defs);
+
+	if (ret < 0)
+		return ret;
+
+	gen_file = parse_log_gen(fw_version_log, fw_version_def, gen,
+				 &gen_ignored, &gen_unknown);
+
+	if (wall_time && !synced) {
+		errno = SWITCHTEC_ERR_LOG_NO_TIME_SYNC;
+		ret = -1;
+		goto ret_free_log_defs;
+	} else if (wall_time && gen_file == SWITCHTEC_GEN_UNKNOWN) {
+		if (info)
+			info->gen_unknown = true;
+		errno = EINVAL;
+		ret = -1;
+		goto ret_free_log_defs;
+	}
+
+	if (columnar)
+		ret = 0;
+	else if (log_type != SWITCHTEC_LOG_PARSE_TYPE_FTDC)
+		ret = append_log_header(fileno(parsed_log_file), sdk_version_log,
+					fw_version_log, 0, NULL);
+	else
+		ret = append_ftdc_log_header(fileno(parsed_log_file), sdk_version_def,
+					fw_version_def);
+
+	if (ret < 0)
+		goto ret_free_log_defs;
+
+	ret = -1;
+	log_data = malloc(PARSE_LOG_CHUNK * sizeof(*log_data));
+	if (!log_data)
+		goto ret_free_log_defs;
+
+	if (log_fmt_prog_init(&prog, &defs, log_type,
+			      get_ts_factor(gen_file)))
+		goto ret_free_log_defs;
+
+	prog.wall_time = wall_time;
+	prog.boot_ns = sync.boot_ns;
+
+	if (columnar) {
+		if (log_col_init(&col, &prog, parsed_log_file, fw_version_log,
+				 sdk_version_log))
+			goto ret_free_log_defs;
+		ret = 1;
+	} else {
+		if (log_fmt_out_init(&out, parsed_log_file))
+			goto ret_free_log_defs;
+
+		ret = log_fmt_write_parallel(&prog, &out, bin_log_file,
+					     nr_threads, &count);
+		if (ret < 0)
+			goto ret_free_log_defs;
+	}
+
+	if (!ret && info && count) {
+		info->gen_ignored = gen_ignored;
+		info->gen_unknown = gen_unknown;
+	}
+
+	/* parse the (remaining) log entries a chunk at a time */
+	while ((count = fread(log_data, sizeof(*log_data), PARSE_LOG_CHUNK,
+			      bin_log_file)) > 0) {
+		if (info) {
+			info->gen_ignored = gen_ignored;
+			info->gen_unknown = gen_unknown;
+		}
+
+		if (columnar) {
+			ret = log_col_write(&col, log_data, count);
+		} else {
+			ret = 0;
+			if (entry_idx == 0)
+				ret = log_fmt_write_heading(&prog, &out);
+			if (!ret)
+				ret = log_fmt_write(&prog, &out, log_data,
+						    count, entry_idx);
+		}
+		if (ret < 0)
+			goto ret_free_log_defs;
+
+		entry_idx += count;
+	}
+
+	if (columnar)
+		ret = log_col_finish(&col);
+	else
+		ret = log_fmt_out_flush(&out);
+
+	if (ret || fflush(parsed_log_file)) {
+		errno = SWITCHTEC_ERR_PARSED_LOG_WRITE_ERROR;
+		ret = -1;
+		goto ret_free_log_defs;
+	}
+
+	if (ferror(bin_log_file)) {
+		errno = SWITCHTEC_ERR_BIN_LOG_READ_ERROR;
+		ret = -1;
+	}
+
+	if (fw_version_def != fw_version_log ||
+	    sdk_version_def != sdk_version_log) {
+		if (info)
+			info->version_mismatch = true;
+		ret = ENOEXEC;
+	}
+
+ret_free_log_defs:
+	log_col_free(&col);
+	log_fmt_out_free(&out);
+	log_fmt_prog_free(&prog);
+	free(log_data);
+	log_defs_free(&defs);
+	return ret;
+}
+
+/**
+ * @brief Parse a binary app log or mailbox log to a text file using
+ *	multiple threads
+ * @param[in] bin_log_file    - Binary log input file
+ * @param[in] log_def_file    - Log definition file
+ * @param[in] parsed_log_file - Parsed output file
+ * @param[in] log_type        - log type
+ * @param[in] gen             - device generation
+ * @param[in] nr_threads      - number of threads, 0 for one per CPU
+ * @param[out] info           - log file information
+ * @return 0 on success, error code on failure
+ *
+ * The output is identical to switchtec_parse_log(). Threads are only
+ * used when \p bin_log_file is a regular file that can be mapped into
+ * memory, otherwise the log is parsed sequentially.
+ */
+int switchtec_parse_log_parallel(FILE *bin_log_file, FILE *log_def_file,
+				 FILE *parsed_log_file,
+				 enum switchtec_log_parse_type log_type,
+				 enum switchtec_gen gen,
+				 unsigned int nr_threads,
+				 struct switchtec_log_file_info *info)
+{
+	return parse_log(bin_log_file, log_def_file, parsed_log_file,
+			 log_type, gen, nr_threads, 0, info);
+}
+
+/**
+ * @brief Export a binary app log or mailbox log to a columnar file
+ * @param[in] bin_log_file    - Binary log input file
+ * @param[in] log_def_file    - Log definition file
+ * @param[in] col_file        - Columnar output file
+ * @param[in] log_type        - log type
+ * @param[in] gen             - device generation
+ * @param[out] info           - log file information
+ * @return 0 on success, error code on failure
+ *
+ * Instead of text, each entry is written as a row of decoded fields:
+ * timestamp, module, severity, entry ID, argument dwords and the index of
+ * its format string in a dictionary of the templates used by the log.
+ * Rows are written in groups of fixed size, see struct log_col_hdr for
+ * the file layout.
+ */
+int switchtec_parse_log_columnar(FILE *bin_log_file, FILE *log_def_file,
+				 FILE *col_file,
+				 enum switchtec_log_parse_type log_type,
+				 enum switchtec_gen gen,
+				 struct switchtec_log_file_info *info)
+{
+	return parse_log(bin_log_file, log_def_file, col_file, log_type,
+			 gen, 1, SWITCHTEC_LOG_PARSE_COLUMNAR, info);
+}
+
+/**
+ * @brief Parse a binary app log or mailbox log with options
+ * @param[in] bin_log_file    - Binary log input file
+ * @param[in] log_def_file    - Log definition file
+ * @param[in] parsed_log_file - Parsed output file
+ * @param[in] log_type        - log type
+ * @param[in] gen             - device generation
+ * @param[in] nr_threads      - number of threads, 0 for one per CPU
+ * @param[in] flags           - SWITCHTEC_LOG_PARSE_* flags
+ * @param[out] info           - log file information
+ * @return 0 on success, error code on failure
+ *
+ * With SWITCHTEC_LOG_PARSE_WALL_TIME, timestamps are printed as UTC date
+ * and time using the host time correlation recorded when the log was
+ * dumped. Logs without it fail with SWITCHTEC_ERR_LOG_NO_TIME_SYNC.
+ */
+int switchtec_parse_log_ex(FILE *bin_log_file, FILE *log_def_file,
+			   FILE *parsed_log_file,
+			   enum switchtec_log_parse_type log_type,
+			   enum switchtec_gen gen, unsigned int nr_threads,
+			   unsigned int flags,
+			   struct switchtec_log_file_info *info)
+{
+	return parse_log(bin_log_file, log_def_file, parsed_log_file,
+			 log_type, gen, nr_threads, flags, info);
+}
+
+/**
+ * @brief One input of a merge of app logs
+ */
+struct log_merge_src {
+	FILE *file;
+	struct log_defs defs;
+	struct log_fmt_prog prog;
+	struct log_a_data *buf;
+	size_t len;		//!< entries in buf
+	size_t pos;		//!< next entry in buf
+	unsigned int entry_idx;	//!< index of the next entry in its log
+	uint64_t time;		//!< wall clock time of the next entry
+};
+
+/* Load the current entry of a source; returns 0 at the end of its log */
+static int log_merge_load(struct log_merge_src *src)
+{
+	const uint32_t *d;
+
+	if (src->pos >= src->len) {
+		src->len = fread(src->buf, sizeof(*src->buf), PARSE_LOG_CHUNK,
+				 src->file);
+		src->pos = 0;
+		if (!src->len) {
+			if (ferror(src->file)) {
+				errno = SWITCHTEC_ERR_BIN_LOG_READ_ERROR;
+				return -1;
+			}
+			return 0;
+		}
+	}
+
+	d = src->buf[src->pos].data;
+	src->time = src->prog.boot_ns +
+		(((uint64_t)d[0] << 32) | d[1]) * src->prog.ts_factor / 100;
+	return 1;
+}
+
+static int log_merge_next(struct log_merge_src *src)
+{
+	src->pos++;
+	src->entry_idx++;
+	return log_merge_load(src);
+}
+
+static void log_merge_sift(struct log_merge_src **heap, int n, int i)
+{
+	struct log_merge_src *tmp;
+	int c;
+
+	while ((c = 2 * i + 1) < n) {
+		if (c + 1 < n && heap[c + 1]->time < heap[c]->time)
+			c++;
+		if (heap[i]->time <= heap[c]->time)
+			break;
+
+		tmp = heap[i];
+		heap[i] = heap[c];
+		heap[c] = tmp;
+		i = c;
+	}
+}
+
+static int log_merge_open(struct log_merge_src *src, FILE *bin_log_file,
+			  FILE *log_def_file, const char *name,
+			  enum switchtec_gen gen)
+{
+	uint32_t fw_version_log, sdk_version_log;
+	uint32_t fw_version_def, sdk_version_def;
+	struct log_time_sync sync;
+	bool synced, gen_ignored = false, gen_unknown = false;
+	int ts_factor;
+	int ret;
+
+	src->file = bin_log_file;
+
+	ret = parse_log_header(bin_log_file, &fw_version_log,
+			       &sdk_version_log, &sync, &synced);
+	if (ret)
+		return ret;
+
+	if (!synced) {
+		errno = SWITCHTEC_ERR_LOG_NO_TIME_SYNC;
+		return -1;
+	}
+
+	ret = log_def_parse_header(log_def_file, &fw_version_def,
+				   &sdk_version_def);
+	if (ret)
+		return ret;
+
+	ret = log_defs_read(log_def_file, SWITCHTEC_LOG_DEF_TYPE_APP,
+			    fw_version_def, sdk_version_def, &src->defs);
+	if (ret < 0)
+		return ret;
+
+	ts_factor = get_ts_factor(parse_log_gen(fw_version_log,
+						fw_version_def, gen,
+						&gen_ignored, &gen_unknown));
+	if (!ts_factor) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (log_fmt_prog_init(&src->prog, &src->defs,
+			      SWITCHTEC_LOG_PARSE_TYPE_APP, ts_factor))
+		return -1;
+
+	src->prog.wall_time = true;
+	src->prog.boot_ns = sync.boot_ns;
+	src->prog.src = name;
+
+	src->buf = malloc(PARSE_LOG_CHUNK * sizeof(*src->buf));
+	if (!src->buf)
+		return -1;
+
+	return log_merge_load(src);
+}
+
+/**
+ * @brief Merge binary app logs from several devices into one text file
+ * @param[in] bin_log_files   - Binary app log files
+ * @param[in] log_def_files   - Log definition file for each log
+ * @param[in] names           - Name printed in front of each log's entries
+ * @param[in] nr_logs         - Number of logs
+ * @param[in] parsed_log_file - Parsed output file
+ * @param[in] gen             - device generation, for logs that don't
+ *				record it
+ * @return 0 on success, negative value on failure
+ *
+ * Entries are converted to wall clock time with the host time
+ * correlation recorded in each log and written in time order. Entry
+ * numbers are those of the entries within their own log. Every log must
+ * have a host time correlation, otherwise this fails with
+ * SWITCHTEC_ERR_LOG_NO_TIME_SYNC.
+ */
+int switchtec_parse_log_merge(FILE **bin_log_files, FILE **log_def_files,
+			      const char **names, int nr_logs,
+			      FILE *parsed_log_file, enum switchtec_gen gen)
+{
+	struct log_merge_src *srcs, **heap, *src;
+	struct log_fmt_out out = {};
+	int i, n = 0, ret = -1;
+
+	srcs = calloc(nr_logs, sizeof(*srcs));
+	heap = calloc(nr_logs, sizeof(*heap));
+	if (!srcs || !heap)
+		goto out_free;
+
+	for (i = 0; i < nr_logs; i++) {
+		ret = log_merge_open(&srcs[i], bin_log_files[i],
+				     log_def_files[i], names[i], gen);
+		if (ret < 0)
+			goto out_free;
+		if (ret)
+			heap[n++] = &srcs[i];
+	}
+
+	ret = -1;
+	if (log_fmt_out_init(&out, parsed_log_file))
+		goto out_free;
+
+	if (n && log_fmt_write_heading(&heap[0]->prog, &out))
+		goto out_free;
+
+	for (i = n / 2 - 1; i >= 0; i--)
+		log_merge_sift(heap, n, i);
+
+	while (n) {
+		src = heap[0];
+
+		if (log_fmt_write(&src->prog, &out, &src->buf[src->pos], 1,
+				  src->entry_idx))
+			goto out_free;
+
+		ret = log_merge_next(src);
+		if (ret < 0)
+			goto out_free;
+		if (!ret)
+			heap[0] = heap[--n];
+
+		log_merge_sift(heap, n, 0);
+	}
+
+	ret = 0;
+	if (log_fmt_out_flush(&out) || fflush(parsed_log_file)) {
+		errno = SWITCHTEC_ERR_PARSED_LOG_WRITE_ERROR;
+		ret = -1;
+	}
+
+out_free:
+	log_fmt_out_free(&out);
+	for (i = 0; srcs && i < nr_logs; i++) {
+		log_fmt_prog_free(&srcs[i].prog);
+		log_defs_free(&srcs[i].defs);
+		free(srcs[i].buf);
+	}
+	free(srcs);
+	free(heap);
+	return ret;
+}
+
+/* Number of binary log entries covered by one index bucket */
+#define LOG_INDEX_BUCKET 1024
+#define LOG_INDEX_VERSION 2
+#define LOG_INDEX_MAX_MODULES 4096
+
+/**
+ * @brief Header of a binary log index file
+ */
+struct log_index_hdr {
+	uint8_t magic[8];
+	uint32_t version;
+	uint32_t bucket_entries;	//!< entries per bucket
+	uint64_t log_size;		//!< size of the indexed log file
+	uint32_t data_off;		//!< offset of the first entry
+	uint32_t nr_entries;
+	uint32_t nr_buckets;
+	uint32_t head_crc;		//!< CRC of the first bucket's entries
+	uint64_t ts_min;		//!< oldest timestamp in the log
+	uint64_t ts_max;		//!< newest timestamp in the log
+	uint32_t tail_crc;		//!< CRC of the last bucket's entries
+	uint32_t rsvd;
+};
+
+/**
+ * @brief Summary of a run of consecutive binary log entries
+ */
+struct log_index_bucket {
+	uint64_t ts_min;
+	uint64_t ts_max;
+	uint32_t sev_mask;		//!< severities present
+	uint32_t rsvd;
+	uint64_t mod_mask[LOG_INDEX_MAX_MODULES / 64];	//!< modules present
+};
+
+static const uint8_t log_index_magic[8] = {
+	'S', 'W', 'L', 'O', 'G', 'I', 'D', 'X'
+};
+
+static inline uint64_t log_entry_ts(const struct log_a_data *e)
+{
+	return ((uint64_t)e->data[0] << 32) | e->data[1];
+}
+
+static inline unsigned int log_entry_mod(const struct log_a_data *e)
+{
+	return (e->data[2] >> 16) & 0xFFF;
+}
+
+static inline unsigned int log_entry_sev(const struct log_a_data *e)
+{
+	return (e->data[2] >> 28) & 0xF;
+}
+
+static uint32_t log_index_crc(const struct log_a_data *log_data,
+			      size_t count)
+{
+	return crc32((const uint8_t *)log_data, count * sizeof(*log_data),
+		     0, 1, 1);
+}
+
+/*
+ * Check that the first and last buckets of the log still hold the
+ * entries the index was built from, so a log dumped again to the same
+ * path with the same size is not queried with a stale index.
+ */
+static int log_index_check_data(FILE *bin_log_file,
+				const struct log_index_hdr *hdr)
+{
+	struct log_a_data *log_data;
+	long tail_off;
+	size_t count;
+	int ret = -1;
+
+	if (!hdr->nr_buckets) {
+		if (!hdr->nr_entries)
+			return 0;
+		errno = SWITCHTEC_ERR_LOG_INDEX_INVAL;
+		return -1;
+	}
+
+	log_data = malloc(LOG_INDEX_BUCKET * sizeof(*log_data));
+	if (!log_data)
+		return -1;
+
+	tail_off = hdr->data_off + (long)(hdr->nr_buckets - 1) *
+		   LOG_INDEX_BUCKET * sizeof(*log_data);
+
+	if (fseek(bin_log_file, hdr->data_off, SEEK_SET))
+		goto out;
+	count = fread(log_data, sizeof(*log_data), LOG_INDEX_BUCKET,
+		      bin_log_file);
+	if (!count || log_index_crc(log_data, count) != hdr->head_crc)
+		goto out_inval;
+
+	if (fseek(bin_log_file, tail_off, SEEK_SET))
+		goto out;
+	count = fread(log_data, sizeof(*log_data), LOG_INDEX_BUCKET,
+		      bin_log_file);
+	if (!count || log_index_crc(log_data, count) != hdr->tail_crc)
+		goto out_inval;
+
+	ret = 0;
+	goto out;
+
+out_inval:
+	errno = SWITCHTEC_ERR_LOG_INDEX_INVAL;
+out:
+	free(log_data);
+	return ret;
+}
 
-	cmd.subcmd = sub_cmd_id;
+static int log_file_size(FILE *file, uint64_t *size)
+{
+	long pos, end;
 
-	ret = switchtec_cmd(dev, MRPC_FWLOGRD, &cmd, sizeof(cmd),
-			    &reply, sizeof(reply));
-	if (ret)
+	pos = ftell(file);
+	if (pos < 0 || fseek(file, 0, SEEK_END))
 		return -1;
 
-	ret = write(fd, &reply, sizeof(reply));
-	if (ret < 0)
-		return ret;
+	end = ftell(file);
+	if (end < 0 || fseek(file, pos, SEEK_SET))
+		return -1;
 
+	*size = end;
 	return 0;
 }
 
-static int log_d_to_file(struct switchtec_dev *dev, int sub_cmd_id, int fd)
+/**
+ * @brief Build an index of a binary app log
+ * @param[in] bin_log_file - Binary app log file
+ * @param[in] index_file   - File to write the index to
+ * @return 0 on success, negative value on failure
+ *
+ * The index splits the log into buckets of consecutive entries and
+ * records the time span, modules and severities found in each, so
+ * switchtec_log_query() only needs to read the buckets that can match.
+ * It also records a CRC of the first and last bucket, so an index no
+ * longer matching its log is detected.
+ */
+int switchtec_log_index_build(FILE *bin_log_file, FILE *index_file)
 {
+	struct log_index_hdr hdr = {
+		.version = LOG_INDEX_VERSION,
+		.bucket_entries = LOG_INDEX_BUCKET,
+		.ts_min = UINT64_MAX,
+	};
+	struct log_index_bucket bucket;
+	struct log_a_data *log_data;
+	uint32_t fw_version, sdk_version;
+	unsigned int mod;
+	size_t count, i;
+	uint64_t ts;
+	long off;
 	int ret;
-	int read = 0;
 
-	struct log_ftdc_retr_result res;
-	struct log_ftdc_retr cmd = {
-		.sub_cmd_id = sub_cmd_id,
-		.reserved = 0,
-		.req_seq = 0,
-	};
-	uint32_t length = sizeof(res.data);
+	rewind(bin_log_file);
+	ret = parse_log_header(bin_log_file, &fw_version, &sdk_version,
+			       NULL, NULL);
+	if (ret)
+		return ret;
 
-	cmd.req_seq = 0;
-	res.data[1] = 0;
+	off = ftell(bin_log_file);
+	if (off < 0 || log_file_size(bin_log_file, &hdr.log_size))
+		return -1;
+	hdr.data_off = off;
 
-	while ( !(res.data[1]) ) {
-		ret = switchtec_cmd(dev, MRPC_FTDC_LOG_DUMP, &cmd, sizeof(cmd),
-				    &res, sizeof(res));
-		if (ret)
-			return -1;
+	log_data = malloc(LOG_INDEX_BUCKET * sizeof(*log_data));
+	if (!log_data)
+		return -1;
 
-		ret = write(fd, res.data, (res.data[0]+1)*4);
-		if (ret < 0)
-			return ret;
+	ret = -1;
 
-		read += length;
-		cmd.req_seq++;
-	}
+	/* the header is written again once the totals are known */
+	rewind(index_file);
+	if (fwrite(&hdr, sizeof(hdr), 1, index_file) != 1)
+		goto out;
 
-	return 0;
-}
+	while ((count = fread(log_data, sizeof(*log_data), LOG_INDEX_BUCKET,
+			      bin_log_file)) > 0) {
+		memset(&bucket, 0, sizeof(bucket));
+		bucket.ts_min = UINT64_MAX;
 
-static int log_ram_flash_to_file(struct switchtec_dev *dev,
-				 int gen5_cmd, int gen4_cmd, int gen4_cmd_lgcy,
-				 int fd, FILE *log_def_file,
-				 struct switchtec_log_file_info *info)
-{
-	int ret;
+		for (i = 0; i < count; i++) {
+			ts = log_entry_ts(&log_data[i]);
+			mod = log_entry_mod(&log_data[i]);
 
-	if (switchtec_is_gen5(dev) || switchtec_is_gen6(dev)) {
-		return log_a_to_file(dev, gen5_cmd, fd, log_def_file,
-				     info);
-	} else {
-		ret = log_a_to_file(dev, gen4_cmd, fd, log_def_file,
-				    info);
+			if (ts < bucket.ts_min)
+				bucket.ts_min = ts;
+			if (ts > bucket.ts_max)
+				bucket.ts_max = ts;
 
-		/* somehow hardware returns ERR_LOGC_PORT_ARDY_BIND
-		 * instead of ERR_SUBCMD_INVALID if this subcommand
-		 * is not supported, so we fall back to legacy
-		 * subcommand on ERR_LOGC_PORT_ARDY_BIND error as well
-		 */
-		if (ret > 0 &&
-		    (ERRNO_MRPC(errno) == ERR_LOGC_PORT_ARDY_BIND ||
-		     ERRNO_MRPC(errno) == ERR_SUBCMD_INVALID))
-			ret = log_a_to_file(dev, gen4_cmd_lgcy, fd,
-					    log_def_file, info);
+			bucket.sev_mask |= 1 << log_entry_sev(&log_data[i]);
+			bucket.mod_mask[mod / 64] |= 1ULL << (mod % 64);
+		}
 
-		return ret;
+		if (bucket.ts_min < hdr.ts_min)
+			hdr.ts_min = bucket.ts_min;
+		if (bucket.ts_max > hdr.ts_max)
+			hdr.ts_max = bucket.ts_max;
+
+		hdr.tail_crc = log_index_crc(log_data, count);
+		if (!hdr.nr_buckets)
+			hdr.head_crc = hdr.tail_crc;
+
+		hdr.nr_entries += count;
+		hdr.nr_buckets++;
+
+		if (fwrite(&bucket, sizeof(bucket), 1, index_file) != 1)
+			goto out;
 	}
+
+	if (ferror(bin_log_file)) {
+		errno = SWITCHTEC_ERR_BIN_LOG_READ_ERROR;
+		goto out;
+	}
+
+	memcpy(hdr.magic, log_index_magic, sizeof(hdr.magic));
+	rewind(index_file);
+	if (fwrite(&hdr, sizeof(hdr), 1, index_file) != 1 ||
+	    fflush(index_file))
+		goto out;
+
+	ret = 0;
+
+out:
+	free(log_data);
+	return ret;
 }
 
-/**
- * @brief Dump the Switchtec log data to a file
- * @param[in]  dev          - Switchtec device handle
- * @param[in]  type         - Type of log data to dump
- * @param[in]  fd           - File descriptor to dump the data to
- * @param[in]  log_def_file - Log definition file
- * @param[out] info         - Log file information
- * @return 0 on success, error code on failure
- */
-int switchtec_log_to_file(struct switchtec_dev *dev,
-		enum switchtec_log_type type, int fd, FILE *log_def_file,
-		struct switchtec_log_file_info *info)
+static int log_query_module(struct log_defs *defs, const char *module)
 {
-	if (info)
-		memset(info, 0, sizeof(*info));
+	char *end;
+	long id;
+	int i;
 
-	switch (type) {
-	case SWITCHTEC_LOG_RAM:
-		return log_ram_flash_to_file(dev,
-					     MRPC_FWLOGRD_RAM_GEN5,
-					     MRPC_FWLOGRD_RAM_WITH_FLAG,
-					     MRPC_FWLOGRD_RAM,
-					     fd, log_def_file, info);
-	case SWITCHTEC_LOG_FLASH:
-		return log_ram_flash_to_file(dev,
-					     MRPC_FWLOGRD_FLASH_GEN5,
-					     MRPC_FWLOGRD_FLASH_WITH_FLAG,
-					     MRPC_FWLOGRD_FLASH,
-					     fd, log_def_file, info);
-	case SWITCHTEC_LOG_FTDC:
-		return log_d_to_file(dev, MRPC_FWLOGRD_RAM, fd);
-	case SWITCHTEC_LOG_MEMLOG:
-		return log_b_to_file(dev, MRPC_FWLOGRD_MEMLOG, fd);
-	case SWITCHTEC_LOG_REGS:
-		return log_b_to_file(dev, MRPC_FWLOGRD_REGS, fd);
-	case SWITCHTEC_LOG_THRD_STACK:
-		return log_b_to_file(dev, MRPC_FWLOGRD_THRD_STACK, fd);
-	case SWITCHTEC_LOG_SYS_STACK:
-		return log_b_to_file(dev, MRPC_FWLOGRD_SYS_STACK, fd);
-	case SWITCHTEC_LOG_THRD:
-		return log_b_to_file(dev, MRPC_FWLOGRD_THRD, fd);
-	case SWITCHTEC_LOG_NVHDR:
-		return log_c_to_file(dev, MRPC_FWLOGRD_NVHDR, fd);
-	};
+	for (i = 0; i < defs->num_alloc; i++) {
+		if (defs->module_defs[i].mod_name &&
+		    !strcasecmp(defs->module_defs[i].mod_name, module))
+			return i;
+	}
+
+	id = strtol(module, &end, 0);
+	if (*module && !*end && id >= 0 && id < LOG_INDEX_MAX_MODULES)
+		return id;
 
 	errno = EINVAL;
-	return -errno;
+	return -1;
 }
 
-static int parse_log_header(FILE *bin_log_file, uint32_t *fw_version,
-			    uint32_t *sdk_version)
+static bool log_query_match(const struct log_a_data *e, int mod_id,
+			    unsigned int sev_mask, uint64_t ts_lo)
 {
-	struct log_header {
-		uint8_t magic[8];
-		uint32_t fw_version;
-		uint32_t sdk_version;
-		uint32_t flags;
-		uint32_t rsvd[3];
-	} header;
-
-	char sig[8] = {'S', 'W', 'M', 'C', 'L', 'O', 'G', 'F'};
-	int ret;
-
-	ret = fread(&header, sizeof(header), 1, bin_log_file);
-	if (ret <= 0) {
-		errno = EBADF;
-		return -EBADF;
-	}
+	if (mod_id >= 0 && log_entry_mod(e) != mod_id)
+		return false;
+	if (sev_mask && !(sev_mask & (1 << log_entry_sev(e))))
+		return false;
 
-	if (memcmp(sig, header.magic, 8)) {
-		rewind(bin_log_file);
-		*fw_version = 0;
-		*sdk_version = 0;
-		return 0;
-	}
+	return log_entry_ts(e) >= ts_lo;
+}
 
-	*fw_version = header.fw_version;
-	*sdk_version = header.sdk_version;
+static bool log_query_bucket(const struct log_index_bucket *b, int mod_id,
+			     unsigned int sev_mask, uint64_t ts_lo)
+{
+	if (mod_id >= 0 &&
+	    !(b->mod_mask[mod_id / 64] & (1ULL << (mod_id % 64))))
+		return false;
+	if (sev_mask && !(sev_mask & b->sev_mask))
+		return false;
 
-	return 0;
+	return b->ts_max >= ts_lo;
 }
 
 /**
- * @brief Parse a binary app log or mailbox log to a text file
- * @param[in] bin_log_file    - Binary log input file
- * @param[in] log_def_file    - Log definition file
- * @param[in] parsed_log_file - Parsed output file
- * @param[in] log_type        - log type
- * @param[in] gen             - device generation
- * @param[out] info           - log file information
- * @return 0 on success, error code on failure
+ * @brief Parse the entries of a binary app log that match a query
+ * @param[in]  bin_log_file    - Binary app log file
+ * @param[in]  index_file      - Index built by switchtec_log_index_build()
+ * @param[in]  log_def_file    - Log definition file
+ * @param[in]  parsed_log_file - Parsed output file
+ * @param[in]  gen             - device generation
+ * @param[in]  query           - entries to select
+ * @param[out] info            - log file information
+ * @return Number of matching entries on success, negative value on failure
+ *
+ * Matching entries keep the entry numbers they have in the full parsed
+ * log. Fails with SWITCHTEC_ERR_LOG_INDEX_INVAL if \p index_file is not
+ * a valid index of \p bin_log_file, in which case it should be rebuilt.
  */
-int switchtec_parse_log(FILE *bin_log_file, FILE *log_def_file,
-			FILE *parsed_log_file,
-			enum switchtec_log_parse_type log_type,
+int switchtec_log_query(FILE *bin_log_file, FILE *index_file,
+			FILE *log_def_file, FILE *parsed_log_file,
 			enum switchtec_gen gen,
+			const struct switchtec_log_query *query,
 			struct switchtec_log_file_info *info)
 {
-	int ret;
-	struct log_a_data log_data;
-	struct log_defs defs = {
-		.module_defs = NULL,
-		.num_alloc = 0};
-	int entry_idx = 0;
-	uint32_t fw_version_log = 0;
-	uint32_t sdk_version_log = 0;
-	uint32_t fw_version_def;
-	uint32_t sdk_version_def;
+	struct log_index_hdr hdr;
+	struct log_index_bucket bucket;
+	struct log_a_data *log_data = NULL;
+	struct log_defs defs = {};
+	struct log_fmt_prog prog = {};
+	struct log_fmt_out out = {};
+	uint32_t fw_version_log, sdk_version_log;
+	uint32_t fw_version_def, sdk_version_def;
 	enum switchtec_gen gen_file;
+	bool gen_ignored = false;
+	bool gen_unknown = false;
+	bool heading = false;
+	uint64_t log_size, ts_lo = 0, span;
+	unsigned int b, first, run, matches = 0;
+	size_t count, i;
+	int mod_id = -1;
+	int ts_factor;
+	int ret;
 
 	if (info)
 		memset(info, 0, sizeof(*info));
 
-	if ((log_type != SWITCHTEC_LOG_PARSE_TYPE_APP) &&
-	    (log_type != SWITCHTEC_LOG_PARSE_TYPE_MAILBOX) &&
-	    (log_type != SWITCHTEC_LOG_PARSE_TYPE_FTDC)) {
-		errno = EINVAL;
-		return -errno;
-	}
+	rewind(bin_log_file);
+	ret = parse_log_header(bin_log_file, &fw_version_log,
+			       &sdk_version_log, NULL, NULL);
+	if (ret)
+		return ret;
 
-	if (log_type != SWITCHTEC_LOG_PARSE_TYPE_FTDC)
-	{
-		ret = parse_log_header(bin_log_file, &fw_version_log,
-			&sdk_version_log);
-		if (ret)
-			return ret;
+	rewind(index_file);
+	if (log_file_size(bin_log_file, &log_size) ||
+	    fread(&hdr, sizeof(hdr), 1, index_file) != 1 ||
+	    memcmp(hdr.magic, log_index_magic, sizeof(hdr.magic)) ||
+	    hdr.version != LOG_INDEX_VERSION ||
+	    hdr.bucket_entries != LOG_INDEX_BUCKET ||
+	    hdr.log_size != log_size ||
+	    hdr.data_off != ftell(bin_log_file)) {
+		errno = SWITCHTEC_ERR_LOG_INDEX_INVAL;
+		return -1;
 	}
 
-	ret = parse_def_header(log_def_file, &fw_version_def,
-			       &sdk_version_def);
+	ret = log_index_check_data(bin_log_file, &hdr);
 	if (ret)
 		return ret;
 
-	if (log_type == SWITCHTEC_LOG_PARSE_TYPE_MAILBOX) {
-		fw_version_log = fw_version_def;
-		sdk_version_log = sdk_version_def;
-	}
+	ret = log_def_parse_header(log_def_file, &fw_version_def,
+				   &sdk_version_def);
+	if (ret)
+		return ret;
+
+	ret = log_defs_read(log_def_file, SWITCHTEC_LOG_DEF_TYPE_APP,
+			    fw_version_def, sdk_version_def, &defs);
+	if (ret < 0)
+		return ret;
+
+	gen_file = parse_log_gen(fw_version_log, fw_version_def, gen,
+				 &gen_ignored, &gen_unknown);
+	ts_factor = get_ts_factor(gen_file);
 
 	if (info) {
 		info->def_fw_version = fw_version_def;
 		info->def_sdk_version = sdk_version_def;
-
 		info->log_fw_version = fw_version_log;
 		info->log_sdk_version = sdk_version_log;
+		info->version_mismatch = fw_version_def != fw_version_log ||
+					 sdk_version_def != sdk_version_log;
+		info->gen_ignored = gen_ignored;
+		info->gen_unknown = gen_unknown;
 	}
-	/* read the log definition file into defs */
-	if (log_type == SWITCHTEC_LOG_PARSE_TYPE_APP || log_type == SWITCHTEC_LOG_PARSE_TYPE_FTDC)
-		ret = read_app_log_defs(log_def_file, &defs);
-	else
-		ret = read_mailbox_log_defs(log_def_file, &defs);
 
-	if (ret < 0)
-		return ret;
+	ret = -1;
 
-	if (log_type != SWITCHTEC_LOG_PARSE_TYPE_FTDC)
-		ret = append_log_header(fileno(parsed_log_file), sdk_version_log,
-					fw_version_log, 0);
-	else
-		ret = append_ftdc_log_header(fileno(parsed_log_file), sdk_version_def,
-					fw_version_def);
+	if (query->module) {
+		mod_id = log_query_module(&defs, query->module);
+		if (mod_id < 0)
+			goto out;
+	}
 
-	if (ret < 0)
-		return ret;
+	if (query->since_ns) {
+		/* timestamps can't be compared without the tick length */
+		if (!ts_factor) {
+			errno = EINVAL;
+			goto out;
+		}
 
-	/* parse each log entry */
-	while (fread(&log_data, sizeof(struct log_a_data), 1,
-		     bin_log_file) == 1) {
-		if (fw_version_log)
-			gen_file = switchtec_fw_version_to_gen(fw_version_log);
-		else
-			gen_file = switchtec_fw_version_to_gen(fw_version_def);
-
-		if (gen_file != SWITCHTEC_GEN_UNKNOWN &&
-		    gen != SWITCHTEC_GEN_UNKNOWN) {
-			if (info)
-				info->gen_ignored = true;
-		} else if (gen_file == SWITCHTEC_GEN_UNKNOWN &&
-			   gen == SWITCHTEC_GEN_UNKNOWN) {
-			if (info)
-				info->gen_unknown = true;
-		} else if (gen != SWITCHTEC_GEN_UNKNOWN) {
-			gen_file = gen;
+		span = query->since_ns * 100 / ts_factor;
+		if (span < hdr.ts_max)
+			ts_lo = hdr.ts_max - span;
+	}
+
+	log_data = malloc(LOG_INDEX_BUCKET * sizeof(*log_data));
+	if (!log_data)
+		goto out;
+
+	if (log_fmt_prog_init(&prog, &defs, SWITCHTEC_LOG_PARSE_TYPE_APP,
+			      ts_factor))
+		goto out;
+
+	if (log_fmt_out_init(&out, parsed_log_file))
+		goto out;
+
+	if (append_log_header(fileno(parsed_log_file), sdk_version_log,
+			      fw_version_log, 0, NULL) < 0)
+		goto out;
+
+	for (b = 0; b < hdr.nr_buckets; b++) {
+		if (fread(&bucket, sizeof(bucket), 1, index_file) != 1) {
+			errno = SWITCHTEC_ERR_LOG_INDEX_INVAL;
+			goto out;
 		}
 
-		ret = write_parsed_log(&log_data, 1, entry_idx, &defs,
-				       log_type, parsed_log_file,
-				       get_ts_factor(gen_file));
-		if (ret < 0)
-			goto ret_free_log_defs;
+		if (!log_query_bucket(&bucket, mod_id, query->sev_mask, ts_lo))
+			continue;
 
-		entry_idx++;
-	}
+		first = b * LOG_INDEX_BUCKET;
+		if (fseek(bin_log_file,
+			  hdr.data_off + (long)first * sizeof(*log_data),
+			  SEEK_SET))
+			goto out_read_err;
+
+		count = fread(log_data, sizeof(*log_data), LOG_INDEX_BUCKET,
+			      bin_log_file);
+		if (!count)
+			goto out_read_err;
+
+		/* format each run of consecutive matching entries at once */
+		for (i = 0; i < count; i += run) {
+			for (run = 0; i + run < count &&
+			     log_query_match(&log_data[i + run], mod_id,
+					     query->sev_mask, ts_lo); run++)
+				;
+
+			if (!run) {
+				run = 1;
+				continue;
+			}
 
-	if (ferror(bin_log_file)) {
-		errno = SWITCHTEC_ERR_BIN_LOG_READ_ERROR;
-		ret = -1;
+			if (!heading && log_fmt_write_heading(&prog, &out))
+				goto out;
+			heading = true;
+
+			if (log_fmt_write(&prog, &out, &log_data[i], run,
+					  first + i))
+				goto out;
+
+			matches += run;
+		}
 	}
 
-	if (fw_version_def != fw_version_log ||
-	    sdk_version_def != sdk_version_log) {
-		if (info)
-			info->version_mismatch = true;
-		ret = ENOEXEC;
+	if (log_fmt_out_flush(&out) || fflush(parsed_log_file)) {
+		errno = SWITCHTEC_ERR_PARSED_LOG_WRITE_ERROR;
+		goto out;
 	}
 
-ret_free_log_defs:
-	free_log_defs(&defs);
+	ret = matches;
+	goto out;
+
+out_read_err:
+	errno = SWITCHTEC_ERR_BIN_LOG_READ_ERROR;
+out:
+	log_fmt_out_free(&out);
+	log_fmt_prog_free(&prog);
+	free(log_data);
+	log_defs_free(&defs);
 	return ret;
 }
 
@@ -2177,6 +2910,20 @@ static int __switchtec_calc_lane_id(struct switchtec_status *port, int lane_id)
 	}
 }
 
+/**
+ * @brief Calculate the global lane ID for a lane of a port
+ * @param[in] port	Status of the port, from switchtec_status()
+ * @param[in] lane_id	Lane number within the port
+ * @return The lane id or -1 on error (with errno set appropriately)
+ *
+ * Unlike switchtec_calc_lane_id(), this does not query the device, so
+ * it is cheap to call for every lane of every port.
+ */
+int switchtec_calc_status_lane_id(struct switchtec_status *port, int lane_id)
+{
+	return __switchtec_calc_lane_id(port, lane_id);
+}
+
 /**
  * @brief Calculate the global lane ID for a lane within a physical port
  * @param[in] dev               Switchtec device handle
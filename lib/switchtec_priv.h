@@ -182,11 +182,49 @@ struct switchtec_dev {
 	gasptr_t gas_map;
 	size_t gas_map_size;
 
+	struct switchtec_fw_part_summary *fw_summary;
+	size_t fw_summary_size;
+	int fw_summary_nr_mcfg;
+
 	const struct switchtec_ops *ops;
 };
 
 extern const struct switchtec_mrpc switchtec_mrpc_table[MRPC_MAX_ID];
 
+/*
+ * Commands that may change what is programmed in (or running from)
+ * the flash partitions. Issuing any of these drops the cached
+ * firmware partition summary. The status and boot read-only query
+ * subcommands of the firmware download commands leave it alone.
+ */
+static inline bool switchtec_fw_cmd_changes_parts(uint32_t cmd,
+						  const void *payload,
+						  size_t payload_len)
+{
+	const uint8_t *sub = payload;
+
+	switch (cmd & SWITCHTEC_CMD_MASK) {
+	case MRPC_FWDNLD:
+		if (!payload_len)
+			return true;
+		if (sub[0] == MRPC_FWDNLD_GET_STATUS)
+			return false;
+		if (sub[0] == MRPC_FWDNLD_BOOT_RO)
+			return payload_len < 2 || sub[1];
+		return true;
+	case MRPC_FW_TX:
+	case MRPC_FW_TX_GEN5:
+	case MRPC_FW_TX_GEN6:
+		return !payload_len || sub[0] != MRPC_FWDNLD_GET_STATUS;
+	case MRPC_RESET:
+	case MRPC_ACT_IMG_IDX_SET:
+	case MRPC_ACT_IMG_IDX_SET_GEN5:
+		return true;
+	default:
+		return false;
+	}
+}
+
 static inline void version_to_string(uint32_t version, char *buf, size_t buflen)
 {
 	int major = version >> 24;